@@ -0,0 +1,528 @@
+/***************************************************************************************************************
+ * FILE: batch.c
+ *
+ * DESCRIPTION:
+ * Batch mode: runs many Myrtle scripts in one process, on a pool of worker threads. The scripts are listed in a
+ * manifest file, one per line, or are the *.myr files in a directory. Each script is a job, and the output of
+ * a job goes to the file named next to it in the manifest, or to the script's name with ".myr" replaced by
+ * ".out".
+ *
+ * Each worker owns an interpreter context (see myrtle.h) which it reuses for every job it runs, so the world,
+ * the compiled program and the output buffer are allocated once per worker rather than once per script.
+ *
+ * The jobs are shared out by work stealing. Every worker starts with an equal, contiguous range of the jobs in
+ * its own deque. A worker takes jobs from the front of its deque; when that is empty it becomes a thief and
+ * takes the back half of what is left in another worker's deque. Scripts of very different lengths therefore
+ * still keep every worker busy until the end, and the workers only touch each other's deques when one of them
+ * runs dry. Each deque has its own mutex, which is uncontended except while a steal is in progress.
+ *
+ * When the batch is done, the time taken by each job is written to the report in manifest order, followed by
+ * the totals and what each worker did.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * 20261016T2000 [JMW] workers run with one job
+ * 20261016T2200 [JMW] workers can run several jobs at a time in lanes
+ * 20261016T2300 [JMW] the report says how many commands -O removed
+ * 20261017T1300 [JMW] workers run one job at a time again; lanes were no faster
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261016T1900 [JMW] Initial revision.
+ **************************************************************************************************************/
+/* Threads, directories and the monotonic clock are POSIX, not Standard C, so ask for them before including
+ * anything. */
+#define _POSIX_C_SOURCE 200112L
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "batch.h"
+#include "bool.h"
+#include "globals.h"
+#include "myrtle.h"
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC GLOBAL CONSTANT DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+static const size_t BATCH_JOBS_INIT = 256;  /* Jobs allocated for at first. Doubles as the batch is read. */
+static const int    BATCH_LINE_MAX  = 4096; /* Longest line of a manifest.                               */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * One script of a batch.
+ *
+ * in_fname  -- The script.
+ * out_fname -- Where its output goes.
+ * status    -- TERM_NORM, or the TERM_ERR_* code the run returned.
+ * ms        -- How long the run took, in milliseconds.
+ * error     -- The message for 'status'. NULL if the run succeeded.
+ * commands  -- The number of commands the optimizer was given. Zero without -O.
+ * removed   -- The number of those commands it removed.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    char   *in_fname;
+    char   *out_fname;
+    int     status;
+    double  ms;
+    char   *error;
+    long    commands;
+    long    removed;
+} batch_job_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * A worker thread and its deque. The deque holds the jobs with indexes top .. bottom - 1.
+ *
+ * thread  -- The thread.
+ * lock    -- Protects top and bottom.
+ * top     -- The next job the worker itself will run.
+ * bottom  -- One past the last job in the deque. Thieves take from this end.
+ * ctx     -- The interpreter context the worker runs its jobs in.
+ * id      -- The index of the worker in 'all'.
+ * all     -- Every worker, for stealing from.
+ * threads -- The number of workers.
+ * jobs    -- Every job of the batch.
+ * done    -- The number of jobs the worker has run.
+ * steals  -- The number of times it has stolen from another worker.
+ * busy_ms -- The total time of the jobs it has run, in milliseconds.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct batch_worker {
+    pthread_t            thread;
+    pthread_mutex_t      lock;
+    size_t               top;
+    size_t               bottom;
+    myrtle_ctx_t        *ctx;
+    int                  id;
+    struct batch_worker *all;
+    int                  threads;
+    batch_job_t         *jobs;
+    size_t               done;
+    size_t               steals;
+    double               busy_ms;
+} batch_worker_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * The jobs of a batch, as they are read.
+ *
+ * jobs  -- The jobs.
+ * count -- The number of jobs.
+ * cap   -- The number of jobs allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    batch_job_t *jobs;
+    size_t       count;
+    size_t       cap;
+} batch_list_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+static int    _batch_add(batch_list_t *list, const char *in_fname, const char *out_fname);
+static int    _batch_fname_cmp(const void *a, const void *b);
+static void   _batch_free(batch_list_t *list);
+static int    _batch_load(batch_list_t *list, const char *source, char *error);
+static int    _batch_load_dir(batch_list_t *list, const char *dir, char *error);
+static int    _batch_load_manifest(batch_list_t *list, const char *manifest, char *error);
+static double _batch_now_ms();
+static bool   _batch_pop(batch_worker_t *worker, size_t *job);
+static void   _batch_report(FILE *report, batch_list_t *list, batch_worker_t *workers, int threads, double wall);
+static void   _batch_run_job(batch_worker_t *worker, batch_job_t *job);
+static bool   _batch_steal(batch_worker_t *thief, size_t *job);
+static char  *_batch_strdup(const char *s, size_t len);
+static void  *_batch_worker(void *arg);
+
+/*======================================= NONSTATIC FUNCTION DEFINITIONS =====================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: batch_run()
+ * DESCR:    Runs every script listed in 'source', a manifest file or a directory, on 'threads' worker threads.
+ *           A 'threads' of zero or less means one per online CPU. Each worker runs its jobs in its own clone of
+ *           'options', with verbose mode off, since the traces of the workers would be interleaved, and with
+ *           one job, since the workers already keep every thread busy. The timings are written to 'report'.
+ * RETURNS:  TERM_NORM if every job succeeded. If the batch could not be run at all, TERM_ERR_INPUT or
+ *           TERM_ERR_MEMORY. If some jobs failed, the status of the first one that did, in manifest order. On
+ *           error, a message is written to 'error', which must hold BATCH_ERROR_SIZE chars.
+ *------------------------------------------------------------------------------------------------------------*/
+int batch_run(myrtle_ctx_t *options, const char *source, int threads, FILE *report, char *error) {
+    batch_list_t    list = { NULL, 0, 0 };
+    batch_worker_t *workers;
+    double          start;
+    size_t          i, failed = 0;
+    int             t, started, status;
+
+    error[0] = '\0';
+    status = _batch_load(&list, source, error);
+    if (status != TERM_NORM) {
+        _batch_free(&list);
+        return status;
+    }
+
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > BATCH_MAX_THREADS) threads = BATCH_MAX_THREADS;
+    if ((size_t)threads > list.count) threads = (int)list.count;
+    if (threads < 1) threads = 1;
+
+    workers = (batch_worker_t *)calloc(threads, sizeof(batch_worker_t));
+    if (!workers) {
+        _batch_free(&list);
+        strcpy(error, "Out of memory starting batch");
+        return TERM_ERR_MEMORY;
+    }
+    for (t = 0; t < threads; t++) {
+        batch_worker_t *w = &workers[t];
+        pthread_mutex_init(&w->lock, NULL);
+        w->top     = list.count * t / threads;
+        w->bottom  = list.count * (t + 1) / threads;
+        w->id      = t;
+        w->all     = workers;
+        w->threads = threads;
+        w->jobs    = list.jobs;
+        w->ctx     = myrtle_ctx_clone(options);
+        if (w->ctx) {
+            myrtle_ctx_verbose_set(w->ctx, NULL);
+            myrtle_ctx_jobs_set(w->ctx, 1);
+        } else {
+            status = TERM_ERR_MEMORY;
+        }
+    }
+
+    start = _batch_now_ms();
+    for (started = 0; started < threads && status == TERM_NORM; started++) {
+        if (pthread_create(&workers[started].thread, NULL, _batch_worker, &workers[started])) break;
+    }
+    /* If a thread could not be started, the ones that were will steal its jobs. */
+    if (started == 0 && status == TERM_NORM) _batch_worker(&workers[0]);
+    for (t = 0; t < started; t++) pthread_join(workers[t].thread, NULL);
+
+    if (status == TERM_NORM) {
+        _batch_report(report, &list, workers, threads, _batch_now_ms() - start);
+        for (i = 0; i < list.count; i++) {
+            if (list.jobs[i].status == TERM_NORM) continue;
+            if (!failed++) status = list.jobs[i].status;
+        }
+        if (failed) sprintf(error, "%lu of %lu jobs failed", (unsigned long)failed, (unsigned long)list.count);
+    } else {
+        strcpy(error, "Out of memory starting batch");
+    }
+
+    for (t = 0; t < threads; t++) {
+        myrtle_ctx_destroy(workers[t].ctx);
+        pthread_mutex_destroy(&workers[t].lock);
+    }
+    free(workers);
+    _batch_free(&list);
+    return status;
+}
+
+/*========================================= STATIC FUNCTION DEFINITIONS ======================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _batch_add()
+ * DESCR:    Adds a job to 'list' for the script 'in_fname'. If 'out_fname' is NULL, the output goes to
+ *           'in_fname' with ".myr" on the end replaced by (or, if there is none, followed by) ".out".
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the job cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _batch_add(batch_list_t *list, const char *in_fname, const char *out_fname) {
+    batch_job_t *job;
+    size_t       len = strlen(in_fname);
+
+    if (list->count == list->cap) {
+        size_t       cap  = list->cap ? list->cap * 2 : BATCH_JOBS_INIT;
+        batch_job_t *jobs = (batch_job_t *)realloc(list->jobs, cap * sizeof(batch_job_t));
+        if (!jobs) return TERM_ERR_MEMORY;
+        list->jobs = jobs;
+        list->cap  = cap;
+    }
+    job = &list->jobs[list->count];
+    job->status   = TERM_NORM;
+    job->ms       = 0;
+    job->error    = NULL;
+    job->commands = 0;
+    job->removed  = 0;
+    job->in_fname = _batch_strdup(in_fname, len);
+    if (out_fname) {
+        job->out_fname = _batch_strdup(out_fname, strlen(out_fname));
+    } else {
+        if (len >= 4 && streq(in_fname + len - 4, ".myr")) len -= 4;
+        job->out_fname = (char *)malloc(len + 5);
+        if (job->out_fname) {
+            memcpy(job->out_fname, in_fname, len);
+            strcpy(job->out_fname + len, ".out");
+        }
+    }
+    if (!job->in_fname || !job->out_fname) {
+        free(job->in_fname);
+        free(job->out_fname);
+        return TERM_ERR_MEMORY;
+    }
+    list->count++;
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _batch_fname_cmp()
+ * DESCR:    qsort() comparison function which orders jobs by script name.
+ * RETURNS:  Negative, zero or positive as 'a' comes before, with or after 'b'.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _batch_fname_cmp(const void *a, const void *b) {
+    return strcmp(((const batch_job_t *)a)->in_fname, ((const batch_job_t *)b)->in_fname);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _batch_free()
+ * DESCR:    Frees the jobs in 'list'.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _batch_free(batch_list_t *list) {
+    size_t i;
+    for (i = 0; i < list->count; i++) {
+        free(list->jobs[i].in_fname);
+        free(list->jobs[i].out_fname);
+        free(list->jobs[i].error);
+    }
+    free(list->jobs);
+    list->jobs  = NULL;
+    list->count = list->cap = 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _batch_load()
+ * DESCR:    Reads the jobs of the batch 'source' into 'list'. 'source' is a directory or a manifest file.
+ * RETURNS:  TERM_NORM, TERM_ERR_INPUT if 'source' cannot be read or lists no scripts, or TERM_ERR_MEMORY. On
+ *           error, a message is written to 'error'.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _batch_load(batch_list_t *list, const char *source, char *error) {
+    struct stat st;
+    int         status;
+
+    if (stat(source, &st)) {
+        sprintf(error, "Cannot open batch '%.100s'", source);
+        return TERM_ERR_INPUT;
+    }
+    if (S_ISDIR(st.st_mode)) status = _batch_load_dir(list, source, error);
+    else status = _batch_load_manifest(list, source, error);
+    if (status == TERM_NORM && !list->count) {
+        sprintf(error, "No scripts in batch '%.100s'", source);
+        status = TERM_ERR_INPUT;
+    }
+    return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _batch_load_dir()
+ * DESCR:    Adds a job to 'list' for every regular file in 'dir' whose name ends in ".myr". readdir() returns
+ *           them in no particular order, so they are sorted by name to make the report repeatable.
+ * RETURNS:  See _batch_load().
+ *------------------------------------------------------------------------------------------------------------*/
+static int _batch_load_dir(batch_list_t *list, const char *dir, char *error) {
+    DIR           *d = opendir(dir);
+    struct dirent *entry;
+    struct stat    st;
+    char          *path;
+    size_t         dir_len = strlen(dir);
+    int            status  = TERM_NORM;
+
+    if (!d) {
+        sprintf(error, "Cannot open batch '%.100s'", dir);
+        return TERM_ERR_INPUT;
+    }
+    while (status == TERM_NORM && (entry = readdir(d)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (len <= 4 || !streq(entry->d_name + len - 4, ".myr")) continue;
+        path = (char *)malloc(dir_len + len + 2);
+        if (!path) {
+            status = TERM_ERR_MEMORY;
+            break;
+        }
+        sprintf(path, "%s/%s", dir, entry->d_name);
+        if (stat(path, &st) == 0 && S_ISREG(st.st_mode)) status = _batch_add(list, path, NULL);
+        free(path);
+    }
+    closedir(d);
+    if (status != TERM_NORM) {
+        strcpy(error, "Out of memory reading batch");
+        return status;
+    }
+    qsort(list->jobs, list->count, sizeof(batch_job_t), _batch_fname_cmp);
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _batch_load_manifest()
+ * DESCR:    Adds a job to 'list' for every line of the file 'manifest'. A line is the name of a script, and
+ *           optionally the name of its output file, separated by whitespace. Blank lines and lines which begin
+ *           with '#' are skipped.
+ * RETURNS:  See _batch_load().
+ *------------------------------------------------------------------------------------------------------------*/
+static int _batch_load_manifest(batch_list_t *list, const char *manifest, char *error) {
+    FILE *f = fopen(manifest, "r");
+    char *line, *in_fname, *out_fname;
+    int   status = TERM_NORM;
+
+    if (!f) {
+        sprintf(error, "Cannot open batch '%.100s'", manifest);
+        return TERM_ERR_INPUT;
+    }
+    line = (char *)malloc(BATCH_LINE_MAX);
+    if (!line) status = TERM_ERR_MEMORY;
+    while (status == TERM_NORM && fgets(line, BATCH_LINE_MAX, f)) {
+        in_fname = strtok(line, " \t\r\n");
+        if (!in_fname || in_fname[0] == '#') continue;
+        out_fname = strtok(NULL, " \t\r\n");
+        status = _batch_add(list, in_fname, out_fname);
+    }
+    free(line);
+    fclose(f);
+    if (status != TERM_NORM) strcpy(error, "Out of memory reading batch");
+    return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _batch_now_ms()
+ * DESCR:    Reads the monotonic clock.
+ * RETURNS:  The time in milliseconds since some fixed point.
+ *------------------------------------------------------------------------------------------------------------*/
+static double _batch_now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _batch_pop()
+ * DESCR:    Takes the job at the front of the deque of 'worker'.
+ * RETURNS:  True and the index of the job in *job, or false if the deque is empty.
+ *------------------------------------------------------------------------------------------------------------*/
+static bool _batch_pop(batch_worker_t *worker, size_t *job) {
+    bool found;
+    pthread_mutex_lock(&worker->lock);
+    found = worker->top < worker->bottom;
+    if (found) *job = worker->top++;
+    pthread_mutex_unlock(&worker->lock);
+    return found;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _batch_report()
+ * DESCR:    Writes the time of each job in 'list', in manifest order, then the totals and the work done by each
+ *           worker. The speedup is the total time of the jobs over the wall-clock time of the batch, i.e., how
+ *           many of the workers were busy on average. With -O, the number of commands the optimizer removed
+ *           from all the jobs follows the totals.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _batch_report(FILE *report, batch_list_t *list, batch_worker_t *workers, int threads, double wall_ms) {
+    double total_ms = 0;
+    long   commands = 0, removed = 0;
+    size_t i, failed = 0;
+    int    t;
+
+    fprintf(report, "%12s  %s\n", "ms", "script -> output");
+    for (i = 0; i < list->count; i++) {
+        batch_job_t *job = &list->jobs[i];
+        fprintf(report, "%12.3f  %s -> %s", job->ms, job->in_fname, job->out_fname);
+        if (job->status != TERM_NORM) fprintf(report, "  FAILED (%d): %s", job->status, job->error);
+        fputc('\n', report);
+        total_ms += job->ms;
+        commands += job->commands;
+        removed  += job->removed;
+        if (job->status != TERM_NORM) failed++;
+    }
+    fprintf(report, "\nbatch: %lu jobs, %lu failed, %d threads\n", (unsigned long)list->count,
+            (unsigned long)failed, threads);
+    fprintf(report, "wall %.3f ms, jobs %.3f ms (mean %.3f ms), %.1f jobs/sec, speedup %.2fx\n", wall_ms, total_ms,
+            total_ms / list->count, wall_ms > 0 ? list->count * 1e3 / wall_ms : 0.0,
+            wall_ms > 0 ? total_ms / wall_ms : 0.0);
+    if (commands > 0) {
+        fprintf(report, "optimizer removed %ld of %ld commands (%.1f%%)\n", removed, commands,
+                100.0 * removed / commands);
+    }
+    for (t = 0; t < threads; t++) {
+        fprintf(report, "thread %3d: %6lu jobs, %4lu steals, %12.3f ms busy\n", t, (unsigned long)workers[t].done,
+                (unsigned long)workers[t].steals, workers[t].busy_ms);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _batch_run_job()
+ * DESCR:    Runs 'job' in the context of 'worker' and records its status and time.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _batch_run_job(batch_worker_t *worker, batch_job_t *job) {
+    double start = _batch_now_ms();
+
+    job->status  = myrtle_ctx_run_file(worker->ctx, job->in_fname, job->out_fname);
+    job->ms      = _batch_now_ms() - start;
+    job->removed = myrtle_ctx_removed(worker->ctx, &job->commands);
+    if (job->status != TERM_NORM) {
+        const char *msg = myrtle_ctx_error(worker->ctx);
+        job->error = _batch_strdup(msg, strlen(msg));
+    }
+    worker->done++;
+    worker->busy_ms += job->ms;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _batch_steal()
+ * DESCR:    Called by a worker whose deque is empty. Looks at the other workers in turn, starting with the next
+ *           one, and takes the back half (rounded up) of the first deque which is not empty. The first of the
+ *           stolen jobs is returned to be run now and the rest go into the thief's own deque. No jobs are ever
+ *           added to a batch once it has started, so if every deque is empty, the thief is done.
+ * RETURNS:  True and the index of a job in *job, or false if there is nothing left to steal.
+ *------------------------------------------------------------------------------------------------------------*/
+static bool _batch_steal(batch_worker_t *thief, size_t *job) {
+    int t;
+    for (t = 1; t < thief->threads; t++) {
+        batch_worker_t *victim = &thief->all[(thief->id + t) % thief->threads];
+        size_t          first = 0, end = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        if (victim->top < victim->bottom) {
+            end   = victim->bottom;
+            first = end - (end - victim->top + 1) / 2;
+            victim->bottom = first;
+        }
+        pthread_mutex_unlock(&victim->lock);
+        if (first == end) continue;
+
+        pthread_mutex_lock(&thief->lock);
+        thief->top    = first + 1;
+        thief->bottom = end;
+        pthread_mutex_unlock(&thief->lock);
+        thief->steals++;
+        *job = first;
+        return true;
+    }
+    return false;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _batch_strdup()
+ * DESCR:    Copies the first 'len' chars of 's' into a new null-terminated string. strdup() is not Standard C.
+ * RETURNS:  The copy, or NULL if it cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+static char *_batch_strdup(const char *s, size_t len) {
+    char *copy = (char *)malloc(len + 1);
+    if (!copy) return NULL;
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _batch_worker()
+ * DESCR:    The body of a worker thread: runs jobs from its own deque, then from the other workers' deques, until
+ *           there are none left.
+ * RETURNS:  NULL.
+ *------------------------------------------------------------------------------------------------------------*/
+static void *_batch_worker(void *arg) {
+    batch_worker_t *worker = (batch_worker_t *)arg;
+    size_t          job;
+
+    while (_batch_pop(worker, &job) || _batch_steal(worker, &job)) _batch_run_job(worker, &worker->jobs[job]);
+    return NULL;
+}
@@ -0,0 +1,32 @@
+/***************************************************************************************************************
+ * FILE: batch.h
+ *
+ * DESCRIPTION:
+ * Declarations for batch mode. See comments in batch.c.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * 20261016T2200 [JMW] batch_run() takes the number of lanes
+ * 20261017T1300 [JMW] batch_run() no longer takes the number of lanes
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261016T1900 [JMW] Initial revision.
+ **************************************************************************************************************/
+#ifndef __BATCH_H__
+#define __BATCH_H__
+
+#include <stdio.h>    /* For FILE. */
+#include "myrtle.h"   /* For myrtle_ctx_t. */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * PREPROCESSOR MACRO DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+#define BATCH_ERROR_SIZE  160  /* Size of the buffer batch_run() writes its error message into. */
+#define BATCH_MAX_THREADS 256  /* Most worker threads a batch can run on.                      */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * NONSTATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+extern int batch_run(myrtle_ctx_t *options, const char *source, int threads, FILE *report, char *error);
+
+#endif
@@ -0,0 +1,265 @@
+/***************************************************************************************************************
+ * FILE: benchsuite.c
+ *
+ * DESCRIPTION:
+ * The benchmark suite run by "make bench". Generates a set of deterministic workloads, writes them as script
+ * files, runs each of them from its file in worlds of several sizes, and reports for each run the commands per
+ * second, the MB per second of input, and the time taken to write the final world to the output file. The same
+ * build always generates the same scripts, so the numbers can be compared release over release.
+ *
+ * The workloads are:
+ *
+ *     lines    -- long horizontal lines, snaking down the world.
+ *     vertical -- long vertical lines, snaking across the world, which are slow in a row-major world.
+ *     penchar  -- short moves with a 'penchar' before nearly every one.
+ *     hugeargs -- moves and 'hyper's with operands of nine or ten digits, which wrap around the world many times.
+ *     mixed    -- a drawing script of short moves and turns, with the odd 'penchar', 'penup', 'repeat' block and
+ *                 call of a procedure.
+ *
+ * Each is generated at three sizes, 'kb' KB and 4 and 16 times that, and each size is run in a world of 50 x 50
+ * (the default), 1000 x 1000 and 4000 x 4000 squares. Each run is repeated 'reps' times and the best time kept.
+ * Caching of compiled programs (see cache.c) is turned off, so that every run reads and compiles its script.
+ *
+ * Usage: benchsuite [-k kb] [-r reps] [-O] [-J] [dir]     (default 1024 KB, 3 reps, directory benchwork)
+ *
+ * -O runs the workloads optimized, as it does for myrtle, and -J as native code (see myrtle_ctx_jit_set()). The
+ * scripts and the output of the last run of each are left in 'dir'.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261017T0400 [JMW] Initial revision.
+ **************************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bool.h"
+#include "file.h"
+#include "globals.h"
+#include "myrtle.h"
+#include "world.h"
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC GLOBAL CONSTANT DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+static const char   *KINDS[]     = { "lines", "vertical", "penchar", "hugeargs", "mixed" };
+static const int     KIND_COUNT  = 5;
+static const long    SIZES[]     = { 1, 4, 16 };            /* The sizes of the scripts, times 'kb' KB. */
+static const int     SIZE_COUNT  = 3;
+static const coord_t WORLDS[][2] = { { 50, 50 }, { 1000, 1000 }, { 4000, 4000 } };
+static const int     WORLD_COUNT = 3;
+static const long    BIG         = 100000000;              /* The least operand of the hugeargs workload. */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+static int    _bench_command(int kind, unsigned long *seed, char *p, long *cmds);
+static char  *_bench_generate(int kind, size_t size, size_t *len, long *cmds);
+static int    _bench_run(myrtle_ctx_t *ctx, const char *in_fname, const char *out_fname, int reps, double *secs,
+                         double *out_secs);
+static double _bench_secs(clock_t start);
+
+/*======================================= NONSTATIC FUNCTION DEFINITIONS =====================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: main()
+ * DESCR:    Generates each workload at each size into 'dir', and runs and times it in each world.
+ * RETURNS:  Zero if every run succeeded, or the status of the first one which failed, or TERM_ERR_CMD_LINE,
+ *           TERM_ERR_OUTPUT if a script cannot be written, or TERM_ERR_MEMORY.
+ *------------------------------------------------------------------------------------------------------------*/
+int main(int argc, char *argv[]) {
+    const char   *dir      = "benchwork";
+    long          kb       = 1024, cmds;
+    int           reps     = 3, kind, size, w, i, status = TERM_NORM;
+    bool          optimize = false, jit = false;
+    char          in_fname[512], out_fname[512];
+    myrtle_ctx_t *ctx;
+
+    for (i = 1; i < argc; i++) {
+        if (streq(argv[i], "-k") && i + 1 < argc) kb = atol(argv[++i]);
+        else if (streq(argv[i], "-r") && i + 1 < argc) reps = atoi(argv[++i]);
+        else if (streq(argv[i], "-O")) optimize = true;
+        else if (streq(argv[i], "-J")) jit = true;
+        else if (argv[i][0] != '-' && strlen(argv[i]) < 400) dir = argv[i];
+        else {
+            fprintf(stderr, "Usage: benchsuite [-k kb] [-r reps] [-O] [-J] [dir]\n");
+            return TERM_ERR_CMD_LINE;
+        }
+    }
+    if (kb < 1) kb = 1;
+    if (reps < 1) reps = 1;
+
+    printf("benchsuite: %ld KB to %ld KB scripts, best of %d%s%s, in %s/\n", kb * SIZES[0],
+           kb * SIZES[SIZE_COUNT - 1], reps, optimize ? ", -O" : "", jit ? ", -J" : "", dir);
+    printf("%-16s %9s %11s %10s %9s %9s %9s %9s\n", "workload", "MB", "world", "commands", "secs", "Mcmd/sec",
+           "MB/sec", "out ms");
+    for (kind = 0; kind < KIND_COUNT; kind++) {
+        for (size = 0; size < SIZE_COUNT; size++) {
+            size_t  len;
+            char   *src = _bench_generate(kind, kb * SIZES[size] << 10, &len, &cmds);
+            FILE   *f;
+            double  mb  = len / 1048576.0;
+
+            if (!src) return TERM_ERR_MEMORY;
+            sprintf(in_fname, "%s/%s-%ldk.myr", dir, KINDS[kind], kb * SIZES[size]);
+            sprintf(out_fname, "%s/%s-%ldk.out", dir, KINDS[kind], kb * SIZES[size]);
+            f = fopen(in_fname, "w");
+            if (!f || fwrite(src, 1, len, f) != len || fclose(f) != 0) {
+                fprintf(stderr, "Cannot write '%s'. Does the directory '%s' exist?\n", in_fname, dir);
+                return TERM_ERR_OUTPUT;
+            }
+            free(src);
+
+            for (w = 0; w < WORLD_COUNT; w++) {
+                double secs, out_secs;
+                char   world[32];
+                int    run_status;
+
+                ctx = myrtle_ctx_create();
+                if (!ctx) return TERM_ERR_MEMORY;
+                myrtle_ctx_cache_set(ctx, false, NULL);
+                myrtle_ctx_world_size_set(ctx, WORLDS[w][0], WORLDS[w][1]);
+                myrtle_ctx_optimize_set(ctx, optimize);
+                myrtle_ctx_jit_set(ctx, jit);
+                run_status = _bench_run(ctx, in_fname, out_fname, reps, &secs, &out_secs);
+                sprintf(world, "%ldx%ld", (long)WORLDS[w][0], (long)WORLDS[w][1]);
+                if (run_status != TERM_NORM) {
+                    printf("%-9s%6ldk %9.2f %11s FAILED: %s\n", KINDS[kind], kb * SIZES[size], mb, world,
+                           myrtle_ctx_error(ctx));
+                    if (status == TERM_NORM) status = run_status;
+                } else {
+                    printf("%-9s%6ldk %9.2f %11s %10ld %9.4f %9.2f %9.1f %9.3f\n", KINDS[kind], kb * SIZES[size],
+                           mb, world, cmds, secs, cmds / secs / 1e6, mb / secs, out_secs * 1e3);
+                }
+                fflush(stdout);
+                myrtle_ctx_destroy(ctx);
+            }
+        }
+    }
+    return status;
+}
+
+/*========================================= STATIC FUNCTION DEFINITIONS ======================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _bench_command()
+ * DESCR:    Writes the next command (or few commands) of the workload 'kind' at 'p', stepping the generator
+ *           *seed, and adds the number of commands written to *cmds.
+ * RETURNS:  The number of chars written.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _bench_command(int kind, unsigned long *seed, char *p, long *cmds) {
+    unsigned long r;
+    int           c;
+
+    *seed = *seed * 1103515245 + 12345;
+    r     = *seed >> 8;
+    c     = (int)((*seed >> 16) % 32);
+    switch (kind) {
+    case 0:   /* lines */
+        *cmds += 1;
+        if (c < 28) return sprintf(p, "forward %lu\n", 200 + r % 800);
+        *cmds += 2;
+        return sprintf(p, (c & 1) ? "right\nforward 1\nright\n" : "left\nforward 1\nleft\n");
+    case 1:   /* vertical */
+        *cmds += 1;
+        if (c < 26) return sprintf(p, "forward %lu\n", 200 + r % 800);
+        if (c < 28) return sprintf(p, "backward %lu\n", r % 100);
+        *cmds += 2;
+        return sprintf(p, (c & 1) ? "right\nforward 1\nright\n" : "left\nforward 1\nleft\n");
+    case 2:   /* penchar */
+        *cmds += 2;
+        if (c < 26) return sprintf(p, "penchar %c\nforward %lu\n", "#*@xo+=%"[r % 8], 1 + r % 3);
+        return sprintf(p, "penchar %c\n%s\n", "#*@xo+=%"[r % 8], (c & 1) ? "right" : "left");
+    case 3:   /* hugeargs */
+        *cmds += 1;
+        if (c < 16) return sprintf(p, "forward %lu\n", BIG + r % 2000000000);
+        if (c < 22) return sprintf(p, "backward %lu\n", BIG + r % 2000000000);
+        if (c < 26) return sprintf(p, "hyper %lu %lu\n", BIG + r % 900000000, BIG + (r >> 3) % 900000000);
+        return sprintf(p, (c & 1) ? "right\n" : "left\n");
+    default:  /* mixed */
+        *cmds += 1;
+        if (c < 12) return sprintf(p, "forward %lu\n", r % 16);
+        if (c < 15) return sprintf(p, "backward %lu\n", r % 8);
+        if (c < 21) return sprintf(p, "right\n");
+        if (c < 26) return sprintf(p, "left\n");
+        if (c < 27) return sprintf(p, "penchar %c\n", "#*@xo+"[r % 6]);
+        if (c < 28) return sprintf(p, "box\n");
+        if (c < 29) {
+            *cmds += 2;
+            return sprintf(p, "penup\nforward %lu\npendown\n", r % 10);
+        }
+        *cmds += 3;
+        return sprintf(p, "repeat %lu [\nforward %lu\nright\n]\n", 1 + r % 8, r % 6);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _bench_generate()
+ * DESCR:    Generates the workload 'kind', 'size' bytes long give or take a command. The number of commands in it
+ *           goes in *cmds.
+ * RETURNS:  The script, allocated with malloc(), and its length in *len, or NULL if it cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+static char *_bench_generate(int kind, size_t size, size_t *len, long *cmds) {
+    char          *buf  = (char *)malloc(size + 256), *p = buf;
+    unsigned long  seed = 12345 + kind;
+
+    if (!buf) return NULL;
+    *cmds = 1;
+    p    += sprintf(p, "pendown\n");
+    if (kind == 1) {
+        *cmds += 1;
+        p     += sprintf(p, "right\n");
+    }
+    if (kind == 4) {
+        *cmds += 13;
+        p     += sprintf(p, "to box\nforward 4\nright\nforward 4\nright\nforward 4\nright\nforward 4\nright\n"
+                         "penchar o\nforward 2\nend\n");
+    }
+    while ((size_t)(p - buf) < size) p += _bench_command(kind, &seed, p, cmds);
+    *len = (size_t)(p - buf);
+    return buf;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _bench_run()
+ * DESCR:    Runs the script in the file 'in_fname' in 'ctx' 'reps' times, writing its output to the file
+ *           'out_fname', and after each run writes the final world to the file again on its own, to time that.
+ * RETURNS:  TERM_NORM, with the best time for a run in *secs and the best time for writing the final world in
+ *           *out_secs, or the status of the first run which failed.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _bench_run(myrtle_ctx_t *ctx, const char *in_fname, const char *out_fname, int reps, double *secs,
+                      double *out_secs) {
+    file_t file;
+    int    rep, status = TERM_NORM;
+
+    *secs     = 1e30;
+    *out_secs = 1e30;
+    file_init(&file);
+    for (rep = 0; rep < reps && status == TERM_NORM; rep++) {
+        clock_t start = clock();
+        double  t;
+
+        status = myrtle_ctx_run_file(ctx, in_fname, out_fname);
+        if ((t = _bench_secs(start)) < *secs) *secs = t;
+        if (status != TERM_NORM) break;
+
+        start = clock();
+        if (file_open_out(&file, out_fname) == TERM_NORM) world_write(myrtle_ctx_world(ctx), &file);
+        status = file_close(&file);
+        if ((t = _bench_secs(start)) < *out_secs) *out_secs = t;
+    }
+    file_free(&file);
+    return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _bench_secs()
+ * DESCR:    Works out the time since 'start'.
+ * RETURNS:  The time in seconds, never zero.
+ *------------------------------------------------------------------------------------------------------------*/
+static double _bench_secs(clock_t start) {
+    double secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+    return secs > 0 ? secs : 1e-9;
+}
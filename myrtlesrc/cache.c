@@ -0,0 +1,495 @@
+/***************************************************************************************************************
+ * FILE: cache.c
+ *
+ * DESCRIPTION:
+ * Caches compiled programs in .myb files, so that a large script is compiled only once. The next run of the same
+ * script maps the .myb file into memory and performs the compiled program straight from the mapping, without
+ * reading, scanning or compiling the source at all.
+ *
+ * A compiled program can be saved as it is, because nothing in it depends on where it is in memory: a 'repeat'
+ * holds the length of its body, a 'to' the length of the procedure, and a 'call' how far back the 'to' is. A
+ * .myb file is a cache_header_t, then the words of the program, then a cache_rec_t for each procedure, then the
+ * names of the procedures, each ending in '\0'. The words are in the byte order and int size of the machine
+ * which wrote them; the header records both, along with everything else which must match for the file to be
+ * used:
+ *
+ *     - CACHE_MAGIC and CACHE_VERSION, which is bumped whenever the layout of the file changes.
+ *     - A hash of the commands in cmds.def, so that a file compiled before a command was added or changed is
+ *       never performed with the wrong opcodes.
+ *     - The size and modification time of the source, and a hash of its bytes. A source of the same size and
+ *       time is taken to be unchanged without reading it. One with a different time, or modified in the same
+ *       second the cache file was written, is hashed, so that touching a script does not make its cache stale
+ *       but editing it does.
+ *
+ * The words themselves are checked too, before anything performs them: every opcode must be a command, every
+ * 'repeat' and 'to' must end inside the block around it, and every 'call' must land on the 'to' of a procedure
+ * declared before it (see _cache_words()). So a damaged or edited file is stale, rather than something the
+ * interpreter or the native code jumps out of the program by.
+ *
+ * A file which does not match is stale and is ignored, and the script is compiled and cached again. The cache of
+ * x.myr is x.myb next to it, or, if a cache directory is given, x-<hash of the name of x.myr>.myb in that
+ * directory. A cache file is written under a temporary name and renamed, so that a run never maps a partly
+ * written one, even with another run writing it at the same time. A cache which cannot be written is not an
+ * error; the script is just compiled again next time.
+ *
+ * Scripts smaller than CACHE_MIN_SIZE compile in about the time it takes to check their cache, so they are not
+ * cached.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * 20261017T1100 [JMW] the words of the program are checked before it is used
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261017T0300 [JMW] Initial revision.
+ **************************************************************************************************************/
+/* mmap(), stat() and friends are POSIX, not Standard C, and mkstemp() is only in POSIX since 2008, so ask for
+ * them before including anything. */
+#define _POSIX_C_SOURCE 200809L
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bool.h"
+#include "cache.h"
+#include "globals.h"
+#include "myrtle.h"
+
+/* POSIX headers for open(), stat(), mmap(), mkstemp(), write() and pwrite() */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * The header of a .myb file. Every field is a long, so that the words which follow are aligned.
+ *
+ * magic     -- CACHE_MAGIC.
+ * version   -- CACHE_VERSION.
+ * format    -- _cache_format(): the commands, the int and long sizes and the byte order of the writer.
+ * src_size  -- The size of the source in bytes.
+ * src_mtime -- The modification time of the source.
+ * src_hash  -- _cache_hash() of the source.
+ * written   -- When the file was written.
+ * count     -- The number of words in the program.
+ * procs     -- The number of procedures.
+ * names     -- The bytes of procedure names.
+ * repeats   -- The number of 'repeat' blocks in the program.
+ * calls     -- The number of calls compiled which were not inlined.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    char          magic[8];
+    long          version;
+    unsigned long format;
+    long          src_size;
+    long          src_mtime;
+    unsigned long src_hash;
+    long          written;
+    long          count;
+    long          procs;
+    long          names;
+    long          repeats;
+    long          calls;
+} cache_header_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * A procedure in a .myb file: its cache_proc_t, with its name as the offset of the name in the names.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    int at;
+    int stampable;
+    int name;
+} cache_rec_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC GLOBAL CONSTANT DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+static const char CACHE_MAGIC[8] = "MYRTLEB";  /* The first 8 bytes of every .myb file, '\0' included. */
+static const long CACHE_VERSION  = 1;          /* Bump whenever the layout of a .myb file changes.     */
+static const long CACHE_BLOCKS   = 16;         /* Nested blocks _cache_words() allocates for at first. */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+static bool          _cache_check(cache_t *cache, const struct stat *st, const char *src, size_t len,
+                                  bool *hashed);
+static unsigned long _cache_format();
+static unsigned long _cache_hash(unsigned long hash, const void *buf, size_t len);
+static char         *_cache_path(const char *dir, const char *fname);
+static void          _cache_touch(const char *path, const struct stat *st);
+static void          _cache_unmap(cache_t *cache);
+static bool          _cache_words(const int *words, long count, const cache_rec_t *recs, long procs, long repeats,
+                                  long calls);
+static bool          _cache_write(int fd, const void *buf, size_t len);
+
+/*======================================= NONSTATIC FUNCTION DEFINITIONS =====================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: cache_free()
+ * DESCR:    Unmaps the cache file 'cache' was loaded from, releases its procedures and leaves it empty.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void cache_free(cache_t *cache) {
+    _cache_unmap(cache);
+    free(cache->procs);
+    cache_init(cache);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: cache_init()
+ * DESCR:    Initializes 'cache' to an empty program which was not loaded from a cache file.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void cache_init(cache_t *cache) {
+    cache->words      = NULL;
+    cache->count      = 0;
+    cache->procs      = NULL;
+    cache->proc_count = 0;
+    cache->repeats    = 0;
+    cache->calls      = 0;
+    cache->map        = NULL;
+    cache->map_size   = 0;
+    cache->procs_cap  = 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: cache_load()
+ * DESCR:    Looks for the compiled program of the script in the file 'fname', whose 'len' bytes are at 'src', in
+ *           the cache directory 'dir', or next to the script if 'dir' is NULL. If its cache file is there and is
+ *           not stale, it is mapped and 'cache' is filled in from it. The mapping of the previous load is
+ *           unmapped either way, so nothing loaded before may be used after this. If the script had to be hashed
+ *           to find that it has not changed, the time it was modified is updated in the cache file, so that the
+ *           next run does not hash it again.
+ * RETURNS:  True if the program was loaded. False if it was not cached, the cache is stale, or the script is
+ *           too small to be cached.
+ *------------------------------------------------------------------------------------------------------------*/
+bool cache_load(cache_t *cache, const char *dir, const char *fname, const char *src, size_t len) {
+    struct stat st, cst;
+    char       *path;
+    void       *map = MAP_FAILED;
+    bool        hashed;
+    int         fd;
+
+    _cache_unmap(cache);
+    if (!fname || !*fname || len < (size_t)CACHE_MIN_SIZE || stat(fname, &st) != 0) return false;
+    if (!(path = _cache_path(dir, fname))) return false;
+    fd = open(path, O_RDONLY);
+    if (fd >= 0 && fstat(fd, &cst) == 0 && (size_t)cst.st_size >= sizeof(cache_header_t)) {
+        map = mmap(NULL, cst.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    if (fd >= 0) close(fd);
+    if (map == MAP_FAILED) {
+        free(path);
+        return false;
+    }
+    cache->map      = map;
+    cache->map_size = cst.st_size;
+    if (!_cache_check(cache, &st, src, len, &hashed)) {
+        _cache_unmap(cache);
+        free(path);
+        return false;
+    }
+    if (hashed) _cache_touch(path, &st);
+    free(path);
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: cache_save()
+ * DESCR:    Writes the compiled program in 'cache' to the cache file of the script in the file 'fname', whose
+ *           'len' bytes are at 'src', in the cache directory 'dir', or next to the script if 'dir' is NULL.
+ *           Nothing is written for a script too small to be cached, and a file which cannot be written is left
+ *           as it was.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void cache_save(const cache_t *cache, const char *dir, const char *fname, const char *src, size_t len) {
+    cache_header_t header;
+    cache_rec_t    rec;
+    struct stat    st;
+    char          *path, *tmp;
+    bool           ok;
+    int            fd, i;
+
+    if (!fname || !*fname || len < (size_t)CACHE_MIN_SIZE || stat(fname, &st) != 0) return;
+    if (!(path = _cache_path(dir, fname))) return;
+    tmp = (char *)malloc(strlen(path) + 8);
+    if (!tmp) {
+        free(path);
+        return;
+    }
+    sprintf(tmp, "%s.XXXXXX", path);
+    fd = mkstemp(tmp);
+    if (fd < 0) {
+        free(tmp);
+        free(path);
+        return;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version   = CACHE_VERSION;
+    header.format    = _cache_format();
+    header.src_size  = (long)len;
+    header.src_mtime = (long)st.st_mtime;
+    header.src_hash  = _cache_hash(0, src, len);
+    header.written   = (long)time(NULL);
+    header.count     = (long)cache->count;
+    header.procs     = cache->proc_count;
+    header.repeats   = cache->repeats;
+    header.calls     = cache->calls;
+    for (i = 0; i < cache->proc_count; i++) header.names += (long)strlen(cache->procs[i].name) + 1;
+
+    ok = fchmod(fd, 0644) == 0 && _cache_write(fd, &header, sizeof(header)) &&
+         _cache_write(fd, cache->words, cache->count * sizeof(int));
+    for (i = 0, rec.name = 0; i < cache->proc_count && ok; i++) {
+        rec.at        = cache->procs[i].at;
+        rec.stampable = cache->procs[i].stampable;
+        ok            = _cache_write(fd, &rec, sizeof(rec));
+        rec.name     += (int)strlen(cache->procs[i].name) + 1;
+    }
+    for (i = 0; i < cache->proc_count && ok; i++) {
+        ok = _cache_write(fd, cache->procs[i].name, strlen(cache->procs[i].name) + 1);
+    }
+    if (close(fd) != 0) ok = false;
+    if (!ok || rename(tmp, path) != 0) unlink(tmp);
+    free(tmp);
+    free(path);
+}
+
+/*========================================= STATIC FUNCTION DEFINITIONS ======================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _cache_check()
+ * DESCR:    Checks the cache file mapped in 'cache' against the script whose 'len' bytes are at 'src' and whose
+ *           file is described by *st, and fills in 'cache' from it if it matches. A file which is cut short, or
+ *           whose words or procedures are not a program the compiler could have written (see _cache_words()),
+ *           does not match either. *hashed is set to whether the script had to be hashed.
+ * RETURNS:  True if the file matches, false if it is stale, or if the procedures or the blocks being checked
+ *           cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+static bool _cache_check(cache_t *cache, const struct stat *st, const char *src, size_t len, bool *hashed) {
+    const cache_header_t *header = (const cache_header_t *)cache->map;
+    const cache_rec_t    *recs;
+    const char           *names;
+    size_t                size   = cache->map_size - sizeof(cache_header_t);
+    int                   i;
+
+    *hashed = false;
+    if (memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) || header->version != CACHE_VERSION ||
+        header->format != _cache_format()) {
+        return false;
+    }
+    if (header->src_size != (long)len || header->src_size != (long)st->st_size) return false;
+    if (header->count < 0 || header->procs < 0 || header->names < 0 || header->names > INT_MAX ||
+        (size_t)header->count > size / sizeof(int) ||
+        (size_t)header->procs > (size - header->count * sizeof(int)) / sizeof(cache_rec_t) ||
+        (size_t)header->names != size - header->count * sizeof(int) - header->procs * sizeof(cache_rec_t)) {
+        return false;
+    }
+    if (header->src_mtime != (long)st->st_mtime || header->src_mtime >= header->written) {
+        *hashed = true;
+        if (header->src_hash != _cache_hash(0, src, len)) return false;
+    }
+
+    cache->words      = (const int *)(header + 1);
+    cache->count      = header->count;
+    cache->proc_count = 0;
+    cache->repeats    = (int)header->repeats;
+    cache->calls      = (int)header->calls;
+    recs              = (const cache_rec_t *)(cache->words + cache->count);
+    names             = (const char *)(recs + header->procs);
+    if (header->procs > 0 && names[header->names - 1] != '\0') return false;
+    if (!_cache_words(cache->words, header->count, recs, header->procs, header->repeats, header->calls)) {
+        return false;
+    }
+    if (header->procs > cache->procs_cap) {
+        cache_proc_t *procs = (cache_proc_t *)realloc(cache->procs, header->procs * sizeof(cache_proc_t));
+        if (!procs) return false;
+        cache->procs     = procs;
+        cache->procs_cap = (int)header->procs;
+    }
+    for (i = 0; i < header->procs; i++) {
+        if (recs[i].at < 0 || (size_t)recs[i].at + 2 > cache->count || recs[i].name < 0 ||
+            recs[i].name >= header->names) {
+            return false;
+        }
+        cache->procs[i].at        = recs[i].at;
+        cache->procs[i].stampable = recs[i].stampable != 0;
+        cache->procs[i].name      = names + recs[i].name;
+    }
+    cache->proc_count = (int)header->procs;
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _cache_format()
+ * DESCR:    Hashes what a compiled program means on this machine: every command in cmds.def with its number of
+ *           operands, the sizes of an int and a long, and the byte order.
+ * RETURNS:  The hash.
+ *------------------------------------------------------------------------------------------------------------*/
+static unsigned long _cache_format() {
+    unsigned long hash = 0;
+    long          one  = 1;
+    int           sizes[2];
+
+#define MYRTLE_CMD(name, str, nargs, usage, help) hash = _cache_hash(hash, str, sizeof(str)); \
+                                                  hash = _cache_hash(hash, "0123456789" + nargs, 1);
+#include "cmds.def"
+#undef MYRTLE_CMD
+    sizes[0] = (int)sizeof(int);
+    sizes[1] = (int)sizeof(long);
+    hash     = _cache_hash(hash, sizes, sizeof(sizes));
+    return _cache_hash(hash, &one, sizeof(one));
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _cache_hash()
+ * DESCR:    Adds the 'len' bytes at 'buf' to 'hash', which is 0 to start a new hash, with 64-bit FNV-1a.
+ * RETURNS:  The new hash.
+ *------------------------------------------------------------------------------------------------------------*/
+static unsigned long _cache_hash(unsigned long hash, const void *buf, size_t len) {
+    const unsigned char *p   = (const unsigned char *)buf;
+    const unsigned char *end = p + len;
+
+    if (!hash) hash = 14695981039346656037UL;
+    for (; p < end; p++) hash = (hash ^ *p) * 1099511628211UL;
+    return hash;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _cache_path()
+ * DESCR:    Works out the name of the cache file of the script in the file 'fname': x.myb next to x.myr if 'dir'
+ *           is NULL, otherwise x-<hash of 'fname'>.myb in 'dir', so that scripts with the same name in
+ *           different directories do not share a cache file.
+ * RETURNS:  The name, allocated with malloc(), or NULL if it cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+static char *_cache_path(const char *dir, const char *fname) {
+    const char *base = dir && strrchr(fname, '/') ? strrchr(fname, '/') + 1 : fname;
+    size_t      len  = strlen(base);
+    char       *path;
+
+    if (len > 4 && streq(base + len - 4, ".myr")) len -= 4;
+    path = (char *)malloc((dir ? strlen(dir) + 1 : 0) + len + 32);
+    if (!path) return NULL;
+    if (dir) sprintf(path, "%s/%.*s-%016lx.myb", dir, (int)len, base, _cache_hash(0, fname, strlen(fname)));
+    else sprintf(path, "%.*s.myb", (int)len, base);
+    return path;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _cache_touch()
+ * DESCR:    Updates the time the source was modified, to st->st_mtime, and the time the cache file was written,
+ *           in the header of the cache file 'path', after the source was hashed and found to be unchanged. A
+ *           file which cannot be updated is left as it was.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _cache_touch(const char *path, const struct stat *st) {
+    long times[2];
+    int  fd = open(path, O_WRONLY);
+
+    if (fd < 0) return;
+    times[0] = (long)st->st_mtime;
+    times[1] = (long)time(NULL);
+    if (pwrite(fd, &times[0], sizeof(long), offsetof(cache_header_t, src_mtime)) == sizeof(long)) {
+        pwrite(fd, &times[1], sizeof(long), offsetof(cache_header_t, written));
+    }
+    close(fd);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _cache_unmap()
+ * DESCR:    Unmaps the cache file 'cache' was loaded from, if any, and empties the program. The procedures
+ *           allocated are kept for the next load.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _cache_unmap(cache_t *cache) {
+    if (cache->map) munmap(cache->map, cache->map_size);
+    cache->map        = NULL;
+    cache->map_size   = 0;
+    cache->words      = NULL;
+    cache->count      = 0;
+    cache->proc_count = 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _cache_words()
+ * DESCR:    Walks the 'count' words of a program loaded from a cache file once, with the 'procs' procedure records
+ *           at 'recs', and checks that they are a program the compiler could have written: every opcode is a
+ *           CMD_* command which the compiler emits, and its operands are all there; the body of every 'repeat'
+ *           and 'to' ends inside the block around it; every 'to' is at the top level and is the next procedure
+ *           in 'recs'; and every 'call' lands on the 'to' of a procedure whose body ends before the 'call'. The
+ *           header must also agree with the words on 'calls', the number of 'call's, and on whether there are
+ *           any 'repeat's, since inlined bodies copy their 'repeat's without counting them. The ends of the
+ *           blocks the walk is inside are kept in a stack, so a deeply nested file cannot overflow the C stack.
+ * RETURNS:  True if the words can be performed, false if they cannot, or if the stack cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+static bool _cache_words(const int *words, long count, const cache_rec_t *recs, long procs, long repeats,
+                         long calls) {
+    long *ends = (long *)malloc(CACHE_BLOCKS * sizeof(long));
+    long  cap  = CACHE_BLOCKS, depth = 0, pc = 0, next = 0, found_repeats = 0, found_calls = 0;
+    long  lo, hi, to;
+    bool  ok   = ends != NULL;
+    int   op;
+
+    if (ok) ends[0] = count;
+    while (ok && pc < count) {
+        op = words[pc];
+        if (op < 0 || op >= CMD_COUNT || op == CMD_CLOSE || op == CMD_END || op == CMD_TURTLE ||
+            cmd_nargs[op] >= ends[depth] - pc) {
+            ok = false;
+            break;
+        }
+        if (op == CMD_REPEAT || op == CMD_TO) {
+            long len = words[pc + cmd_nargs[op]];  /* The length of the body is the last operand of both. */
+            if (depth + 1 == cap) {
+                long *more = (long *)realloc(ends, 2 * cap * sizeof(long));
+                if (!more) {
+                    ok = false;
+                    break;
+                }
+                ends = more;
+                cap *= 2;
+            }
+            if (len < 0 || len > ends[depth] - pc - 1 - cmd_nargs[op]) ok = false;
+            if (op == CMD_TO && (depth != 0 || next >= procs || recs[next].at != pc)) ok = false;
+            if (op == CMD_TO) next++;
+            else found_repeats++;
+            ends[++depth] = pc + 1 + cmd_nargs[op] + len;
+        } else if (op == CMD_CALL) {
+            /* recs[0..next) are the procedures declared so far, in order, so binary search them for the 'to'. */
+            to = pc + words[pc + 1];
+            lo = 0;
+            hi = next - 1;
+            while (lo <= hi && recs[(lo + hi) / 2].at != to) {
+                if (recs[(lo + hi) / 2].at < to) lo = (lo + hi) / 2 + 1;
+                else hi = (lo + hi) / 2 - 1;
+            }
+            if (lo > hi || to + 2 + words[to + 1] > pc) ok = false;
+            found_calls++;
+        }
+        pc += 1 + cmd_nargs[op];
+        while (depth > 0 && pc == ends[depth]) depth--;
+    }
+    free(ends);
+    return ok && next == procs && found_calls == calls && (found_repeats > 0) == (repeats > 0);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _cache_write()
+ * DESCR:    Writes all 'len' bytes at 'buf' to the file 'fd', however many write() calls it takes.
+ * RETURNS:  True if they were all written.
+ *------------------------------------------------------------------------------------------------------------*/
+static bool _cache_write(int fd, const void *buf, size_t len) {
+    const char *p = (const char *)buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n <= 0) return false;
+        p   += n;
+        len -= n;
+    }
+    return true;
+}
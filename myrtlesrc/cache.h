@@ -0,0 +1,70 @@
+/***************************************************************************************************************
+ * FILE: cache.h
+ *
+ * DESCRIPTION:
+ * Declarations for the cache of compiled programs (.myb files). See comments in cache.c.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261017T0300 [JMW] Initial revision.
+ **************************************************************************************************************/
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <stddef.h>   /* For size_t. */
+#include "bool.h"     /* For bool.   */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * PREPROCESSOR MACRO DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+#define CACHE_MIN_SIZE (256L << 10)  /* Bytes of source below which a script is compiled faster than cached. */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * A procedure of a cached program: the index in the program of its CMD_TO, whether it can be stamped (see
+ * stamp.c), and its name.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    int         at;
+    bool        stampable;
+    const char *name;
+} cache_proc_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * A compiled program, as it is saved with cache_save() and as cache_load() finds it in a mapped cache file.
+ *
+ * words      -- The compiled program. After cache_load(), this points into the mapping.
+ * count      -- The number of words in it.
+ * procs      -- Its procedures, in the order they were declared. After cache_load(), their names point into the
+ *               mapping.
+ * proc_count -- The number of procedures.
+ * repeats    -- The number of 'repeat' blocks in the program.
+ * calls      -- The number of calls compiled which were not inlined.
+ * map        -- The mapping of the cache file the program was loaded from, or NULL.
+ * map_size   -- The bytes mapped at map.
+ * procs_cap  -- The number of procs allocated by cache_load(). Kept for the next load.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    const int    *words;
+    size_t        count;
+    cache_proc_t *procs;
+    int           proc_count;
+    int           repeats;
+    int           calls;
+    void         *map;
+    size_t        map_size;
+    int           procs_cap;
+} cache_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * NONSTATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+extern void cache_free(cache_t *cache);
+extern void cache_init(cache_t *cache);
+extern bool cache_load(cache_t *cache, const char *dir, const char *fname, const char *src, size_t len);
+extern void cache_save(const cache_t *cache, const char *dir, const char *fname, const char *src, size_t len);
+
+#endif
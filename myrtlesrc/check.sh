@@ -0,0 +1,239 @@
+#!/bin/bash
+#---------------------------------------------------------------------------------------------------------------
+# FILE:    check.sh
+# DESCR:   Checks that the ways of running a Myrtle script which promise the same output as running it plainly
+#          really do write the same output. Each script in check/, and the long ones generated here, is run
+#          plainly and then each of those ways, and the outputs are compared with cmp. "make check" runs it.
+#
+#          A plain run of a script with turtle blocks runs its turtles on one thread, and -j 2 and -j 8 run them
+#          on several, so comparing those checks that the turtles' order does not depend on threads.
+#
+#          Repetitions of a 'repeat' block are skipped when they cannot change the world, and nothing turns that
+#          off, so a script with 'repeat' blocks is also checked against the same script with them unrolled.
+#
+#          Nothing smaller than CACHE_MIN_SIZE is cached, so for the cache each script is padded up to that with
+#          blank lines, then run once to write its compiled program to the cache and once to load it from there.
+#
+#          --replay writes only the world as it was at the end of the recorded run, so its output is compared
+#          with the last world the plain run wrote.
+#
+#          --restore resumes from a checkpoint taken about halfway through the run, into a copy of the output
+#          with junk after it, which it must cut back and write on from there.
+#
+#          --watch is started on the script with a 'left' put in two thirds of the way down, and the script is
+#          then saved without it. Once the run has been redone, its output must be that of the plain run.
+#
+#          myrtle has no option to run a script as native code, so jitbench -c runs each script both ways in one
+#          process instead, and compares the outputs itself.
+#
+#          Usage: ./check.sh [myrtle [jitbench]]     (default ./myrtle ./jitbench)
+#
+#          The exit status is zero if every check passed, and one if any failed.
+# AUTHORS: Matt Welch [JMW]
+#---------------------------------------------------------------------------------------------------------------
+
+MYRTLE=${1:-./myrtle}
+JITBENCH=${2:-./jitbench}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+PASSED=0
+FAILED=0
+
+# long_script n [seed] : Writes a script of n random commands to stdout, with a 'stop' every 25000. Its stretches
+# of commands between stops are long enough for -j to split. The generator is seeded, by default with 12345, so
+# the script is always the same.
+long_script() {
+    awk -v n="$1" -v seed="${2:-12345}" 'BEGIN {
+        split("forward backward left right penup pendown penchar hyper", cmd, " ")
+        for (i = 1; i <= n; i++) {
+            seed = (seed * 16807) % 2147483647
+            c = cmd[seed % 8 + 1]
+            if (c == "forward" || c == "backward") print c, seed % 20 + 1
+            else if (c == "penchar") print c, substr("*#@o+x", seed % 6 + 1, 1)
+            else if (c == "hyper") print c, seed % 50, int(seed / 50) % 50
+            else print c
+            if (i % 25000 == 0) print "stop"
+        }
+    }'
+}
+
+# turtles_script n : Writes a script of n turtle blocks to stdout, each of a long script of its own, so that the
+# turtles keep several threads busy and paint over each other's squares.
+turtles_script() {
+    local t
+    for ((t = 1; t <= $1; t++)); do
+        echo "turtle t$t"
+        long_script 20000 $t
+        echo "end"
+    done
+}
+
+# unroll : Copies the script on stdin to stdout with every 'repeat' block, nested or not, written out as many
+# times as it repeats, one token per line. The script must not use '[' or ']' as a pen char.
+unroll() {
+    awk '{ for (i = 1; i <= NF; i++) tok[++n] = $i }
+         function emit(from, to,    i, j, k, depth) {
+             for (i = from; i <= to; i++) {
+                 if (tok[i] != "repeat") { print tok[i]; continue }
+                 depth = 1
+                 for (j = i + 3; depth > 0; j++) depth += (tok[j] == "[") - (tok[j] == "]")
+                 for (k = 0; k < tok[i + 1]; k++) emit(i + 3, j - 2)
+                 i = j - 1
+             }
+         }
+         END { emit(1, n) }'
+}
+
+# fail name mode : Counts a failed check and says which.
+fail() {
+    echo "FAILED: $1 $2"
+    FAILED=$((FAILED + 1))
+}
+
+# pass_if name mode status : Counts a passed check if the status is zero, or a failed one if not.
+pass_if() {
+    if [ "$3" -eq 0 ]; then
+        PASSED=$((PASSED + 1))
+    else
+        fail "$1" "$2"
+    fi
+}
+
+# run script mode [options...] : Runs the script with the options, writing its output to $WORK/name.mode, where
+# name is the script's name without .myr.
+run() {
+    local script=$1 mode=$2
+    shift 2
+    "$MYRTLE" -i "$script" -o "$WORK/$(basename "$script" .myr).$mode" "$@" 2> /dev/null
+}
+
+# native script : Checks that jitbench -c finds that the script writes the same run as native code as it does
+# interpreted.
+native() {
+    "$JITBENCH" -c "$1" > /dev/null
+    pass_if "$(basename "$1" .myr)" native $?
+}
+
+# same script mode [options...] : Checks that running the script with the options writes exactly what the plain
+# run of it did.
+same() {
+    local name
+    name=$(basename "$1" .myr)
+    run "$@" && cmp -s "$WORK/$name.plain" "$WORK/$name.$2"
+    pass_if "$name" "$2" $?
+}
+
+# unrolled script : Checks that the script with its 'repeat' blocks unrolled writes exactly what the plain run of
+# it did.
+unrolled() {
+    local name
+    name=$(basename "$1" .myr)
+    unroll < "$1" > "$WORK/$name.unrolled.myr"
+    run "$WORK/$name.unrolled.myr" plain && cmp -s "$WORK/$name.plain" "$WORK/$name.unrolled.plain"
+    pass_if "$name" unrolled $?
+}
+
+# cached script : Checks that the script, padded up to CACHE_MIN_SIZE, writes exactly what the plain run of it
+# did both when its compiled program is written to the cache and when it is loaded from there. A program
+# without turtle blocks must have left a .myb file in the cache.
+cached() {
+    local name padded
+    name=$(basename "$1" .myr)
+    padded="$WORK/$name.padded.myr"
+    { cat "$1"; head -c $((256 << 10)) /dev/zero | tr '\0' '\n'; } > "$padded"
+    mkdir -p "$WORK/cache"
+    run "$padded" write -C "$WORK/cache" && cmp -s "$WORK/$name.plain" "$WORK/$name.padded.write"
+    pass_if "$name" cache-write $?
+    if ! grep -qw turtle "$1"; then
+        ls "$WORK/cache/$name.padded-"*.myb > /dev/null 2>&1
+        pass_if "$name" cache-file $?
+    fi
+    run "$padded" load -C "$WORK/cache" && cmp -s "$WORK/$name.plain" "$WORK/$name.padded.load"
+    pass_if "$name" cache-load $?
+}
+
+# recorded script : Checks that recording the script writes exactly what the plain run of it did, and that
+# replaying the trace writes the last world of the plain run. What --replay says about the trace is left in
+# $WORK/name.replay.err.
+recorded() {
+    local name
+    name=$(basename "$1" .myr)
+    same "$1" record --record "$WORK/$name.trace"
+    "$MYRTLE" --replay "$WORK/$name.trace" -o "$WORK/$name.replay" 2> "$WORK/$name.replay.err" &&
+        [ -s "$WORK/$name.replay" ] &&
+        tail -c "$(wc -c < "$WORK/$name.replay")" "$WORK/$name.plain" | cmp -s - "$WORK/$name.replay"
+    pass_if "$name" replay $?
+}
+
+# restored script : Checks that a run of the script which takes a checkpoint halfway through writes exactly what
+# the plain run did, and that restoring the checkpoint into a copy of that output with junk after it writes it
+# again. The number of commands comes from what --replay said about the trace of the script (see recorded()).
+restored() {
+    local name commands
+    name=$(basename "$1" .myr)
+    commands=$(sed -n 's/^Replayed [0-9]* of \([0-9]*\) commands.*/\1/p' "$WORK/$name.replay.err")
+    same "$1" checkpoint --checkpoint "$WORK/$name.ckpt" --every $((${commands:-0} / 2 + 1))
+    { cat "$WORK/$name.checkpoint"; echo junk; } > "$WORK/$name.restore"
+    same "$1" restore --restore "$WORK/$name.ckpt"
+}
+
+# wait_lines file n : Waits up to 10 seconds for the file to have at least n lines.
+wait_lines() {
+    local i
+    for ((i = 0; i < 200; i++)); do
+        [ "$(wc -l < "$1")" -ge "$2" ] && return 0
+        sleep 0.05
+    done
+    return 1
+}
+
+# watched script : Checks that --watch, once it has run the script with a 'left' put in two thirds of the way
+# down and then again after the script was saved without it, leaves exactly what the plain run wrote.
+watched() {
+    local name lines pid ok=false
+    name=$(basename "$1" .myr)
+    lines=$(wc -l < "$1")
+    awk -v at=$((lines * 2 / 3 + 1)) 'NR == at { print "left" } { print }' "$1" > "$WORK/$name.edit.myr"
+    "$MYRTLE" --watch -i "$WORK/$name.edit.myr" -o "$WORK/$name.watch" 2> "$WORK/$name.watch.log" &
+    pid=$!
+    if wait_lines "$WORK/$name.watch.log" 1; then
+        cp "$1" "$WORK/$name.saved.myr"
+        mv "$WORK/$name.saved.myr" "$WORK/$name.edit.myr"
+        wait_lines "$WORK/$name.watch.log" 2 && ok=true
+    fi
+    kill $pid
+    wait $pid 2> /dev/null
+    $ok && cmp -s "$WORK/$name.plain" "$WORK/$name.watch"
+    pass_if "$name" watch $?
+}
+
+long_script 100000 > "$WORK/long.myr"
+turtles_script 8 > "$WORK/many-turtles.myr"
+SCRIPTS="$(dirname "$0")/check/*.myr $WORK/long.myr $WORK/many-turtles.myr"
+
+for script in $SCRIPTS; do
+    if ! run "$script" plain; then
+        fail "$(basename "$script" .myr)" plain
+        continue
+    fi
+    same "$script" sparse -w sparse
+    same "$script" packed -w packed
+    same "$script" blocked -w blocked
+    same "$script" j1 -j 1
+    same "$script" j2 -j 2
+    same "$script" j8 -j 8
+    same "$script" O -O
+    same "$script" O-j8 -O -j 8
+    native "$script"
+    if grep -qw repeat "$script"; then unrolled "$script"; fi
+    cached "$script"
+    if ! grep -qw turtle "$script"; then
+        recorded "$script"
+        restored "$script"
+    fi
+    watched "$script"
+done
+
+echo "check: $PASSED passed, $FAILED failed"
+[ $FAILED -eq 0 ]
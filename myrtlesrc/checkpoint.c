@@ -0,0 +1,270 @@
+/***************************************************************************************************************
+ * FILE: checkpoint.c
+ *
+ * DESCRIPTION:
+ * Checkpoints of a run, written by --checkpoint and resumed from by --restore, so that a long run which crashes
+ * or is preempted does not have to start over. A checkpoint is taken just before a command is performed, and
+ * holds everything the rest of the run depends on: Myrtle's world and state, where she is in the program, the
+ * number of commands performed and how much output had been written by then.
+ *
+ * The program is compiled before it is performed, so where Myrtle is in it is not an offset in the input but a
+ * stack of frames, one for each 'repeat' and 'call' she is inside and one for the command about to be
+ * performed. A frame holds the index of its command in the compiled program and, for a 'repeat', its plan and
+ * the repetition being performed. A checkpoint also holds a hash of the compiled program, and only a run which
+ * compiles the same input with the same options to the same program may resume from it.
+ *
+ * A checkpoint file is a checkpoint_header_t, then the frames, then the world exactly as world_write() writes it.
+ * The header records CHECKPOINT_MAGIC, CHECKPOINT_VERSION, which is bumped whenever the layout of the file
+ * changes, and the sizes and byte order of the machine which wrote it, since the frames and header are written
+ * as they are in memory. A checkpoint is written under a temporary name and renamed, so a crash while it is
+ * being written leaves the previous one as it was.
+ *
+ * To resume, the file is mapped and the world is loaded straight from the mapping, so the time it takes depends
+ * on the size of the checkpoint and not on how many commands were performed before it was taken.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261017T0800 [JMW] Initial revision.
+ **************************************************************************************************************/
+/* mmap(), fstat() and friends are POSIX, not Standard C, so ask for them before including anything. */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bool.h"
+#include "checkpoint.h"
+#include "file.h"
+#include "globals.h"
+#include "par.h"
+#include "world.h"
+
+/* POSIX headers for open(), fstat() and mmap() */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * The header of a checkpoint file. See checkpoint_t for the fields after 'format', which is _checkpoint_format()
+ * of the machine which wrote it.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    char          magic[8];
+    long          version;
+    unsigned long format;
+    unsigned long program;
+    coord_t       rows;
+    coord_t       cols;
+    long          commands;
+    long          output;
+    long          depth;
+    par_turtle_t  turtle;
+} checkpoint_header_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC GLOBAL CONSTANT DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+static const char CHECKPOINT_MAGIC[8] = "MYRTLEK";  /* The first 8 bytes of every checkpoint file.         */
+static const long CHECKPOINT_VERSION  = 1;          /* Bump whenever the layout of a checkpoint changes.   */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+static int           _checkpoint_error(checkpoint_t *checkpoint, char *err, int status, const char *msg,
+                                       const char *fname);
+static unsigned long _checkpoint_format();
+static unsigned long _checkpoint_hash(unsigned long hash, const void *buf, size_t len);
+
+/*======================================= NONSTATIC FUNCTION DEFINITIONS =====================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: checkpoint_free()
+ * DESCR:    Unmaps the checkpoint file 'checkpoint' was loaded from, if any, and leaves it empty.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void checkpoint_free(checkpoint_t *checkpoint) {
+    if (checkpoint->map) munmap(checkpoint->map, checkpoint->map_size);
+    checkpoint_init(checkpoint);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: checkpoint_hash()
+ * DESCR:    Hashes the 'count' words of a compiled program at 'words', so that a checkpoint is only resumed by a
+ *           run of the program it was taken of.
+ * RETURNS:  The hash.
+ *------------------------------------------------------------------------------------------------------------*/
+unsigned long checkpoint_hash(const int *words, size_t count) {
+    return _checkpoint_hash(0, words, count * sizeof(int));
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: checkpoint_init()
+ * DESCR:    Initializes 'checkpoint' to none, not loaded from a file.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void checkpoint_init(checkpoint_t *checkpoint) {
+    memset(checkpoint, 0, sizeof(*checkpoint));
+    checkpoint->frames   = NULL;
+    checkpoint->cells    = NULL;
+    checkpoint->map      = NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: checkpoint_load()
+ * DESCR:    Maps the checkpoint file 'fname' and fills in 'checkpoint' from it. Its frames and world point into
+ *           the mapping, which stays until checkpoint_free(). Whatever 'checkpoint' was loaded from before is
+ *           unmapped first. Only the file is checked here; whether the frames fit the program is up to the run
+ *           which resumes from it.
+ * RETURNS:  TERM_NORM, or TERM_ERR_INPUT if the file cannot be read, is not a checkpoint, was written by another
+ *           version of Myrtle or is corrupt, in which case 'err', which must hold 160 chars, says which.
+ *------------------------------------------------------------------------------------------------------------*/
+int checkpoint_load(checkpoint_t *checkpoint, const char *fname, char *err) {
+    const checkpoint_header_t *header;
+    struct stat                st;
+    void                      *map = MAP_FAILED;
+    size_t                     size;
+    int                        fd;
+
+    checkpoint_free(checkpoint);
+    fd = open(fname, O_RDONLY);
+    if (fd < 0) {
+        return _checkpoint_error(checkpoint, err, TERM_ERR_INPUT, "Cannot open checkpoint file '%.100s'", fname);
+    }
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(checkpoint_header_t)) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+        return _checkpoint_error(checkpoint, err, TERM_ERR_INPUT, "'%.100s' is not a Myrtle checkpoint", fname);
+    }
+    checkpoint->map      = map;
+    checkpoint->map_size = st.st_size;
+
+    header = (const checkpoint_header_t *)map;
+    size   = checkpoint->map_size - sizeof(checkpoint_header_t);
+    if (memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic))) {
+        return _checkpoint_error(checkpoint, err, TERM_ERR_INPUT, "'%.100s' is not a Myrtle checkpoint", fname);
+    }
+    if (header->version != CHECKPOINT_VERSION || header->format != _checkpoint_format()) {
+        return _checkpoint_error(checkpoint, err, TERM_ERR_INPUT,
+                                 "The checkpoint '%.100s' was taken by another version of Myrtle", fname);
+    }
+    if (header->rows < 1 || header->rows > WORLD_MAX_DIM || header->cols < 1 || header->cols > WORLD_MAX_DIM ||
+        header->commands < 0 || header->output < 0 || header->depth < 1 ||
+        (size_t)header->depth > size / sizeof(checkpoint_frame_t) ||
+        (size_t)header->rows > (size - header->depth * sizeof(checkpoint_frame_t)) / ((size_t)header->cols + 1) ||
+        (size_t)header->rows * ((size_t)header->cols + 1) != size - header->depth * sizeof(checkpoint_frame_t) ||
+        header->turtle.row < 0 || header->turtle.row >= header->rows || header->turtle.col < 0 ||
+        header->turtle.col >= header->cols || header->turtle.dir < 0 || header->turtle.dir > 3) {
+        return _checkpoint_error(checkpoint, err, TERM_ERR_INPUT, "The checkpoint '%.100s' is corrupt", fname);
+    }
+
+    checkpoint->rows     = header->rows;
+    checkpoint->cols     = header->cols;
+    checkpoint->program  = header->program;
+    checkpoint->commands = header->commands;
+    checkpoint->output   = (size_t)header->output;
+    checkpoint->turtle   = header->turtle;
+    checkpoint->depth    = header->depth;
+    checkpoint->frames   = (const checkpoint_frame_t *)(header + 1);
+    checkpoint->cells    = (const char *)(checkpoint->frames + checkpoint->depth);
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: checkpoint_save()
+ * DESCR:    Writes 'checkpoint', whose world is 'world' (its 'cells' and 'map' are not used), to the checkpoint
+ *           file 'fname'. It is written to fname.tmp and renamed, so 'fname' is either the old checkpoint or
+ *           the new one, never part of one.
+ * RETURNS:  True if it was written.
+ *------------------------------------------------------------------------------------------------------------*/
+bool checkpoint_save(const checkpoint_t *checkpoint, world_t *world, const char *fname) {
+    checkpoint_header_t header;
+    file_t             *file = (file_t *)malloc(sizeof(file_t));
+    char               *tmp  = (char *)malloc(strlen(fname) + sizeof(".tmp"));
+    bool                ok;
+
+    if (!file || !tmp) {
+        free(file);
+        free(tmp);
+        return false;
+    }
+    sprintf(tmp, "%s.tmp", fname);
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version  = CHECKPOINT_VERSION;
+    header.format   = _checkpoint_format();
+    header.program  = checkpoint->program;
+    header.rows     = world->rows;
+    header.cols     = world->cols;
+    header.commands = checkpoint->commands;
+    header.output   = (long)checkpoint->output;
+    header.depth    = checkpoint->depth;
+    header.turtle   = checkpoint->turtle;
+
+    file_init(file);
+    ok = file_open_out(file, tmp) == TERM_NORM &&
+         file_write(file, (const char *)&header, sizeof(header)) == TERM_NORM &&
+         file_write(file, (const char *)checkpoint->frames,
+                    (size_t)checkpoint->depth * sizeof(checkpoint_frame_t)) == TERM_NORM &&
+         world_write(world, file) == TERM_NORM;
+    if (file_close(file) != TERM_NORM) ok = false;
+    if (!ok || rename(tmp, fname) != 0) {
+        remove(tmp);
+        ok = false;
+    }
+    free(file);
+    free(tmp);
+    return ok;
+}
+
+/*========================================= STATIC FUNCTION DEFINITIONS ======================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _checkpoint_error()
+ * DESCR:    Unmaps what was mapped of the checkpoint file 'fname' and formats the error message 'msg', which names
+ *           the file with "%.100s", into 'err'.
+ * RETURNS:  'status'.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _checkpoint_error(checkpoint_t *checkpoint, char *err, int status, const char *msg, const char *fname) {
+    checkpoint_free(checkpoint);
+    sprintf(err, msg, fname);
+    return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _checkpoint_format()
+ * DESCR:    Hashes what the header and frames of a checkpoint file mean on this machine: the sizes of an int, a
+ *           long, a coord_t, a par_turtle_t and a frame, and the byte order.
+ * RETURNS:  The hash.
+ *------------------------------------------------------------------------------------------------------------*/
+static unsigned long _checkpoint_format() {
+    long sizes[6];
+
+    sizes[0] = (long)sizeof(int);
+    sizes[1] = (long)sizeof(long);
+    sizes[2] = (long)sizeof(coord_t);
+    sizes[3] = (long)sizeof(par_turtle_t);
+    sizes[4] = (long)sizeof(checkpoint_frame_t);
+    sizes[5] = 1;
+    return _checkpoint_hash(0, sizes, sizeof(sizes));
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _checkpoint_hash()
+ * DESCR:    Adds the 'len' bytes at 'buf' to 'hash', which is 0 to start a new hash, with 64-bit FNV-1a.
+ * RETURNS:  The new hash.
+ *------------------------------------------------------------------------------------------------------------*/
+static unsigned long _checkpoint_hash(unsigned long hash, const void *buf, size_t len) {
+    const unsigned char *p   = (const unsigned char *)buf;
+    const unsigned char *end = p + len;
+
+    if (!hash) hash = 14695981039346656037UL;
+    for (; p < end; p++) hash = (hash ^ *p) * 1099511628211UL;
+    return hash;
+}
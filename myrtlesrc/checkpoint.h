@@ -0,0 +1,73 @@
+/***************************************************************************************************************
+ * FILE: checkpoint.h
+ *
+ * DESCRIPTION:
+ * Declarations for checkpoints of a run, which a later run resumes from. See comments in checkpoint.c.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261017T0800 [JMW] Initial revision.
+ **************************************************************************************************************/
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include <stddef.h>   /* For size_t.        */
+#include "bool.h"     /* For bool.          */
+#include "globals.h"  /* For coord_t.       */
+#include "par.h"      /* For par_turtle_t.  */
+#include "repeat.h"   /* For repeat_plan_t. */
+#include "world.h"    /* For world_t.       */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * One of the commands being performed when a checkpoint was taken, outermost first: the index in the compiled
+ * program of the command, and, if it is a 'repeat', how it was planned (see repeat.c) and which repetition of
+ * it was being performed, counting those performed before the skipped ones and not the skipped ones.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    long          pc;
+    long          rep;
+    repeat_plan_t plan;
+} checkpoint_frame_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * The state of a run as a command was about to be performed.
+ *
+ * rows, cols -- The size of Myrtle's world.
+ * program    -- checkpoint_hash() of the compiled program, which only a run of the same program may resume.
+ * commands   -- The number of commands performed before it, counted as -V lists them.
+ * output     -- The number of bytes of output written before it.
+ * turtle     -- Myrtle.
+ * frames     -- The commands being performed, from the outermost to the one about to be performed.
+ * depth      -- The number of frames. At least 1.
+ * cells      -- The world, as world_write() writes it.
+ * map        -- The mapping of the checkpoint file, which frames and cells point into, or NULL.
+ * map_size   -- The bytes mapped at map.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    coord_t                   rows;
+    coord_t                   cols;
+    unsigned long             program;
+    long                      commands;
+    size_t                    output;
+    par_turtle_t              turtle;
+    const checkpoint_frame_t *frames;
+    long                      depth;
+    const char               *cells;
+    void                     *map;
+    size_t                    map_size;
+} checkpoint_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * NONSTATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+extern void          checkpoint_free(checkpoint_t *checkpoint);
+extern unsigned long checkpoint_hash(const int *words, size_t count);
+extern void          checkpoint_init(checkpoint_t *checkpoint);
+extern int           checkpoint_load(checkpoint_t *checkpoint, const char *fname, char *err);
+extern bool          checkpoint_save(const checkpoint_t *checkpoint, world_t *world, const char *fname);
+
+#endif
@@ -0,0 +1,81 @@
+/***************************************************************************************************************
+ * FILE: code.c
+ *
+ * DESCRIPTION:
+ * Storage for a compiled Myrtle program. The compiler in myrtle.c appends words to a code_t with code_emit()
+ * and the execution loop walks the words array from front to back.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * 20261017T0300 [JMW] added code_view(), for running a program straight from a mapped cache file (cache.c)
+ * 20261016T1800 [JMW] code_emit() returns TERM_ERR_MEMORY instead of terminating the program
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261016T0900 [JMW] Initial revision.
+ **************************************************************************************************************/
+#include <stdlib.h>   /* For realloc(), free(). */
+#include <string.h>   /* For memcpy().          */
+#include "code.h"
+#include "globals.h"
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC GLOBAL CONSTANT DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+static const size_t CODE_INIT_CAP = 4096;  /* Words allocated on the first code_emit(). Doubles thereafter. */
+
+/*======================================= NONSTATIC FUNCTION DEFINITIONS =====================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: code_emit()
+ * DESCR:    Appends 'word' to the end of the instruction stream, growing the array when it is full. The words of
+ *           a view (see code_view()) are copied into an array of its own first.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the array cannot be grown.
+ *------------------------------------------------------------------------------------------------------------*/
+int code_emit(code_t *code, int word) {
+    if (code->count >= code->cap) {
+        size_t cap = code->cap ? code->cap * 2 : CODE_INIT_CAP;
+        int   *words;
+        while (cap <= code->count) cap *= 2;
+        words = (int *)realloc(code->cap ? code->words : NULL, cap * sizeof(int));
+        if (!words) return TERM_ERR_MEMORY;
+        if (!code->cap && code->count) memcpy(words, code->words, code->count * sizeof(int));
+        code->words = words;
+        code->cap   = cap;
+    }
+    code->words[code->count++] = word;
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: code_free()
+ * DESCR:    Releases the instruction stream and leaves 'code' empty. The words of a view are not freed.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void code_free(code_t *code) {
+    if (code->cap) free(code->words);
+    code_init(code);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: code_init()
+ * DESCR:    Initializes 'code' to an empty program.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void code_init(code_t *code) {
+    code->words = NULL;
+    code->count = 0;
+    code->cap   = 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: code_view()
+ * DESCR:    Makes 'code' a view of the 'count' words at 'words', which it does not own, so that a program can be
+ *           run from where it already is, such as a mapped cache file, without copying it. The words are only
+ *           read, unless code_emit() is called, which copies them first. Whatever 'code' held is freed.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void code_view(code_t *code, const int *words, size_t count) {
+    code_free(code);
+    code->words = (int *)words;
+    code->count = count;
+}
@@ -0,0 +1,45 @@
+/***************************************************************************************************************
+ * FILE: code.h
+ *
+ * DESCRIPTION:
+ * Declarations for the compiled form of a Myrtle program. See comments in code.c.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * 20261017T0300 [JMW] added code_view()
+ * 20261016T1800 [JMW] code_emit() returns a status
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261016T0900 [JMW] Initial revision.
+ **************************************************************************************************************/
+#ifndef __CODE_H__
+#define __CODE_H__
+
+#include <stddef.h>   /* For size_t. */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * A compiled Myrtle program is a flat array of ints. Each instruction is an opcode (one of the CMD_* constants
+ * in myrtle.h) followed immediately by its operands, so 'forward 10' compiles to the two words CMD_FORWARD, 10
+ * and 'hyper 3 4' compiles to the three words CMD_HYPER, 3, 4.
+ *
+ * words -- The instruction stream.
+ * count -- The number of words in use.
+ * cap   -- The number of words allocated. Zero when 'words' is a view of words 'code' does not own.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    int    *words;
+    size_t  count;
+    size_t  cap;
+} code_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * NONSTATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+extern int  code_emit(code_t *code, int word);
+extern void code_free(code_t *code);
+extern void code_init(code_t *code);
+extern void code_view(code_t *code, const int *words, size_t count);
+
+#endif
@@ -8,54 +8,50 @@
  *
  * MODIFICATION HISTORY:
  * 20111010T1728 [JMW] added static function prototypes
+ * 20261016T1100 [JMW] input is memory-mapped (or streamed in large blocks) and tokenized in place
+ * 20261016T1200 [JMW] tokens are found in batches by scan_tokens()
+ * 20261016T1400 [JMW] output goes through a buffer and is written with write(); added file_write(), file_flush()
+ * 20261016T1800 [JMW] the static globals became file_t; input can be a memory buffer and output can go to
+ *                     memory; errors are returned to the caller instead of terminating the program
+ * 20261017T0500 [JMW] count the bytes of input read in file->in_read
+ * 20261017T0800 [JMW] count the bytes of output in file->out_total; added file_open_out_at()
+ * 20261017T0900 [JMW] added file_cut_out(), file_open_out_end() and file_skip_in(), for watch mode
  * ------------------------------------------------------------------------------------------------------------
  * 01 Oct 2011 [KRB] Initial revision.
  **************************************************************************************************************/
 
+/* mmap(), fstat(), read() and friends are POSIX, not Standard C, so ask for them before including anything. */
+#define _POSIX_C_SOURCE 200112L
+
 /* Write necessary #include directives here. Hint: there should be FIVE. HintHint: file.h is one of them. */
 #include "file.h"
 #include "globals.h"
 #include "bool.h"
 
-/* main.c for main_terminate_err()*/
-#include "main.h"
+/* scan.h for scan_tokens() */
+#include "scan.h"
 
-/* stdio for fscanf() */
+/* stdio for sprintf() and fflush() */
 #include <stdio.h>
 
+/* stdlib for malloc() */
+#include <stdlib.h>
+
 /* string for strcpy() */
 #include <string.h>
 
-/*--------------------------------------------------------------------------------------------------------------
- * TYPEDEFS
- *
- * This structure type defines the static global variables for this module:
- *
- * in_fname  -- A C-string which stores the input file name parsed from the -i command line option.
- * out_fname -- A C-string which stores the output file name parsed from the -o command line option.
- * fin       -- The input file stream. Will either be stdin or an input file.
- * out       -- The output file stream. Will either be stdout or an output file.
- *------------------------------------------------------------------------------------------------------------*/
-typedef struct {
-    char  in_fname[128];
-    char  out_fname[128];
-    FILE *fin;
-    FILE *fout;
-} global_t;
+/* POSIX headers for open(), fstat(), mmap() and read() */
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 /*--------------------------------------------------------------------------------------------------------------
- * GLOBAL VARIABLE DEFINITIONS
- * 
- * 'globals' is a global variable structure which stores the global variables. This statement defines globals
- * and initializes each of the global variable. Note that the initialization of global variables is performed
- * once as the program is loaded into memory and before it begins executing.
+ * STATIC GLOBAL CONSTANT DEFINITIONS
  *------------------------------------------------------------------------------------------------------------*/
-static global_t globals = {
-    { '\0' },  /* Each element of in_fname[] is initialized to the null char.  */
-    { '\0' },  /* Each element of out_fname[] is initialized to the null char. */
-    NULL,      /* fin is initialized to NULL.                                  */
-    NULL       /* fout is initialized to NULL.                                 */
-};
+static const size_t FILE_BLOCK_SIZE = 1 << 20;  /* Bytes requested per read() when the input is not mapped. */
+static const size_t FILE_MEM_INIT   = 1 << 16;  /* Bytes allocated for output to memory at first. Doubles.   */
 
 /*--------------------------------------------------------------------------------------------------------------
  * STATIC FUNCTION DECLARATIONS (PROTOTYPES)
@@ -70,141 +66,381 @@ static global_t globals = {
  * to call a function, the compiler must know those three things. Hint: there should be four declarations.
  */
 
-static void _file_close_in() ;
-static void _file_close_out();
-static void _file_open_in();
-static void _file_open_out();
+static int  _file_error(file_t *file, int status, const char *msg, const char *fname);
+static void _file_in_reset(file_t *file);
+static int  _file_refill(file_t *file, size_t keep);
+static int  _file_write_all(file_t *file, const char *buf, size_t len);
 
 /*======================================= NONSTATIC FUNCTION DEFINITIONS =====================================*/
 
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: file_close_files()
- * DESCR:    Closes the input and output files.    
+ * FUNCTION: file_close()
+ * DESCR:    Writes any buffered output, then closes the input and output files. Output written to memory stays
+ *           available from file_mem() until the next file_open_out_mem() or file_free().
+ * RETURNS:  TERM_NORM, or the TERM_ERR_* code of the first error on 'file'.
+ *------------------------------------------------------------------------------------------------------------*/
+int file_close(file_t *file) {
+    file_flush(file);
+    if (file->in_mapped) munmap(file->in_buf, file->in_len);
+    else if (file->in_cap) free(file->in_buf);
+    file->in_buf = NULL;
+    file->in_cap = 0;
+    file->in_mapped = false;
+    if (file->fin > 0) close(file->fin);    /* Don't close stdin.  */
+    if (file->fout > 1) close(file->fout);  /* Don't close stdout. */
+    file->fin = file->fout = -1;
+    return file->status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: file_cut_out()
+ * DESCR:    Cuts the output back to its first 'offset' bytes, which must all have been written since it was
+ *           opened, so that what is written next follows them. stdout cannot be cut.
+ * RETURNS:  TERM_NORM, or TERM_ERR_OUTPUT if the output cannot be cut there.
+ *------------------------------------------------------------------------------------------------------------*/
+int file_cut_out(file_t *file, size_t offset) {
+    if (file_flush(file) != TERM_NORM || offset == file->out_total) return file->status;
+    if (offset > file->out_total || file->fout == 0 || file->fout == 1 ||
+        (file->fout > 1 && (ftruncate(file->fout, (off_t)offset) != 0 ||
+                            lseek(file->fout, (off_t)offset, SEEK_SET) < 0))) {
+        return _file_error(file, TERM_ERR_OUTPUT, "Cannot cut the output back", NULL);
+    }
+    if (file->fout < 0) file->mem_len = offset;
+    file->out_total = offset;
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: file_flush()
+ * DESCR:    Writes any buffered output to the output file.
+ * RETURNS:  TERM_NORM, or the TERM_ERR_* code of the first error on 'file'.
+ *------------------------------------------------------------------------------------------------------------*/
+int file_flush(file_t *file) {
+    if (file->out_len) _file_write_all(file, file->out_buf, file->out_len);
+    file->out_len = 0;
+    return file->status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: file_free()
+ * DESCR:    Closes 'file' and frees the memory output buffer.
  * RETURNS:  Nothing.
  *------------------------------------------------------------------------------------------------------------*/
-void file_close_files() {
-    /* Call the static functions to close the input and output files. */
-	_file_close_in();
-	_file_close_out();
+void file_free(file_t *file) {
+    file_close(file);
+    free(file->mem);
+    file->mem = NULL;
+    file->mem_len = file->mem_cap = 0;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: file_next_token()
- * DESCR:    Returns the next string (i.e., in programming language terms, these "words" are called "tokens")
- *           from the input source code file.
- * RETURNS:  A pointer to a char buffer containing the token, or NULL on EOF.
- *------------------------------------------------------------------------------------------------------------*/
-char *file_next_token() {
-    /* A static local variable is one that is allocated statically, i.e., the variable comes into existence
-     * when the program begins executing and the variable remains allocated until the program terminates.
-     * However, unlike a global variable, a static local variable only has scope from the point where it is
-     * defined to the end of the function. Therefore the scope of 'buffer' is basically this function. The
-     * reason buffer is static is because we return a pointer to this buffer, and when we return from the
-     * function, we do not want the buffer to be deallocated. I could have defined buffer as a static global
-     * variable in this source code file, but then it would be global to every function in this source code
-     * file, but this is the only function in which it is used. Therefore, it is better to define it as a
-     * static local variable.
-     */
-    static char buffer[32];
-    int read = fscanf(globals.fin, "%s", buffer);  /* & not needed because buffer is an array.     */
-    return ((read == 1) ? buffer : NULL);            /* fscanf() returns the number of strings read. */
-}
-
-/*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: file_open_files()
- * DESCR:    Opens both the input and output files.
+ * FUNCTION: file_init()
+ * DESCR:    Initializes 'file' with no input or output open.
  * RETURNS:  Nothing.
  *------------------------------------------------------------------------------------------------------------*/
-void file_open_files() {
-    /* Call the static functions to open the input and output files. */
-	_file_open_in();
-	_file_open_out();
+void file_init(file_t *file) {
+    file->fin       = -1;
+    file->fout      = -1;
+    file->in_buf    = NULL;
+    file->in_cap    = 0;
+    file->in_mapped = false;
+    file->out_len   = 0;
+    file->out_total = 0;
+    file->mem       = NULL;
+    file->mem_len   = 0;
+    file->mem_cap   = 0;
+    file->status    = TERM_NORM;
+    file->error[0]  = '\0';
+    _file_in_reset(file);
 }
 
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: file_set_in_fname()
- * DESCR:    Mutator function for the globals.in_fname variable.
+ * FUNCTION: file_mem()
+ * DESCR:    Returns the output written to memory. Any buffered output is flushed first.
+ * RETURNS:  The output, which is not null-terminated. *len is set to its length.
+ *------------------------------------------------------------------------------------------------------------*/
+char *file_mem(file_t *file, size_t *len) {
+    file_flush(file);
+    *len = file->mem_len;
+    return file->mem;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: file_next_token()
+ * DESCR:    Returns the next string (i.e., in programming language terms, these "words" are called "tokens") in
+ *           the input source code file. Tokens are separated by the same whitespace chars as fscanf("%s").
+ *           Tokens are found FILE_TOKEN_BATCH at a time by scan_tokens() and handed out one per call. Nothing is
+ *           copied: 'token' points into the input buffer and is NOT null-terminated. When the input is
+ *           streamed, the buffer may be refilled by the next call, so the token is only valid until then.
+ * RETURNS:  True if a token was found, false on EOF or if the input could not be read. In the latter case
+ *           file->status is set.
+ *------------------------------------------------------------------------------------------------------------*/
+bool file_next_token(file_t *file, token_t *token) {
+    while (file->tok_next == file->tok_count) {
+        file->tok_next  = 0;
+        file->tok_count = scan_tokens(file->in_buf, file->in_len, file->in_eof, &file->in_pos, &file->in_line,
+                                      file->toks, FILE_TOKEN_BATCH, SCAN_AUTO);
+        if (file->tok_count) break;
+        if (file->in_eof) return false;
+        if (_file_refill(file, file->in_pos) != TERM_NORM) return false;  /* Keep the incomplete token. */
+    }
+    *token = file->toks[file->tok_next++];
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: file_open_in()
+ * DESCR:    Opens the file 'fname' for reading. If 'fname' is NULL or the empty string, we are reading from
+ *           stdin, so file->fin will be set to 0. If the input is a regular file, the whole file is mapped into
+ *           memory and tokens are found in place. Otherwise (stdin, pipes, devices, or if mmap() fails) the
+ *           input is read in FILE_BLOCK_SIZE blocks by _file_refill().
+ * RETURNS:  TERM_NORM, or TERM_ERR_INPUT if the file cannot be opened.
+ *------------------------------------------------------------------------------------------------------------*/
+int file_open_in(file_t *file, const char *fname) {
+    struct stat st;
+
+    _file_in_reset(file);
+    file->fin = (fname && *fname) ? open(fname, O_RDONLY) : 0;
+    if (file->fin < 0) return _file_error(file, TERM_ERR_INPUT, "Cannot open input file '%s'", fname);
+
+    if (fstat(file->fin, &st) == 0 && S_ISREG(st.st_mode)) {
+        if (st.st_size == 0) {
+            file->in_eof = true;
+            return TERM_NORM;
+        }
+        file->in_buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, file->fin, 0);
+        if (file->in_buf != MAP_FAILED) {
+            posix_madvise(file->in_buf, st.st_size, POSIX_MADV_SEQUENTIAL);
+            file->in_len    = file->in_read = st.st_size;
+            file->in_mapped = true;
+            file->in_eof    = true;
+            return TERM_NORM;
+        }
+        file->in_buf = NULL;
+    }
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: file_open_in_buf()
+ * DESCR:    Makes the 'len' bytes at 'buf' the input. Tokens are found in place, so 'buf' must not change until
+ *           file_close().
  * RETURNS:  Nothing.
  *------------------------------------------------------------------------------------------------------------*/
-void file_set_in_fname(char *fname) {
-    strcpy(globals.in_fname, fname);
+void file_open_in_buf(file_t *file, const char *buf, size_t len) {
+    _file_in_reset(file);
+    file->in_buf  = (char *)buf;  /* The scanner only reads it. */
+    file->in_len  = file->in_read = len;
+    file->in_eof  = true;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: file_set_out_fname()
- * DESCR:    Mutator function for the globals.out_fname variable.
+ * FUNCTION: file_open_out()
+ * DESCR:    Opens the file 'fname' for writing, creating or truncating it like fopen() with mode "wt" would. If
+ *           'fname' is NULL or the empty string, we are writing to stdout, so file->fout will be set to 1.
+ * RETURNS:  TERM_NORM, or TERM_ERR_INPUT if the file cannot be opened.
+ *------------------------------------------------------------------------------------------------------------*/
+int file_open_out(file_t *file, const char *fname) {
+    file->out_len   = 0;
+    file->out_total = 0;
+    file->fout = (fname && *fname) ? open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0666) : 1;
+    if (file->fout < 0) return _file_error(file, TERM_ERR_INPUT, "Cannot open outut file '%s'", fname);
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: file_open_out_at()
+ * DESCR:    Opens the file 'fname' for writing like file_open_out(), but keeps its first 'offset' bytes and cuts
+ *           off the rest, so that what is written next follows them, as if they had been written since it was
+ *           opened. Used to resume a run whose output had reached 'offset'. stdout cannot be cut, so output to
+ *           stdout just follows whatever is there.
+ * RETURNS:  TERM_NORM, TERM_ERR_INPUT if the file cannot be opened, or TERM_ERR_OUTPUT if it is shorter than
+ *           'offset' or cannot be cut.
+ *------------------------------------------------------------------------------------------------------------*/
+int file_open_out_at(file_t *file, const char *fname, size_t offset) {
+    struct stat st;
+
+    file->out_len   = 0;
+    file->out_total = offset;
+    file->fout = (fname && *fname) ? open(fname, O_WRONLY | O_CREAT, 0666) : 1;
+    if (file->fout < 0) return _file_error(file, TERM_ERR_INPUT, "Cannot open output file '%s'", fname);
+    if (file->fout == 1) return TERM_NORM;
+    if (fstat(file->fout, &st) != 0 || (size_t)st.st_size < offset || ftruncate(file->fout, (off_t)offset) != 0 ||
+        lseek(file->fout, (off_t)offset, SEEK_SET) < 0) {
+        return _file_error(file, TERM_ERR_OUTPUT, "Cannot resume the output file '%s'", fname);
+    }
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: file_open_out_end()
+ * DESCR:    Opens the file 'fname' for writing like file_open_out(), but keeps what is in it and writes after it,
+ *           as if it had all been written since it was opened, so that file_cut_out() can cut it back to where a
+ *           run resumes from. Output to stdout starts with nothing written.
+ * RETURNS:  TERM_NORM, or TERM_ERR_INPUT if the file cannot be opened.
+ *------------------------------------------------------------------------------------------------------------*/
+int file_open_out_end(file_t *file, const char *fname) {
+    off_t end = 0;
+
+    file->out_len   = 0;
+    file->out_total = 0;
+    file->fout = (fname && *fname) ? open(fname, O_WRONLY | O_CREAT, 0666) : 1;
+    if (file->fout < 0) return _file_error(file, TERM_ERR_INPUT, "Cannot open output file '%s'", fname);
+    if (file->fout > 1 && (end = lseek(file->fout, 0, SEEK_END)) < 0) {
+        return _file_error(file, TERM_ERR_INPUT, "Cannot open output file '%s'", fname);
+    }
+    file->out_total = (size_t)end;
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: file_open_out_mem()
+ * DESCR:    Sends the output to memory, where file_mem() finds it. The memory left by a previous run is reused.
  * RETURNS:  Nothing.
  *------------------------------------------------------------------------------------------------------------*/
-void file_set_out_fname(char *fname) {
-    /* Copy the string 'fname' to globals.out_fname. */
-    strcpy(globals.out_fname, fname);
+void file_open_out_mem(file_t *file) {
+    file->out_len   = 0;
+    file->out_total = 0;
+    file->fout      = -1;
+    file->mem_len   = 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: file_skip_in()
+ * DESCR:    Skips the input to offset 'pos', the first char of a token on line 'line', as if the tokens before it
+ *           had been read. Only input which is all in memory, a mapped file or a buffer, can be skipped.
+ * RETURNS:  True, or false if the input is streamed or shorter than 'pos'.
+ *------------------------------------------------------------------------------------------------------------*/
+bool file_skip_in(file_t *file, size_t pos, int line) {
+    if (!file->in_eof || file->in_cap || pos > file->in_len) return false;
+    file->in_pos    = pos;
+    file->in_line   = line;
+    file->tok_count = 0;
+    file->tok_next  = 0;
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: file_write()
+ * DESCR:    Writes 'len' bytes from 'buf' to the output file. Small writes are collected in file->out_buf; a
+ *           write at least as big as the buffer goes straight to the file in one write() call.
+ * RETURNS:  TERM_NORM, or the TERM_ERR_* code of the first error on 'file'.
+ *------------------------------------------------------------------------------------------------------------*/
+int file_write(file_t *file, const char *buf, size_t len) {
+    if (file->out_len + len > FILE_OUT_BUF_SIZE) file_flush(file);
+    if (len >= FILE_OUT_BUF_SIZE) {
+        _file_write_all(file, buf, len);
+    } else {
+        memcpy(file->out_buf + file->out_len, buf, len);
+        file->out_len += len;
+    }
+    file->out_total += len;
+    return file->status;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
  * FUNCTION: file_write_char()
  * DESCR:    Writes one character to the output file.
- * RETURNS:  Nothing.
+ * RETURNS:  TERM_NORM, or the TERM_ERR_* code of the first error on 'file'.
  *------------------------------------------------------------------------------------------------------------*/
-void file_write_char(char ch) {
-    fprintf(globals.fout, "%c", ch);
+int file_write_char(file_t *file, char ch) {
+    if (file->out_len == FILE_OUT_BUF_SIZE) file_flush(file);
+    file->out_buf[file->out_len++] = ch;
+    file->out_total++;
+    return file->status;
 }
 
 /*========================================= STATIC FUNCTION DEFINITIONS ======================================*/
 
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: _file_close_in()
- * DESCR:    Closes the input file stream.
- * RETURNS:  Nothing.
+ * FUNCTION: _file_error()
+ * DESCR:    Records an error on 'file', unless there already is one. 'msg' may contain one %s, for 'fname'.
+ * RETURNS:  file->status.
  *------------------------------------------------------------------------------------------------------------*/
-static void _file_close_in() {
-    if (globals.fin != stdin) fclose(globals.fin);  /* Don't close stdin. */
+static int _file_error(file_t *file, int status, const char *msg, const char *fname) {
+    if (file->status != TERM_NORM) return file->status;
+    file->status = status;
+    sprintf(file->error, msg, fname ? fname : "");
+    return status;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: _file_close_out()
- * DESCR:    Closes the output file stream.
- * RETURNS:  Nothing
+ * FUNCTION: _file_in_reset()
+ * DESCR:    Forgets the previous input and any error, ready for a new input to be opened.
+ * RETURNS:  Nothing.
  *------------------------------------------------------------------------------------------------------------*/
-static void _file_close_out() {
-    if (globals.fout != stdout) fclose(globals.fout);  /* Don't close stdout. */
+static void _file_in_reset(file_t *file) {
+    file->in_len    = file->in_pos = file->in_read = 0;
+    file->tok_count = file->tok_next = 0;
+    file->in_line   = 1;
+    file->in_eof    = false;
+    file->status    = TERM_NORM;
+    file->error[0]  = '\0';
 }
 
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: _file_open_in()
- * DESCR:    If an input filename was specified on the command line with the -i option, then this function
- *           opens that file for reading. The mode "rt" means read/text and is used to open a text file for
- *           reading. If the -i command line option was not specified, then the globals.in_fname variable
- *           will be the empty string (i.e., the first char will be '\0'). In this case, we are reading from
- *           stdin, so globals.fin will be set to stdin.
- * RETURNS:  Nothing. If the filename specified with the -i command line option cannot be opened, then the
- *           program terminates with an error code of TERM_ERR_INPUT. Otherwise, globals.fin will be a valid
- *           file stream pointer.
+ * FUNCTION: _file_refill()
+ * DESCR:    Reads the next block of a streamed input. The bytes from offset 'keep' to the end of the window are
+ *           the start of a token which has not been found yet, so they are slid to the front of the window
+ *           first. The window is doubled if that token already fills it.
+ * RETURNS:  TERM_NORM. Sets file->in_eof when the input is exhausted. TERM_ERR_INPUT on a read error, or
+ *           TERM_ERR_MEMORY if the window cannot be grown.
  *------------------------------------------------------------------------------------------------------------*/
-static void _file_open_in() {
-    globals.fin = *globals.in_fname ? fopen(globals.in_fname, "rt") : stdin;
-    if (!globals.fin) {
-        char buffer[128];
-        sprintf(buffer, "Cannot open input file '%s'", globals.in_fname);
-        main_terminate_err(buffer, TERM_ERR_INPUT);
+static int _file_refill(file_t *file, size_t keep) {
+    size_t  kept = file->in_len - keep;
+    ssize_t got;
+
+    if (kept) memmove(file->in_buf, file->in_buf + keep, kept);
+    file->in_len = kept;
+    file->in_pos = 0;
+    if (file->in_cap - kept < FILE_BLOCK_SIZE) {
+        size_t cap = file->in_cap ? file->in_cap * 2 : FILE_BLOCK_SIZE;
+        char  *buf = (char *)realloc(file->in_buf, cap);
+        if (!buf) return _file_error(file, TERM_ERR_MEMORY, "Out of memory reading input file", NULL);
+        file->in_buf = buf;
+        file->in_cap = cap;
     }
+    do {
+        got = read(file->fin, file->in_buf + kept, file->in_cap - kept);
+    } while (got < 0 && errno == EINTR);
+    if (got < 0) return _file_error(file, TERM_ERR_INPUT, "Cannot read input file", NULL);
+    if (got == 0) file->in_eof = true;
+    file->in_len  += got;
+    file->in_read += got;
+    return TERM_NORM;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: _file_open_out()
- * DESCR:    If an output filename was specified on the command line with the -o option, then this function
- *           opens that file for writing. The mode "wt" means write/text and is used to open a text file for
- *           writing. If the -o command line option was not specified, then the globals.out_fname variable
- *           will be the empty string (i.e., the first char will be '\0'). In this case, we are writing to
- *           stdout, so globals.fout will be set to stdout.
- * RETURNS:  Nothing. If the filename specified with the -o command line option cannot be opened, then the
- *           program terminates with an error code of TERM_ERR_OUTPUT. Otherwise, globals.fout will be a valid
- *           file stream pointer.
+ * FUNCTION: _file_write_all()
+ * DESCR:    Writes all 'len' bytes at 'buf' to the output file, retrying after partial writes, or appends them
+ *           to file->mem when the output goes to memory. When the output file is stdout, anything the rest of
+ *           the program has printed with stdio (e.g. verbose mode) is flushed first, so the two appear in the
+ *           order they were produced. Once there has been an error, nothing more is written.
+ * RETURNS:  TERM_NORM, TERM_ERR_OUTPUT on a write error, or TERM_ERR_MEMORY if file->mem cannot be grown.
  *------------------------------------------------------------------------------------------------------------*/
-static void _file_open_out() {
-    globals.fout = *globals.out_fname ? fopen(globals.out_fname, "wt") : stdout;
-    if (!globals.fout) {
-        char buffer[128];
-        sprintf(buffer, "Cannot open outut file '%s'", globals.out_fname);
-        main_terminate_err(buffer, TERM_ERR_INPUT);
+static int _file_write_all(file_t *file, const char *buf, size_t len) {
+    if (file->status != TERM_NORM) return file->status;
+    if (file->fout < 0) {
+        if (file->mem_len + len > file->mem_cap) {
+            size_t cap = file->mem_cap ? file->mem_cap : FILE_MEM_INIT;
+            char  *mem;
+            while (cap < file->mem_len + len) cap *= 2;
+            mem = (char *)realloc(file->mem, cap);
+            if (!mem) return _file_error(file, TERM_ERR_MEMORY, "Out of memory writing output", NULL);
+            file->mem     = mem;
+            file->mem_cap = cap;
+        }
+        memcpy(file->mem + file->mem_len, buf, len);
+        file->mem_len += len;
+        return TERM_NORM;
+    }
+    if (file->fout == 1) fflush(stdout);
+    while (len) {
+        ssize_t put = write(file->fout, buf, len);
+        if (put < 0 && errno == EINTR) continue;
+        if (put <= 0) return _file_error(file, TERM_ERR_OUTPUT, "Cannot write output file", NULL);
+        buf += put;
+        len -= put;
     }
+    return TERM_NORM;
 }
@@ -9,6 +9,14 @@
  * MODIFICATION HISTORY:
  * 20111010T1728 [JMW] added ifndef, define, directives to prevent multiple inclusion
  * 20111010T1729 [JMW] added nonstatic fcn prototypes
+ * 20261016T1100 [JMW] added token_t; file_next_token() returns a view into the input buffer
+ * 20261016T1200 [JMW] added token_t.value, filled in by the scanner in scan.c; removed file_token_int()
+ * 20261016T1400 [JMW] added file_flush() and file_write()
+ * 20261016T1800 [JMW] added file_t, so the caller owns the file state; output can go to memory; errors are
+ *                     returned instead of terminating the program
+ * 20261017T0500 [JMW] added file_t.in_read, for -S
+ * 20261017T0800 [JMW] added file_t.out_total, for checkpoints; added file_open_out_at()
+ * 20261017T0900 [JMW] added file_cut_out(), file_open_out_end() and file_skip_in(), for watch mode
  * ------------------------------------------------------------------------------------------------------------
  * 01 Oct 2011 [KRB] Initial revision.
  **************************************************************************************************************/
@@ -17,6 +25,85 @@
 #ifndef __FILE_H__
 #define __FILE_H__
 
+#include <stddef.h>   /* For size_t. */
+#include "bool.h"
+
+/*--------------------------------------------------------------------------------------------------------------
+ * PREPROCESSOR MACRO DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+#define FILE_TOKEN_BATCH  256        /* Tokens found per call to scan_tokens(). Macros because they size arrays. */
+#define FILE_OUT_BUF_SIZE (1 << 16)  /* Bytes of output buffered before they are written.                       */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * A token found by file_next_token(). The token is not copied out of the input buffer, so 'text' is NOT null-
+ * terminated; always use 'len'.
+ *
+ * text  -- Points to the first char of the token in the input buffer.
+ * len   -- The number of chars in the token.
+ * line  -- The line of the input file which the token is on. The first line is 1.
+ * value -- If the token begins with a digit, '+' or '-', what atoi() would return for it. Otherwise zero.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    char *text;
+    int   len;
+    int   line;
+    int   value;
+} token_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * The input and output of one run of the interpreter. Every function in file.c takes a pointer to one, so any
+ * number of runs can be going at once.
+ *
+ * fin       -- The input file descriptor: 0 (stdin), an input file, or -1 when the input is a memory buffer.
+ * fout      -- The output file descriptor: 1 (stdout), an output file, or -1 when the output goes to memory.
+ * in_buf    -- The input bytes. If in_mapped is true, this is the whole input file mapped into memory. If fin is
+ *              -1, this is the caller's buffer. Otherwise, this is a window of the input which is refilled by
+ *              _file_refill() as tokens are consumed.
+ * in_len    -- The number of valid bytes in in_buf.
+ * in_cap    -- The number of bytes allocated for in_buf. Zero when in_buf is a mapping or the caller's buffer.
+ * in_pos    -- The offset in in_buf where the next token search begins.
+ * in_line   -- The source line of the byte at in_pos. Starts at 1.
+ * in_mapped -- True if in_buf is a mapping of the input file.
+ * in_eof    -- True when there is nothing more to read into in_buf.
+ * in_read   -- The number of bytes of input read (or mapped) since the input was opened.
+ * toks      -- The batch of tokens most recently found by scan_tokens(). They point into in_buf.
+ * tok_count -- The number of tokens in toks.
+ * tok_next  -- The index in toks of the token file_next_token() returns next.
+ * out_buf   -- Output which has not been written to fout yet.
+ * out_len   -- The number of bytes in out_buf.
+ * out_total -- The number of bytes of output since the output was opened, including those still in out_buf.
+ * mem       -- When fout is -1, everything written so far. Kept between runs so that it can be reused.
+ * mem_len   -- The number of bytes in mem.
+ * mem_cap   -- The number of bytes allocated for mem.
+ * status    -- TERM_NORM, or the TERM_ERR_* code of the first error.
+ * error     -- The message for 'status'.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    int     fin;
+    int     fout;
+    char   *in_buf;
+    size_t  in_len;
+    size_t  in_cap;
+    size_t  in_pos;
+    int     in_line;
+    bool    in_mapped;
+    bool    in_eof;
+    size_t  in_read;
+    token_t toks[FILE_TOKEN_BATCH];
+    size_t  tok_count;
+    size_t  tok_next;
+    char    out_buf[FILE_OUT_BUF_SIZE];
+    size_t  out_len;
+    size_t  out_total;
+    char   *mem;
+    size_t  mem_len;
+    size_t  mem_cap;
+    int     status;
+    char    error[160];
+} file_t;
+
 /*--------------------------------------------------------------------------------------------------------------
  * NONSTATIC FUNCTION DECLARATIONS (PROTOTYPES)
  *
@@ -26,18 +113,22 @@
  *
  * Hint: think of the word "extern" as meaning "public".
  *------------------------------------------------------------------------------------------------------------*/
-
-/* 
- * Write function declarations for the nonstatic functions defined in file.c. Note that the word "extern" at
- * the beginning of the line tells the compiler that these are function declarations for functions defined in
- * an "external" file, aka, another source code file. Hint: these should be six function declarations here.
- */
-extern void file_close_files();
-extern char *file_next_token();
-extern void file_open_files();
-extern void file_set_in_fname(char *fname);
-extern void file_set_out_fname(char *fname);
-extern void file_write_char(char ch);
+extern int   file_close(file_t *file);
+extern int   file_cut_out(file_t *file, size_t offset);
+extern int   file_flush(file_t *file);
+extern void  file_free(file_t *file);
+extern void  file_init(file_t *file);
+extern char *file_mem(file_t *file, size_t *len);
+extern bool  file_next_token(file_t *file, token_t *token);
+extern int   file_open_in(file_t *file, const char *fname);
+extern void  file_open_in_buf(file_t *file, const char *buf, size_t len);
+extern int   file_open_out(file_t *file, const char *fname);
+extern int   file_open_out_at(file_t *file, const char *fname, size_t offset);
+extern int   file_open_out_end(file_t *file, const char *fname);
+extern void  file_open_out_mem(file_t *file);
+extern bool  file_skip_in(file_t *file, size_t pos, int line);
+extern int   file_write(file_t *file, const char *buf, size_t len);
+extern int   file_write_char(file_t *file, char ch);
 
 /* What goes here at the end of a header file? */
 #endif
@@ -10,6 +10,8 @@
  * AUTHORS: Kevin R. Burger (burgerk@asu.edu) [KRB]
  *
  * MODIFICATION HISTORY:
+ * 20261016T1500 [JMW] MAX_WORLD_ROWS and MAX_WORLD_COLS are the default size; -r and -c on the command line
+ *                     override them
  * ------------------------------------------------------------------------------------------------------------
  * 01 Oct 2011 [KRB] Initial revision.
  **************************************************************************************************************/
@@ -35,9 +37,9 @@
  * "declarations" go in .h files.
  *------------------------------------------------------------------------------------------------------------*/
 
-/* Define an int constant named MAX_WORLD_ROWS and initialize it to 50. */
+/* Define an int constant named MAX_WORLD_ROWS and initialize it to 50. The world is this tall unless -r. */
 const int MAX_WORLD_ROWS = 50;
 
-/* Define an int constant named MAX_WORLD_COLS and initialize it to 50. */
+/* Define an int constant named MAX_WORLD_COLS and initialize it to 50. The world is this wide unless -c. */
 const int MAX_WORLD_COLS = 50;
 
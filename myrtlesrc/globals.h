@@ -8,6 +8,9 @@
  *
  * MODIFICATION HISTORY:
  * * 20111010T1716 [JMW] added ifndef, define, directives to prevent multiple inclusion
+ * 20261016T0900 [JMW] added TERM_ERR_MEMORY and TERM_ERR_SYNTAX
+ * 20261016T1500 [JMW] added coord_t; MAX_WORLD_ROWS and MAX_WORLD_COLS are now the default world size
+ * 20261017T0800 [JMW] added TERM_ERR_STOPPED
  * ------------------------------------------------------------------------------------------------------------
  * 01 Oct 2011 [KRB] Initial revision.
  **************************************************************************************************************/
@@ -36,6 +39,9 @@
 #define TERM_ERR_CMD_LINE   -2
 #define TERM_ERR_OUTPUT     -3
 #define TERM_ERR_UNK_CMD    -4
+#define TERM_ERR_MEMORY     -5
+#define TERM_ERR_SYNTAX     -6
+#define TERM_ERR_STOPPED    -7
 
 /*
  * I hate writing "if (!strcmp(s1, s2))" to compare two strings for equality because I think it is ugly. This
@@ -44,6 +50,14 @@
  */
 #define streq(s1,s2) (!strcmp((s1),(s2)))
 
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * A row or column number in Myrtle's world. The world can be far wider and taller than an int can count, so
+ * positions and sizes are 64 bits.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef long long coord_t;
+
 /*--------------------------------------------------------------------------------------------------------------
  * GLOBAL CONSTANT DECLARATIONS
  *------------------------------------------------------------------------------------------------------------*/
@@ -0,0 +1,489 @@
+/***************************************************************************************************************
+ * FILE: jit.c
+ *
+ * DESCRIPTION:
+ * Compiles a Myrtle program to native x86-64 code, for myrtle_ctx_jit_set(). The code is emitted straight into
+ * memory and mapped executable; no compiler or assembler is run.
+ *
+ * A Myrtle program has no branches and reads no input, so, as in opt.c, where Myrtle is, which way she faces and
+ * what her pen is doing are known at every command when the program is compiled. The compiler follows her
+ * through the program exactly as _myrtle_exec() would, with the same wrapping as _myrtle_move() and the same
+ * clamping as _myrtle_cmd_hyper(), and a 'repeat' block is followed as _myrtle_cmd_repeat() performs it, with
+ * repeat_plan(). The only commands left in the native code are the ones which can be seen:
+ *
+ *     - Every run of squares drawn becomes stores into the cells of a dense world (see world.h) at offsets
+ *       worked out for the size of the world when the program is compiled. A run along a row is stored 8
+ *       squares at a time, or with 'rep stosb' if it is long. A run down a col is a store per square, or a loop
+ *       stepping a row at a time if it is long.
+ *     - Every 'stop' becomes a call to the stop function given to jit_run(). A status other than TERM_NORM
+ *       ends the run with that status.
+ *
+ * The native code is one function, int fn(char *cells, void *arg, jit_stop_t stop), in the System V calling
+ * convention. It keeps cells, arg and stop in rbx, r12 and r13, which the stop function preserves, and the pen
+ * char, repeated in every byte, in rax. The code for returning is emitted first, so that a failed 'stop' can
+ * jump back to it.
+ *
+ * Compiling costs about as much as performing the program once, so the compiled program is kept in the jit_t,
+ * and running the same program again in a world of the same size only runs the native code. A program which
+ * would need more than JIT_MAX_CODE bytes of native code is not compiled, nor is any program on a machine other
+ * than x86-64, nor where memory cannot be mapped executable. jit_compile() returns false for them, and the
+ * caller performs them with the interpreter instead.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * 20261017T1100 [JMW] operand counts come from cmd_nargs[] in myrtle.c
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261017T0200 [JMW] Initial revision.
+ **************************************************************************************************************/
+/* mmap() and mprotect() are POSIX, and MAP_ANONYMOUS is BSD, not Standard C, so ask for them before including
+ * anything. */
+#define _DEFAULT_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include "bool.h"
+#include "globals.h"
+#include "jit.h"
+#include "myrtle.h"
+#include "par.h"
+#include "repeat.h"
+
+#if defined(__GNUC__) && defined(__x86_64__) && (defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__))
+#define JIT_X86_64 1
+#include <sys/mman.h>
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+
+/*--------------------------------------------------------------------------------------------------------------
+ * PREPROCESSOR MACRO DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+#define JIT_ENTRY 6  /* The offset of the function in the native code. The code for returning comes before it. */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * The native code, as a function.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef int (*jit_fn_t)(char *cells, void *arg, jit_stop_t stop);
+
+/*--------------------------------------------------------------------------------------------------------------
+ * The state of the compiler as it works through a program.
+ *
+ * jit        -- Where the native code is emitted.
+ * turtle     -- Myrtle's state at the command being compiled.
+ * rows, cols -- The size of the world.
+ * stride     -- The chars from one row of the dense world to the next.
+ * ch         -- The char which rax is filled with, or -1 if rax does not hold one.
+ * failed     -- True once the native code is too big, or its memory cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    jit_t        *jit;
+    par_turtle_t  turtle;
+    coord_t       rows;
+    coord_t       cols;
+    coord_t       stride;
+    int           ch;
+    bool          failed;
+} jit_gen_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+static void    _jit_block(jit_gen_t *g, const int *pc, const int *end);
+static coord_t _jit_clamp(coord_t pos, coord_t size);
+static void    _jit_emit(jit_gen_t *g, const unsigned char *bytes, size_t n);
+static void    _jit_emit_imm(jit_gen_t *g, const unsigned char *bytes, size_t n, long imm, size_t imm_size);
+static void    _jit_fill(jit_gen_t *g, bool vert, coord_t line, coord_t first, coord_t count, char ch);
+static bool    _jit_install(jit_t *jit);
+static void    _jit_move(jit_gen_t *g, int squares);
+static void    _jit_pattern(jit_gen_t *g, char ch);
+static void    _jit_store(jit_gen_t *g, coord_t offset, coord_t count);
+static void    _jit_unmap(jit_t *jit);
+static bool    _jit_words(jit_t *jit, const int *pc, size_t count);
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC GLOBAL CONSTANT DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+static const size_t  JIT_CODE_INIT = 4096;  /* Bytes of native code allocated for at first. Doubles as it fills. */
+static const coord_t JIT_REP_MIN   = 128;   /* A run along a row this long or longer is stored by 'rep stosb'.  */
+static const coord_t JIT_LOOP_MIN  = 8;     /* A run down a col this long or longer is stored by a loop.        */
+
+/*======================================= NONSTATIC FUNCTION DEFINITIONS =====================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: jit_compile()
+ * DESCR:    Compiles the commands from 'pc' to 'end', performed from state *start in a dense 'rows' x 'cols'
+ *           world, to native code in 'jit'. If 'jit' already holds the native code for the same program, world
+ *           and start, it is kept.
+ * RETURNS:  True if 'jit' holds the native code, false if the program is to be interpreted instead.
+ *------------------------------------------------------------------------------------------------------------*/
+bool jit_compile(jit_t *jit, const int *pc, const int *end, const par_turtle_t *start, coord_t rows,
+                 coord_t cols) {
+    static const unsigned char prologue[] = {
+        0x41, 0x5d,            /* pop  r13       -- The code for returning, at offset 0. */
+        0x41, 0x5c,            /* pop  r12                                               */
+        0x5b,                  /* pop  rbx                                               */
+        0xc3,                  /* ret                                                    */
+        0x53,                  /* push rbx       -- The function, at JIT_ENTRY.          */
+        0x41, 0x54,            /* push r12                                               */
+        0x41, 0x55,            /* push r13                                               */
+        0x48, 0x89, 0xfb,      /* mov  rbx, rdi  -- cells                                */
+        0x49, 0x89, 0xf4,      /* mov  r12, rsi  -- arg                                  */
+        0x49, 0x89, 0xd5       /* mov  r13, rdx  -- stop                                 */
+    };
+    static const unsigned char epilogue[] = { 0x31, 0xc0 };  /* xor eax, eax */
+    static const unsigned char jmp[]      = { 0xe9 };        /* jmp rel32    */
+    size_t    count = (size_t)(end - pc);
+    jit_gen_t g;
+
+    if (!jit_supported()) return false;
+    if (jit->exec && jit->count == count && jit->rows == rows && jit->cols == cols &&
+        jit->start.row == start->row && jit->start.col == start->col && jit->start.dir == start->dir &&
+        jit->start.pendown == start->pendown && jit->start.penchar == start->penchar &&
+        !memcmp(jit->words, pc, count * sizeof(int))) {
+        return true;
+    }
+    _jit_unmap(jit);
+    jit->len = 0;
+
+    g.jit    = jit;
+    g.turtle = *start;
+    g.rows   = rows;
+    g.cols   = cols;
+    g.stride = cols + 1;
+    g.ch     = -1;
+    g.failed = false;
+    _jit_emit(&g, prologue, sizeof(prologue));
+    _jit_block(&g, pc, end);
+    _jit_emit(&g, epilogue, sizeof(epilogue));
+    _jit_emit_imm(&g, jmp, sizeof(jmp), -(long)(jit->len + 5), 4);
+    if (g.failed || !_jit_words(jit, pc, count) || !_jit_install(jit)) return false;
+    jit->rows  = rows;
+    jit->cols  = cols;
+    jit->start = *start;
+    jit->end   = g.turtle;
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: jit_free()
+ * DESCR:    Releases the native code in 'jit' and what it was compiled for, and leaves 'jit' empty.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void jit_free(jit_t *jit) {
+    _jit_unmap(jit);
+    free(jit->buf);
+    free(jit->words);
+    jit_init(jit);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: jit_init()
+ * DESCR:    Initializes 'jit' to hold no native code.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void jit_init(jit_t *jit) {
+    memset(jit, 0, sizeof(jit_t));
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: jit_run()
+ * DESCR:    Runs the native code compiled by jit_compile() on the cells of a dense world of the size it was
+ *           compiled for. 'stop' is called with 'arg' for each 'stop'. On success, *turtle is set to the state
+ *           the program leaves Myrtle in.
+ * RETURNS:  TERM_NORM, or the status returned by 'stop' which ended the run.
+ *------------------------------------------------------------------------------------------------------------*/
+int jit_run(jit_t *jit, char *cells, jit_stop_t stop, void *arg, par_turtle_t *turtle) {
+    jit_fn_t fn     = (jit_fn_t)(jit->exec + JIT_ENTRY);
+    int      status = fn(cells, arg, stop);
+    if (status == TERM_NORM) *turtle = jit->end;
+    return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: jit_supported()
+ * DESCR:    Tells whether programs can be compiled to native code on this machine.
+ * RETURNS:  True on x86-64, false elsewhere.
+ *------------------------------------------------------------------------------------------------------------*/
+bool jit_supported() {
+#ifdef JIT_X86_64
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*========================================= STATIC FUNCTION DEFINITIONS ======================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _jit_block()
+ * DESCR:    Compiles the commands from 'pc' to 'end', following Myrtle through them in g->turtle.
+ * RETURNS:  Nothing. g->failed is set if the native code cannot be emitted.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _jit_block(jit_gen_t *g, const int *pc, const int *end) {
+    static const unsigned char stop[] = {
+        0x4c, 0x89, 0xe7,      /* mov  rdi, r12 */
+        0x41, 0xff, 0xd5,      /* call r13      */
+        0x85, 0xc0,            /* test eax, eax */
+        0x0f, 0x85             /* jnz  rel32    */
+    };
+    const int    *next;
+    repeat_plan_t plan;
+    long          i;
+
+    for (; pc < end && !g->failed; pc = next) {
+        next = pc + 1 + cmd_nargs[*pc];
+        switch (*pc) {
+        case CMD_BACKWARD: if (pc[1] > 0) _jit_move(g, -pc[1]);                   break;
+        case CMD_FORWARD:  if (pc[1] > 0) _jit_move(g, pc[1]);                    break;
+        case CMD_LEFT:     g->turtle.dir     = (g->turtle.dir + 3) & 3;           break;
+        case CMD_RIGHT:    g->turtle.dir     = (g->turtle.dir + 1) & 3;           break;
+        case CMD_PENCHAR:  g->turtle.penchar = (char)pc[1];                       break;
+        case CMD_PENDOWN:  g->turtle.pendown = true;                              break;
+        case CMD_PENUP:    g->turtle.pendown = false;                             break;
+        case CMD_HYPER:
+            g->turtle.row = _jit_clamp(pc[1], g->rows);
+            g->turtle.col = _jit_clamp(pc[2], g->cols);
+            if (g->turtle.pendown) _jit_fill(g, false, g->turtle.row, g->turtle.col, 1, g->turtle.penchar);
+            break;
+        case CMD_STOP:
+            _jit_emit_imm(g, stop, sizeof(stop), -(long)(g->jit->len + sizeof(stop) + 4), 4);
+            g->ch = -1;   /* The stop function does not preserve rax. */
+            break;
+        case CMD_REPEAT:
+            repeat_plan(&plan, pc[1], pc + 3, pc + 3 + pc[2], &g->turtle, g->rows, g->cols);
+            for (i = 0; i < plan.first && !g->failed; i++) _jit_block(g, pc + 3, pc + 3 + pc[2]);
+            if (plan.skipped > 0) {
+                g->turtle = plan.resume;
+                for (i = 0; i < plan.last && !g->failed; i++) _jit_block(g, pc + 3, pc + 3 + pc[2]);
+            }
+            next += pc[2];
+            break;
+        case CMD_CALL: {
+            const int *to = pc + pc[1];   /* The CMD_TO of the procedure; its body follows its length. */
+            _jit_block(g, to + 2, to + 2 + to[1]);
+            break;
+        }
+        case CMD_TO:
+            next += pc[1];
+            break;
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _jit_clamp()
+ * DESCR:    Clamps a position to 0 .. size - 1, as _myrtle_row_set() and _myrtle_col_set() do.
+ * RETURNS:  The clamped position.
+ *------------------------------------------------------------------------------------------------------------*/
+static coord_t _jit_clamp(coord_t pos, coord_t size) {
+    if (pos < 0) return 0;
+    if (pos >= size) return size - 1;
+    return pos;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _jit_emit()
+ * DESCR:    Appends the 'n' bytes at 'bytes' to the native code, growing it as needed, up to JIT_MAX_CODE.
+ * RETURNS:  Nothing. g->failed is set if the native code would be too big or cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _jit_emit(jit_gen_t *g, const unsigned char *bytes, size_t n) {
+    jit_t *jit = g->jit;
+
+    if (g->failed) return;
+    if (jit->len + n > jit->cap) {
+        size_t         cap = jit->cap ? jit->cap * 2 : JIT_CODE_INIT;
+        unsigned char *buf;
+        while (cap < jit->len + n) cap *= 2;
+        buf = (cap <= JIT_MAX_CODE) ? (unsigned char *)realloc(jit->buf, cap) : NULL;
+        if (!buf) {
+            g->failed = true;
+            return;
+        }
+        jit->buf = buf;
+        jit->cap = cap;
+    }
+    memcpy(jit->buf + jit->len, bytes, n);
+    jit->len += n;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _jit_emit_imm()
+ * DESCR:    Appends an instruction: the 'n' bytes at 'bytes', then 'imm' as an 'imm_size'-byte little-endian
+ *           immediate or displacement.
+ * RETURNS:  Nothing. See _jit_emit().
+ *------------------------------------------------------------------------------------------------------------*/
+static void _jit_emit_imm(jit_gen_t *g, const unsigned char *bytes, size_t n, long imm, size_t imm_size) {
+    unsigned char le[8];
+    size_t        i;
+    for (i = 0; i < imm_size; i++) le[i] = (unsigned char)((unsigned long)imm >> (8 * i));
+    _jit_emit(g, bytes, n);
+    _jit_emit(g, le, imm_size);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _jit_fill()
+ * DESCR:    Compiles the drawing of 'count' squares of 'ch' in col (or row) 'line' from row (or col) 'first',
+ *           going down the col if 'vert' is true, as world_fill_col() and world_fill_row() do on a dense world.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _jit_fill(jit_gen_t *g, bool vert, coord_t line, coord_t first, coord_t count, char ch) {
+    static const unsigned char lea[]   = { 0x48, 0x8d, 0xbb };   /* lea rdi, [rbx + disp32] */
+    static const unsigned char ecx[]   = { 0xb9 };               /* mov ecx, imm32          */
+    static const unsigned char store[] = { 0x88, 0x83 };         /* mov [rbx + disp32], al  */
+    static const unsigned char loop[]  = {
+        0x88, 0x07,                                  /* L: mov [rdi], al       */
+        0x48, 0x81, 0xc7                             /*    add rdi, imm32 ...  */
+    };
+    static const unsigned char next[]  = {
+        0xff, 0xc9,                                  /*    dec ecx             */
+        0x75, 0xf3                                   /*    jnz L               */
+    };
+    coord_t i;
+
+    if (count <= 0) return;
+    _jit_pattern(g, ch);
+    if (!vert) {
+        _jit_store(g, line * g->stride + first, count);
+    } else if (count < JIT_LOOP_MIN) {
+        for (i = 0; i < count; i++) {
+            _jit_emit_imm(g, store, sizeof(store), (long)((first + i) * g->stride + line), 4);
+        }
+    } else {
+        _jit_emit_imm(g, lea, sizeof(lea), (long)(first * g->stride + line), 4);
+        _jit_emit_imm(g, ecx, sizeof(ecx), (long)count, 4);
+        _jit_emit_imm(g, loop, sizeof(loop), (long)g->stride, 4);
+        _jit_emit(g, next, sizeof(next));
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _jit_install()
+ * DESCR:    Copies the native code in jit->buf into memory mapped for it, and makes that memory executable and no
+ *           longer writable.
+ * RETURNS:  True on success, false if the memory cannot be mapped or made executable.
+ *------------------------------------------------------------------------------------------------------------*/
+static bool _jit_install(jit_t *jit) {
+#ifdef JIT_X86_64
+    void *mem = mmap(NULL, jit->len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return false;
+    memcpy(mem, jit->buf, jit->len);
+    if (mprotect(mem, jit->len, PROT_READ | PROT_EXEC) != 0) {
+        munmap(mem, jit->len);
+        return false;
+    }
+    jit->exec      = (unsigned char *)mem;
+    jit->exec_size = jit->len;
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _jit_move()
+ * DESCR:    Compiles a move of 'squares' squares in the direction Myrtle is facing, or backward if 'squares' is
+ *           negative, wrapping around the edges of the world. The squares entered with the pen down are worked
+ *           out exactly as _myrtle_move() does, as at most two runs.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _jit_move(jit_gen_t *g, int squares) {
+    par_turtle_t *t     = &g->turtle;
+    bool          vert  = (t->dir == DIR_NORTH || t->dir == DIR_SOUTH);
+    coord_t       size  = vert ? g->rows : g->cols;
+    coord_t       pos   = vert ? t->row : t->col;
+    coord_t       step  = (t->dir == DIR_NORTH || t->dir == DIR_WEST) ? -(coord_t)squares : (coord_t)squares;
+    coord_t       count = step < 0 ? -step : step;
+    coord_t       end   = ((pos + step % size) % size + size) % size;
+
+    if (t->pendown) {
+        coord_t first = (count >= size) ? 0 : (step > 0) ? (pos + 1) % size : end;
+        coord_t run   = (count >= size) ? size : count;
+        coord_t tail  = first + run - size;   /* Squares that wrapped around to the start of the line. */
+        coord_t line  = vert ? t->col : t->row;
+        if (tail > 0) run -= tail;
+        _jit_fill(g, vert, line, first, run, t->penchar);
+        if (tail > 0) _jit_fill(g, vert, line, 0, tail, t->penchar);
+    }
+    if (vert) t->row = end;
+    else t->col = end;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _jit_pattern()
+ * DESCR:    Compiles filling rax with 'ch' in every byte, unless it already is.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _jit_pattern(jit_gen_t *g, char ch) {
+    static const unsigned char mov[] = { 0x48, 0xb8 };   /* mov rax, imm64 */
+    if (g->ch == (unsigned char)ch) return;
+    _jit_emit_imm(g, mov, sizeof(mov), (long)(0x0101010101010101UL * (unsigned char)ch), 8);
+    g->ch = (unsigned char)ch;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _jit_store()
+ * DESCR:    Compiles storing the char in rax into the 'count' cells from 'offset', along a row.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _jit_store(jit_gen_t *g, coord_t offset, coord_t count) {
+    static const unsigned char lea[]  = { 0x48, 0x8d, 0xbb };   /* lea rdi, [rbx + disp32] */
+    static const unsigned char ecx[]  = { 0xb9 };               /* mov ecx, imm32          */
+    static const unsigned char rep[]  = { 0xf3, 0xaa };         /* rep stosb               */
+    static const unsigned char st8[]  = { 0x48, 0x89, 0x83 };   /* mov [rbx + disp32], rax */
+    static const unsigned char st4[]  = { 0x89, 0x83 };         /* mov [rbx + disp32], eax */
+    static const unsigned char st2[]  = { 0x66, 0x89, 0x83 };   /* mov [rbx + disp32], ax  */
+    static const unsigned char st1[]  = { 0x88, 0x83 };         /* mov [rbx + disp32], al  */
+
+    if (count >= JIT_REP_MIN) {
+        _jit_emit_imm(g, lea, sizeof(lea), (long)offset, 4);
+        _jit_emit_imm(g, ecx, sizeof(ecx), (long)count, 4);
+        _jit_emit(g, rep, sizeof(rep));
+        return;
+    }
+    for (; count >= 8; offset += 8, count -= 8) _jit_emit_imm(g, st8, sizeof(st8), (long)offset, 4);
+    if (count >= 4) {
+        _jit_emit_imm(g, st4, sizeof(st4), (long)offset, 4);
+        offset += 4;
+        count  -= 4;
+    }
+    if (count >= 2) {
+        _jit_emit_imm(g, st2, sizeof(st2), (long)offset, 4);
+        offset += 2;
+        count  -= 2;
+    }
+    if (count >= 1) _jit_emit_imm(g, st1, sizeof(st1), (long)offset, 4);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _jit_unmap()
+ * DESCR:    Releases the executable copy of the native code in 'jit', if there is one.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _jit_unmap(jit_t *jit) {
+#ifdef JIT_X86_64
+    if (jit->exec) munmap(jit->exec, jit->exec_size);
+#endif
+    jit->exec      = NULL;
+    jit->exec_size = 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _jit_words()
+ * DESCR:    Keeps a copy of the 'count' words of the program at 'pc' in 'jit', so that the next jit_compile() can
+ *           tell whether it is given the same program.
+ * RETURNS:  True on success, false if the copy cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+static bool _jit_words(jit_t *jit, const int *pc, size_t count) {
+    if (count > jit->words_cap) {
+        int *words = (int *)realloc(jit->words, count * sizeof(int));
+        if (!words) return false;
+        jit->words     = words;
+        jit->words_cap = count;
+    }
+    memcpy(jit->words, pc, count * sizeof(int));
+    jit->count = count;
+    return true;
+}
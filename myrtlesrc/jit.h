@@ -0,0 +1,74 @@
+/***************************************************************************************************************
+ * FILE: jit.h
+ *
+ * DESCRIPTION:
+ * Declarations for compiling a Myrtle program to native code. See comments in jit.c.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261017T0200 [JMW] Initial revision.
+ **************************************************************************************************************/
+#ifndef __JIT_H__
+#define __JIT_H__
+
+#include <stddef.h>   /* For size_t.       */
+#include "bool.h"     /* For bool.         */
+#include "globals.h"  /* For coord_t.      */
+#include "par.h"      /* For par_turtle_t. */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * PREPROCESSOR MACRO DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+#define JIT_MAX_CODE (64L << 20)  /* Most bytes of native code for one program. A larger one is interpreted. */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * Called by the native code for each 'stop', with the 'arg' given to jit_run(). Returns TERM_NORM, or the status
+ * which ends the run.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef int (*jit_stop_t)(void *arg);
+
+/*--------------------------------------------------------------------------------------------------------------
+ * A program compiled to native code. The compiled program is kept, with the program and world it was compiled
+ * for, so that running the same program again in a world of the same size does not compile it again.
+ *
+ * buf        -- Where the native code is emitted. Its memory is reused by the next compile.
+ * len, cap   -- The bytes of native code in buf, and the bytes allocated.
+ * exec       -- The executable copy of the native code, or NULL if there is none.
+ * exec_size  -- The bytes mapped at exec.
+ * words      -- The compiled program the native code is for.
+ * count      -- The number of words in it.
+ * words_cap  -- The number of words allocated.
+ * rows, cols -- The size of the world the native code is for.
+ * start      -- The state Myrtle starts in.
+ * end        -- The state the program leaves her in.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    unsigned char *buf;
+    size_t         len;
+    size_t         cap;
+    unsigned char *exec;
+    size_t         exec_size;
+    int           *words;
+    size_t         count;
+    size_t         words_cap;
+    coord_t        rows;
+    coord_t        cols;
+    par_turtle_t   start;
+    par_turtle_t   end;
+} jit_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * NONSTATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+extern bool jit_compile(jit_t *jit, const int *pc, const int *end, const par_turtle_t *start, coord_t rows,
+                        coord_t cols);
+extern void jit_free(jit_t *jit);
+extern void jit_init(jit_t *jit);
+extern int  jit_run(jit_t *jit, char *cells, jit_stop_t stop, void *arg, par_turtle_t *turtle);
+extern bool jit_supported();
+
+#endif
@@ -0,0 +1,222 @@
+/***************************************************************************************************************
+ * FILE: jitbench.c
+ *
+ * DESCRIPTION:
+ * Benchmark for running a script as native code (jit.c). Generates a long drawing script in memory, a body of
+ * mostly short moves and turns repeated many times, and runs it with the interpreter and as native code, all on
+ * one thread. Checks that every run as native code writes exactly the output of the interpreter, and reports for
+ * each:
+ *
+ *     - a single run in a context of its own, which for native code includes compiling the script. This is what
+ *       a run of myrtle would take.
+ *     - the runs per second of 'runs' runs in one context, where the native code compiled by the first run is
+ *       reused by the rest. The time of the first run, compiling included, is counted.
+ *
+ * With -c, runs each script given instead, once with the interpreter and once as native code, each in a context
+ * of its own, and checks that both write exactly the same bytes. "make check" does this for its scripts (see
+ * check.sh).
+ *
+ * Usage: jitbench [commands [runs [repeats]]]     (default 2000 50 100)
+ *        jitbench -c script...
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * 20261017T1400 [JMW] the native numbers include compiling; a single run is reported; added -c
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261017T0200 [JMW] Initial revision.
+ **************************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bool.h"
+#include "globals.h"
+#include "jit.h"
+#include "myrtle.h"
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+static int            _bench_check(int count, char **fnames);
+static char          *_bench_generate(unsigned long seed, int cmds, int repeats, size_t *len);
+static char          *_bench_read(const char *fname, size_t *len);
+static double         _bench_runs(myrtle_ctx_t *ctx, const char *src, size_t len, int runs, unsigned long *sum);
+static unsigned long  _bench_sum(myrtle_ctx_t *ctx);
+
+/*======================================= NONSTATIC FUNCTION DEFINITIONS =====================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: main()
+ * DESCR:    Generates the script, runs it with the interpreter to get the expected output, then checks and times
+ *           the runs as native code. With -c, checks the scripts given instead (see _bench_check()).
+ * RETURNS:  Zero if every run as native code matched, TERM_ERR_OUTPUT otherwise, or TERM_ERR_MEMORY.
+ *------------------------------------------------------------------------------------------------------------*/
+int main(int argc, char *argv[]) {
+    int            cmds, runs, repeats;
+    size_t         len;
+    char          *src;
+    myrtle_ctx_t  *interp_ctx, *native_ctx;
+    unsigned long  expect, sum;
+    double         interp_one, interp, native_one, native;
+    int            status  = TERM_NORM;
+
+    if (argc > 1 && streq(argv[1], "-c")) return _bench_check(argc - 2, argv + 2);
+
+    cmds       = argc > 1 ? atoi(argv[1]) : 2000;
+    runs       = argc > 2 ? atoi(argv[2]) : 50;
+    repeats    = argc > 3 ? atoi(argv[3]) : 100;
+    src        = _bench_generate(12345, cmds, repeats, &len);
+    interp_ctx = myrtle_ctx_create();
+    native_ctx = myrtle_ctx_create();
+    if (!src || !interp_ctx || !native_ctx) return TERM_ERR_MEMORY;
+    if (runs < 1) runs = 1;
+    printf("jitbench: %d commands repeated %d times, %d runs\n", cmds, repeats, runs);
+    if (!jit_supported()) printf("native code is not supported on this machine; both runs are interpreted\n");
+
+    interp_one = _bench_runs(interp_ctx, src, len, 1, &expect);
+    interp     = interp_one + (runs > 1 ? _bench_runs(interp_ctx, src, len, runs - 1, &expect) : 0);
+    printf("%-12s %9.3f ms single run %10.1f runs/sec\n", "interpreter", interp_one * 1000, runs / interp);
+
+    myrtle_ctx_jit_set(native_ctx, true);
+    native_one = _bench_runs(native_ctx, src, len, 1, &sum);
+    if (sum == expect) native = native_one + (runs > 1 ? _bench_runs(native_ctx, src, len, runs - 1, &sum) : 0);
+    if (sum != expect) {
+        printf("%-12s MISMATCH with interpreter\n", "native");
+        status = TERM_ERR_OUTPUT;
+    } else {
+        printf("%-12s %9.3f ms single run %10.1f runs/sec   %.2fx single, %.2fx runs (compiling included)\n",
+               "native", native_one * 1000, runs / native, interp_one / native_one, interp / native);
+    }
+
+    myrtle_ctx_destroy(interp_ctx);
+    myrtle_ctx_destroy(native_ctx);
+    free(src);
+    return status;
+}
+
+/*========================================= STATIC FUNCTION DEFINITIONS ======================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _bench_check()
+ * DESCR:    Runs each of the 'count' scripts in 'fnames' once with the interpreter and once as native code, each
+ *           in a context of its own, and compares the status and output bytes of the two runs. Writes a line for
+ *           each script saying whether they matched.
+ * RETURNS:  Zero if every script matched, TERM_ERR_OUTPUT if one did not, or TERM_ERR_INPUT if one could not be
+ *           read.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _bench_check(int count, char **fnames) {
+    int i, status = TERM_NORM;
+
+    for (i = 0; i < count; i++) {
+        myrtle_ctx_t *interp_ctx = myrtle_ctx_create(), *native_ctx = myrtle_ctx_create();
+        size_t        len, interp_len, native_len;
+        char         *src = _bench_read(fnames[i], &len), *interp_out, *native_out;
+        int           interp_status, native_status;
+
+        if (!interp_ctx || !native_ctx) return TERM_ERR_MEMORY;
+        if (!src) {
+            printf("%s: cannot be read\n", fnames[i]);
+            if (status == TERM_NORM) status = TERM_ERR_INPUT;
+        } else {
+            myrtle_ctx_jit_set(native_ctx, true);
+            interp_status = myrtle_ctx_run(interp_ctx, src, len);
+            native_status = myrtle_ctx_run(native_ctx, src, len);
+            interp_out    = myrtle_ctx_output(interp_ctx, &interp_len);
+            native_out    = myrtle_ctx_output(native_ctx, &native_len);
+            if (interp_status == native_status && interp_len == native_len &&
+                    memcmp(interp_out, native_out, interp_len) == 0) {
+                printf("%s: same\n", fnames[i]);
+            } else {
+                printf("%s: MISMATCH with interpreter\n", fnames[i]);
+                if (status == TERM_NORM) status = TERM_ERR_OUTPUT;
+            }
+        }
+        free(src);
+        myrtle_ctx_destroy(interp_ctx);
+        myrtle_ctx_destroy(native_ctx);
+    }
+    return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _bench_generate()
+ * DESCR:    Generates a deterministic script: 'repeats' times a body of 'cmds' commands, mostly short moves and
+ *           turns with the pen down, the way a drawing script is written, with the odd 'penchar' and 'penup', and
+ *           a 'stop' at the end. The body wanders off by a different amount each time, so no repetition of it is
+ *           skipped (see repeat.c) unless the world is small.
+ * RETURNS:  The script, allocated with malloc(), and its length in *len.
+ *------------------------------------------------------------------------------------------------------------*/
+static char *_bench_generate(unsigned long seed, int cmds, int repeats, size_t *len) {
+    char *buf = (char *)malloc(cmds * 32 + 64), *p = buf;
+    int   i;
+
+    if (!buf) return NULL;
+    p += sprintf(p, "pendown\nrepeat %d [\n", repeats);
+    for (i = 0; i < cmds; i++) {
+        int c;
+        seed = seed * 1103515245 + 12345;
+        c = (int)((seed >> 16) % 32);
+        if (c < 14) p += sprintf(p, "forward %lu\n", (seed >> 8) % 16);
+        else if (c < 18) p += sprintf(p, "backward %lu\n", (seed >> 8) % 8);
+        else if (c < 24) p += sprintf(p, "right\n");
+        else if (c < 29) p += sprintf(p, "left\n");
+        else if (c < 31) p += sprintf(p, "penchar %c\n", "#*@xo+"[(seed >> 20) % 6]);
+        else p += sprintf(p, "penup\nforward 3\npendown\n");
+    }
+    p += sprintf(p, "right\nforward 1\n]\nstop\n");
+    *len = (size_t)(p - buf);
+    return buf;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _bench_read()
+ * DESCR:    Reads the whole of the file 'fname'.
+ * RETURNS:  The contents, allocated with malloc(), and their length in *len, or NULL if the file cannot be read.
+ *------------------------------------------------------------------------------------------------------------*/
+static char *_bench_read(const char *fname, size_t *len) {
+    FILE *file = fopen(fname, "rb");
+    char *buf  = NULL;
+    long  size;
+
+    if (!file) return NULL;
+    if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+        buf = (char *)malloc((size_t)size + 1);
+        if (buf && fread(buf, 1, (size_t)size, file) != (size_t)size) {
+            free(buf);
+            buf = NULL;
+        }
+        *len = (size_t)size;
+    }
+    fclose(file);
+    return buf;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _bench_runs()
+ * DESCR:    Runs the script 'runs' times in 'ctx', and checksums the output of the last run in *sum.
+ * RETURNS:  The time taken in seconds.
+ *------------------------------------------------------------------------------------------------------------*/
+static double _bench_runs(myrtle_ctx_t *ctx, const char *src, size_t len, int runs, unsigned long *sum) {
+    clock_t start = clock();
+    double  secs;
+    int     i;
+
+    for (i = 0; i < runs; i++) myrtle_ctx_run(ctx, src, len);
+    secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+    *sum = _bench_sum(ctx);
+    return secs > 0 ? secs : 1e-9;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _bench_sum()
+ * DESCR:    Checksums the output of the last run in 'ctx'.
+ * RETURNS:  The checksum.
+ *------------------------------------------------------------------------------------------------------------*/
+static unsigned long _bench_sum(myrtle_ctx_t *ctx) {
+    unsigned long sum = 0;
+    size_t        len, i;
+    char         *out = myrtle_ctx_output(ctx, &len);
+    for (i = 0; i < len; i++) sum = sum * 31 + (unsigned char)out[i];
+    return sum + len;
+}
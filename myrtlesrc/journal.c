@@ -0,0 +1,778 @@
+/***************************************************************************************************************
+ * FILE: journal.c
+ *
+ * DESCRIPTION:
+ * The trace of a run written by --record, and its replay by --replay. A trace holds what every command performed
+ * did, in the order it was performed: how Myrtle moved, turned or changed her pen, and the runs of squares she
+ * painted. From it, --replay rebuilds the world as it was after any number of commands without the script, so a
+ * rendering difference seen in production can be narrowed down to the command which made it.
+ *
+ * A trace starts with a header: JOURNAL_MAGIC, JOURNAL_VERSION, the number of commands in cmds.def, the size of
+ * the world and Myrtle's state when the run started. Then there is one record for each command performed:
+ *
+ *     tag              -- The opcode of the command in the low 5 bits, and JOURNAL_MOVED, JOURNAL_TURNED and
+ *                         JOURNAL_FILLS for the parts which follow.
+ *     row, col         -- JOURNAL_MOVED: how far Myrtle's row and col changed.
+ *     dir, pen         -- JOURNAL_TURNED: one byte of her direction, JOURNAL_PEN if the pen is down, and
+ *                         JOURNAL_PENCHAR if the pen char changed, in which case the char follows.
+ *     fills            -- JOURNAL_FILLS: the number of runs painted, then each run: a byte of JOURNAL_VERT and
+ *                         JOURNAL_CH, the row (or col) of the run and its first square, both relative to where
+ *                         Myrtle was when the command started, the number of squares and, with JOURNAL_CH, the
+ *                         char if it was not the pen char.
+ *
+ * Every number is a varint, 7 bits to a byte, lowest first, and signed ones are zigzag encoded, so a typical
+ * 'forward' or 'right' takes three bytes or fewer. A record says what happened from the start of its command to
+ * the start of the next, which is where -V would print the next "Performing command" line; the body of a 'repeat'
+ * or a 'call' is recorded as the commands in it, after the 'repeat' or 'call' itself. Repetitions which repeat.c
+ * skips are not performed and so not recorded; Myrtle's jump past them is in the record of the command before.
+ *
+ * Every so often there is a keyframe: JOURNAL_KEY, the number of commands before it, Myrtle's state and every
+ * square of the world as runs of the same char. A keyframe is taken when the records and squares painted since
+ * the last one add up to as many as there are squares in the world, so taking keyframes never costs more than
+ * painting did, and the trace is never more than a small multiple of the records in it. The trace ends with
+ * JOURNAL_END, the number of commands, the index of the keyframes, and the offset of the JOURNAL_END and
+ * JOURNAL_MAGIC again, so that a replay can find the index from the end of the file. To rebuild the world after
+ * n commands, a replay starts from the last keyframe at or before n and applies the records after it.
+ *
+ * A trace which was cut short, e.g. by a crash, has no index, and is replayed from the start up to where it was
+ * cut. Keyframes are only taken between commands, and only by the interpreter, so with --record the
+ * program is not stamped (see stamp.c), not run as native code or on threads, and programs with turtle blocks
+ * cannot be recorded.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261017T0700 [JMW] Initial revision.
+ **************************************************************************************************************/
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bool.h"
+#include "globals.h"
+#include "journal.h"
+#include "myrtle.h"
+#include "par.h"
+#include "world.h"
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * A trace being replayed: the trace file, the bytes of it read into buf, from offset 'offset' of the file, and
+ * how many of them have been used. 'eof' is true once the end of the file has been reached.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    FILE          *in;
+    unsigned char  buf[JOURNAL_BUF_SIZE];
+    size_t         pos;
+    size_t         len;
+    long           offset;
+    bool           eof;
+} journal_in_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC GLOBAL CONSTANT DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+static const char          JOURNAL_MAGIC[8] = "MYRTLEJ";  /* The first and last 8 bytes of a trace.        */
+static const unsigned long JOURNAL_VERSION  = 1;          /* Bump whenever the layout of a trace changes. */
+
+static const int JOURNAL_OP      = 0x1f;  /* The bits of a tag which hold the opcode.                           */
+static const int JOURNAL_END     = 0x1e;  /* The tag which ends the records. No opcode is this large.           */
+static const int JOURNAL_KEY     = 0x1f;  /* The tag of a keyframe.                                             */
+static const int JOURNAL_MOVED   = 0x20;  /* Tag bit: Myrtle's row or col changed.                              */
+static const int JOURNAL_TURNED  = 0x40;  /* Tag bit: her direction, her pen or her pen char changed.           */
+static const int JOURNAL_FILLS   = 0x80;  /* Tag bit: the command painted squares.                              */
+static const int JOURNAL_PEN     = 0x04;  /* State byte bit: the pen is down. The low 2 bits are the direction. */
+static const int JOURNAL_PENCHAR = 0x08;  /* State byte bit: the pen char follows.                              */
+static const int JOURNAL_VERT    = 0x01;  /* Run byte bit: the run goes down a col.                             */
+static const int JOURNAL_CH      = 0x02;  /* Run byte bit: the char of the run follows.                         */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+static void   _journal_bytes(journal_t *journal, const unsigned char *bytes, size_t len);
+static void   _journal_end(journal_t *journal, const par_turtle_t *turtle);
+static int    _journal_error(char *err, int status, const char *msg, const char *fname);
+static void   _journal_flush(journal_t *journal);
+static int    _journal_get(journal_in_t *in);
+static bool   _journal_index(journal_in_t *in, long at, long *total, journal_key_t *key);
+static void   _journal_key(journal_t *journal, const par_turtle_t *turtle);
+static int    _journal_key_read(journal_in_t *in, world_t *world, bool apply, par_turtle_t *turtle, long *index);
+static size_t _journal_put_int(unsigned char *p, coord_t value);
+static size_t _journal_put_state(unsigned char *p, const par_turtle_t *turtle);
+static size_t _journal_put_uint(unsigned char *p, unsigned long long value);
+static bool   _journal_read_int(journal_in_t *in, coord_t *value);
+static bool   _journal_read_state(journal_in_t *in, par_turtle_t *turtle, const world_t *world);
+static bool   _journal_read_uint(journal_in_t *in, unsigned long long *value);
+static int    _journal_record_read(journal_in_t *in, int tag, world_t *world, par_turtle_t *turtle);
+static int    _journal_replay(journal_in_t *in, long at, world_t *world, int layout, journal_pos_t *pos,
+                              const char *fname, char *err);
+static void   _journal_reserve(journal_t *journal, size_t len);
+static void   _journal_run(journal_t *journal, coord_t run, char ch);
+static bool   _journal_seek(journal_in_t *in, long offset);
+
+/*======================================= NONSTATIC FUNCTION DEFINITIONS =====================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: journal_close()
+ * DESCR:    Writes what is left of the trace, closes the trace file and frees what 'journal' allocated.
+ * RETURNS:  True if the whole trace was written.
+ *------------------------------------------------------------------------------------------------------------*/
+bool journal_close(journal_t *journal) {
+    if (journal->out) {
+        _journal_flush(journal);
+        if (fclose(journal->out) != 0) journal->ok = false;
+    }
+    free(journal->fills);
+    free(journal->keys);
+    journal->out   = NULL;
+    journal->fills = NULL;
+    journal->keys  = NULL;
+    return journal->ok;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: journal_command()
+ * DESCR:    Called by the interpreter before it performs the command 'op', with Myrtle's state in *turtle. Writes
+ *           the record of the command before, which ends here, and takes a keyframe if one is due.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void journal_command(journal_t *journal, int op, const par_turtle_t *turtle) {
+    if (journal->op >= 0) {
+        _journal_end(journal, turtle);
+        if (journal->work >= journal->key_work) _journal_key(journal, turtle);
+    }
+    journal->op = op;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: journal_fill()
+ * DESCR:    Called by the interpreter when the command being performed fills 'count' squares of col (or row)
+ *           'line' with 'ch' from row (or col) 'first', going down the col if 'vert' is true. The run is added to
+ *           the record of the command.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void journal_fill(journal_t *journal, bool vert, coord_t line, coord_t first, coord_t count, char ch) {
+    const par_turtle_t *state = &journal->state;
+    unsigned char      *p;
+
+    if (journal->op < 0) return;
+    if (journal->fill_len + 40 > journal->fill_cap) {
+        size_t         cap   = journal->fill_cap ? journal->fill_cap * 2 : 256;
+        unsigned char *fills = (unsigned char *)realloc(journal->fills, cap);
+        if (!fills) {
+            journal->ok = false;
+            return;
+        }
+        journal->fills    = fills;
+        journal->fill_cap = cap;
+    }
+    p = journal->fills + journal->fill_len;
+    *p++ = (unsigned char)((vert ? JOURNAL_VERT : 0) | (ch != state->penchar ? JOURNAL_CH : 0));
+    p += _journal_put_int(p, line - (vert ? state->col : state->row));
+    p += _journal_put_int(p, first - (vert ? state->row : state->col));
+    p += _journal_put_uint(p, (unsigned long long)count);
+    if (ch != state->penchar) *p++ = (unsigned char)ch;
+    journal->fill_len = (size_t)(p - journal->fills);
+    journal->fill_count++;
+    journal->work += count;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: journal_open()
+ * DESCR:    Initializes 'journal' to record a run into the file 'fname', which is created or truncated. Nothing is
+ *           written to it until the run starts (see journal_start()).
+ * RETURNS:  True, or false if the file cannot be opened.
+ *------------------------------------------------------------------------------------------------------------*/
+bool journal_open(journal_t *journal, const char *fname) {
+    journal->out        = fopen(fname, "wb");
+    journal->len        = 0;
+    journal->offset     = 0;
+    journal->world      = NULL;
+    journal->started    = false;
+    journal->op         = -1;
+    journal->index      = 0;
+    journal->fills      = NULL;
+    journal->fill_len   = 0;
+    journal->fill_cap   = 0;
+    journal->fill_count = 0;
+    journal->work       = 0;
+    journal->key_work   = 0;
+    journal->keys       = NULL;
+    journal->key_count  = 0;
+    journal->key_cap    = 0;
+    journal->ok         = journal->out != NULL;
+    return journal->ok;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: journal_replay()
+ * DESCR:    Rebuilds in 'world' the world recorded in the trace file 'fname' as it was after the first 'at'
+ *           commands, or at the end of the trace if it has fewer. The world is reset to the size in the trace and
+ *           the WORLD_* 'layout' first. *pos says where the replay stopped and what state Myrtle was in.
+ * RETURNS:  TERM_NORM, TERM_ERR_INPUT if the trace cannot be read, is not a trace or is corrupt, or
+ *           TERM_ERR_MEMORY if the world cannot be allocated. On an error, 'err', which must hold 160 chars,
+ *           says what went wrong.
+ *------------------------------------------------------------------------------------------------------------*/
+int journal_replay(const char *fname, long at, world_t *world, int layout, journal_pos_t *pos, char *err) {
+    journal_in_t *in = (journal_in_t *)malloc(sizeof(journal_in_t));
+    int           status;
+
+    if (!in) return _journal_error(err, TERM_ERR_MEMORY, "Out of memory replaying '%.100s'", fname);
+    in->in     = fopen(fname, "rb");
+    in->pos    = in->len = 0;
+    in->offset = 0;
+    in->eof    = false;
+    if (!in->in) status = _journal_error(err, TERM_ERR_INPUT, "Cannot open trace file '%.100s'", fname);
+    else status = _journal_replay(in, at, world, layout, pos, fname, err);
+    if (in->in) fclose(in->in);
+    free(in);
+    return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: journal_start()
+ * DESCR:    Called by the interpreter when it starts performing the program, with Myrtle's state in *turtle and
+ *           her world in 'world'. Writes the header of the trace. A journal records only the first run it is
+ *           started for.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void journal_start(journal_t *journal, world_t *world, const par_turtle_t *turtle) {
+    coord_t        most = (coord_t)1 << 62;
+    unsigned char *p    = journal->buf;
+
+    if (journal->started) return;
+    journal->started  = true;
+    journal->world    = world;
+    journal->state    = *turtle;
+    journal->key_work = world->rows > most / world->cols ? most : world->rows * world->cols;
+    if (journal->key_work < JOURNAL_KEY_MIN) journal->key_work = JOURNAL_KEY_MIN;
+
+    memcpy(p, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    p += sizeof(JOURNAL_MAGIC);
+    p += _journal_put_uint(p, JOURNAL_VERSION);
+    p += _journal_put_uint(p, CMD_COUNT);
+    p += _journal_put_uint(p, (unsigned long long)world->rows);
+    p += _journal_put_uint(p, (unsigned long long)world->cols);
+    p += _journal_put_state(p, turtle);
+    journal->len = (size_t)(p - journal->buf);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: journal_stop()
+ * DESCR:    Called by the interpreter when the run ends, however it ended, with Myrtle's state in *turtle. Writes
+ *           the record of the last command, JOURNAL_END and the index of the keyframes.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void journal_stop(journal_t *journal, const par_turtle_t *turtle) {
+    long           end, index = 0, offset = 0;
+    size_t         i;
+    int            b;
+    unsigned char *p;
+
+    if (!journal->world) return;
+    if (journal->op >= 0) _journal_end(journal, turtle);
+    journal->world = NULL;
+
+    end = journal->offset + (long)journal->len;
+    _journal_reserve(journal, 21);
+    p = journal->buf + journal->len;
+    *p++ = (unsigned char)JOURNAL_END;
+    p += _journal_put_uint(p, (unsigned long long)journal->index);
+    p += _journal_put_uint(p, (unsigned long long)journal->key_count);
+    journal->len = (size_t)(p - journal->buf);
+    for (i = 0; i < journal->key_count; i++) {
+        _journal_reserve(journal, 20);
+        p = journal->buf + journal->len;
+        p += _journal_put_uint(p, (unsigned long long)(journal->keys[i].index - index));
+        p += _journal_put_uint(p, (unsigned long long)(journal->keys[i].offset - offset));
+        journal->len = (size_t)(p - journal->buf);
+        index  = journal->keys[i].index;
+        offset = journal->keys[i].offset;
+    }
+    _journal_reserve(journal, 16);
+    p = journal->buf + journal->len;
+    for (b = 0; b < 8; b++) *p++ = (unsigned char)((unsigned long long)end >> (8 * b));
+    memcpy(p, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    journal->len += 16;
+    _journal_flush(journal);
+}
+
+/*========================================= STATIC FUNCTION DEFINITIONS ======================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _journal_bytes()
+ * DESCR:    Adds the 'len' bytes at 'bytes' to the trace. As many as fill the buffer go straight to the file.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _journal_bytes(journal_t *journal, const unsigned char *bytes, size_t len) {
+    _journal_reserve(journal, len);
+    if (len >= JOURNAL_BUF_SIZE) {
+        if (fwrite(bytes, 1, len, journal->out) != len) journal->ok = false;
+        journal->offset += (long)len;
+    } else {
+        memcpy(journal->buf + journal->len, bytes, len);
+        journal->len += len;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _journal_end()
+ * DESCR:    Writes the record of the command being performed, which has left Myrtle in the state *turtle.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _journal_end(journal_t *journal, const par_turtle_t *turtle) {
+    par_turtle_t  *state   = &journal->state;
+    bool           moved   = turtle->row != state->row || turtle->col != state->col;
+    bool           penchar = turtle->penchar != state->penchar;
+    bool           turned  = penchar || turtle->dir != state->dir || turtle->pendown != state->pendown;
+    int            tag     = journal->op;
+    unsigned char *p;
+
+    if (moved) tag |= JOURNAL_MOVED;
+    if (turned) tag |= JOURNAL_TURNED;
+    if (journal->fill_count > 0) tag |= JOURNAL_FILLS;
+
+    _journal_reserve(journal, 40);
+    p = journal->buf + journal->len;
+    *p++ = (unsigned char)tag;
+    if (moved) {
+        p += _journal_put_int(p, turtle->row - state->row);
+        p += _journal_put_int(p, turtle->col - state->col);
+    }
+    if (turned) {
+        *p++ = (unsigned char)(turtle->dir | (turtle->pendown ? JOURNAL_PEN : 0) |
+                               (penchar ? JOURNAL_PENCHAR : 0));
+        if (penchar) *p++ = (unsigned char)turtle->penchar;
+    }
+    if (journal->fill_count > 0) p += _journal_put_uint(p, (unsigned long long)journal->fill_count);
+    journal->work += p - (journal->buf + journal->len);
+    journal->len   = (size_t)(p - journal->buf);
+    if (journal->fill_count > 0) {
+        _journal_bytes(journal, journal->fills, journal->fill_len);
+        journal->work      += (coord_t)journal->fill_len;
+        journal->fill_len   = 0;
+        journal->fill_count = 0;
+    }
+    journal->state = *turtle;
+    journal->index++;
+    journal->op = -1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _journal_error()
+ * DESCR:    Formats the error message 'msg', which names the trace file 'fname' with "%.100s", into 'err'.
+ * RETURNS:  'status'.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _journal_error(char *err, int status, const char *msg, const char *fname) {
+    sprintf(err, msg, fname);
+    return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _journal_flush()
+ * DESCR:    Writes the buffered bytes of the trace to the trace file.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _journal_flush(journal_t *journal) {
+    if (journal->len && fwrite(journal->buf, 1, journal->len, journal->out) != journal->len) journal->ok = false;
+    journal->offset += (long)journal->len;
+    journal->len     = 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _journal_get()
+ * DESCR:    Reads the next byte of the trace being replayed.
+ * RETURNS:  The byte, or -1 at the end of the file.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _journal_get(journal_in_t *in) {
+    if (in->pos == in->len) {
+        in->offset += (long)in->len;
+        in->pos     = 0;
+        in->len     = fread(in->buf, 1, JOURNAL_BUF_SIZE, in->in);
+        if (in->len == 0) {
+            in->eof = true;
+            return -1;
+        }
+    }
+    return in->buf[in->pos++];
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _journal_index()
+ * DESCR:    Reads the index at the end of the trace being replayed. *total is set to the number of commands in it,
+ *           and *key to the last keyframe taken after at most 'at' commands, or to an index of -1 if there is
+ *           none. Where the trace is read from next is left anywhere.
+ * RETURNS:  True, or false if the trace has no index, because it was cut short, or it cannot be read.
+ *------------------------------------------------------------------------------------------------------------*/
+static bool _journal_index(journal_in_t *in, long at, long *total, journal_key_t *key) {
+    unsigned char      tail[16];
+    unsigned long long end = 0, count, delta, index = 0, offset = 0;
+    int                b;
+
+    key->index = -1;
+    if (fseek(in->in, -16L, SEEK_END) != 0 || fread(tail, 1, sizeof(tail), in->in) != sizeof(tail) ||
+        memcmp(tail + 8, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0) {
+        return false;
+    }
+    for (b = 7; b >= 0; b--) end = end << 8 | tail[b];
+    if (end > LONG_MAX || !_journal_seek(in, (long)end) || _journal_get(in) != JOURNAL_END ||
+        !_journal_read_uint(in, &delta) || delta > LONG_MAX || !_journal_read_uint(in, &count)) {
+        return false;
+    }
+    *total = (long)delta;
+    for (; count > 0; count--) {
+        if (!_journal_read_uint(in, &delta)) return false;
+        index += delta;
+        if (!_journal_read_uint(in, &delta)) return false;
+        offset += delta;
+        if (index > (unsigned long long)at || offset >= end) break;
+        key->index  = (long)index;
+        key->offset = (long)offset;
+    }
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _journal_key()
+ * DESCR:    Writes a keyframe: the number of commands recorded, Myrtle's state *turtle, and every square of the
+ *           world, row by row, as runs of the same char. A keyframe which cannot be added to the index is not
+ *           taken; the replay just has further to go.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _journal_key(journal_t *journal, const par_turtle_t *turtle) {
+    world_t       *world = journal->world;
+    coord_t        row, col, run = 0;
+    char           last  = WORLD_BACKGROUND;
+    unsigned char *p;
+
+    if (journal->key_count == journal->key_cap) {
+        size_t         cap  = journal->key_cap ? journal->key_cap * 2 : 64;
+        journal_key_t *keys = (journal_key_t *)realloc(journal->keys, cap * sizeof(journal_key_t));
+        if (!keys) return;
+        journal->keys    = keys;
+        journal->key_cap = cap;
+    }
+    journal->keys[journal->key_count].index  = journal->index;
+    journal->keys[journal->key_count].offset = journal->offset + (long)journal->len;
+    journal->key_count++;
+
+    _journal_reserve(journal, 40);
+    p = journal->buf + journal->len;
+    *p++ = (unsigned char)JOURNAL_KEY;
+    p += _journal_put_uint(p, (unsigned long long)journal->index);
+    p += _journal_put_state(p, turtle);
+    journal->len = (size_t)(p - journal->buf);
+    for (row = 0; row < world->rows; row++) {
+        for (col = 0; col < world->cols; col++) {
+            char ch = world_get(world, row, col);
+            if (ch != last && run > 0) {
+                _journal_run(journal, run, last);
+                run = 0;
+            }
+            last = ch;
+            run++;
+        }
+    }
+    _journal_run(journal, run, last);
+    journal->work = 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _journal_key_read()
+ * DESCR:    Reads a keyframe, whose tag has been read, from the trace being replayed into *index and *turtle. If
+ *           'apply' is true, its squares are drawn in 'world', which must be blank; otherwise they are skipped.
+ * RETURNS:  TERM_NORM, TERM_ERR_INPUT if the keyframe is cut short or corrupt, or TERM_ERR_MEMORY if the world
+ *           cannot grow to hold it.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _journal_key_read(journal_in_t *in, world_t *world, bool apply, par_turtle_t *turtle, long *index) {
+    unsigned long long u, run;
+    coord_t            row = 0, col = 0;
+    int                ch;
+
+    if (!_journal_read_uint(in, &u) || u > LONG_MAX || !_journal_read_state(in, turtle, world)) {
+        return TERM_ERR_INPUT;
+    }
+    *index = (long)u;
+    while (row < world->rows) {
+        if (!_journal_read_uint(in, &run) || run < 1 || (ch = _journal_get(in)) < 0) return TERM_ERR_INPUT;
+        while (run > 0) {
+            coord_t n = world->cols - col;
+            if (row >= world->rows) return TERM_ERR_INPUT;
+            if ((unsigned long long)n > run) n = (coord_t)run;
+            if (apply && (char)ch != WORLD_BACKGROUND &&
+                world_fill_row(world, row, col, n, (char)ch) != TERM_NORM) {
+                return TERM_ERR_MEMORY;
+            }
+            run -= (unsigned long long)n;
+            col += n;
+            if (col == world->cols) {
+                col = 0;
+                row++;
+            }
+        }
+    }
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _journal_put_int()
+ * DESCR:    Encodes 'value' at 'p' as a zigzag varint: 0, -1, 1, -2, ... become 0, 1, 2, 3, ...
+ * RETURNS:  The number of bytes written, at most 10.
+ *------------------------------------------------------------------------------------------------------------*/
+static size_t _journal_put_int(unsigned char *p, coord_t value) {
+    unsigned long long u = (unsigned long long)value << 1;
+    return _journal_put_uint(p, value < 0 ? ~u : u);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _journal_put_state()
+ * DESCR:    Encodes Myrtle's whole state *turtle at 'p': her row and col, a byte of her direction and JOURNAL_PEN,
+ *           and her pen char.
+ * RETURNS:  The number of bytes written, at most 22.
+ *------------------------------------------------------------------------------------------------------------*/
+static size_t _journal_put_state(unsigned char *p, const par_turtle_t *turtle) {
+    size_t len = _journal_put_uint(p, (unsigned long long)turtle->row);
+    len += _journal_put_uint(p + len, (unsigned long long)turtle->col);
+    p[len++] = (unsigned char)(turtle->dir | (turtle->pendown ? JOURNAL_PEN : 0));
+    p[len++] = (unsigned char)turtle->penchar;
+    return len;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _journal_put_uint()
+ * DESCR:    Encodes 'value' at 'p' as a varint: 7 bits to a byte, lowest first, with the top bit set on every byte
+ *           but the last.
+ * RETURNS:  The number of bytes written, at most 10.
+ *------------------------------------------------------------------------------------------------------------*/
+static size_t _journal_put_uint(unsigned char *p, unsigned long long value) {
+    size_t len = 0;
+    while (value >= 0x80) {
+        p[len++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    p[len++] = (unsigned char)value;
+    return len;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _journal_read_int()
+ * DESCR:    Reads a zigzag varint (see _journal_put_int()) from the trace being replayed into *value.
+ * RETURNS:  True, or false if the trace ends first or the varint is too long.
+ *------------------------------------------------------------------------------------------------------------*/
+static bool _journal_read_int(journal_in_t *in, coord_t *value) {
+    unsigned long long u;
+    if (!_journal_read_uint(in, &u)) return false;
+    *value = (u & 1) ? -(coord_t)(u >> 1) - 1 : (coord_t)(u >> 1);
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _journal_read_state()
+ * DESCR:    Reads Myrtle's whole state (see _journal_put_state()) from the trace being replayed into *turtle.
+ * RETURNS:  True, or false if the trace ends first or the state is not in 'world'.
+ *------------------------------------------------------------------------------------------------------------*/
+static bool _journal_read_state(journal_in_t *in, par_turtle_t *turtle, const world_t *world) {
+    unsigned long long row, col;
+    int                pen, penchar;
+
+    if (!_journal_read_uint(in, &row) || !_journal_read_uint(in, &col) || (pen = _journal_get(in)) < 0 ||
+        (penchar = _journal_get(in)) < 0 || row >= (unsigned long long)world->rows ||
+        col >= (unsigned long long)world->cols) {
+        return false;
+    }
+    turtle->row     = (coord_t)row;
+    turtle->col     = (coord_t)col;
+    turtle->dir     = pen & 3;
+    turtle->pendown = (pen & JOURNAL_PEN) != 0;
+    turtle->penchar = (char)penchar;
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _journal_read_uint()
+ * DESCR:    Reads a varint (see _journal_put_uint()) from the trace being replayed into *value.
+ * RETURNS:  True, or false if the trace ends first or the varint is too long.
+ *------------------------------------------------------------------------------------------------------------*/
+static bool _journal_read_uint(journal_in_t *in, unsigned long long *value) {
+    int shift = 0, c;
+
+    *value = 0;
+    do {
+        if (shift > 63 || (c = _journal_get(in)) < 0) return false;
+        *value |= (unsigned long long)(c & 0x7f) << shift;
+        shift  += 7;
+    } while (c & 0x80);
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _journal_record_read()
+ * DESCR:    Reads the record of a command, whose tag 'tag' has been read, from the trace being replayed. Its runs
+ *           are drawn in 'world' and *turtle, Myrtle's state when the command started, is changed to her state
+ *           after it.
+ * RETURNS:  TERM_NORM, TERM_ERR_INPUT if the record is cut short or corrupt, or TERM_ERR_MEMORY if the world
+ *           cannot grow to hold its runs.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _journal_record_read(journal_in_t *in, int tag, world_t *world, par_turtle_t *turtle) {
+    par_turtle_t       next = *turtle;
+    unsigned long long fills, count;
+    coord_t            delta, line, first, lines, size;
+    int                flags, c, status;
+    bool               vert;
+    char               ch;
+
+    if ((tag & JOURNAL_OP) >= CMD_COUNT) return TERM_ERR_INPUT;
+    if (tag & JOURNAL_MOVED) {
+        if (!_journal_read_int(in, &delta)) return TERM_ERR_INPUT;
+        next.row += delta;
+        if (!_journal_read_int(in, &delta)) return TERM_ERR_INPUT;
+        next.col += delta;
+        if (next.row < 0 || next.row >= world->rows || next.col < 0 || next.col >= world->cols) {
+            return TERM_ERR_INPUT;
+        }
+    }
+    if (tag & JOURNAL_TURNED) {
+        if ((flags = _journal_get(in)) < 0) return TERM_ERR_INPUT;
+        next.dir     = flags & 3;
+        next.pendown = (flags & JOURNAL_PEN) != 0;
+        if (flags & JOURNAL_PENCHAR) {
+            if ((c = _journal_get(in)) < 0) return TERM_ERR_INPUT;
+            next.penchar = (char)c;
+        }
+    }
+    if (tag & JOURNAL_FILLS) {
+        if (!_journal_read_uint(in, &fills)) return TERM_ERR_INPUT;
+        for (; fills > 0; fills--) {
+            if ((flags = _journal_get(in)) < 0 || !_journal_read_int(in, &line) ||
+                !_journal_read_int(in, &first) || !_journal_read_uint(in, &count)) {
+                return TERM_ERR_INPUT;
+            }
+            ch = turtle->penchar;
+            if (flags & JOURNAL_CH) {
+                if ((c = _journal_get(in)) < 0) return TERM_ERR_INPUT;
+                ch = (char)c;
+            }
+            vert   = (flags & JOURNAL_VERT) != 0;
+            line  += vert ? turtle->col : turtle->row;
+            first += vert ? turtle->row : turtle->col;
+            lines  = vert ? world->cols : world->rows;
+            size   = vert ? world->rows : world->cols;
+            if (line < 0 || line >= lines || first < 0 || first >= size || count < 1 ||
+                count > (unsigned long long)(size - first)) {
+                return TERM_ERR_INPUT;
+            }
+            if (vert) status = world_fill_col(world, line, first, (coord_t)count, ch);
+            else status = world_fill_row(world, line, first, (coord_t)count, ch);
+            if (status != TERM_NORM) return status;
+        }
+    }
+    *turtle = next;
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _journal_replay()
+ * DESCR:    Does the work of journal_replay() on the open trace file 'in', which is named 'fname'.
+ * RETURNS:  See journal_replay().
+ *------------------------------------------------------------------------------------------------------------*/
+static int _journal_replay(journal_in_t *in, long at, world_t *world, int layout, journal_pos_t *pos,
+                           const char *fname, char *err) {
+    unsigned long long version, ops, rows, cols;
+    journal_key_t      key;
+    long               body, index;
+    par_turtle_t       skipped;
+    int                i, tag, status = TERM_NORM;
+
+    for (i = 0; i < (int)sizeof(JOURNAL_MAGIC); i++) {
+        if (_journal_get(in) != (unsigned char)JOURNAL_MAGIC[i]) {
+            return _journal_error(err, TERM_ERR_INPUT, "'%.100s' is not a Myrtle trace", fname);
+        }
+    }
+    if (!_journal_read_uint(in, &version) || !_journal_read_uint(in, &ops) || version != JOURNAL_VERSION ||
+        ops != CMD_COUNT) {
+        return _journal_error(err, TERM_ERR_INPUT, "'%.100s' was recorded by another version of Myrtle", fname);
+    }
+    if (!_journal_read_uint(in, &rows) || !_journal_read_uint(in, &cols) || rows < 1 || cols < 1 ||
+        rows > WORLD_MAX_DIM || cols > WORLD_MAX_DIM) {
+        return _journal_error(err, TERM_ERR_INPUT, "The trace '%.100s' is corrupt", fname);
+    }
+    if (world_reset(world, (coord_t)rows, (coord_t)cols, layout) != TERM_NORM) {
+        return _journal_error(err, TERM_ERR_MEMORY, "Out of memory allocating Myrtle's world", fname);
+    }
+    if (!_journal_read_state(in, &pos->turtle, world)) {
+        return _journal_error(err, TERM_ERR_INPUT, "The trace '%.100s' is corrupt", fname);
+    }
+    body       = in->offset + (long)in->pos;
+    pos->index = 0;
+    pos->total = -1;
+    pos->op    = -1;
+
+    /* Start from the last keyframe at or before 'at', if the trace has an index, or else from the beginning. */
+    if (_journal_index(in, at, &pos->total, &key) && key.index > 0) {
+        if (!_journal_seek(in, key.offset) || _journal_get(in) != JOURNAL_KEY) status = TERM_ERR_INPUT;
+        else status = _journal_key_read(in, world, true, &pos->turtle, &pos->index);
+        if (status == TERM_NORM && pos->index != key.index) status = TERM_ERR_INPUT;
+    } else if (!_journal_seek(in, body)) {
+        status = TERM_ERR_INPUT;
+    }
+
+    /* Then apply the records after it. A trace cut short is replayed up to where it ends. */
+    while (status == TERM_NORM && pos->index < at) {
+        tag = _journal_get(in);
+        if (tag < 0) break;
+        if (tag == JOURNAL_END) {
+            pos->total = pos->index;
+            break;
+        }
+        if (tag == JOURNAL_KEY) {
+            status = _journal_key_read(in, world, false, &skipped, &index);
+        } else {
+            status = _journal_record_read(in, tag, world, &pos->turtle);
+            if (status == TERM_NORM) {
+                pos->op = tag & JOURNAL_OP;
+                pos->index++;
+            }
+        }
+        if (status == TERM_ERR_INPUT && in->eof) {
+            status = TERM_NORM;
+            break;
+        }
+    }
+    if (status == TERM_ERR_MEMORY) return _journal_error(err, status, "Out of memory replaying '%.100s'", fname);
+    if (status != TERM_NORM) return _journal_error(err, status, "The trace '%.100s' is corrupt", fname);
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _journal_reserve()
+ * DESCR:    Makes room in the buffer for 'len' more bytes of the trace, by writing it out if it has to.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _journal_reserve(journal_t *journal, size_t len) {
+    if (journal->len + len > JOURNAL_BUF_SIZE) _journal_flush(journal);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _journal_run()
+ * DESCR:    Writes a run of a keyframe: 'run' squares of 'ch'.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _journal_run(journal_t *journal, coord_t run, char ch) {
+    _journal_reserve(journal, 11);
+    journal->len += _journal_put_uint(journal->buf + journal->len, (unsigned long long)run);
+    journal->buf[journal->len++] = (unsigned char)ch;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _journal_seek()
+ * DESCR:    Moves the trace being replayed to 'offset', where it is read from next.
+ * RETURNS:  True, or false if the file cannot be seeked.
+ *------------------------------------------------------------------------------------------------------------*/
+static bool _journal_seek(journal_in_t *in, long offset) {
+    in->pos    = in->len = 0;
+    in->offset = offset;
+    in->eof    = false;
+    return fseek(in->in, offset, SEEK_SET) == 0;
+}
@@ -0,0 +1,107 @@
+/***************************************************************************************************************
+ * FILE: journal.h
+ *
+ * DESCRIPTION:
+ * Declarations for the trace of a run written by --record and read back by --replay. See comments in journal.c.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261017T0700 [JMW] Initial revision.
+ **************************************************************************************************************/
+#ifndef __JOURNAL_H__
+#define __JOURNAL_H__
+
+#include <stddef.h>   /* For size_t.       */
+#include <stdio.h>    /* For FILE.         */
+#include "bool.h"     /* For bool.         */
+#include "globals.h"  /* For coord_t.      */
+#include "par.h"      /* For par_turtle_t. */
+#include "world.h"    /* For world_t.      */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * PREPROCESSOR MACRO DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+#define JOURNAL_BUF_SIZE (1 << 16)   /* Bytes of the trace buffered before they are written, or after read. */
+#define JOURNAL_KEY_MIN  (1L << 16)  /* Fewest bytes of records between one keyframe and the next.          */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * A keyframe of a trace: the number of commands performed before it was taken, and where it is in the file.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    long index;
+    long offset;
+} journal_key_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * A trace being recorded.
+ *
+ * out        -- The trace file.
+ * buf        -- The bytes not yet written to 'out'.
+ * len        -- The number of bytes in buf.
+ * offset     -- The number of bytes written to 'out' before those in buf.
+ * world      -- The world of the run, which keyframes are taken of.
+ * started    -- True once journal_start() has written the header.
+ * op         -- The command being performed, whose record is written when the next one starts, or -1.
+ * index      -- The number of commands recorded.
+ * state      -- Myrtle as of the last record. Each record holds how she changed since the one before.
+ * fills      -- The runs of squares painted by the command being performed, already encoded.
+ * fill_len   -- The number of bytes in fills.
+ * fill_cap   -- The number of bytes allocated for fills.
+ * fill_count -- The number of runs in fills.
+ * work       -- The bytes of records written and squares painted since the last keyframe.
+ * key_work   -- How much work there is between keyframes: the number of squares in the world, so that the time
+ *               spent taking keyframes is never more than the time spent painting, but at least JOURNAL_KEY_MIN.
+ * keys       -- The keyframes taken, in order. Written at the end of the trace so that a replay can seek.
+ * key_count  -- The number of keyframes taken.
+ * key_cap    -- The number of keyframes allocated.
+ * ok         -- False once anything could not be written or allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct journal {
+    FILE          *out;
+    unsigned char  buf[JOURNAL_BUF_SIZE];
+    size_t         len;
+    long           offset;
+    world_t       *world;
+    bool           started;
+    int            op;
+    long           index;
+    par_turtle_t   state;
+    unsigned char *fills;
+    size_t         fill_len;
+    size_t         fill_cap;
+    long           fill_count;
+    coord_t        work;
+    coord_t        key_work;
+    journal_key_t *keys;
+    size_t         key_count;
+    size_t         key_cap;
+    bool           ok;
+} journal_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * Where journal_replay() stopped: the number of commands replayed, the number in the trace or -1 if the trace
+ * was cut short, the last command replayed or -1 if none was, and Myrtle's state after it.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    long         index;
+    long         total;
+    int          op;
+    par_turtle_t turtle;
+} journal_pos_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * NONSTATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+extern bool journal_close(journal_t *journal);
+extern void journal_command(journal_t *journal, int op, const par_turtle_t *turtle);
+extern void journal_fill(journal_t *journal, bool vert, coord_t line, coord_t first, coord_t count, char ch);
+extern bool journal_open(journal_t *journal, const char *fname);
+extern int  journal_replay(const char *fname, long at, world_t *world, int layout, journal_pos_t *pos, char *err);
+extern void journal_start(journal_t *journal, world_t *world, const par_turtle_t *turtle);
+extern void journal_stop(journal_t *journal, const par_turtle_t *turtle);
+
+#endif
@@ -8,17 +8,49 @@
  *
  * MODIFICATION HISTORY:
  * 20111010T1558 [JMW] implemented functions: main(), _main_terminate_norm(), main_terminate_err()
+ * 20261016T1000 [JMW] help message lists the commands in cmds.def
+ * 20261016T1500 [JMW] added -r, -c and -w to set the size and layout of Myrtle's world
+ * 20261016T1600 [JMW] added -w packed
+ * 20261016T1700 [JMW] added -w blocked
+ * 20261016T1800 [JMW] main() is a client of the myrtle_ctx_* API; the options are set on a context
+ * 20261016T1900 [JMW] added -b and -t to run a batch of scripts on worker threads
+ * 20261016T2000 [JMW] added -j to split a run across threads
+ * 20261016T2100 [JMW] -j also limits the threads turtles run on
+ * 20261016T2200 [JMW] added -L to run a batch in lockstep lanes
+ * 20261016T2300 [JMW] added -O to optimize the compiled program
+ * 20261017T0200 [JMW] added -J to run the program as native code
+ * 20261017T0300 [JMW] added -C to choose where compiled programs are cached, or to turn caching off
+ * 20261017T0500 [JMW] added -S to write the statistics of the run to stderr
+ * 20261017T0600 [JMW] added -P to profile the run by source line
+ * 20261017T0700 [JMW] added --record to record the run in a trace, and --replay and --at to replay one
+ * 20261017T0800 [JMW] added --checkpoint, --every and --restore; SIGUSR1 and SIGTERM take checkpoints
+ * 20261017T0900 [JMW] added --watch to run the script again whenever it changes
+ * 20261017T1300 [JMW] removed -L; a batch in lanes was no faster than one script at a time
+ * 20261017T1400 [JMW] removed -J; compiling to native code only pays when a program is run again and again
+ * 20261017T1400 [JMW] turtles run on one thread without -j
  * ------------------------------------------------------------------------------------------------------------
  * 01 Oct 2011 [KRB] Initial revision.
  **************************************************************************************************************/
+/* sigaction() is POSIX, not Standard C, so ask for it before including anything. */
+#define _POSIX_C_SOURCE 200112L
+
+#include <limits.h>   /* For LONG_MAX.                         */
+#include <signal.h>   /* For sigaction() and SIGUSR1.          */
 #include <stdio.h>    /* For fprintf() declaration.            */
 #include <stdlib.h>   /* For exit() declaration.               */
 #include <string.h>   /* For strcmp() declaration.             */
+#include "batch.h"    /* For batch_run().                      */
 #include "bool.h"     /* For bool, false, true.                */
-#include "file.h"     /* For declarations in file module.      */
+#include "cache.h"    /* For CACHE_MIN_SIZE.                   */
 #include "globals.h"  /* For global constant declarations.     */
+#include "journal.h"  /* For journal_t.                        */
 #include "main.h"     /* For main_termiante_err() declaration. */
 #include "myrtle.h"   /* For declarations in myrtle module.    */
+#include "par.h"      /* For PAR_MAX_THREADS.                  */
+#include "prof.h"     /* For prof_t and prof_write().          */
+#include "stats.h"    /* For stats_t and stats_print().        */
+#include "watch.h"    /* For watch_t and watch_run().          */
+#include "world.h"    /* For WORLD_* layouts and limits.       */
 
 /*--------------------------------------------------------------------------------------------------------------
  * STATICALLY GLOBAL PREPROCESSOR MACROS
@@ -30,6 +62,48 @@
 #define COPY     "2011"
 #define AUTHOR   "Kevin R. Burger"
 
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * The command line options which are not options of the interpreter context, i.e., what to run.
+ *
+ * in_fname  -- The source code file given by -i. NULL for stdin.
+ * out_fname -- The output file given by -o. NULL for stdout.
+ * batch     -- The manifest or directory given by -b. NULL unless running a batch.
+ * threads   -- The number of worker threads given by -t. Zero for one per CPU.
+ * stats     -- True if -S was given: the statistics of the run are written to stderr when it ends.
+ * json      -- True if they are written as JSON (-S json).
+ * prof      -- The stem given by -P. The profile of the run is written to stem.time.folded and stem.cells.folded.
+ *              NULL unless profiling.
+ * record    -- The trace file given by --record, which the run is recorded in. NULL unless recording.
+ * replay    -- The trace file given by --replay, which is replayed instead of running a program. NULL unless
+ *              replaying.
+ * at        -- The number of commands to replay, given by --at. -1 if it was not given, for all of them.
+ * checkpoint -- The checkpoint file given by --checkpoint, which the run is checkpointed in. NULL unless
+ *              checkpointing.
+ * every     -- The number of commands between checkpoints, given by --every n. Zero unless it was given.
+ * at_stop   -- True if --every stop was given: a checkpoint is taken after each 'stop'.
+ * restore   -- The checkpoint file given by --restore, which the run resumes from. NULL unless resuming.
+ * watch     -- True if --watch was given: the script is run again whenever it changes.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    char *in_fname;
+    char *out_fname;
+    char *batch;
+    int   threads;
+    bool  stats;
+    bool  json;
+    char *prof;
+    char *record;
+    char *replay;
+    long  at;
+    char *checkpoint;
+    long  every;
+    bool  at_stop;
+    char *restore;
+    bool  watch;
+} options_t;
+
 /*--------------------------------------------------------------------------------------------------------------
  * STATIC FUNCTION DECLARATIONS
  *
@@ -43,27 +117,111 @@
  * Hint: Think of the word "static" as meaning "private", and the word "extern" as meaning "public".
  *------------------------------------------------------------------------------------------------------------*/
 static void _main_help();
-static void _main_parse_cmd_line(int argc, char *argv[]);
+static char *_main_option_arg(int argc, char *argv[], int *i);
+static coord_t _main_parse_num(char *arg, coord_t max, char *err_msg);
+static void _main_parse_cmd_line(int argc, char *argv[], myrtle_ctx_t *ctx, options_t *options);
 static void _main_print_version();
+static void _main_prof_write(const prof_t *prof, const char *stem);
+static void _main_signal(int sig);
 static void _main_terminate_norm();
 
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC GLOBAL VARIABLE DEFINITIONS
+ *
+ * Set by _main_signal() when a signal asks a checkpointed run for a checkpoint, to one of MYRTLE_CHECKPOINT_*.
+ * A signal handler can only talk to the rest of the program through a global like this one.
+ *------------------------------------------------------------------------------------------------------------*/
+static volatile sig_atomic_t g_signalled = 0;
+
 /*===================================== NONSTATIC FUNCTION DEFINITIONS =======================================*/
 
 /*--------------------------------------------------------------------------------------------------------------
  * FUNCTION: main()
- * DESCR:    Starting point of execution. Simply parses the command line, and if there is a source code file
- *           on the command line, passes the file name to run(). If the command line is invalid, then parse_
- *           command_line does not return. Note: In C, main() should NEVER be defined as a static function.
- *           Otherwise the C startup code will not be able to call it. You will get a linker error if you do
- *           define main() as static. So don't. There, I said it.
- * RETURNS:  Zero on success, non-zero on error.
+ * DESCR:    Starting point of execution. Simply parses the command line into an interpreter context, and runs
+ *           the source code file named on the command line (or stdin) in it. If the command line is invalid,
+ *           then parse_command_line does not return. Note: In C, main() should NEVER be defined as a static
+ *           function. Otherwise the C startup code will not be able to call it. You will get a linker error if
+ *           you do define main() as static. So don't. There, I said it.
+ * RETURNS:  Zero on success. On error, main_terminate_err() is called with the message and status of the run.
  *------------------------------------------------------------------------------------------------------------*/
 int main(int argc, char *argv[])  {
+    myrtle_ctx_t *ctx = myrtle_ctx_create();
+    options_t     options = { NULL, NULL, NULL, 0, false, false, NULL, NULL, NULL, -1,
+                              NULL, 0, false, NULL, false };
+    stats_t       stats;
+    prof_t        prof;
+    journal_t     journal;
+    watch_t       watch;
+    char          err_msg[160];
+    int           status;
+
+    if (!ctx) main_terminate_err("Out of memory allocating Myrtle's world", TERM_ERR_MEMORY);
+
     /* See what's on the command line. Call _main_parse_cmd_line() and pass argc and argv as parameters. */
-	_main_parse_cmd_line(argc, argv);
+	_main_parse_cmd_line(argc, argv, ctx, &options);
+    if (options.stats && !myrtle_ctx_stats_set(ctx, &stats)) {
+        main_terminate_err("This interpreter was built without statistics (make STATS=0)", TERM_ERR_CMD_LINE);
+    }
+    prof_init(&prof);
+    if (options.prof) myrtle_ctx_prof_set(ctx, &prof);
+    if (options.record) {
+        if (!journal_open(&journal, options.record)) {
+            sprintf(err_msg, "Cannot open trace file '%.100s'", options.record);
+            main_terminate_err(err_msg, TERM_ERR_OUTPUT);
+        }
+        myrtle_ctx_journal_set(ctx, &journal);
+    }
+    if (options.checkpoint) {
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = _main_signal;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGUSR1, &action, NULL);
+        sigaction(SIGTERM, &action, NULL);
+        sigaction(SIGINT, &action, NULL);
+        myrtle_ctx_checkpoint_set(ctx, options.checkpoint, options.every, options.at_stop, &g_signalled);
+    }
+    if (options.restore) myrtle_ctx_restore_set(ctx, options.restore);
 
-    /* Call myrtle_interp() and return what it returns. */
-    return myrtle_interp();
+    /* Run the program, or the batch, or replay the trace, or watch the script, and return what the run returns. */
+    if (options.replay) {
+        long        total, replayed;
+        const char *last;
+        status   = myrtle_ctx_replay_file(ctx, options.replay, options.at < 0 ? LONG_MAX : options.at,
+                                          options.out_fname);
+        replayed = myrtle_ctx_replayed(ctx, &total, &last);
+        if (status == TERM_NORM && total < 0) {
+            fprintf(stderr, "Replayed %ld commands of a trace which was cut short", replayed);
+        } else if (status == TERM_NORM) {
+            fprintf(stderr, "Replayed %ld of %ld commands", replayed, total);
+        }
+        if (status == TERM_NORM) fprintf(stderr, last ? "; the last was '%s'.\n" : ".\n", last);
+        strcpy(err_msg, myrtle_ctx_error(ctx));
+    } else if (options.watch) {
+        watch_init(&watch);
+        status = watch_run(ctx, &watch, options.in_fname, options.out_fname, stderr, err_msg);
+        watch_free(&watch);
+    } else if (options.batch) {
+        status = batch_run(ctx, options.batch, options.threads, stdout, err_msg);
+    } else {
+        long removed, commands;
+        status  = myrtle_ctx_run_file(ctx, options.in_fname, options.out_fname);
+        removed = myrtle_ctx_removed(ctx, &commands);
+        if (commands > 0) fprintf(stderr, "Optimizer removed %ld of %ld commands.\n", removed, commands);
+        if (options.stats) stats_print(&stats, stderr, options.json);
+        if (options.prof) {
+            _main_prof_write(&prof, options.prof);
+            if (!prof.ok) fprintf(stderr, "Profile is incomplete: out of memory or too many call paths.\n");
+        }
+        if (options.record && !journal_close(&journal)) {
+            fprintf(stderr, "Cannot write the trace to %s.\n", options.record);
+        }
+        strcpy(err_msg, myrtle_ctx_error(ctx));
+    }
+    myrtle_ctx_destroy(ctx);
+    prof_free(&prof);
+    if (status != TERM_NORM) main_terminate_err(err_msg, status);
+    return TERM_NORM;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
@@ -108,39 +266,227 @@ static void _main_help() {
     fprintf(stdout, "-h         Displays this help message and terminates.\n");
     fprintf(stdout, "-V         Verbose mode. Displays commands as they are performed.\n");
     fprintf(stdout, "-v         Displays the version of the Myrtle interpreter and terminates.\n");
+    fprintf(stdout, "-r rows    Makes Myrtle's world 'rows' rows tall. The default is %d.\n", MAX_WORLD_ROWS);
+    fprintf(stdout, "-c cols    Makes Myrtle's world 'cols' cols wide. The default is %d.\n", MAX_WORLD_COLS);
+    fprintf(stdout, "-w layout  Stores the world 'dense', 'sparse' in tiles allocated as they are drawn in,\n");
+    fprintf(stdout, "           'packed' in 1, 2, 4 or 8 bits per square, or 'blocked' in 64x64 tiles,\n");
+    fprintf(stdout, "           which is faster for vertical lines. The default, 'auto', is dense unless\n");
+    fprintf(stdout, "           the world is larger than %d MB.\n", (int)(WORLD_DENSE_MAX >> 20));
+    fprintf(stdout, "-b batch   Runs every script listed in the file 'batch', one per line, optionally\n");
+    fprintf(stdout, "           followed by its output file, or every *.myr file in the directory 'batch'.\n");
+    fprintf(stdout, "           The output of x.myr goes to x.out unless the list names another file.\n");
+    fprintf(stdout, "           Writes the time taken by each script and in total. Not with -i, -o or -V.\n");
+    fprintf(stdout, "-t n       Runs a batch on n threads. The default is one per CPU.\n");
+    fprintf(stdout, "-j n       Splits each long stretch of commands between stops across n threads.\n");
+    fprintf(stdout, "           The output is the same as without -j. Not with -b. A program with\n");
+    fprintf(stdout, "           turtle blocks runs its turtles on at most n threads, and on one without\n");
+    fprintf(stdout, "           -j. Only worth it with long stretches and several CPUs (see parbench).\n");
+    fprintf(stdout, "-O         Optimizes the program before performing it, merging, cancelling and\n");
+    fprintf(stdout, "           collapsing commands which make no difference to the output. Writes how\n");
+    fprintf(stdout, "           many commands were removed to stderr, or to the batch report. With -V,\n");
+    fprintf(stdout, "           shows the commands of the optimized program.\n");
+    fprintf(stdout, "-C dir     Keeps the compiled programs of scripts of %d KB or more in 'dir'.\n",
+            (int)(CACHE_MIN_SIZE >> 10));
+    fprintf(stdout, "           The default is next to each script, x.myb for x.myr. The next run\n");
+    fprintf(stdout, "           of a script maps its compiled program instead of compiling it again,\n");
+    fprintf(stdout, "           unless the script has changed. 'off' turns the cache off.\n");
+    fprintf(stdout, "-S [json]  Writes statistics of the run to stderr when it ends: the commands\n");
+    fprintf(stdout, "           performed, squares painted and overwritten, input read, time spent\n");
+    fprintf(stdout, "           compiling, performing and writing the world, with histograms, and\n");
+    fprintf(stdout, "           peak memory. 'json' writes them as one JSON object. Not with -b.\n");
+    fprintf(stdout, "-P stem    Profiles the run by source line and column: writes the time spent in\n");
+    fprintf(stdout, "           each command to stem.time.folded and the squares it painted to\n");
+    fprintf(stdout, "           stem.cells.folded, nested in the procedure calls and repeat blocks\n");
+    fprintf(stdout, "           around it, as folded stacks for flamegraph tools. The program is\n");
+    fprintf(stdout, "           interpreted, without -O, -j or the cache. Not with -b.\n");
+    fprintf(stdout, "--record file\n");
+    fprintf(stdout, "           Records what every command performed does in the binary trace 'file':\n");
+    fprintf(stdout, "           how Myrtle moves and turns and the squares she paints. The program is\n");
+    fprintf(stdout, "           interpreted and procedures are performed at every call, without -j.\n");
+    fprintf(stdout, "           Not with -b, nor with programs with turtle blocks.\n");
+    fprintf(stdout, "--replay file\n");
+    fprintf(stdout, "           Replays the trace 'file' instead of running a program: writes the world\n");
+    fprintf(stdout, "           as it was at the end of the run to the output, without the program, and\n");
+    fprintf(stdout, "           how many commands were replayed to stderr.\n");
+    fprintf(stdout, "--at n     Replays only the first n commands, counted as -V lists them.\n");
+    fprintf(stdout, "--checkpoint file\n");
+    fprintf(stdout, "           Checkpoints the run in 'file': Myrtle, her world, where she is in the\n");
+    fprintf(stdout, "           program and how much output has been written, so that --restore can\n");
+    fprintf(stdout, "           carry on from there. SIGUSR1 takes a checkpoint, and SIGTERM or SIGINT\n");
+    fprintf(stdout, "           takes one and stops. The program is interpreted and procedures are\n");
+    fprintf(stdout, "           performed at every call, without -j. Not with -b, --record or\n");
+    fprintf(stdout, "           --replay, nor with programs with turtle blocks.\n");
+    fprintf(stdout, "--every n  Also takes a checkpoint every n commands, counted as -V lists them.\n");
+    fprintf(stdout, "--every stop\n");
+    fprintf(stdout, "           Also takes a checkpoint after each stop. Only with --checkpoint.\n");
+    fprintf(stdout, "--restore file\n");
+    fprintf(stdout, "           Resumes the run checkpointed in 'file' from where it was taken. The\n");
+    fprintf(stdout, "           program and options must be the same; the output file is cut back to\n");
+    fprintf(stdout, "           what had been written and written on from there. Not with -b, --record\n");
+    fprintf(stdout, "           or --replay.\n");
+    fprintf(stdout, "--watch    Runs the script given by -i, then runs it again whenever it is saved,\n");
+    fprintf(stdout, "           until interrupted, and writes how long each run took to stderr. Each\n");
+    fprintf(stdout, "           run starts again from shortly before the first command which changed,\n");
+    fprintf(stdout, "           and cuts the file given by -o back to what had been written by then.\n");
+    fprintf(stdout, "           The program is interpreted, without -O, -j or the cache. Not with\n");
+    fprintf(stdout, "           -b, -S, -P, --record, --replay, --checkpoint or --restore.\n");
+    fprintf(stdout, "\nNative code:\n");
+    fprintf(stdout, "Programs which embed Myrtle (libmyrtle.a) and run the same program again\n");
+    fprintf(stdout, "and again can have it compiled to native x86-64 code once and reused, with\n");
+    fprintf(stdout, "myrtle_ctx_jit_set() in myrtle.h. myrtle runs a program once, which is\n");
+    fprintf(stdout, "faster interpreted than compiled first, so it has no option for it.\n");
+    fprintf(stdout, "\nCommands:\n");
+#define MYRTLE_CMD(name, str, nargs, usage, help) fprintf(stdout, "%-14s%s\n", usage, help);
+#include "cmds.def"
+#undef MYRTLE_CMD
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _main_option_arg()
+ * DESCR:    Steps *i past the option at argv[*i] to the argument which follows it.
+ * RETURNS:  The argument. If the option is the last thing on the command line, the help message is displayed and
+ *           the program terminates with TERM_ERR_CMD_LINE.
+ *------------------------------------------------------------------------------------------------------------*/
+static char *_main_option_arg(int argc, char *argv[], int *i) {
+    if (*i + 1 >= argc) {
+        _main_help();
+        main_terminate_err("\nInvalid command line", TERM_ERR_CMD_LINE);
+    }
+    return argv[++*i];
 }
 
 /*--------------------------------------------------------------------------------------------------------------
  * FUNCTION: _main_parse_cmd_line()
- * DESCR:    Examines the command line for the source code file and other command line options.
+ * DESCR:    Examines the command line for the source code file and other command line options. What to run goes
+ *           in 'options'; the options of the interpreter are set on 'ctx'.
  * RETURNS:  Nothing
  *------------------------------------------------------------------------------------------------------------*/
-static void _main_parse_cmd_line(int argc, char *argv[]) {
-    int i;
+static void _main_parse_cmd_line(int argc, char *argv[], myrtle_ctx_t *ctx, options_t *options) {
+    bool verbose = false;
+    bool jobs    = false;
+    int  i;
 
-    /* Call myrtle_verbose_set() to set the verbose flag to false. */
-    myrtle_verbose_set(false);
+    /* Call myrtle_ctx_verbose_set() to turn verbose mode off. */
+    myrtle_ctx_verbose_set(ctx, NULL);
 
     for (i = 1; i < argc; i++) {
         if (streq(argv[i], "-i")) {
-            file_set_in_fname(argv[++i]);
+            options->in_fname = argv[++i];
         } else if (streq(argv[i], "-o")) {
-            file_set_out_fname(argv[++i]);
+            options->out_fname = argv[++i];
         } else if (streq(argv[i], "-h")) {
             _main_print_version();
             _main_help();
             _main_terminate_norm();
         } else if (streq(argv[i], "-V")) {
-            /* Call myrtle_verbose_set() to set the verbose flag to true. */
-        	myrtle_verbose_set(true);
+            /* Call myrtle_ctx_verbose_set() to send the commands to stdout as they are performed. */
+        	myrtle_ctx_verbose_set(ctx, stdout);
+            verbose = true;
         } else if (streq(argv[i], "-v")) {
             _main_print_version();
             _main_terminate_norm();
+        } else if (streq(argv[i], "-r")) {
+            myrtle_ctx_world_size_set(ctx, _main_parse_num(_main_option_arg(argc, argv, &i), WORLD_MAX_DIM,
+                                      "Invalid world size"), 0);
+        } else if (streq(argv[i], "-c")) {
+            myrtle_ctx_world_size_set(ctx, 0, _main_parse_num(_main_option_arg(argc, argv, &i), WORLD_MAX_DIM,
+                                      "Invalid world size"));
+        } else if (streq(argv[i], "-b")) {
+            options->batch = _main_option_arg(argc, argv, &i);
+        } else if (streq(argv[i], "-t")) {
+            options->threads = (int)_main_parse_num(_main_option_arg(argc, argv, &i), BATCH_MAX_THREADS,
+                                                    "Invalid number of threads");
+        } else if (streq(argv[i], "-O")) {
+            myrtle_ctx_optimize_set(ctx, true);
+        } else if (streq(argv[i], "-C")) {
+            char *dir = _main_option_arg(argc, argv, &i);
+            if (streq(dir, "off")) myrtle_ctx_cache_set(ctx, false, NULL);
+            else myrtle_ctx_cache_set(ctx, true, dir);
+        } else if (streq(argv[i], "-S")) {
+            options->stats = true;
+            if (i + 1 < argc && streq(argv[i + 1], "json")) {
+                options->json = true;
+                i++;
+            }
+        } else if (streq(argv[i], "-P")) {
+            options->prof = _main_option_arg(argc, argv, &i);
+        } else if (streq(argv[i], "--record")) {
+            options->record = _main_option_arg(argc, argv, &i);
+        } else if (streq(argv[i], "--replay")) {
+            options->replay = _main_option_arg(argc, argv, &i);
+        } else if (streq(argv[i], "--at")) {
+            char *at = _main_option_arg(argc, argv, &i);
+            options->at = streq(at, "0") ? 0 : (long)_main_parse_num(at, LONG_MAX, "Invalid number of commands");
+        } else if (streq(argv[i], "--checkpoint")) {
+            options->checkpoint = _main_option_arg(argc, argv, &i);
+        } else if (streq(argv[i], "--every")) {
+            char *every = _main_option_arg(argc, argv, &i);
+            if (streq(every, "stop")) options->at_stop = true;
+            else options->every = (long)_main_parse_num(every, LONG_MAX, "Invalid number of commands");
+        } else if (streq(argv[i], "--restore")) {
+            options->restore = _main_option_arg(argc, argv, &i);
+        } else if (streq(argv[i], "--watch")) {
+            options->watch = true;
+        } else if (streq(argv[i], "-j")) {
+            myrtle_ctx_jobs_set(ctx, (int)_main_parse_num(_main_option_arg(argc, argv, &i), PAR_MAX_THREADS,
+                                                          "Invalid number of jobs"));
+            jobs = true;
+        } else if (streq(argv[i], "-w")) {
+            char *layout = _main_option_arg(argc, argv, &i);
+            if (streq(layout, "auto")) myrtle_ctx_world_layout_set(ctx, WORLD_AUTO);
+            else if (streq(layout, "dense")) myrtle_ctx_world_layout_set(ctx, WORLD_DENSE);
+            else if (streq(layout, "sparse")) myrtle_ctx_world_layout_set(ctx, WORLD_SPARSE);
+            else if (streq(layout, "packed")) myrtle_ctx_world_layout_set(ctx, WORLD_PACKED);
+            else if (streq(layout, "blocked")) myrtle_ctx_world_layout_set(ctx, WORLD_BLOCKED);
+            else main_terminate_err("Invalid world layout", TERM_ERR_CMD_LINE);
         } else {
             _main_help();
             main_terminate_err("\nInvalid command line", TERM_ERR_CMD_LINE); 
         }
     }
+
+    /* A batch names its own input and output files, the traces of its threads would be interleaved, it
+     * already keeps every thread busy, and it reports its own times. */
+    if (options->batch && (options->in_fname || options->out_fname || verbose || jobs || options->stats ||
+                           options->prof || options->record)) {
+        _main_help();
+        main_terminate_err("\nInvalid command line", TERM_ERR_CMD_LINE);
+    }
+
+    /* A replay runs no program. */
+    if ((options->replay && (options->batch || options->in_fname || options->stats || options->prof ||
+                             options->record)) || (options->at >= 0 && !options->replay)) {
+        _main_help();
+        main_terminate_err("\nInvalid command line", TERM_ERR_CMD_LINE);
+    }
+
+    /* A checkpoint is of one interpreted run of a program, whose commands are not being recorded. */
+    if (((options->checkpoint || options->restore) && (options->batch || options->replay || options->record)) ||
+        ((options->every || options->at_stop) && !options->checkpoint)) {
+        _main_help();
+        main_terminate_err("\nInvalid command line", TERM_ERR_CMD_LINE);
+    }
+    /* Watching runs one script, again and again, and reports each run itself. */
+    if (options->watch && (!options->in_fname || options->batch || options->stats || options->prof ||
+                           options->record || options->replay || options->checkpoint || options->restore)) {
+        _main_help();
+        main_terminate_err("\nInvalid command line", TERM_ERR_CMD_LINE);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _main_parse_num()
+ * DESCR:    Converts the argument of an option such as -r or -c to a number. atoi() would quietly turn "1e6" into
+ *           1, so the digits are converted here and anything else is rejected.
+ * RETURNS:  The number, which is between 1 and 'max'. Otherwise, the program terminates with TERM_ERR_CMD_LINE
+ *           and 'err_msg'.
+ *------------------------------------------------------------------------------------------------------------*/
+static coord_t _main_parse_num(char *arg, coord_t max, char *err_msg) {
+    coord_t n = 0;
+    char   *p;
+    for (p = arg; *p >= '0' && *p <= '9' && n <= max; p++) n = n * 10 + (*p - '0');
+    if (p == arg || *p || n < 1 || n > max) main_terminate_err(err_msg, TERM_ERR_CMD_LINE);
+    return n;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
@@ -152,6 +498,48 @@ static void _main_print_version() {
     fprintf(stdout, "Myrtle (the Turtle) Ver %s -- (c) %s %s\n", VERSION, COPY, AUTHOR);
 }
 
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _main_prof_write()
+ * DESCR:    Writes the profile of the run to stem.time.folded and stem.cells.folded (see prof_write()). A profile
+ *           which cannot be written is reported on stderr, but does not fail the run.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _main_prof_write(const prof_t *prof, const char *stem) {
+    char *time_name  = (char *)malloc(strlen(stem) + sizeof(".time.folded"));
+    char *cells_name = (char *)malloc(strlen(stem) + sizeof(".cells.folded"));
+    FILE *time_out, *cells_out;
+    bool  ok;
+
+    if (!time_name || !cells_name) {
+        fprintf(stderr, "Out of memory writing the profile.\n");
+        free(time_name);
+        free(cells_name);
+        return;
+    }
+    sprintf(time_name, "%s.time.folded", stem);
+    sprintf(cells_name, "%s.cells.folded", stem);
+    time_out  = fopen(time_name, "w");
+    cells_out = fopen(cells_name, "w");
+    ok = time_out && cells_out && prof_write(prof, time_out, cells_out);
+    if (time_out && fclose(time_out) != 0) ok = false;
+    if (cells_out && fclose(cells_out) != 0) ok = false;
+    if (!ok) fprintf(stderr, "Cannot write the profile to %s and %s.\n", time_name, cells_name);
+    free(time_name);
+    free(cells_name);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _main_signal()
+ * DESCR:    Handles the signals a checkpointed run is sent: SIGUSR1 asks for a checkpoint, and SIGTERM or SIGINT
+ *           for a checkpoint and then to stop. The run takes it before its next command. A request to stop is
+ *           never turned back into one to go on.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _main_signal(int sig) {
+    if (sig != SIGUSR1) g_signalled = MYRTLE_CHECKPOINT_STOP;
+    else if (g_signalled != MYRTLE_CHECKPOINT_STOP) g_signalled = MYRTLE_CHECKPOINT_GO;
+}
+
 /*--------------------------------------------------------------------------------------------------------------
  * FUNCTION: _main_terminate_norm()
  * DESCR:    Called to terminate the program normally, i.e., with no error return code.
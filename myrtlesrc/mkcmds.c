@@ -0,0 +1,103 @@
+/***************************************************************************************************************
+ * FILE: mkcmds.c
+ *
+ * DESCRIPTION:
+ * Build-time generator for cmds_hash.h. Searches for parameters of MYRTLE_CMD_HASH() (see myrtle.h) under which
+ * every command in cmds.def hashes to a different slot, and writes those parameters and the slot table to
+ * stdout. The Makefile runs this program whenever cmds.def changes, so _myrtle_cmd_lookup() can find a command
+ * with one hash and one final string comparison.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261016T1000 [JMW] Initial revision.
+ **************************************************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include "bool.h"
+#include "myrtle.h"
+
+/*--------------------------------------------------------------------------------------------------------------
+ * PREPROCESSOR MACRO DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+#define MAX_SLOTS 4096  /* Give up if no table this small works. A macro because it sizes an array. */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC GLOBAL CONSTANT DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+static const char *CMDS[] = {
+#define MYRTLE_CMD(name, str, nargs, usage, help) str,
+#include "cmds.def"
+#undef MYRTLE_CMD
+};
+
+static const int MAX_MULT = 64;  /* Multipliers tried are 1..MAX_MULT-1. */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+static bool _mkcmds_try(int len_mult, int first_mult, int mask, int *slots);
+static void _mkcmds_write(int len_mult, int first_mult, int mask, int *slots);
+
+/*======================================= NONSTATIC FUNCTION DEFINITIONS =====================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: main()
+ * DESCR:    Tries table sizes from the smallest power of two with at least twice as many slots as there are
+ *           commands upward, and every pair of multipliers for each size, until the hash is perfect.
+ * RETURNS:  Zero on success, TERM_ERR_CMD_LINE if no perfect hash was found.
+ *------------------------------------------------------------------------------------------------------------*/
+int main() {
+    static int slots[MAX_SLOTS];
+    int size, len_mult, first_mult;
+
+    for (size = 1; size < 2 * CMD_COUNT; size *= 2) ;
+    for (; size <= MAX_SLOTS; size *= 2) {
+        for (first_mult = 1; first_mult < MAX_MULT; first_mult++) {
+            for (len_mult = 1; len_mult < MAX_MULT; len_mult++) {
+                if (_mkcmds_try(len_mult, first_mult, size - 1, slots)) {
+                    _mkcmds_write(len_mult, first_mult, size - 1, slots);
+                    return TERM_NORM;
+                }
+            }
+        }
+    }
+    fprintf(stderr, "mkcmds: no perfect hash for the commands in cmds.def\n");
+    return TERM_ERR_CMD_LINE;
+}
+
+/*========================================= STATIC FUNCTION DEFINITIONS ======================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _mkcmds_try()
+ * DESCR:    Hashes every command with the given parameters into 'slots', which has mask + 1 elements. Each
+ *           slot is left holding the CMD_* value of the command which hashed there, or -1.
+ * RETURNS:  True if no two commands hashed to the same slot.
+ *------------------------------------------------------------------------------------------------------------*/
+static bool _mkcmds_try(int len_mult, int first_mult, int mask, int *slots) {
+    int i, h;
+    for (i = 0; i <= mask; i++) slots[i] = -1;
+    for (i = 0; i < CMD_COUNT; i++) {
+        h = MYRTLE_CMD_HASH(CMDS[i], (int)strlen(CMDS[i]), len_mult, first_mult, mask);
+        if (slots[h] != -1) return false;
+        slots[h] = i;
+    }
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _mkcmds_write()
+ * DESCR:    Writes cmds_hash.h to stdout.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _mkcmds_write(int len_mult, int first_mult, int mask, int *slots) {
+    int i;
+    printf("/* Generated by mkcmds from cmds.def. Do not edit. */\n");
+    printf("#define CMD_HASH_LEN_MULT   %d\n", len_mult);
+    printf("#define CMD_HASH_FIRST_MULT %d\n", first_mult);
+    printf("#define CMD_HASH_MASK       %d\n", mask);
+    printf("static const signed char CMD_HASH_SLOTS[%d] = {", mask + 1);
+    for (i = 0; i <= mask; i++) printf("%s%d", !i ? "\n    " : (i % 16) ? ", " : ",\n    ", slots[i]);
+    printf("\n};\n");
+}
@@ -8,6 +8,36 @@
  *
  * MODIFICATION HISTORY:
  * 20111010T1748 [JMW] added static int MAX_CMDS
+ * 20261016T0900 [JMW] compile the input to a code_t before executing it; commands take their operands as params
+ * 20261016T1000 [JMW] command table generated from cmds.def; _myrtle_cmd_lookup() uses the perfect hash
+ * 20261016T1100 [JMW] compile from token_t views; globals.line is the real source line
+ * 20261016T1200 [JMW] numeric operands come from token_t.value
+ * 20261016T1300 [JMW] forward/backward move and draw a whole span at once instead of one square at a time
+ * 20261016T1400 [JMW] the world is one aligned block whose rows end in '\n'; it is written with one file_write()
+ * 20261016T1500 [JMW] the world moved to world.c; its size is set at run time and positions are coord_t
+ * 20261016T1800 [JMW] all state is in a myrtle_ctx_t; errors are returned instead of terminating the program
+ * 20261016T1900 [JMW] added myrtle_ctx_clone(); a run reuses the world of the previous run
+ * 20261016T2000 [JMW] added myrtle_ctx_jobs_set(); long runs of commands can be split across threads by par.c
+ * 20261016T2100 [JMW] 'turtle' blocks declare more turtles, which par.c runs at the same time as Myrtle
+ * 20261016T2200 [JMW] added myrtle_ctx_run_lanes() to perform many programs in lockstep (lanes.c)
+ * 20261016T2300 [JMW] added myrtle_ctx_optimize_set(); -O optimizes the compiled program (opt.c)
+ * 20261017T0000 [JMW] added 'repeat n [ ... ]'; repetitions which cannot change the world are skipped (repeat.c)
+ * 20261017T0100 [JMW] added procedures ('to name ... end'); small ones are inlined, others stamped (stamp.c)
+ * 20261017T0200 [JMW] added myrtle_ctx_jit_set(); -J compiles the program to native code (jit.c)
+ * 20261017T0300 [JMW] added myrtle_ctx_cache_set(); large scripts are run from a cached compiled program (cache.c)
+ * 20261017T0500 [JMW] added myrtle_ctx_stats_set(); a run can keep statistics (stats.c)
+ * 20261017T0600 [JMW] added myrtle_ctx_prof_set(); a run can be profiled by source line (prof.c)
+ * 20261017T0700 [JMW] added myrtle_ctx_journal_set(); a run can be recorded and replayed (journal.c)
+ * 20261017T0800 [JMW] added myrtle_ctx_checkpoint_set() and myrtle_ctx_restore_set(); runs resume (checkpoint.c)
+ * 20261017T0900 [JMW] added myrtle_ctx_watch_set(); a run of a changed script resumes where it changed (watch.c)
+ * 20261017T1100 [JMW] cmd_names[] and cmd_nargs[] are defined here for the other modules
+ * 20261017T1200 [JMW] only one context's run at a time is timed by the profiler
+ * 20261017T1200 [JMW] added myrtle_ctx_lanes_impl_set(); the lane implementation is kept in the context
+ * 20261017T1300 [JMW] the lanes are only built in with MYRTLE_LANES (make LANES=1)
+ * 20261017T1400 [JMW] removed myrtle_ctx_run_lanes() and lanes.c; performing programs in lanes was no faster
+ * 20261017T1400 [JMW] removed the commented-out stopping _myrtle_move()
+ * 20261017T1400 [JMW] myrtle no longer has -J; myrtle_ctx_jit_set() is for programs which rerun a program
+ * 20261017T1400 [JMW] turtles run on one thread unless more jobs are set; more threads measured no faster
  * ------------------------------------------------------------------------------------------------------------
  * 01 Oct 2011 [KRB] Initial revision.
  **************************************************************************************************************/
@@ -15,150 +45,231 @@
 #include <stdlib.h>
 #include <string.h>
 #include "bool.h"
+#include "cache.h"
+#include "checkpoint.h"
+#include "code.h"
 #include "file.h"
 #include "globals.h"
-#include "main.h"
+#include "jit.h"
+#include "journal.h"
 #include "myrtle.h"
-
-/*--------------------------------------------------------------------------------------------------------------
- * GLOBAL PREPROCESSOR MACRO DEFINITIONS
- *
- * I have a good reason for defining these constants as preprocessor macros rather than using the const reserv-
- * ed word. The reason is that in the initialization of the 'globals' variable on line x, I want to initialize
- * 'dir' to DIR_EAST. If DIR_EAST were defined using "static const int DIR_EAST = 1", then I would not be able
- * to use the static constant in that initialization because... well, for some reason I don't quite understand.
- * All I know is that the gcc C compiler barfed on that line, so I switched these to be preprocessor macros.  
- *------------------------------------------------------------------------------------------------------------*/
-#define DIR_NORTH 0
-#define DIR_EAST  1
-#define DIR_SOUTH 2
-#define DIR_WEST  3
+#include "opt.h"
+#include "par.h"
+#include "prof.h"
+#include "repeat.h"
+#include "scan.h"
+#include "stamp.h"
+#include "stats.h"
+#include "watch.h"
+#include "world.h"
+#include "cmds_hash.h"  /* Generated by mkcmds. See the Makefile. */
 
 /*--------------------------------------------------------------------------------------------------------------
  * GLOBAL CONSTANT DEFINITIONS
  *------------------------------------------------------------------------------------------------------------*/
-
-/* Define MAX_CMDS as a static int constant and initialize it to 7. */
-static int MAX_CMDS = 9;
+static const int INLINE_WORDS = 16;  /* A procedure whose body is at most this many words is inlined. */
 
 /*--------------------------------------------------------------------------------------------------------------
  * TYPEDEFS
  *
- * This structure type stores a tuple: a string for a command, and a pointer to a function which is to be
- * called in order to perform the command.
- *
- * This code illustrates what is called a "function pointer", or a "pointer to a function." Remember, that a
- * pointer variable contains the address in memory of something. Well, it is possible to define a pointer
- * variable which points to a function, i.e., the pointer variable will contain the address in memory where
- * the code for the function is located. Here is how to define and use a function pointer variable,
- *
- * -- Returns true if x < y, false otherwise.
- * int compare_int(int *x, int *y) {  
- *     return *x < *y;
- * }
- *
- * -- Returns true if person p1's name is lexically less than p2's name.
- * int compare_person(struct person *p1, struct person *p2) {
- *     return strcmp(p1->name, p2->name);
- * }
- *
- * -- Generic bubble sort rountine. Sorts an array containing 'size' elements. 'compare' is a pointer to
- * -- a comparison function. If we are sorting an array of ints then we pass compare_int to bubble_sort().
- * -- If we are sorting an array of struct person, we pass compare_person to bubble_sort().
- * void bubble_sort(void *array, int size, int (*compare)(void *, void *)) {
- *     -- Performs the bubble sort algorithm on 'array'.
- * }
- *
- * int main() {
- *     int A[10];
- *     struct person people[10];                 -- Assume this struct has been defined.
- *     ...                                       -- Assume code is here to fill up the A and people arrays.
- *     bubble_sort(A, 10, compare_int);          -- Sort the int array. Pass compare_int().
- *     bubble_sort(people, 10, compare_person);  -- Sort the struct person array. Pass compare_person().
- *     return 0;
- * }
- *
- * Note that when passing compare_int or compare_person to bubble_sort, we do not have to precede the function
- * name with an & like we would if we were passing an int parameter using "pass-by-pointer". Function names
- * are treated the same as array names, i.e., the name of an array is equivalent to the address in memory of
- * the first element of the array; the name of a function is equivalent to the address in memory of the first
- * instruction of the function. That said, it is syntactically legal to write "&compare_int", but don't do it
- * because the other C programmers will laugh at you.
- *
- * Note the syntax in bubble_sort() for specifying that the third parameter is a function pointer. If we have
- * a function declaration "int f(int, double *)" then the way to define the function pointer variable to f() is:
- *
- *    int (*function_pointer)(int, double *)
- *
- * Weird, I know. It is critial that parentheses surround 'function_pointer', i.e., if you simply write,
- *
- *    int *function_pointer(int, double *)
- *
- * Then this tells the compiler that there is a function named 'function_pointer' which returns a pointer to
- * an int. That's not the same as saying that 'function_pointer' is a pointer to a function which returns an
- * int.
- */
+ * This structure type stores a tuple: a string for a command, the length of the string, and the opcode which the
+ * compiler emits for the command. Each operand which follows the command in the source code file (see cmd_nargs)
+ * becomes one int word in the compiled program, so _myrtle_exec() never has to look at the command string again.
+ *------------------------------------------------------------------------------------------------------------*/
 typedef struct {
-	char *cmd;          /* cmd is a pointer to a string. */
-	void (*perform)();  /* perform is a pointer to a function that performs the command. */
+	char *cmd;          /* cmd is a pointer to a string.     */
+	int   len;          /* strlen(cmd).                      */
+	int   code;         /* The CMD_* opcode for the command. */
 } cmd_t;
 
 /*--------------------------------------------------------------------------------------------------------------
- * This structure type defines the static global variables for this module:
+ * A turtle other than Myrtle, declared by a 'turtle' block: its name, and the compiled commands of every block
+ * with that name, in order.
  *------------------------------------------------------------------------------------------------------------*/
-
 typedef struct {
-	bool  pendown;      /* True if Myrtle's pen is down.                                                      */
-	bool  verbose;      /* If true, the command being performed is sent to the terminal. False by default.    */
-	char  penchar;      /* The char being drawn by the pen. Space char ' ' by default.                        */
-	char  **world;      /* A dynamically-allocated 2D-array of chars which is Myrtle's world.                 */
-	int   line;         /* The line number in the input source file being executed. Starts at 1.              */
-	int   dir;          /* The direction Myrtle is facing. East by default.                                   */
-	int   row;          /* The row in the world where Myrtle is at. Zero by default.                          */
-	int   col;          /* The col in the world where Myrtle is at. Zero by default.                          */
-	cmd_t cmd_table[];  /* The command table.                                                                 */
-} global_t;
+	char   *name;
+	code_t  code;
+} turtle_t;
 
 /*--------------------------------------------------------------------------------------------------------------
- * STATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ * A procedure declared by 'to name': its name, the index in ctx->code of its CMD_TO (its body follows the CMD_TO
+ * and its length), whether its 'end' has been compiled, whether it can be stamped (it has no 'hyper' or 'stop'
+ * and calls only procedures which can be), and its stamps, one for each direction Myrtle may face when called.
  *------------------------------------------------------------------------------------------------------------*/
-static void   _myrtle_cmd_backward();
-static void   _myrtle_cmd_forward();
-static void   _myrtle_cmd_hyper();
-static void   _myrtle_cmd_left();
-static cmd_t *_myrtle_cmd_lookup(char *cmd);
-static void   _myrtle_cmd_penchar();
-static void   _myrtle_cmd_pendown();
-static void   _myrtle_cmd_penup();
-static void   _myrtle_cmd_perform(char *cmd);
-static void   _myrtle_cmd_right();
-static void   _myrtle_cmd_stop();
-
-static int    _myrtle_col_get();
-static void   _myrtle_col_set(int);
-
-static int    _myrtle_line_get();
-static void   _myrtle_line_set(int n);
-static void   _myrtle_line_inc();
-
-static int    _myrtle_dir_get();
-static void   _myrtle_dir_set(int dir);
-
-static void   _myrtle_move(int squares);
-
-static void   _myrtle_pen_down();
-static char   _myrtle_pen_char_get();
-static void   _myrtle_pen_char_set(char ch);
-static bool   _myrtle_pen_is_down();
-static void   _myrtle_pen_up();
+typedef struct {
+	char    *name;
+	int      at;
+	bool     defined;
+	bool     stampable;
+	stamp_t  stamps[4];
+} proc_t;
 
-static int    _myrtle_row_get();
-static void   _myrtle_row_set(int);
+/*--------------------------------------------------------------------------------------------------------------
+ * This structure type holds what used to be the static global variables for this module. There is one per
+ * myrtle_ctx_create(), and every function below takes a pointer to the one it works on, so two contexts never
+ * share anything but the read-only command table.
+ *------------------------------------------------------------------------------------------------------------*/
+struct myrtle_ctx {
+	bool    pendown;    /* True if Myrtle's pen is down.                                                      */
+	FILE   *trace;      /* Verbose mode: the command being performed is sent here. NULL (off) by default.     */
+	char    penchar;    /* The char being drawn by the pen. Space char ' ' by default.                        */
+	coord_t rows;       /* The number of rows in Myrtle's world. MAX_WORLD_ROWS unless set.                   */
+	coord_t cols;       /* The number of cols in Myrtle's world. MAX_WORLD_COLS unless set.                   */
+	int     layout;     /* How the world is stored, one of the WORLD_* layouts. WORLD_AUTO unless set.        */
+	int     jobs;       /* The number of threads a run may be split across. 1 (serial) unless set.            */
+	bool    optimize;   /* True if the compiled program is optimized before it is performed. Off unless set.  */
+	bool    jit;        /* True if the program is run as native code (see jit.c). Off unless set.             */
+	jit_t   native;     /* The native code of the last program run as native code. Kept for the next run.     */
+	bool    cache;      /* True if compiled programs of large scripts are cached (see cache.c). On by default. */
+	const char *cache_dir; /* The directory cache files are kept in, or NULL to keep them next to the scripts. */
+	cache_t cached;     /* The program loaded from a cache file. ctx->code may be a view of its mapping.       */
+	const char *source; /* The name of the input file of the run, or NULL if it is not a named file.          */
+	stats_t *stats;     /* Where the statistics of a run are kept (see stats.c), or NULL (off) by default.    */
+	prof_t *prof;       /* Where the profile of a run is kept (see prof.c), or NULL (off) by default.          */
+	journal_t *journal; /* Where a run is recorded (see journal.c), or NULL (off) by default.                  */
+	journal_pos_t replayed; /* Where the last myrtle_ctx_replay_file() stopped.                               */
+	const char *checkpoint; /* The file a run is checkpointed in (see checkpoint.c), or NULL (off) by default.  */
+	long    every;      /* A checkpoint is taken every this many commands, or never if 0.                     */
+	bool    at_stop;    /* True if a checkpoint is taken after each 'stop'.                                   */
+	volatile sig_atomic_t *signalled; /* Set to a MYRTLE_CHECKPOINT_* by a signal handler, or NULL.            */
+	const char *restore; /* The checkpoint file a run of a file resumes from, or NULL (off) by default.        */
+	checkpoint_t restored; /* The checkpoint the run is resuming from, mapped until the run ends.             */
+	bool    resumable;  /* True if the run is checkpointed or resumed, so ctx->frames are kept.               */
+	checkpoint_frame_t *frames; /* The commands being performed, outermost first (see checkpoint.h).          */
+	long    depth;      /* The number of frames.                                                              */
+	long    frame_cap;  /* The number of frames allocated. Their memory is reused by the next run.            */
+	long    resume;     /* The number of frames of a restored run not yet entered again, or 0.                */
+	long    performed;  /* The number of commands performed, counted as -V lists them.                        */
+	long    last_checkpoint; /* ctx->performed when the last checkpoint was taken or restored.                */
+	bool    checkpoint_due; /* True if a checkpoint is to be taken before the next command.                   */
+	unsigned long program; /* checkpoint_hash() of ctx->code, which checkpoints are taken of.                 */
+	watch_t *watch;     /* What a watched run keeps for the next (see watch.c), or NULL (off) by default.     */
+	world_t world;      /* Myrtle's world. Kept after a run, until the next run or myrtle_ctx_destroy().       */
+	file_t  file;       /* The input and output of the run.                                                   */
+	code_t  code;       /* The compiled program. Its memory is reused by the next run.                        */
+	code_t  scratch;    /* Where the optimizer builds the optimized program before it is swapped with 'code'. */
+	long    commands;   /* The number of commands the optimizer was given in the last run. 0 if it was off.  */
+	long    removed;    /* The number of those commands it removed.                                           */
+	turtle_t *turtles;  /* The turtles declared by the program, in the order they were first declared.        */
+	int     turtle_count; /* The number of turtles declared by the program.                                   */
+	int     turtle_cap; /* The number of turtles allocated. Their code is reused by the next run.             */
+	int     block;      /* The turtle whose block is being compiled, or -1 while compiling Myrtle's commands. */
+	proc_t *procs;      /* The procedures declared by the program, in the order they were declared.           */
+	int     proc_count; /* The number of procedures declared by the program.                                  */
+	int     proc_cap;   /* The number of procedures allocated. Their stamps' memory is reused by the next run. */
+	int     proc;       /* The procedure whose body is being compiled, or -1.                                 */
+	int     calls;      /* The number of calls compiled which were not inlined.                               */
+	stamp_t *recording; /* The stamp being recorded while a procedure is performed, or NULL.                  */
+	int     repeat;     /* The index in ctx->code of the innermost open 'repeat' being compiled, or -1.      */
+	int     repeats;    /* The number of 'repeat' blocks in the program.                                      */
+	int     line;       /* The source line of the command being compiled. Starts at 1.                        */
+	int     dir;        /* The direction Myrtle is facing. East by default.                                   */
+	coord_t row;        /* The row in the world where Myrtle is at. Zero by default.                          */
+	coord_t col;        /* The col in the world where Myrtle is at. Zero by default.                          */
+	int     status;     /* TERM_NORM, or the TERM_ERR_* code of the error which ended the last run.           */
+	char    error[160]; /* The message for 'status'.                                                          */
+};
 
-static void   _myrtle_world_clear();
-static void   _myrtle_world_draw_char();
-static void   _myrtle_world_init();
-static void   _myrtle_world_write();
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+static int    _myrtle_arg_next(myrtle_ctx_t *ctx, const cmd_t *command, int *arg);
+static int    _myrtle_block_begin(myrtle_ctx_t *ctx, const cmd_t *command);
+static int    _myrtle_block_end(myrtle_ctx_t *ctx);
+
+static bool   _myrtle_cache_load(myrtle_ctx_t *ctx);
+static void   _myrtle_cache_save(myrtle_ctx_t *ctx);
+
+static int    _myrtle_checkpoint(myrtle_ctx_t *ctx, int *cmd);
+static int    _myrtle_checkpoint_save(myrtle_ctx_t *ctx);
+static int    _myrtle_checkpoint_start(myrtle_ctx_t *ctx);
+
+static int    _myrtle_cmd_backward(myrtle_ctx_t *ctx, int squares);
+static int    _myrtle_cmd_call(myrtle_ctx_t *ctx, int *pc);
+static int    _myrtle_cmd_forward(myrtle_ctx_t *ctx, int squares);
+static int    _myrtle_cmd_hyper(myrtle_ctx_t *ctx, int row, int col);
+static void   _myrtle_cmd_left(myrtle_ctx_t *ctx);
+static const cmd_t *_myrtle_cmd_lookup(char *cmd, int len);
+static char  *_myrtle_cmd_name(int code);
+static void   _myrtle_cmd_penchar(myrtle_ctx_t *ctx, char ch);
+static void   _myrtle_cmd_pendown(myrtle_ctx_t *ctx);
+static void   _myrtle_cmd_penup(myrtle_ctx_t *ctx);
+static int    _myrtle_cmd_repeat(myrtle_ctx_t *ctx, int *pc);
+static void   _myrtle_cmd_right(myrtle_ctx_t *ctx);
+static int    _myrtle_cmd_stop(myrtle_ctx_t *ctx);
+
+static code_t *_myrtle_code(myrtle_ctx_t *ctx);
+static int    _myrtle_compile(myrtle_ctx_t *ctx);
+static int    _myrtle_exec(myrtle_ctx_t *ctx, int *pc, int *end);
+static int    _myrtle_exec_jit(myrtle_ctx_t *ctx);
+static int    _myrtle_exec_par(myrtle_ctx_t *ctx);
+static int    _myrtle_exec_turtles(myrtle_ctx_t *ctx);
+static int    _myrtle_exec_watch(myrtle_ctx_t *ctx);
+
+static coord_t _myrtle_col_get(myrtle_ctx_t *ctx);
+static void   _myrtle_col_set(myrtle_ctx_t *ctx, coord_t col);
+
+static int    _myrtle_line_get(myrtle_ctx_t *ctx);
+static void   _myrtle_line_set(myrtle_ctx_t *ctx, int n);
+
+static int    _myrtle_dir_get(myrtle_ctx_t *ctx);
+static void   _myrtle_dir_set(myrtle_ctx_t *ctx, int dir);
+
+static int    _myrtle_fail(myrtle_ctx_t *ctx, int status, const char *msg);
+static int    _myrtle_fill(myrtle_ctx_t *ctx, bool vert, coord_t line, coord_t first, coord_t count, char ch);
+static int    _myrtle_frame_enter(myrtle_ctx_t *ctx, int **pc);
+
+static int    _myrtle_hook_jit_stop(void *arg);
+static int    _myrtle_hook_stop(void *arg, int stream);
+static void   _myrtle_hook_trace(void *arg, int stream, int op);
+
+static bool   _myrtle_jit_ok(myrtle_ctx_t *ctx);
+static void   _myrtle_journal_command(myrtle_ctx_t *ctx, int op);
+static int    _myrtle_load(myrtle_ctx_t *ctx);
+
+static int    _myrtle_move(myrtle_ctx_t *ctx, int squares);
+static int    _myrtle_operand_next(myrtle_ctx_t *ctx, const cmd_t *command, token_t *token);
+static int    _myrtle_optimize(myrtle_ctx_t *ctx);
+
+static char   _myrtle_pen_char_get(myrtle_ctx_t *ctx);
+static void   _myrtle_pen_char_set(myrtle_ctx_t *ctx, char ch);
+static bool   _myrtle_pen_is_down(myrtle_ctx_t *ctx);
+static int    _myrtle_perform(myrtle_ctx_t *ctx);
+
+static int    _myrtle_proc_at(myrtle_ctx_t *ctx, int at);
+static int    _myrtle_proc_begin(myrtle_ctx_t *ctx, const cmd_t *command);
+static int    _myrtle_proc_call(myrtle_ctx_t *ctx, const cmd_t *command, token_t *token);
+static int    _myrtle_proc_end(myrtle_ctx_t *ctx);
+static int    _myrtle_proc_exec(myrtle_ctx_t *ctx, int *site, int *body, int *end);
+static int    _myrtle_proc_find(myrtle_ctx_t *ctx, const char *name, int len);
+static void   _myrtle_procs_clear(myrtle_ctx_t *ctx);
+
+static int    _myrtle_repeat_begin(myrtle_ctx_t *ctx, const cmd_t *command);
+static int    _myrtle_repeat_end(myrtle_ctx_t *ctx);
+static int    _myrtle_restore(myrtle_ctx_t *ctx);
+
+static coord_t _myrtle_row_get(myrtle_ctx_t *ctx);
+static void   _myrtle_row_set(myrtle_ctx_t *ctx, coord_t row);
+
+static int    _myrtle_run(myrtle_ctx_t *ctx);
+
+#ifndef MYRTLE_NO_STATS
+static void   _myrtle_stats_end(myrtle_ctx_t *ctx);
+static void   _myrtle_stats_program(myrtle_ctx_t *ctx);
+#endif
+
+static void   _myrtle_trace(myrtle_ctx_t *ctx, int *pc, int *end);
+static void   _myrtle_turtle_get(myrtle_ctx_t *ctx, par_turtle_t *turtle);
+static void   _myrtle_turtle_set(myrtle_ctx_t *ctx, const par_turtle_t *turtle);
+static void   _myrtle_turtles_clear(myrtle_ctx_t *ctx);
+
+static int    _myrtle_watch_compile(myrtle_ctx_t *ctx);
+static int    _myrtle_watch_loc(myrtle_ctx_t *ctx, const token_t *token);
+static int    _myrtle_watch_start(myrtle_ctx_t *ctx);
+
+static int    _myrtle_world_draw_char(myrtle_ctx_t *ctx);
+static int    _myrtle_world_status(myrtle_ctx_t *ctx, int status);
+static int    _myrtle_world_write(myrtle_ctx_t *ctx);
 
 /*--------------------------------------------------------------------------------------------------------------
  * GLOBAL VARIABLE DEFINITIONS
@@ -186,142 +297,704 @@ static void   _myrtle_world_write();
  *
  * I STRONGLY suggest if you use global variables, that you define them as static in a source code file and
  * provide accessor/mutator functions to read/write them.
+ *
+ * The only one left is the command table, indexed by CMD_* opcode. It is const, so every context can share it.
  *------------------------------------------------------------------------------------------------------------*/
-static global_t globals = {
-		false,
-		false,
-		' ',
-		NULL,
-		1,
-		DIR_EAST,
-		0,
-		0,
-		{
-				{ "backward", _myrtle_cmd_backward },
-				{ "forward",  _myrtle_cmd_forward  },
-				{ "hyper",    _myrtle_cmd_hyper    },
-				{ "left",     _myrtle_cmd_left     },
-				{ "penchar",  _myrtle_cmd_penchar  },
-				{ "pendown",  _myrtle_cmd_pendown  },
-				{ "penup",    _myrtle_cmd_penup    },
-				{ "right",    _myrtle_cmd_right    },
-				{ "stop",	  _myrtle_cmd_stop     }
-		}
+static const cmd_t cmd_table[] = {
+#define MYRTLE_CMD(name, str, nargs, usage, help) { str, sizeof(str) - 1, CMD_##name },
+#include "cmds.def"
+#undef MYRTLE_CMD
+};
+
+/*--------------------------------------------------------------------------------------------------------------
+ * GLOBAL CONSTANT DEFINITIONS
+ *
+ * The names and operand counts of the commands, indexed by CMD_* opcode, for every module which walks a compiled
+ * program (see myrtle.h). They are the only copies; no other file builds its own from cmds.def.
+ *------------------------------------------------------------------------------------------------------------*/
+const char *const cmd_names[CMD_COUNT] = {
+#define MYRTLE_CMD(name, str, nargs, usage, help) str,
+#include "cmds.def"
+#undef MYRTLE_CMD
+};
+
+const int cmd_nargs[CMD_COUNT] = {
+#define MYRTLE_CMD(name, str, nargs, usage, help) nargs,
+#include "cmds.def"
+#undef MYRTLE_CMD
 };
 
 /*===================================== NONSTATIC FUNCTION DEFINITIONS =======================================*/
 
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: myrtle_interp()
- * DESCR:    Implements the interpreter for the Myrtle programming language.
- * RETURNS:  An int: zero on success, a negative integer on failure.
- * PSEUDOCODE:
- * 1. Call file_open_files() to open the input and output files. Note that by the time we reach this function
- *    the command line has been parsed and the name(s) of the input and output files are stored in the globals
- *    variable of the "file" module.
- * 2. Call the appropriate function in this source code file to initialize Myrtle's world.
- * 3. Write a for loop which initializes globals.line to 1 by calling the _myrtle_line_set() mutator function;
- *    the condition is "true" (we break out of this loop when file_next_token() returns NULL; the post-loop
- *    expression is to increment the line number by calling _myrtle_line_inc().
- *    a. Call file_next_token() to get a char pointer named 'cmd' to the next token in the source code file.
- *    b. If 'cmd' is NULL (i.e., we reached the end of the input file) then break out of this loop.
- *    c. If the verbose flag is set, then call fprintf(stdout, "Performing command: %s\n", cmd).
- *    d. Call _myrtle_cmd_perform() and pass 'cmd' as the parameter.
- * 4. Call the appropriate function in this source code file to write Myrtle's world to the output file.
- * 5. Call file_close_files() to close the input and output files.
- * 6. Return 0.
+ * FUNCTION: myrtle_ctx_cache_set()
+ * DESCR:    Mutator function for ctx->cache and ctx->cache_dir. When caching is on, a script run from a file
+ *           which is at least CACHE_MIN_SIZE bytes has its compiled program saved in a cache file, in the
+ *           directory 'dir', or next to the script if 'dir' is NULL, and the next run of the script maps that
+ *           file and performs the program from it instead of compiling the script again (see cache.c). 'dir' is
+ *           not copied, so it must outlive 'ctx'. Programs with turtle blocks are not cached.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void myrtle_ctx_cache_set(myrtle_ctx_t *ctx, bool cache, const char *dir) {
+	ctx->cache     = cache;
+	ctx->cache_dir = dir;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: myrtle_ctx_checkpoint_set()
+ * DESCR:    Mutator function for ctx->checkpoint, ctx->every, ctx->at_stop and ctx->signalled. When 'fname' is
+ *           set, each run writes checkpoints to the file 'fname', from which a later run can resume (see
+ *           myrtle_ctx_restore_set() and checkpoint.c): one every 'every' commands if it is more than 0, one after
+ *           each 'stop' if 'at_stop' is true, and one whenever a signal handler sets *signalled, if it is not
+ *           NULL, to MYRTLE_CHECKPOINT_GO, or to MYRTLE_CHECKPOINT_STOP to end the run with TERM_ERR_STOPPED once
+ *           it is taken. Each checkpoint replaces the last. A checkpointed run is interpreted and its procedures
+ *           are not stamped, so native code and jobs are ignored, and a program with turtle blocks cannot be
+ *           checkpointed, nor can a recorded run. 'fname' is not copied. A NULL 'fname' turns checkpoints off.
+ *           They are not kept by clones.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void myrtle_ctx_checkpoint_set(myrtle_ctx_t *ctx, const char *fname, long every, bool at_stop,
+                               volatile sig_atomic_t *signalled) {
+	ctx->checkpoint = fname;
+	ctx->every      = every > 0 ? every : 0;
+	ctx->at_stop    = at_stop;
+	ctx->signalled  = signalled;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: myrtle_ctx_clone()
+ * DESCR:    Creates an interpreter context with the same options as 'ctx': world size and layout, verbose mode,
+ *           jobs, optimization, native code and caching. Nothing else is shared, so the two can run at the same
+ *           time.
+ * RETURNS:  The context, or NULL if it cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+myrtle_ctx_t *myrtle_ctx_clone(myrtle_ctx_t *ctx) {
+	myrtle_ctx_t *clone = myrtle_ctx_create();
+	if (!clone) return NULL;
+	clone->trace     = ctx->trace;
+	clone->rows      = ctx->rows;
+	clone->cols      = ctx->cols;
+	clone->layout    = ctx->layout;
+	clone->jobs      = ctx->jobs;
+	clone->optimize  = ctx->optimize;
+	clone->jit       = ctx->jit;
+	clone->cache     = ctx->cache;
+	clone->cache_dir = ctx->cache_dir;
+	return clone;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: myrtle_ctx_create()
+ * DESCR:    Creates an interpreter context with the default options: a MAX_WORLD_ROWS x MAX_WORLD_COLS world in
+ *           the WORLD_AUTO layout, verbose mode off, one job and no optimization.
+ * RETURNS:  The context, or NULL if it cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+myrtle_ctx_t *myrtle_ctx_create() {
+	myrtle_ctx_t *ctx = (myrtle_ctx_t *)calloc(1, sizeof(myrtle_ctx_t));
+	if (!ctx) return NULL;
+	ctx->rows   = MAX_WORLD_ROWS;
+	ctx->cols   = MAX_WORLD_COLS;
+	ctx->layout = WORLD_AUTO;
+	ctx->jobs   = 1;
+	ctx->cache  = true;
+	ctx->replayed.op = -1;
+	file_init(&ctx->file);
+	code_init(&ctx->code);
+	code_init(&ctx->scratch);
+	jit_init(&ctx->native);
+	cache_init(&ctx->cached);
+	checkpoint_init(&ctx->restored);
+	return ctx;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: myrtle_ctx_destroy()
+ * DESCR:    Frees 'ctx' and everything in it: the world, the output of the last run and the compiled program,
+ *           turtles, procedures, native code and checkpoint frames.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void myrtle_ctx_destroy(myrtle_ctx_t *ctx) {
+	int i;
+	if (!ctx) return;
+	world_free(&ctx->world);
+	file_free(&ctx->file);
+	code_free(&ctx->code);
+	code_free(&ctx->scratch);
+	jit_free(&ctx->native);
+	cache_free(&ctx->cached);
+	checkpoint_free(&ctx->restored);
+	free(ctx->frames);
+	_myrtle_turtles_clear(ctx);
+	for (i = 0; i < ctx->turtle_cap; i++) code_free(&ctx->turtles[i].code);
+	free(ctx->turtles);
+	_myrtle_procs_clear(ctx);
+	for (i = 0; i < ctx->proc_cap * 4; i++) stamp_free(&ctx->procs[i / 4].stamps[i % 4]);
+	free(ctx->procs);
+	free(ctx);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: myrtle_ctx_error()
+ * DESCR:    Accessor function for the message of the error which ended the last run.
+ * RETURNS:  The message, e.g. "Unknown command 'fd' on line 3". The empty string if the run succeeded.
+ *------------------------------------------------------------------------------------------------------------*/
+const char *myrtle_ctx_error(myrtle_ctx_t *ctx) {
+	return ctx->error;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: myrtle_ctx_jit_set()
+ * DESCR:    Mutator function for ctx->jit. When it is on, each program is compiled to native code and the native
+ *           code is run instead of performing the commands one by one (see jit.c). The output is the same. The
+ *           interpreter is used as before when the machine is not x86-64, in verbose mode, for programs with
+ *           turtle blocks, and for worlds which are not stored dense. Compiling takes longer than performing
+ *           the program once, so this only pays when the same program is run again in 'ctx', which reuses the
+ *           native code (see jitbench.c). myrtle itself does not turn it on.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void myrtle_ctx_jit_set(myrtle_ctx_t *ctx, bool jit) {
+	ctx->jit = jit;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: myrtle_ctx_jobs_set()
+ * DESCR:    Mutator function for ctx->jobs. With more than one job, each long stretch of commands between one
+ *           'stop' and the next is split across up to 'jobs' threads (see par.c), and so are the turtles of a
+ *           program with turtle blocks. The output is the same.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void myrtle_ctx_jobs_set(myrtle_ctx_t *ctx, int jobs) {
+	ctx->jobs = jobs > 1 ? jobs : 1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: myrtle_ctx_journal_set()
+ * DESCR:    Mutator function for ctx->journal. When it is set, the next run is recorded in it, command by command,
+ *           as a trace which myrtle_ctx_replay_file() can replay (see journal.c). 'journal' must have been opened
+ *           with journal_open() and must outlive the run. A recorded run is interpreted and its procedures are not
+ *           stamped, so native code and jobs are ignored, and a program with turtle blocks cannot be recorded. A
+ *           NULL 'journal' turns recording off. It is not kept by clones.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void myrtle_ctx_journal_set(myrtle_ctx_t *ctx, journal_t *journal) {
+	ctx->journal = journal;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: myrtle_ctx_output()
+ * DESCR:    Accessor function for the output of the last myrtle_ctx_run(): each world written by 'stop' and the
+ *           final world, one line per row.
+ * RETURNS:  The output, which is NOT null-terminated, and its length in *len. It belongs to 'ctx' and is valid
+ *           until the next run.
+ *------------------------------------------------------------------------------------------------------------*/
+char *myrtle_ctx_output(myrtle_ctx_t *ctx, size_t *len) {
+	return file_mem(&ctx->file, len);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: myrtle_ctx_optimize_set()
+ * DESCR:    Mutator function for ctx->optimize. When it is on, each program is optimized after it is compiled and
+ *           before it is performed (see opt.c). The output is the same, but verbose mode shows the commands of
+ *           the optimized program. Programs with turtle blocks are never optimized.
+ * RETURNS:  Nothing.
  *------------------------------------------------------------------------------------------------------------*/
-int myrtle_interp() {
+void myrtle_ctx_optimize_set(myrtle_ctx_t *ctx, bool optimize) {
+	ctx->optimize = optimize;
+}
 
-	char *cmd;
-	/*
-	 * 1. Call file_open_files() to open the input and output files. Note that by the time we reach this function
-	 *    the command line has been parsed and the name(s) of the input and output files are stored in the globals
-	 *    variable of the "file" module.
-	 *    Currently, this is probably not correct*/
-	file_open_files();
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: myrtle_ctx_prof_set()
+ * DESCR:    Mutator function for ctx->prof. Each run is then profiled into *prof (see prof.c), which is reset when
+ *           the run starts and must outlive it; the profile can be written with prof_write() until the next run.
+ *           A profiled run is always interpreted, so optimization, caching, native code and jobs are ignored. A
+ *           NULL 'prof' turns profiling off. It is not kept by clones. Time is sampled by a timer which belongs to
+ *           the process, so only one run at a time can be timed: a run which starts while another context's run
+ *           is being profiled counts its squares, takes no samples, and its profile is marked incomplete
+ *           (prof->ok is false) rather than taking the timer away.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void myrtle_ctx_prof_set(myrtle_ctx_t *ctx, prof_t *prof) {
+	ctx->prof = prof;
+}
 
-	/* 2. Call the appropriate function in this source code file to initialize Myrtle's world. */
-	_myrtle_world_init();
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: myrtle_ctx_removed()
+ * DESCR:    Accessor function for what the optimizer did in the last run. If 'commands' is not NULL, *commands is
+ *           the number of commands it was given, which is zero if it was not run.
+ * RETURNS:  The number of commands the optimizer removed.
+ *------------------------------------------------------------------------------------------------------------*/
+long myrtle_ctx_removed(myrtle_ctx_t *ctx, long *commands) {
+	if (commands) *commands = ctx->commands;
+	return ctx->removed;
+}
 
-	/*  3. Write a for loop which initializes globals.line to 1 by calling the _myrtle_line_set() mutator function;
-	 *    the condition is "true" (we break out of this loop when file_next_token() returns NULL; the post-loop
-	 *    expression is to increment the line number by calling _myrtle_line_inc().
-	 *    a. Call file_next_token() to get a char pointer named 'cmd' to the next token in the source code file.
-	 *    b. If 'cmd' is NULL (i.e., we reached the end of the input file) then break out of this loop.
-	 *    c. If the verbose flag is set, then call fprintf(stdout, "Performing command: %s\n", cmd).
-	 *    d. Call _myrtle_cmd_perform() and pass 'cmd' as the parameter.*/
-	for((_myrtle_line_set(1)); (cmd=file_next_token()); _myrtle_line_inc() ){
-		/*cmd = file_next_token();*/
-		if(cmd==NULL) break;
-		if(globals.verbose) fprintf(stdout, "Performing command: %s\n", cmd);
-		_myrtle_cmd_perform(cmd);
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: myrtle_ctx_replay_file()
+ * DESCR:    Rebuilds Myrtle's world as it was after the first 'at' commands of the run recorded in the trace file
+ *           'trace_fname', without the program, and writes it to the file 'out_fname' as a run would. A NULL or
+ *           empty 'out_fname' means stdout. The world takes its size from the trace and its layout from 'ctx',
+ *           and Myrtle is left in the state she was in; myrtle_ctx_replayed() says where the replay stopped.
+ * RETURNS:  TERM_NORM, or a negative TERM_ERR_* code. myrtle_ctx_error() says what went wrong.
+ *------------------------------------------------------------------------------------------------------------*/
+int myrtle_ctx_replay_file(myrtle_ctx_t *ctx, const char *trace_fname, long at, const char *out_fname) {
+	int status;
+	ctx->status   = TERM_NORM;
+	ctx->error[0] = '\0';
+	file_open_in_buf(&ctx->file, "", 0);
+	if (file_open_out(&ctx->file, out_fname) != TERM_NORM) {
+		file_close(&ctx->file);
+		return _myrtle_fail(ctx, ctx->file.status, ctx->file.error);
+	}
+	status = journal_replay(trace_fname, at, &ctx->world, ctx->layout, &ctx->replayed, ctx->error);
+	if (status == TERM_NORM) {
+		_myrtle_turtle_set(ctx, &ctx->replayed.turtle);
+		status = _myrtle_world_write(ctx);
+	} else {
+		ctx->status = status;
 	}
+	if (file_close(&ctx->file) != TERM_NORM && status == TERM_NORM) {
+		status = _myrtle_fail(ctx, ctx->file.status, ctx->file.error);
+	}
+	return status;
+}
 
-	/*  4. Call the appropriate function in this source code file to write Myrtle's world to the output file.*/
-	_myrtle_world_write();
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: myrtle_ctx_replayed()
+ * DESCR:    Accessor function for where the last myrtle_ctx_replay_file() stopped. If 'total' is not NULL, *total
+ *           is the number of commands in the trace, or -1 if it was cut short. If 'last' is not NULL, *last is the
+ *           last command replayed, or NULL if none was.
+ * RETURNS:  The number of commands replayed.
+ *------------------------------------------------------------------------------------------------------------*/
+long myrtle_ctx_replayed(myrtle_ctx_t *ctx, long *total, const char **last) {
+	if (total) *total = ctx->replayed.total;
+	if (last) *last = ctx->replayed.op >= 0 ? _myrtle_cmd_name(ctx->replayed.op) : NULL;
+	return ctx->replayed.index;
+}
 
-	/* 5. Call file_close_files() to close the input and output files.*/
-	file_close_files();
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: myrtle_ctx_restore_set()
+ * DESCR:    Mutator function for ctx->restore. When it is set, each myrtle_ctx_run_file() resumes from the
+ *           checkpoint file 'fname' (see myrtle_ctx_checkpoint_set()) instead of starting over: the world takes
+ *           its size from the checkpoint, Myrtle and her world are as they were when it was taken, and the output
+ *           file is cut back to what had been written by then and written on from there. The program must be the
+ *           one the checkpoint was taken of, compiled with the same options. A resumed run is interpreted as a
+ *           checkpointed one is. 'fname' is not copied. A NULL 'fname' turns resuming off. It is not kept by
+ *           clones.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void myrtle_ctx_restore_set(myrtle_ctx_t *ctx, const char *fname) {
+	ctx->restore = fname;
+}
 
-	/* 6. Return 0.*/
-	return 0;
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: myrtle_ctx_run()
+ * DESCR:    Runs the Myrtle program in the 'len' chars at 'src', which need not be null-terminated. The output
+ *           goes to memory, where myrtle_ctx_output() finds it.
+ * RETURNS:  TERM_NORM, or a negative TERM_ERR_* code. myrtle_ctx_error() says what went wrong.
+ *------------------------------------------------------------------------------------------------------------*/
+int myrtle_ctx_run(myrtle_ctx_t *ctx, const char *src, size_t len) {
+	ctx->source = NULL;
+	file_open_in_buf(&ctx->file, src, len);
+	file_open_out_mem(&ctx->file);
+	return _myrtle_run(ctx);
 }
 
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: myrtle_verbose_get()
- * DESCR:    Accessor function for globals.verbose.
- * RETURNS:  The value of globals.verbose which is a bool.
+ * FUNCTION: myrtle_ctx_run_file()
+ * DESCR:    Runs the Myrtle program in the file 'in_fname' and writes the output to the file 'out_fname'. A NULL
+ *           or empty name means stdin or stdout. If ctx->restore is set, the run resumes from that checkpoint.
+ *           A watched run keeps what is in the output file until it knows where it resumes from.
+ * RETURNS:  TERM_NORM, or a negative TERM_ERR_* code. myrtle_ctx_error() says what went wrong.
  *------------------------------------------------------------------------------------------------------------*/
-bool myrtle_verbose_get() {
-	return globals.verbose;
+int myrtle_ctx_run_file(myrtle_ctx_t *ctx, const char *in_fname, const char *out_fname) {
+	char err[160];
+	int  status;
+	ctx->source = in_fname;
+	if (ctx->restore && checkpoint_load(&ctx->restored, ctx->restore, err) != TERM_NORM) {
+		ctx->status = TERM_NORM;
+		return _myrtle_fail(ctx, TERM_ERR_INPUT, err);
+	}
+	if (file_open_in(&ctx->file, in_fname) == TERM_NORM) {
+		if (ctx->restored.map) file_open_out_at(&ctx->file, out_fname, ctx->restored.output);
+		else if (ctx->watch) file_open_out_end(&ctx->file, out_fname);
+		else file_open_out(&ctx->file, out_fname);
+	}
+	if (ctx->file.status != TERM_NORM) {
+		file_close(&ctx->file);
+		checkpoint_free(&ctx->restored);
+		return _myrtle_fail(ctx, ctx->file.status, ctx->file.error);
+	}
+	status = _myrtle_run(ctx);
+	checkpoint_free(&ctx->restored);
+	if (file_close(&ctx->file) != TERM_NORM && status == TERM_NORM) {
+		status = _myrtle_fail(ctx, ctx->file.status, ctx->file.error);
+	}
+	return status;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: myrtle_verbose_set()
- * DESCR:    Mutator function for globals.verbose.
+ * FUNCTION: myrtle_ctx_stats_set()
+ * DESCR:    Mutator function for ctx->stats. Each run then keeps its statistics in *stats, which is reset when the
+ *           run starts and must outlive it. A NULL 'stats' turns the statistics off. They are not kept by clones.
+ * RETURNS:  True, or false if the interpreter was built without statistics (make STATS=0) and 'stats' is not
+ *           NULL, in which case they stay off.
+ *------------------------------------------------------------------------------------------------------------*/
+bool myrtle_ctx_stats_set(myrtle_ctx_t *ctx, stats_t *stats) {
+	if (!STATS_ENABLED && stats) return false;
+	ctx->stats = stats;
+	return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: myrtle_ctx_status()
+ * DESCR:    Accessor function for ctx->status.
+ * RETURNS:  TERM_NORM if the last run succeeded, or the TERM_ERR_* code of the error which ended it.
+ *------------------------------------------------------------------------------------------------------------*/
+int myrtle_ctx_status(myrtle_ctx_t *ctx) {
+	return ctx->status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: myrtle_ctx_verbose_set()
+ * DESCR:    Turns on verbose mode, in which each command is written to 'trace' as it is performed. A NULL 'trace'
+ *           turns verbose mode off.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void myrtle_ctx_verbose_set(myrtle_ctx_t *ctx, FILE *trace) {
+	ctx->trace = trace;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: myrtle_ctx_watch_set()
+ * DESCR:    Mutator function for ctx->watch. When it is set, each run of a file keeps marks of its state in
+ *           'watch', and the next run of the file, once it has changed, compiles and performs it again only from
+ *           the last mark before the first command which changed (see watch.c). The output must be a file for a
+ *           run to resume; it is cut back to what had been written by then. 'watch' must have been initialized
+ *           with watch_init(), must outlive the runs and is for the runs of one file with the same options. A
+ *           watched run is interpreted, without optimization, jobs, native code or the cache, and cannot be
+ *           profiled, recorded or checkpointed. A program with turtle blocks is always run from the beginning. A
+ *           NULL 'watch' turns watching off. It is not kept by clones.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void myrtle_ctx_watch_set(myrtle_ctx_t *ctx, watch_t *watch) {
+	ctx->watch = watch;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: myrtle_ctx_world()
+ * DESCR:    Accessor function for Myrtle's world, e.g. for world_get(). After a run it holds the final world.
+ * RETURNS:  The world. It belongs to 'ctx' and is valid until the next run.
+ *------------------------------------------------------------------------------------------------------------*/
+world_t *myrtle_ctx_world(myrtle_ctx_t *ctx) {
+	return &ctx->world;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: myrtle_ctx_world_layout_set()
+ * DESCR:    Mutator function for ctx->layout. 'layout' is one of the WORLD_* layouts in world.h.
  * RETURNS:  Nothing.
  *------------------------------------------------------------------------------------------------------------*/
-void myrtle_verbose_set(bool flag) {
-	globals.verbose = flag;
+void myrtle_ctx_world_layout_set(myrtle_ctx_t *ctx, int layout) {
+	ctx->layout = layout;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: myrtle_ctx_world_size_set()
+ * DESCR:    Sets the size of Myrtle's world. A 'rows' or 'cols' of zero leaves that dimension as it is.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void myrtle_ctx_world_size_set(myrtle_ctx_t *ctx, coord_t rows, coord_t cols) {
+	if (rows > 0) ctx->rows = rows;
+	if (cols > 0) ctx->cols = cols;
 }
 
 /*======================================= STATIC FUNCTION DEFINITIONS ========================================*/
 
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: _myrtle_cmd_backward()
- * DESCR:    Performs the 'backward' command. There should be an integer following the word 'backward' in the
- *           statement. This is the number of squares to move backward. Note: if Myrtle reaches one of the edges
- *           of her world, then she stops there and does not move, lest she fall off since everyone knows the
- *           world is flat. Function is analogous to _myrtle_cmd_forward().
+ * FUNCTION: _myrtle_arg_next()
+ * DESCR:    Reads the next operand of 'command' from the input file and converts it into the int word which is
+ *           stored in the compiled program, in *arg. The operand of 'penchar' is the first char of the token;
+ *           every other operand was already converted by the scanner, with the same result as atoi().
+ * RETURNS:  TERM_NORM, TERM_ERR_SYNTAX if the input file ends before the operand, or the status of the input
+ *           file if it cannot be read.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_arg_next(myrtle_ctx_t *ctx, const cmd_t *command, int *arg) {
+	token_t token;
+	if (_myrtle_operand_next(ctx, command, &token) != TERM_NORM) return ctx->status;
+	*arg = (command->code == CMD_PENCHAR) ? token.text[0] : token.value;
+	return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_block_begin()
+ * DESCR:    Compiles 'turtle name', which starts a turtle block. The commands up to the matching 'end' are
+ *           compiled into the code of the turtle 'name', which is declared the first time it is named. Another
+ *           block with the same name adds to the same turtle's commands. Blocks cannot be nested, nor used in a
+ *           program with 'repeat' blocks or procedures.
+ * RETURNS:  TERM_NORM, TERM_ERR_SYNTAX if the block is inside another, has no name or follows a 'repeat' or 'to',
+ *           TERM_ERR_MEMORY if the turtle cannot be allocated, or the status of the input file if it cannot be
+ *           read.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_block_begin(myrtle_ctx_t *ctx, const cmd_t *command) {
+	token_t token;
+	char    buffer[128];
+	int     i;
+
+	if (ctx->block >= 0) {
+		sprintf(buffer, "Turtle blocks cannot be nested on line %d", _myrtle_line_get(ctx));
+		return _myrtle_fail(ctx, TERM_ERR_SYNTAX, buffer);
+	}
+	if (ctx->repeats > 0 || ctx->proc_count > 0) {
+		sprintf(buffer, "Turtle blocks cannot be used with '%s' on line %d", ctx->repeats ? "repeat" : "to",
+			_myrtle_line_get(ctx));
+		return _myrtle_fail(ctx, TERM_ERR_SYNTAX, buffer);
+	}
+	if (_myrtle_operand_next(ctx, command, &token) != TERM_NORM) return ctx->status;
+
+	for (i = 0; i < ctx->turtle_count; i++) {
+		turtle_t *t = &ctx->turtles[i];
+		if ((int)strlen(t->name) == token.len && !memcmp(t->name, token.text, token.len)) break;
+	}
+	if (i == ctx->turtle_count) {
+		if (ctx->turtle_count == ctx->turtle_cap) {
+			int       cap     = ctx->turtle_cap ? ctx->turtle_cap * 2 : 4;
+			turtle_t *turtles = (turtle_t *)realloc(ctx->turtles, cap * sizeof(turtle_t));
+			if (!turtles) return _myrtle_fail(ctx, TERM_ERR_MEMORY, "Out of memory compiling program");
+			ctx->turtles = turtles;
+			for (; ctx->turtle_cap < cap; ctx->turtle_cap++) code_init(&ctx->turtles[ctx->turtle_cap].code);
+		}
+		ctx->turtles[i].name = (char *)malloc(token.len + 1);
+		if (!ctx->turtles[i].name) return _myrtle_fail(ctx, TERM_ERR_MEMORY, "Out of memory compiling program");
+		memcpy(ctx->turtles[i].name, token.text, token.len);
+		ctx->turtles[i].name[token.len] = '\0';
+		ctx->turtles[i].code.count = 0;
+		ctx->turtle_count++;
+	}
+	ctx->block = i;
+	return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_block_end()
+ * DESCR:    Compiles 'end', which ends a turtle block. The commands which follow are Myrtle's again.
+ * RETURNS:  TERM_NORM, or TERM_ERR_SYNTAX if there is no block to end.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_block_end(myrtle_ctx_t *ctx) {
+	char buffer[128];
+	if (ctx->block < 0) {
+		sprintf(buffer, "Unexpected 'end' on line %d", _myrtle_line_get(ctx));
+		return _myrtle_fail(ctx, TERM_ERR_SYNTAX, buffer);
+	}
+	ctx->block = -1;
+	return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_cache_load()
+ * DESCR:    Step 3 of _myrtle_run() when the input file has been cached: loads the compiled program and its
+ *           procedures from the cache file (see cache.c) instead of compiling the file. ctx->code becomes a view
+ *           of the program in the mapped file, so it is performed from there without being copied.
+ * RETURNS:  True if the program was loaded. False if caching is off, the run is profiled (the cache does not
+ *           keep where commands came from), the input is not a mapped file, there is no cache file or it is
+ *           stale, or the procedures cannot be allocated; the file must be compiled.
+ *------------------------------------------------------------------------------------------------------------*/
+static bool _myrtle_cache_load(myrtle_ctx_t *ctx) {
+	cache_t *cached = &ctx->cached;
+	int      i, j;
+
+	if (!ctx->cache || ctx->prof || !ctx->source || !ctx->file.in_mapped ||
+	    !cache_load(cached, ctx->cache_dir, ctx->source, ctx->file.in_buf, ctx->file.in_len)) {
+		return false;
+	}
+	if (cached->proc_count > ctx->proc_cap) {
+		proc_t *procs = (proc_t *)realloc(ctx->procs, cached->proc_count * sizeof(proc_t));
+		if (!procs) return false;
+		ctx->procs = procs;
+		for (; ctx->proc_cap < cached->proc_count; ctx->proc_cap++) {
+			for (j = 0; j < 4; j++) stamp_init(&ctx->procs[ctx->proc_cap].stamps[j]);
+		}
+	}
+	for (i = 0; i < cached->proc_count; i++) {
+		proc_t *p = &ctx->procs[i];
+		p->name = (char *)malloc(strlen(cached->procs[i].name) + 1);
+		if (!p->name) {
+			_myrtle_procs_clear(ctx);
+			return false;
+		}
+		strcpy(p->name, cached->procs[i].name);
+		p->at        = cached->procs[i].at;
+		p->defined   = true;
+		p->stampable = cached->procs[i].stampable;
+		for (j = 0; j < 4; j++) stamp_reset(&p->stamps[j]);
+		ctx->proc_count++;
+	}
+	code_view(&ctx->code, cached->words, cached->count);
+	ctx->repeats = cached->repeats;
+	ctx->calls   = cached->calls;
+	STATS_DO(ctx->stats, ctx->stats->cached = true);
+	return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_cache_save()
+ * DESCR:    Saves the program just compiled from the input file, and its procedures, in the cache file of the
+ *           input file (see cache.c), if caching is on. Programs with turtle blocks are not cached. A cache file
+ *           which cannot be written is not an error; the file is just compiled again next time.
  * RETURNS:  Nothing.
- * PSEUDOCODE:
- * 1. Define i and squares as int variables.
- * 2. Call file_next_token() to get 'n' from the input file. Pass this string to atoi() which will convert it
- *    into an equivalent integer. Assign the return value from atoi() to squares.
- * 3. Write a for loop (using i as the index variable) which iterates 'squares' times.
- *    a. Call _myrtle_move(1) to move Myrtle backward one square.
- *    b. If the pen is down, then call _myrtle_world_draw_char() to draw a character in the square that Myrtle
- *       just entered.
  *------------------------------------------------------------------------------------------------------------*/
-static void _myrtle_cmd_backward() {
-	/* 1. Define i and squares as int variables. */
-	int i, squares;
-	char *n;
+static void _myrtle_cache_save(myrtle_ctx_t *ctx) {
+	cache_t cached;
+	int     i;
 
-	/* 2. Call file_next_token() to get 'n' from the input file. Pass this string to atoi() which will convert it
-	 *    into an equivalent integer. Assign the return value from atoi() to squares. */
-	n = file_next_token();
-	squares = atoi(n);
+	if (!ctx->cache || !ctx->source || !ctx->file.in_mapped || ctx->turtle_count > 0 ||
+	    ctx->file.in_len < (size_t)CACHE_MIN_SIZE) {
+		return;
+	}
+	cache_init(&cached);
+	cached.procs = (cache_proc_t *)malloc((ctx->proc_count + 1) * sizeof(cache_proc_t));
+	if (!cached.procs) return;
+	for (i = 0; i < ctx->proc_count; i++) {
+		cached.procs[i].at        = ctx->procs[i].at;
+		cached.procs[i].stampable = ctx->procs[i].stampable;
+		cached.procs[i].name      = ctx->procs[i].name;
+	}
+	cached.words      = ctx->code.words;
+	cached.count      = ctx->code.count;
+	cached.proc_count = ctx->proc_count;
+	cached.repeats    = ctx->repeats;
+	cached.calls      = ctx->calls;
+	cache_save(&cached, ctx->cache_dir, ctx->source, ctx->file.in_buf, ctx->file.in_len);
+	free(cached.procs);
+}
 
-	/* 3. Write a for loop (using i as the index variable) which iterates 'squares' times.
-	 *    a. Call _myrtle_move(1) to move Myrtle backward one square.
-	 *    b. If the pen is down, then call _myrtle_world_draw_char() to draw a character in the square that Myrtle
-	 *       just entered.*/
-	for(i = squares; i > 0; --i) {
-		_myrtle_move(-1);
-		if(_myrtle_pen_is_down()) _myrtle_world_draw_char();
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_checkpoint()
+ * DESCR:    Called by _myrtle_exec() before the command at 'cmd' is performed in a checkpointed or resumed run:
+ *           notes that it is the command of the innermost frame, and takes a checkpoint if one is due, because
+ *           ctx->every commands have been performed since the last one, a 'stop' has just been performed, or a
+ *           signal asked for one. Then the command is counted.
+ * RETURNS:  TERM_NORM, TERM_ERR_OUTPUT if the checkpoint cannot be written, or TERM_ERR_STOPPED if the signal
+ *           asked for the run to stop once the checkpoint was taken.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_checkpoint(myrtle_ctx_t *ctx, int *cmd) {
+	int  signal = ctx->signalled ? (int)*ctx->signalled : 0;
+	char buffer[160];
+
+	ctx->frames[ctx->depth - 1].pc = (long)(cmd - ctx->code.words);
+	if (ctx->checkpoint && (signal || ctx->checkpoint_due ||
+	    (ctx->every > 0 && ctx->performed - ctx->last_checkpoint >= ctx->every))) {
+		if (signal) *ctx->signalled = 0;
+		if (_myrtle_checkpoint_save(ctx) != TERM_NORM) return ctx->status;
+		if (signal == MYRTLE_CHECKPOINT_STOP) {
+			sprintf(buffer, "Stopped after checkpoint '%.100s' was taken", ctx->checkpoint);
+			return _myrtle_fail(ctx, TERM_ERR_STOPPED, buffer);
+		}
+	}
+	ctx->performed++;
+	return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_checkpoint_save()
+ * DESCR:    Takes a checkpoint of the run as it is, before the command of the innermost frame, and writes it to
+ *           the file ctx->checkpoint (see checkpoint.c). The output is flushed first, so that the output file
+ *           holds everything the checkpoint says was written before it.
+ * RETURNS:  TERM_NORM, the status of the output file if it cannot be written, or TERM_ERR_OUTPUT if the
+ *           checkpoint cannot be.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_checkpoint_save(myrtle_ctx_t *ctx) {
+	checkpoint_t checkpoint;
+	char         buffer[160];
+
+	if (file_flush(&ctx->file) != TERM_NORM) return _myrtle_fail(ctx, ctx->file.status, ctx->file.error);
+	checkpoint_init(&checkpoint);
+	checkpoint.rows     = ctx->world.rows;
+	checkpoint.cols     = ctx->world.cols;
+	checkpoint.program  = ctx->program;
+	checkpoint.commands = ctx->performed;
+	checkpoint.output   = ctx->file.out_total;
+	checkpoint.frames   = ctx->frames;
+	checkpoint.depth    = ctx->depth;
+	_myrtle_turtle_get(ctx, &checkpoint.turtle);
+	if (!checkpoint_save(&checkpoint, &ctx->world, ctx->checkpoint)) {
+		sprintf(buffer, "Cannot write checkpoint file '%.100s'", ctx->checkpoint);
+		return _myrtle_fail(ctx, TERM_ERR_OUTPUT, buffer);
+	}
+	ctx->last_checkpoint = ctx->performed;
+	ctx->checkpoint_due  = false;
+	return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_checkpoint_start()
+ * DESCR:    Gets a checkpointed or resumed run ready to be performed: hashes the compiled program, which every
+ *           checkpoint is taken of, and starts with no frames and no commands performed, or, when resuming, as
+ *           the checkpoint left off (see _myrtle_restore()).
+ * RETURNS:  TERM_NORM, or the status of _myrtle_restore().
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_checkpoint_start(myrtle_ctx_t *ctx) {
+	ctx->program         = checkpoint_hash(ctx->code.words, ctx->code.count);
+	ctx->depth           = 0;
+	ctx->resume          = 0;
+	ctx->performed       = 0;
+	ctx->last_checkpoint = 0;
+	ctx->checkpoint_due  = false;
+	return ctx->restored.map ? _myrtle_restore(ctx) : TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_cmd_backward()
+ * DESCR:    Performs the 'backward' command. 'squares' is the number of squares to move backward. Note: if Myrtle
+ *           reaches one of the edges of her world, then she wraps around to the opposite edge. Function is
+ *           analogous to _myrtle_cmd_forward().
+ * RETURNS:  See _myrtle_move().
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_cmd_backward(myrtle_ctx_t *ctx, int squares) {
+	return squares > 0 ? _myrtle_move(ctx, -squares) : TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_cmd_call()
+ * DESCR:    Performs a call of a procedure. pc[0] is how far the CMD_TO of the procedure is from the CMD_CALL,
+ *           which is at pc[-1]; the CMD_TO is followed by the length of the body and then the body. A procedure
+ *           which can be stamped is performed once for each direction Myrtle is facing when it is called with the
+ *           pen down, and what it draws is recorded in a stamp (see stamp.c). A later call facing the same way
+ *           with the same pen char draws the stamp instead. Verbose mode and a recorded run always perform the
+ *           commands, so that they are all traced, as does a checkpointed or resumed run, so that a checkpoint can
+ *           be taken inside the procedure, and so does a call made while a stamp is being recorded, which is drawn
+ *           into the stamp being recorded.
+ * RETURNS:  TERM_NORM, or the status of the command which failed.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_cmd_call(myrtle_ctx_t *ctx, int *pc) {
+	int          *to     = pc - 1 + pc[0];
+	int          *body   = to + 2;
+	int          *end    = body + to[1];
+	proc_t       *proc   = &ctx->procs[_myrtle_proc_at(ctx, (int)(to - ctx->code.words))];
+	stamp_t      *stamp  = &proc->stamps[_myrtle_dir_get(ctx)];
+	int           status;
+	par_turtle_t  turtle;
+
+	if (!proc->stampable || !_myrtle_pen_is_down(ctx) || ctx->trace || ctx->journal || ctx->resumable ||
+	    ctx->recording || stamp->failed) {
+		return _myrtle_proc_exec(ctx, pc - 1, body, end);
+	}
+	_myrtle_turtle_get(ctx, &turtle);
+	if (stamp->valid && stamp->start.penchar == turtle.penchar) {
+		status = stamp_blit(stamp, &ctx->world, &turtle);
+		STATS_DO(ctx->stats, stats_stamp(ctx->stats, stamp));
+		if (ctx->prof) prof_stamp(ctx->prof, stamp);
+		_myrtle_turtle_set(ctx, &turtle);
+		return _myrtle_world_status(ctx, status);
 	}
+	stamp_begin(stamp, &turtle);
+	ctx->recording = stamp;
+	status = _myrtle_proc_exec(ctx, pc - 1, body, end);
+	ctx->recording = NULL;
+	if (status == TERM_NORM) {
+		_myrtle_turtle_get(ctx, &turtle);
+		stamp_end(stamp, &turtle, ctx->world.rows, ctx->world.cols);
+	}
+	return status;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
@@ -340,75 +1013,31 @@ static void _myrtle_cmd_backward() {
 
 /*--------------------------------------------------------------------------------------------------------------
  * FUNCTION: _myrtle_cmd_foward()
- * DESCR:    Performs the 'forward' command. There should be an integer following the word 'forward' in the
- *           statement. This is the number of squares to move forward. Note: if Myrtle reaches one of the edges
- *           of her world, then she stops there and does not move, lest she fall off since everyone knows the
- *           world is flat.
- * RETURNS:  Nothing.
- * PSEUDOCODE:
- * 1. Define i and squares as int variables.
- * 2. Call file_next_token() to get 'n' from the input file. Pass this string to atoi() which will convert it
- *    into an equivalent integer. Assign the return value from atoi() to squares.
- * 3. Write a for loop (using i as the index variable) which iterates 'squares' times.
- *    a. Call _myrtle_move(1) to move Myrtle forward one square.
- *    b. If the pen is down, then call _myrtle_world_draw_char() to draw a character in the square that Myrtle
- *       just entered.
+ * DESCR:    Performs the 'forward' command. 'squares' is the number of squares to move forward. Note: if Myrtle
+ *           reaches one of the edges of her world, then she wraps around to the opposite edge. A negative or
+ *           zero 'squares' does nothing.
+ * RETURNS:  See _myrtle_move().
  *------------------------------------------------------------------------------------------------------------*/
-static void _myrtle_cmd_forward() {
-	/* 1. Define i and squares as int variables. */
-	int i, squares;
-	char *n;
-
-	/* 2. Call file_next_token() to get 'n' from the input file. Pass this string to atoi() which will convert it
-	 *    into an equivalent integer. Assign the return value from atoi() to squares. */
-	n = file_next_token();
-	squares = atoi(n);
-
-	/* 3. Write a for loop (using i as the index variable) which iterates 'squares' times.
-	 *    a. Call _myrtle_move(1) to move Myrtle forward one square.
-	 *    b. If the pen is down, then call _myrtle_world_draw_char() to draw a character in the square that Myrtle
-	 *       just entered.*/
-	for(i = squares; i > 0; --i) {
-		_myrtle_move(1);
-		if(_myrtle_pen_is_down()) _myrtle_world_draw_char();
-	}
+static int _myrtle_cmd_forward(myrtle_ctx_t *ctx, int squares) {
+	return squares > 0 ? _myrtle_move(ctx, squares) : TERM_NORM;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
  * FUNCTION: _myrtle_cmd_hyper()
- * DESCR:    Performs the 'hyper' command. There should be two integers following the word 'hyper' in the state-
- *           ment. These are read as strings and converted into equivalent int values using the C library func-
- *           tion atoi(). If they are not ints or they are missing, then something bad is likely to happen. I
- *           suggest wearing a flak jacket whenever using this interprer. Note that when Myrtle hyperspaces
- *           she lands facing the same direction she was originally. If the pen was down, then a char is drawn
- *           in the new square. If the pen is up, then no char is drawn.
- * RETURNS:  Nothing.
+ * DESCR:    Performs the 'hyper' command. 'row' and 'col' are the two integers which followed the word 'hyper'
+ *           in the statement; they were converted using atoi() by the compiler, so if they were not ints then
+ *           something bad is likely to happen. I suggest wearing a flak jacket whenever using this interprer.
+ *           Note that when Myrtle hyperspaces she lands facing the same direction she was originally. If the
+ *           pen was down, then a char is drawn in the new square. If the pen is up, then no char is drawn.
+ * RETURNS:  See _myrtle_world_draw_char().
  * PSEUDOCODE:
- * 1. Call file_next_token() to get the row from the input file. Use atoi() to convert this into an integer
- *    and assign it to a defined int variable named 'row'.
- * 2. Do Step 1 to get 'col'.
- * 3. Call the _myrtle_row_set() and _myrtle_col_set() mutator functions to update Myrtle's row and col.
- * 4. If the pen is down, then draw a character in the square that Myrtle just landed in.
+ * 1. Call the _myrtle_row_set() and _myrtle_col_set() mutator functions to update Myrtle's row and col.
+ * 2. If the pen is down, then draw a character in the square that Myrtle just landed in.
  *------------------------------------------------------------------------------------------------------------*/
-static void _myrtle_cmd_hyper() {
-	/* 1. Call file_next_token() to get the row from the input file. Use atoi() to convert this into an integer
-	 *    and assign it to a defined int variable named 'row'.*/
-	char *n;
-	int row, col;
-
-	n = file_next_token();
-	row = atoi(n);
-
-	/* 2. Do Step 1 to get 'col'. */
-	n = file_next_token();
-	col = atoi(n);
-
-	/* 3. Call the _myrtle_row_set() and _myrtle_col_set() mutator functions to update Myrtle's row and col.*/
-	_myrtle_row_set(row);
-	_myrtle_col_set(col);
-
-	/* 4. If the pen is down, then draw a character in the square that Myrtle just landed in.*/
-	if( _myrtle_pen_is_down() ) _myrtle_world_draw_char();
+static int _myrtle_cmd_hyper(myrtle_ctx_t *ctx, int row, int col) {
+	_myrtle_row_set(ctx, row);
+	_myrtle_col_set(ctx, col);
+	return _myrtle_world_draw_char(ctx);
 }
 
 /*--------------------------------------------------------------------------------------------------------------
@@ -416,43 +1045,48 @@ static void _myrtle_cmd_hyper() {
  * DESCR:    Performs the 'left' command.
  * RETURNS:  Nothing.
  *------------------------------------------------------------------------------------------------------------*/
-static void _myrtle_cmd_left() {
-	if (_myrtle_dir_get() == DIR_NORTH) _myrtle_dir_set(DIR_WEST);
-	else _myrtle_dir_set(_myrtle_dir_get() - 1);
+static void _myrtle_cmd_left(myrtle_ctx_t *ctx) {
+	if (_myrtle_dir_get(ctx) == DIR_NORTH) _myrtle_dir_set(ctx, DIR_WEST);
+	else _myrtle_dir_set(ctx, _myrtle_dir_get(ctx) - 1);
 }
 
 /*--------------------------------------------------------------------------------------------------------------
  * FUNCTION: _myrtle_cmd_lookup()
- * DESCR:    Looks up 'cmd_string' in the globals.cmd_table table.
- * RETURNS:  A pointer to the command in the globals.cmd_table array. NULL if the command is not found. This
- *           would be caused by a syntax error in the Myrtle source code file.
- * NOTE:     Suppose A is an array of ints, defined "int A[10];" and we want to return the address of A. We
- *           can simply write "A" and the compiler will interpret that to mean "the address of the first
- *           element of A". However, suppose we wish to return the address of the third element of A. If we
- *           simply write "A[2]" the compiler will interpret that to mean the "value" of the third element of
- *           A. If we want the "address" of the third element, we have to write "&A[2]". Note that "&A[0]"
- *           is equivalent to "&A" which is equivalent to "A".
- *------------------------------------------------------------------------------------------------------------*/
-static cmd_t *_myrtle_cmd_lookup(char *cmd_string) {
-	int i;
-	for (i = 0; i < MAX_CMDS; i++) {
-		if (streq(globals.cmd_table[i].cmd, cmd_string)) return &globals.cmd_table[i];
-	}
-	return NULL;
+ * DESCR:    Looks up 'cmd_string', which is 'len' chars long, in the cmd_table table. The perfect hash generated
+ *           by mkcmds maps each command to its own slot, so at most one command can match and only that one is
+ *           compared against 'cmd_string'.
+ * RETURNS:  A pointer to the command in the cmd_table array. NULL if the command is not found. This would be
+ *           caused by a syntax error in the Myrtle source code file.
+ *------------------------------------------------------------------------------------------------------------*/
+static const cmd_t *_myrtle_cmd_lookup(char *cmd_string, int len) {
+	int          slot;
+	const cmd_t *command;
+
+	if (len < 1) return NULL;
+	slot = CMD_HASH_SLOTS[MYRTLE_CMD_HASH(cmd_string, len, CMD_HASH_LEN_MULT, CMD_HASH_FIRST_MULT, CMD_HASH_MASK)];
+	if (slot < 0) return NULL;
+	command = &cmd_table[slot];
+	if (command->len != len || memcmp(command->cmd, cmd_string, len)) return NULL;
+	return command;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_cmd_name()
+ * DESCR:    Looks up the command string for the opcode 'code'. Used by verbose mode.
+ * RETURNS:  The command string.
+ *------------------------------------------------------------------------------------------------------------*/
+static char *_myrtle_cmd_name(int code) {
+	return cmd_table[code].cmd;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
  * FUNCTION: _myrtle_cmd_penchar()
- * DESCR:    Performs the 'penchar' command. There should be a char following the word 'penchar' in the state-
- *           ment. If there's not, then they are out of luck.
+ * DESCR:    Performs the 'penchar' command. 'ch' is the first char of the token following the word 'penchar'
+ *           in the statement.
  * RETURNS:  Nothing.
- * PSEUDOCODE:
- * 1. Call file_next_token() to get a char pointer to the next token. Call this char pointer variable 'token'.
- * 2. Pass the first char of 'token' to _myrtle_pen_char_set().
  *------------------------------------------------------------------------------------------------------------*/
-static void _myrtle_cmd_penchar() {
-	char *next = file_next_token();
-	_myrtle_pen_char_set(next[0]);
+static void _myrtle_cmd_penchar(myrtle_ctx_t *ctx, char ch) {
+	_myrtle_pen_char_set(ctx, ch);
 }
 
 /*--------------------------------------------------------------------------------------------------------------
@@ -460,9 +1094,9 @@ static void _myrtle_cmd_penchar() {
  * DESCR:    Performs the 'pendown' command.
  * RETURNS:  Nothing.
  *------------------------------------------------------------------------------------------------------------*/
-static void _myrtle_cmd_pendown() {
+static void _myrtle_cmd_pendown(myrtle_ctx_t *ctx) {
 	/* This one is trivial. */
-	globals.pendown = true;
+	ctx->pendown = true;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
@@ -470,26 +1104,53 @@ static void _myrtle_cmd_pendown() {
  * DESCR:    Performs the 'penup' command.
  * RETURNS:  Nothing.
  *------------------------------------------------------------------------------------------------------------*/
-static void _myrtle_cmd_penup() {
+static void _myrtle_cmd_penup(myrtle_ctx_t *ctx) {
 	/* And so is this one. */
-	globals.pendown = false;
+	ctx->pendown = false;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: _myrtle_cmd_perform()
- * DESCR:    Performs the command 'cmd' by making Myrtle do whatever she needs to do.
- * RETURNS:  Nothing.
- * NOTE:     Printing a string to a string buffer using sprintf() is an old and extremely useful C trick.
- *           Learn it. You will see it in C code (well, at least in the code I write).
+ * FUNCTION: _myrtle_cmd_repeat()
+ * DESCR:    Performs the 'repeat' command. pc[0] is the count, pc[1] the length of the body in words, and the
+ *           body follows. repeat_plan() works out which repetitions cannot change the world; Myrtle jumps past
+ *           them to the state she would be in after them, and performs the rest. When the run is checkpointed,
+ *           the plan and the repetition being performed are kept in the frame of the 'repeat', and a resumed run
+ *           takes them from there instead of planning again.
+ * RETURNS:  TERM_NORM, or the status of the command which failed.
  *------------------------------------------------------------------------------------------------------------*/
-static void _myrtle_cmd_perform(char *cmd_string) {
-	cmd_t *command = _myrtle_cmd_lookup(cmd_string);
-	if (!command) {
-		char buffer[128];
-		sprintf(buffer, "Unknown command '%s' on line %d", cmd_string, _myrtle_line_get());
-		main_terminate_err(buffer, TERM_ERR_UNK_CMD);
+static int _myrtle_cmd_repeat(myrtle_ctx_t *ctx, int *pc) {
+	int          *body    = pc + 2;
+	int          *end     = body + pc[1];
+	int           status  = TERM_NORM;
+	long          frame   = ctx->resumable ? ctx->depth - 1 : -1;  /* Not a pointer: ctx->frames may move. */
+	bool          resumed = ctx->resume > ctx->depth;
+	long          i, from = 0;
+	par_turtle_t  start;
+	repeat_plan_t plan;
+
+	if (resumed) {
+		plan = ctx->frames[frame].plan;
+		from = ctx->frames[frame].rep;
+	} else {
+		_myrtle_turtle_get(ctx, &start);
+		repeat_plan(&plan, pc[0], body, end, &start, ctx->world.rows, ctx->world.cols);
+		if (frame >= 0) ctx->frames[frame].plan = plan;
+	}
+	for (i = from; i < plan.first && status == TERM_NORM; i++) {
+		if (frame >= 0) ctx->frames[frame].rep = i;
+		status = _myrtle_exec(ctx, body, end);
 	}
-	command->perform();
+	if (plan.skipped > 0 && status == TERM_NORM) {
+		if (!resumed || from < plan.first) {
+			if (ctx->trace) fprintf(ctx->trace, "Skipping %ld repetitions\n", plan.skipped);
+			_myrtle_turtle_set(ctx, &plan.resume);
+		}
+		for (i = from > plan.first ? from : plan.first; i < plan.first + plan.last && status == TERM_NORM; i++) {
+			if (frame >= 0) ctx->frames[frame].rep = i;
+			status = _myrtle_exec(ctx, body, end);
+		}
+	}
+	return status;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
@@ -497,148 +1158,592 @@ static void _myrtle_cmd_perform(char *cmd_string) {
  * DESCR:    Performs the 'right' command.
  * RETURNS:  Nothing.
  *------------------------------------------------------------------------------------------------------------*/
-static void _myrtle_cmd_right() {
+static void _myrtle_cmd_right(myrtle_ctx_t *ctx) {
 	/* function is similar to _myrtle_cmd_left(), but rotating clockwise */
-	if (_myrtle_dir_get() == DIR_WEST) _myrtle_dir_set(DIR_NORTH);
-	else _myrtle_dir_set(_myrtle_dir_get() + 1);
+	if (_myrtle_dir_get(ctx) == DIR_WEST) _myrtle_dir_set(ctx, DIR_NORTH);
+	else _myrtle_dir_set(ctx, _myrtle_dir_get(ctx) + 1);
 }
 
 
 /*--------------------------------------------------------------------------------------------------------------
  * FUNCTION: _myrtle_cmd_stop()
  * DESCR:	 Stops myrtle in her tracks, terminates program, draws output
- * RETURNS:	 Nothing.
+ * RETURNS:	 See _myrtle_world_write().
  *------------------------------------------------------------------------------------------------------------*/
-static void _myrtle_cmd_stop() {
+static int _myrtle_cmd_stop(myrtle_ctx_t *ctx) {
+	int status;
 	/* TODO: is there an easy to terminate the program from _stop()
 	 * 1. program terminates immediately*/
 	/* 2. send myrtle's world to the output file */
-	_myrtle_world_write();
+	status = _myrtle_world_write(ctx);
+	STATS_DO(ctx->stats, stats_phase(ctx->stats, STATS_EXEC));
+	if (ctx->at_stop) ctx->checkpoint_due = true;
+	return status;
 }
 
 
 /*--------------------------------------------------------------------------------------------------------------
  * FUNCTION: _myrtle_col_get()
- * DESCR:    Accessor function for globals.col.
- * RETURNS:  The value of the int globals.col variable.
+ * DESCR:    Accessor function for ctx->col.
+ * RETURNS:  The value of the coord_t ctx->col variable.
  *------------------------------------------------------------------------------------------------------------*/
-static int _myrtle_col_get() {
-	return globals.col;
+static coord_t _myrtle_col_get(myrtle_ctx_t *ctx) {
+	return ctx->col;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
  * FUNCTION: _myrtle_col_set()
- * DESCR:    Mutator function for globals.col. Note that as Myrtle is moving, if she reaches either the west
- *           or east border of her world, she stops moving and essentially just keeps banging her head against
- *           the wall.
+ * DESCR:    Mutator function for ctx->col. Note that as Myrtle is moving, if she reaches either the west or east
+ *           border of her world, she stops moving and essentially just keeps banging her head against the wall.
  * RETURNS:  Nothing.
  *------------------------------------------------------------------------------------------------------------*/
-static void _myrtle_col_set(int col) {
-	if (col < 0) globals.col = 0;
-	else if (col >= MAX_WORLD_COLS) globals.col = MAX_WORLD_COLS - 1;
-	else globals.col = col;
+static void _myrtle_col_set(myrtle_ctx_t *ctx, coord_t col) {
+	if (col < 0) ctx->col = 0;
+	else if (col >= ctx->world.cols) ctx->col = ctx->world.cols - 1;
+	else ctx->col = col;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_code()
+ * DESCR:    Finds the code being compiled into: that of the turtle whose block is being compiled, or Myrtle's.
+ * RETURNS:  The code.
+ *------------------------------------------------------------------------------------------------------------*/
+static code_t *_myrtle_code(myrtle_ctx_t *ctx) {
+	return ctx->block < 0 ? &ctx->code : &ctx->turtles[ctx->block].code;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_compile()
+ * DESCR:    Translates the entire input file into ctx->code, and the commands in turtle blocks into the code of
+ *           their turtles. A word which is not a command is a call of the procedure it names. Each command is
+ *           looked up once, here, and its operands are converted to ints once, here, so that performing the
+ *           program is just a walk over an int array. ctx->line is the source line of the command being compiled
+ *           and is used in error messages.
+ * RETURNS:  TERM_NORM, TERM_ERR_UNK_CMD on an unknown command or procedure, TERM_ERR_SYNTAX on a missing operand
+ *           or a turtle block, 'repeat' block or procedure which is not ended properly, TERM_ERR_MEMORY if the
+ *           program does not fit in memory, or the status of the input file if it cannot be read.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_compile(myrtle_ctx_t *ctx) {
+	token_t      token;
+	const cmd_t *command;
+	int          i, arg = 0;
+
+	while (file_next_token(&ctx->file, &token)) {
+		STATS_DO(ctx->stats, stats_token(ctx->stats));
+		_myrtle_line_set(ctx, token.line);
+		command = _myrtle_cmd_lookup(token.text, token.len);
+		if (ctx->prof && ctx->block < 0) prof_loc(ctx->prof, (int)ctx->code.count, &ctx->file, &token);
+		if (ctx->watch && ctx->block < 0 && ctx->proc < 0 && ctx->repeat < 0 &&
+		    _myrtle_watch_loc(ctx, &token) != TERM_NORM) {
+			return ctx->status;
+		}
+		if (!command || command->code == CMD_CALL) {
+			if (_myrtle_proc_call(ctx, command, &token) != TERM_NORM) return ctx->status;
+			continue;
+		}
+		if (command->code == CMD_TURTLE) {
+			if (_myrtle_block_begin(ctx, command) != TERM_NORM) return ctx->status;
+			continue;
+		}
+		if (command->code == CMD_END) {
+			if ((ctx->proc >= 0 ? _myrtle_proc_end(ctx) : _myrtle_block_end(ctx)) != TERM_NORM) return ctx->status;
+			continue;
+		}
+		if (command->code == CMD_TO) {
+			if (_myrtle_proc_begin(ctx, command) != TERM_NORM) return ctx->status;
+			continue;
+		}
+		if (command->code == CMD_REPEAT) {
+			if (_myrtle_repeat_begin(ctx, command) != TERM_NORM) return ctx->status;
+			continue;
+		}
+		if (command->code == CMD_CLOSE) {
+			if (_myrtle_repeat_end(ctx) != TERM_NORM) return ctx->status;
+			continue;
+		}
+		if (code_emit(_myrtle_code(ctx), command->code) != TERM_NORM) {
+			return _myrtle_fail(ctx, TERM_ERR_MEMORY, "Out of memory compiling program");
+		}
+		for (i = 0; i < cmd_nargs[command->code]; i++) {
+			if (_myrtle_arg_next(ctx, command, &arg) != TERM_NORM) return ctx->status;
+			if (code_emit(_myrtle_code(ctx), arg) != TERM_NORM) {
+				return _myrtle_fail(ctx, TERM_ERR_MEMORY, "Out of memory compiling program");
+			}
+		}
+	}
+	if (ctx->file.status != TERM_NORM) return _myrtle_fail(ctx, ctx->file.status, ctx->file.error);
+	if (ctx->block >= 0) {
+		char buffer[128];
+		sprintf(buffer, "Missing 'end' for turtle '%.64s'", ctx->turtles[ctx->block].name);
+		return _myrtle_fail(ctx, TERM_ERR_SYNTAX, buffer);
+	}
+	if (ctx->proc >= 0) {
+		char buffer[128];
+		sprintf(buffer, "Missing 'end' for procedure '%.64s'", ctx->procs[ctx->proc].name);
+		return _myrtle_fail(ctx, TERM_ERR_SYNTAX, buffer);
+	}
+	if (ctx->repeat >= 0) return _myrtle_fail(ctx, TERM_ERR_SYNTAX, "Missing ']' for 'repeat'");
+	return TERM_NORM;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
  * FUNCTION: _myrtle_dir_get()
- * DESCR:    Accessor function for the globals.dir variable.
- * RETURNS:  The value of int variable globals.dir.
+ * DESCR:    Accessor function for the ctx->dir variable.
+ * RETURNS:  The value of int variable ctx->dir.
  *------------------------------------------------------------------------------------------------------------*/
-static int _myrtle_dir_get() {
-	return globals.dir;
+static int _myrtle_dir_get(myrtle_ctx_t *ctx) {
+	return ctx->dir;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
  * FUNCTION: _myrtle_dir_set()
- * DESCR:    Mutator function for the globals.dir variable.
+ * DESCR:    Mutator function for the ctx->dir variable.
  * RETURNS:  Nothing.
  *------------------------------------------------------------------------------------------------------------*/
-static void _myrtle_dir_set(int dir) {
-	if(dir > -1 && dir < 4) globals.dir = dir;
+static void _myrtle_dir_set(myrtle_ctx_t *ctx, int dir) {
+	if(dir > -1 && dir < 4) ctx->dir = dir;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: _myrtle_line_get()
- * DESCR:    Accessor function for globals.line.
- * RETURNS:  The value of int variable globals.line.
+ * FUNCTION: _myrtle_exec()
+ * DESCR:    Performs the commands of the compiled program ctx->code from 'pc' to 'end', in order. Each opcode is
+ *           followed by its operands, which are consumed by advancing 'pc' past them. The body of a procedure is
+ *           stepped over where it is declared, and performed where it is called. Stops at the first command which
+ *           fails. When the run is profiled, what happened during each command is attributed to it afterwards.
+ *           When it is recorded, each command is recorded as it starts (see journal.c). When it is checkpointed or
+ *           resumed, the commands are performed in a frame of their own, and a checkpoint may be taken before
+ *           each; a resumed run enters its frames again without performing their commands again until it is
+ *           back at the command the checkpoint was taken before (see _myrtle_frame_enter()).
+ * RETURNS:  TERM_NORM, or the status of the command which failed.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_exec(myrtle_ctx_t *ctx, int *pc, int *end) {
+	int status = TERM_NORM;
+
+	if (ctx->resumable && _myrtle_frame_enter(ctx, &pc) != TERM_NORM) return ctx->status;
+	while (pc < end && status == TERM_NORM) {
+		int *cmd = pc, op = *pc++;
+		if (ctx->resumable && !ctx->resume && (status = _myrtle_checkpoint(ctx, cmd)) != TERM_NORM) break;
+		if (ctx->trace && !ctx->resume) fprintf(ctx->trace, "Performing command: %s\n", _myrtle_cmd_name(op));
+		if (ctx->journal) _myrtle_journal_command(ctx, op);
+		switch (op) {
+		case CMD_BACKWARD: status = _myrtle_cmd_backward(ctx, pc[0]);     pc += 1; break;
+		case CMD_CALL:     status = _myrtle_cmd_call(ctx, pc);            pc += 1; break;
+		case CMD_FORWARD:  status = _myrtle_cmd_forward(ctx, pc[0]);      pc += 1; break;
+		case CMD_HYPER:    status = _myrtle_cmd_hyper(ctx, pc[0], pc[1]); pc += 2; break;
+		case CMD_LEFT:     _myrtle_cmd_left(ctx);                                  break;
+		case CMD_PENCHAR:  _myrtle_cmd_penchar(ctx, (char)pc[0]);         pc += 1; break;
+		case CMD_PENDOWN:  _myrtle_cmd_pendown(ctx);                               break;
+		case CMD_PENUP:    _myrtle_cmd_penup(ctx);                                 break;
+		case CMD_REPEAT:   status = _myrtle_cmd_repeat(ctx, pc);  pc += 2 + pc[1];        break;
+		case CMD_RIGHT:    _myrtle_cmd_right(ctx);                                 break;
+		case CMD_STOP:     status = _myrtle_cmd_stop(ctx);                         break;
+		case CMD_TO:       pc += 1 + pc[0];                                        break;
+		}
+		if (ctx->prof) PROF_COMMAND(ctx->prof, (int)(cmd - ctx->code.words));
+	}
+	if (ctx->resumable) ctx->depth--;
+	return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_exec_jit()
+ * DESCR:    Runs the native code which _myrtle_jit_ok() compiled ctx->code to, on the cells of Myrtle's world.
+ *           Each 'stop' calls _myrtle_hook_jit_stop(). Myrtle is left in the state the program leaves her in.
+ * RETURNS:  TERM_NORM, or the status of the 'stop' which failed.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_exec_jit(myrtle_ctx_t *ctx) {
+	par_turtle_t turtle;
+	int          status;
+	STATS_DO(ctx->stats, stats_executor(ctx->stats, "native"));
+	status = jit_run(&ctx->native, ctx->world.cells, _myrtle_hook_jit_stop, ctx, &turtle);
+	if (status == TERM_NORM) _myrtle_turtle_set(ctx, &turtle);
+	return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_exec_par()
+ * DESCR:    Performs the compiled program ctx->code on up to ctx->jobs threads. The commands between one
+ *           'stop', 'repeat', 'call' or 'to' and the next are handed to par_exec(), which runs them on threads if
+ *           there are enough of them to be worth it; otherwise, and for each of those, _myrtle_exec() runs them.
+ *           Verbose mode traces the commands run on threads before the 'stop' that ends them is performed, so
+ *           the output is in the same order.
+ * RETURNS:  TERM_NORM, or the status of the command which failed.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_exec_par(myrtle_ctx_t *ctx) {
+	int         *pc     = ctx->code.words;
+	int         *end    = ctx->code.words + ctx->code.count;
+	int          status = TERM_NORM;
+	par_turtle_t turtle;
+
+	STATS_DO(ctx->stats, stats_executor(ctx->stats, "parallel"));
+	while (pc < end && status == TERM_NORM) {
+		int *first = pc;
+		while (pc < end && *pc != CMD_STOP && *pc != CMD_REPEAT && *pc != CMD_CALL && *pc != CMD_TO) {
+			pc += 1 + cmd_nargs[*pc];
+		}
+
+		_myrtle_turtle_get(ctx, &turtle);
+		status = par_exec(&ctx->world, first, pc, &turtle, ctx->jobs);
+		if (status == PAR_SERIAL) {
+			status = _myrtle_exec(ctx, first, pc);
+		} else if (status == TERM_NORM) {
+			_myrtle_turtle_set(ctx, &turtle);
+			_myrtle_trace(ctx, first, pc);
+		} else {
+			return _myrtle_fail(ctx, status, "Out of memory drawing Myrtle's world on threads");
+		}
+
+		/* The 'stop', 'repeat', 'call' or 'to', if there is one. */
+		if (pc < end && status == TERM_NORM) {
+			int *next = pc + 1 + cmd_nargs[*pc];
+			if (*pc == CMD_REPEAT) next += pc[2];
+			if (*pc == CMD_TO) next += pc[1];
+			status = _myrtle_exec(ctx, pc, next);
+			pc     = next;
+		}
+	}
+	return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_exec_turtles()
+ * DESCR:    Performs Myrtle's commands and those of every turtle declared by the program at the same time, with
+ *           par_exec_streams(), on up to ctx->jobs threads, so on one unless more jobs were set. Every turtle
+ *           starts where Myrtle does. See par.c for the order in which the turtles' commands take effect.
+ * RETURNS:  TERM_NORM, or the status of the command which failed.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_exec_turtles(myrtle_ctx_t *ctx) {
+	par_stream_t *streams = (par_stream_t *)malloc((ctx->turtle_count + 1) * sizeof(par_stream_t));
+	par_hooks_t   hooks;
+	int           i, status;
+
+	if (!streams) return _myrtle_fail(ctx, TERM_ERR_MEMORY, "Out of memory starting turtles");
+	STATS_DO(ctx->stats, stats_executor(ctx->stats, "turtles"));
+	for (i = 0; i <= ctx->turtle_count; i++) {
+		code_t *code = i ? &ctx->turtles[i - 1].code : &ctx->code;
+		streams[i].pc  = code->words;
+		streams[i].end = code->words + code->count;
+		_myrtle_turtle_get(ctx, &streams[i].turtle);
+	}
+	hooks.arg   = ctx;
+	hooks.stop  = _myrtle_hook_stop;
+	hooks.trace = ctx->trace ? _myrtle_hook_trace : NULL;
+
+	status = par_exec_streams(&ctx->world, streams, ctx->turtle_count + 1, ctx->jobs, &hooks);
+	_myrtle_turtle_set(ctx, &streams[0].turtle);
+	free(streams);
+	if (status == TERM_NORM) return TERM_NORM;
+	return _myrtle_fail(ctx, status, "Out of memory drawing Myrtle's world on threads");
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_exec_watch()
+ * DESCR:    Performs the compiled program ctx->code in a watched run, from the mark it resumes from, or from the
+ *           beginning. The program is performed one location at a time (see watch.h), and a mark may be taken
+ *           before each (see watch_mark()), of the state _myrtle_watch_start() would restore.
+ * RETURNS:  TERM_NORM, or the status of the command which failed.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_exec_watch(myrtle_ctx_t *ctx) {
+	watch_t     *watch  = ctx->watch;
+	int         *words  = ctx->code.words;
+	long         count  = (long)ctx->code.count, i = 0, next;
+	int          status = TERM_NORM;
+	par_turtle_t turtle;
+
+	STATS_DO(ctx->stats, stats_executor(ctx->stats, "watched"));
+	if (watch->resumed >= 0) {
+		i = watch_find(watch, watch->marks[watch->resumed].loc.pc);
+	} else if (!watch->loc_count || watch->locs[0].pc > 0) {
+		status = _myrtle_exec(ctx, words, words + (watch->loc_count ? watch->locs[0].pc : count));
+	}
+	for (; i < (long)watch->loc_count && status == TERM_NORM; i++) {
+		next = i + 1 < (long)watch->loc_count ? watch->locs[i + 1].pc : count;
+		_myrtle_turtle_get(ctx, &turtle);
+		watch_mark(watch, i, ctx->file.in_buf, &ctx->world, &turtle, ctx->file.out_total);
+		watch->work += next - watch->locs[i].pc;
+		status = _myrtle_exec(ctx, words + watch->locs[i].pc, words + next);
+	}
+	return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_fail()
+ * DESCR:    Records an error which ends the run: 'status' is its TERM_ERR_* code and 'msg' its message. Only the
+ *           first error of a run is kept.
+ * RETURNS:  ctx->status.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_fail(myrtle_ctx_t *ctx, int status, const char *msg) {
+	if (ctx->status != TERM_NORM) return ctx->status;
+	ctx->status = status;
+	strncpy(ctx->error, msg, sizeof(ctx->error) - 1);
+	ctx->error[sizeof(ctx->error) - 1] = '\0';
+	return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_fill()
+ * DESCR:    Fills 'count' squares of col (or row) 'line' of Myrtle's world with 'ch' from row (or col) 'first',
+ *           going down the col if 'vert' is true. If a stamp is being recorded, the run is logged in it, and if
+ *           the run is recorded, it is added to the record of the command. A watched run counts it as work.
+ * RETURNS:  See world_fill_col() and world_fill_row().
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_fill(myrtle_ctx_t *ctx, bool vert, coord_t line, coord_t first, coord_t count, char ch) {
+	if (ctx->recording) stamp_log(ctx->recording, vert, line, first, count, ch, ctx->world.rows, ctx->world.cols);
+	STATS_DO(ctx->stats, stats_fill(ctx->stats, &ctx->world, vert, line, first, count));
+	if (ctx->prof) ctx->prof->cells += (unsigned long)count;
+	if (ctx->journal) journal_fill(ctx->journal, vert, line, first, count, ch);
+	if (ctx->watch) ctx->watch->work += count;
+	if (vert) return world_fill_col(&ctx->world, line, first, count, ch);
+	return world_fill_row(&ctx->world, line, first, count, ch);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_frame_enter()
+ * DESCR:    Called by _myrtle_exec() in a checkpointed or resumed run as it starts performing the commands from
+ *           *pc: pushes a frame for them onto ctx->frames. While the run is resuming, the frame at this depth was
+ *           restored from the checkpoint, and *pc moves to its command; once the innermost frame is entered
+ *           again, the run has resumed.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the frame cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_frame_enter(myrtle_ctx_t *ctx, int **pc) {
+	if (ctx->depth == ctx->frame_cap) {
+		long                cap    = ctx->frame_cap ? ctx->frame_cap * 2 : 16;
+		checkpoint_frame_t *frames = (checkpoint_frame_t *)realloc(ctx->frames, cap * sizeof(checkpoint_frame_t));
+		if (!frames) return _myrtle_fail(ctx, TERM_ERR_MEMORY, "Out of memory performing program");
+		ctx->frames    = frames;
+		ctx->frame_cap = cap;
+	}
+	ctx->depth++;
+	if (ctx->depth <= ctx->resume) {
+		*pc = ctx->code.words + ctx->frames[ctx->depth - 1].pc;
+		if (ctx->depth == ctx->resume) ctx->resume = 0;
+	}
+	return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_hook_jit_stop()
+ * DESCR:    Called by the native code compiled by jit.c for a 'stop'. 'arg' is the context.
+ * RETURNS:  See _myrtle_cmd_stop().
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_hook_jit_stop(void *arg) {
+	return _myrtle_cmd_stop((myrtle_ctx_t *)arg);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_hook_stop()
+ * DESCR:    Called by par_exec_streams() for a 'stop' by any turtle. 'arg' is the context.
+ * RETURNS:  See _myrtle_cmd_stop().
  *------------------------------------------------------------------------------------------------------------*/
-static int _myrtle_line_get() {
-	return globals.line;
+static int _myrtle_hook_stop(void *arg, int stream) {
+	return _myrtle_cmd_stop((myrtle_ctx_t *)arg);
 }
 
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: _myrtle_line_inc()
- * DESCR:    Increments globals.line.
+ * FUNCTION: _myrtle_hook_trace()
+ * DESCR:    Called by par_exec_streams() in verbose mode for each command 'op' performed. 'arg' is the context and
+ *           'stream' is 0 for Myrtle, or 1 + the index of the turtle, whose name follows the command.
  * RETURNS:  Nothing.
  *------------------------------------------------------------------------------------------------------------*/
-static void _myrtle_line_inc() {
-	_myrtle_line_set(_myrtle_line_get() + 1);
+static void _myrtle_hook_trace(void *arg, int stream, int op) {
+	myrtle_ctx_t *ctx = (myrtle_ctx_t *)arg;
+	if (stream == 0) fprintf(ctx->trace, "Performing command: %s\n", _myrtle_cmd_name(op));
+	else fprintf(ctx->trace, "Performing command: %s (%s)\n", _myrtle_cmd_name(op), ctx->turtles[stream - 1].name);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_jit_ok()
+ * DESCR:    Decides whether the program compiled in 'ctx' is to be run as native code, and if so compiles it with
+ *           jit_compile(), unless the native code of the last run is for the same program. It is not if ctx->jit
+ *           is off, if it is to be traced, profiled, recorded, checkpointed or resumed, or if Myrtle's world is
+ *           not stored dense, since the native code stores straight into its cells. jit_compile() turns down the
+ *           rest (see jit.c).
+ * RETURNS:  True if ctx->native holds the native code of the program.
+ *------------------------------------------------------------------------------------------------------------*/
+static bool _myrtle_jit_ok(myrtle_ctx_t *ctx) {
+	par_turtle_t start;
+	if (!ctx->jit || ctx->trace || ctx->prof || ctx->journal || ctx->resumable ||
+	    ctx->world.layout != WORLD_DENSE) {
+		return false;
+	}
+	_myrtle_turtle_get(ctx, &start);
+	return jit_compile(&ctx->native, ctx->code.words, ctx->code.words + ctx->code.count, &start, ctx->world.rows,
+	                   ctx->world.cols);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_journal_command()
+ * DESCR:    Tells ctx->journal that the command 'op' is about to be performed, with Myrtle in the state she is in,
+ *           or, if 'op' is -1, that the run has ended.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _myrtle_journal_command(myrtle_ctx_t *ctx, int op) {
+	par_turtle_t turtle;
+	_myrtle_turtle_get(ctx, &turtle);
+	if (op < 0) journal_stop(ctx->journal, &turtle);
+	else journal_command(ctx->journal, op, &turtle);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_line_get()
+ * DESCR:    Accessor function for ctx->line.
+ * RETURNS:  The value of int variable ctx->line.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_line_get(myrtle_ctx_t *ctx) {
+	return ctx->line;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
  * FUNCTION: _myrtle_line_set()
- * DESCR:    Mutator function for globals.line.
+ * DESCR:    Mutator function for ctx->line.
  * RETURNS:  Nothing.
  *------------------------------------------------------------------------------------------------------------*/
-static void _myrtle_line_set(int n) {
+static void _myrtle_line_set(myrtle_ctx_t *ctx, int n) {
 	/* check for valid values of line */
-	if(n > -1) globals.line = n;
+	if(n > -1) ctx->line = n;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: _myrtle_move()
- * DESCR:    Moves Myrtle 'squares' squares in the direction she is facing. Note that if Myrtle reaches one of
- *           the edges of her world, she just stops.
- * RETURNS:  Nothing.
+ * FUNCTION: _myrtle_load()
+ * DESCR:    Steps 1 to 3 of _myrtle_run(): resets Myrtle and her world and compiles and optimizes the input file.
+ *           A resumed run's world takes its size from the checkpoint. A watched run is compiled by
+ *           _myrtle_watch_compile().
+ * RETURNS:  TERM_NORM, or the status of the step which failed.
  *------------------------------------------------------------------------------------------------------------*/
-/*static void _myrtle_move(int squares) {
-	if (_myrtle_dir_get() == DIR_NORTH) {
-		_myrtle_row_set(_myrtle_row_get() - squares);
-	} else if (_myrtle_dir_get() == DIR_EAST) {
-		_myrtle_col_set(_myrtle_col_get() + squares);
-	} else if (_myrtle_dir_get() == DIR_SOUTH) {
-		_myrtle_row_set(_myrtle_row_get() + squares);
-	} else {
-		_myrtle_col_set(_myrtle_col_get() - squares);
+static int _myrtle_load(myrtle_ctx_t *ctx) {
+	STATS_DO(ctx->stats, stats_reset(ctx->stats));
+	if (ctx->prof) prof_reset(ctx->prof, ctx->source);
+
+	/* 1. Reset Myrtle. */
+	ctx->pendown  = false;
+	ctx->penchar  = ' ';
+	ctx->line     = 1;
+	ctx->dir      = DIR_EAST;
+	ctx->row      = 0;
+	ctx->col      = 0;
+	ctx->status   = TERM_NORM;
+	ctx->error[0] = '\0';
+	ctx->resumable = ctx->checkpoint || ctx->restored.map;
+
+	/* 2. Initialize Myrtle's world. */
+	if (world_reset(&ctx->world, ctx->restored.map ? ctx->restored.rows : ctx->rows,
+	                ctx->restored.map ? ctx->restored.cols : ctx->cols, ctx->layout) != TERM_NORM) {
+		return _myrtle_world_status(ctx, TERM_ERR_MEMORY);
 	}
-}*/
-/* attempting to make myrtle "warp around" if she overlaps one side of the world, using modular arithmetic */
-static void _myrtle_move(int squares) {
-	if (_myrtle_dir_get() == DIR_NORTH) {
-		_myrtle_row_set( (_myrtle_row_get() - squares + MAX_WORLD_ROWS) % MAX_WORLD_ROWS);
-	} else if (_myrtle_dir_get() == DIR_EAST) {
-		_myrtle_col_set( (_myrtle_col_get() + squares + MAX_WORLD_COLS) % MAX_WORLD_COLS);
-	} else if (_myrtle_dir_get() == DIR_SOUTH) {
-		_myrtle_row_set( (_myrtle_row_get() + squares + MAX_WORLD_ROWS) % MAX_WORLD_ROWS);
+
+	/* 3. Compile the whole input file, or load it compiled from the cache, and optimize it if asked to. A watched
+	 *    run compiles on from where the file changed instead. */
+	STATS_DO(ctx->stats, stats_phase(ctx->stats, STATS_PARSE));
+	ctx->commands   = 0;
+	ctx->removed    = 0;
+	ctx->repeat     = -1;
+	ctx->recording  = NULL;
+	_myrtle_turtles_clear(ctx);
+	if (ctx->watch) {
+		if (_myrtle_watch_compile(ctx) != TERM_NORM) return ctx->status;
 	} else {
-		_myrtle_col_set( (_myrtle_col_get() - squares + MAX_WORLD_COLS) % MAX_WORLD_COLS);
+		ctx->code.count = 0;
+		ctx->repeats    = 0;
+		ctx->calls      = 0;
+		_myrtle_procs_clear(ctx);
+		if (!_myrtle_cache_load(ctx)) {
+			if (_myrtle_compile(ctx) != TERM_NORM) return ctx->status;
+			_myrtle_cache_save(ctx);
+		}
+		if (_myrtle_optimize(ctx) != TERM_NORM) return ctx->status;
 	}
+	STATS_DO(ctx->stats, stats_phase(ctx->stats, STATS_NONE));
+	return TERM_NORM;
 }
+
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: _myrtle_pen_char_get()
- * DESCR:    Accessor function for the globals.penchar variable.
- * RETURNS:  The value of the char globals.penchar variable.
+ * FUNCTION: _myrtle_move()
+ * DESCR:    Moves Myrtle 'squares' squares in the direction she is facing, or backward if 'squares' is negative,
+ *           wrapping around the edges of her world. If the pen is down, a char is drawn in every square she
+ *           enters. Rather than stepping one square at a time, the final position is computed directly and the
+ *           squares she passed through are filled as at most two runs (two when she wraps around the edge).
+ *           A move of at least the width (or height) of the world enters every square on the line. So the cost
+ *           depends on the size of the world and not on 'squares'.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the world cannot grow to hold what was drawn.
  *------------------------------------------------------------------------------------------------------------*/
-static char _myrtle_pen_char_get() {
-	return globals.penchar;
+static int _myrtle_move(myrtle_ctx_t *ctx, int squares) {
+	int     dir    = _myrtle_dir_get(ctx);
+	bool    vert   = (dir == DIR_NORTH || dir == DIR_SOUTH);
+	coord_t size   = vert ? ctx->world.rows : ctx->world.cols;
+	coord_t pos    = vert ? _myrtle_row_get(ctx) : _myrtle_col_get(ctx);
+	coord_t step   = (dir == DIR_NORTH || dir == DIR_WEST) ? -(coord_t)squares : (coord_t)squares;
+	coord_t count  = step < 0 ? -step : step;
+	coord_t end    = ((pos + step % size) % size + size) % size;
+	int     status = TERM_NORM;
+
+	if (_myrtle_pen_is_down(ctx)) {
+		/* The squares entered are pos+1 .. pos+count going up, or pos-count .. pos-1 going down. */
+		coord_t first = (count >= size) ? 0 : (step > 0) ? (pos + 1) % size : end;
+		coord_t run   = (count >= size) ? size : count;
+		coord_t tail  = first + run - size;   /* Squares that wrapped around to the start of the line. */
+		char    ch    = _myrtle_pen_char_get(ctx);
+		coord_t line  = vert ? _myrtle_col_get(ctx) : _myrtle_row_get(ctx);
+		if (tail > 0) run -= tail;
+		status = _myrtle_fill(ctx, vert, line, first, run, ch);
+		if (tail > 0 && !status) status = _myrtle_fill(ctx, vert, line, 0, tail, ch);
+	}
+	if (vert) _myrtle_row_set(ctx, end);
+	else _myrtle_col_set(ctx, end);
+	return _myrtle_world_status(ctx, status);
 }
 
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: _myrtle_pen_char_set()
- * DESCR:    Mutator function for the globals.penchar variable.
- * RETURNS:  Nothing.
+ * FUNCTION: _myrtle_operand_next()
+ * DESCR:    Reads the next operand of 'command' from the input file into *token.
+ * RETURNS:  TERM_NORM, TERM_ERR_SYNTAX if the input file ends before the operand, or the status of the input
+ *           file if it cannot be read.
  *------------------------------------------------------------------------------------------------------------*/
-static void _myrtle_pen_char_set(char ch) {
-	globals.penchar = ch;
+static int _myrtle_operand_next(myrtle_ctx_t *ctx, const cmd_t *command, token_t *token) {
+	char buffer[128];
+	if (file_next_token(&ctx->file, token)) {
+		STATS_DO(ctx->stats, stats_token(ctx->stats));
+		return TERM_NORM;
+	}
+	if (ctx->file.status != TERM_NORM) return _myrtle_fail(ctx, ctx->file.status, ctx->file.error);
+	sprintf(buffer, "Missing operand for '%s' on line %d", command->cmd, _myrtle_line_get(ctx));
+	return _myrtle_fail(ctx, TERM_ERR_SYNTAX, buffer);
 }
 
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: _myrtle_pen_down()
- * DESCR:    Sets the globals.pendown variable to indicate that Myrtle's pen is down.
+ * FUNCTION: _myrtle_optimize()
+ * DESCR:    If ctx->optimize is on, optimizes the compiled program with opt_code(), from the state Myrtle starts
+ *           in. A program with turtle blocks is left alone, since removing commands from it would change the
+ *           order in which the turtles draw, and so is one with calls which were not inlined, and so is one being
+ *           profiled, whose commands must stay where they were written.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the optimized program does not fit in memory.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_optimize(myrtle_ctx_t *ctx) {
+	par_turtle_t start;
+	if (!ctx->optimize || ctx->prof || ctx->turtle_count > 0 || ctx->calls > 0) return TERM_NORM;
+	_myrtle_turtle_get(ctx, &start);
+	if (opt_code(&ctx->code, &ctx->scratch, &start, ctx->world.rows, ctx->world.cols, &ctx->commands,
+	             &ctx->removed) != TERM_NORM) {
+		return _myrtle_fail(ctx, TERM_ERR_MEMORY, "Out of memory optimizing program");
+	}
+	return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_pen_char_get()
+ * DESCR:    Accessor function for the ctx->penchar variable.
+ * RETURNS:  The value of the char ctx->penchar variable.
+ *------------------------------------------------------------------------------------------------------------*/
+static char _myrtle_pen_char_get(myrtle_ctx_t *ctx) {
+	return ctx->penchar;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_pen_char_set()
+ * DESCR:    Mutator function for the ctx->penchar variable.
  * RETURNS:  Nothing.
  *------------------------------------------------------------------------------------------------------------*/
-static void _myrtle_pen_down() {
-	globals.pendown = true;
+static void _myrtle_pen_char_set(myrtle_ctx_t *ctx, char ch) {
+	ctx->penchar = ch;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
@@ -646,101 +1751,641 @@ static void _myrtle_pen_down() {
  * DESCR:    Returns true if Myrtle's pen is down.
  * RETURNS:  See description.
  *------------------------------------------------------------------------------------------------------------*/
-static bool _myrtle_pen_is_down() {
-	return globals.pendown;
+static bool _myrtle_pen_is_down(myrtle_ctx_t *ctx) {
+	return ctx->pendown;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_perform()
+ * DESCR:    Step 4 of _myrtle_run(): performs the compiled commands in the way the program, ctx->jit and ctx->jobs
+ *           call for. A profiled, recorded, checkpointed, resumed or watched run is interpreted, and its profile
+ *           or trace is started, or its checkpoint or mark restored, here.
+ * RETURNS:  TERM_NORM, TERM_ERR_CMD_LINE if a program with turtle blocks is to be recorded or checkpointed,
+ *           TERM_ERR_INPUT if the checkpoint to resume from is not of this program, the status of the output file
+ *           if a watched run cannot cut it back, or the status of the command which failed.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_perform(myrtle_ctx_t *ctx) {
+	int          status, i;
+	par_turtle_t start;
+
+	if (ctx->journal) {
+		if (ctx->turtle_count > 0) return _myrtle_fail(ctx, TERM_ERR_CMD_LINE, "Turtle blocks cannot be recorded");
+		_myrtle_turtle_get(ctx, &start);
+		journal_start(ctx->journal, &ctx->world, &start);
+	}
+	if (ctx->resumable && _myrtle_checkpoint_start(ctx) != TERM_NORM) return ctx->status;
+	if (ctx->watch && _myrtle_watch_start(ctx) != TERM_NORM) return ctx->status;
+	STATS_DO(ctx->stats, _myrtle_stats_program(ctx));
+	if (ctx->prof) {
+		for (i = 0; i < ctx->proc_count; i++) prof_proc(ctx->prof, ctx->procs[i].at, ctx->procs[i].name);
+		prof_start(ctx->prof, ctx->code.words, ctx->code.count);
+	}
+	if (ctx->turtle_count > 0) status = _myrtle_exec_turtles(ctx);
+	else if (ctx->watch) status = _myrtle_exec_watch(ctx);
+	else if (_myrtle_jit_ok(ctx)) status = _myrtle_exec_jit(ctx);
+	else if (ctx->jobs > 1 && !ctx->prof && !ctx->journal && !ctx->resumable) status = _myrtle_exec_par(ctx);
+	else status = _myrtle_exec(ctx, ctx->code.words, ctx->code.words + ctx->code.count);
+	STATS_DO(ctx->stats, stats_phase(ctx->stats, STATS_NONE));
+	return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_proc_at()
+ * DESCR:    Finds the procedure whose CMD_TO is at index 'at' in ctx->code. Procedures are declared in the order
+ *           they appear, so ctx->procs is sorted by 'at' and can be searched by halves.
+ * RETURNS:  The index of the procedure in ctx->procs, or -1 if there is none at 'at'.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_proc_at(myrtle_ctx_t *ctx, int at) {
+	int lo = 0, hi = ctx->proc_count - 1;
+	while (lo <= hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (ctx->procs[mid].at == at) return mid;
+		if (ctx->procs[mid].at < at) lo = mid + 1;
+		else hi = mid - 1;
+	}
+	return -1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_proc_begin()
+ * DESCR:    Compiles 'to name', which starts a procedure. It is compiled into CMD_TO and the length of the body,
+ *           which is filled in by the matching 'end'. Performing CMD_TO just steps over the body. Procedures
+ *           cannot be nested, nor declared inside a 'repeat' block, nor used in a program with turtle blocks.
+ * RETURNS:  TERM_NORM, TERM_ERR_SYNTAX if the procedure has no name, its name is a command or another
+ *           procedure's, or it cannot be declared where it is, TERM_ERR_MEMORY if the procedure cannot be
+ *           allocated, or the status of the input file if it cannot be read.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_proc_begin(myrtle_ctx_t *ctx, const cmd_t *command) {
+	token_t  token;
+	char     buffer[160];
+	proc_t  *p;
+	int      i, len;
+
+	if (ctx->turtle_count > 0) {
+		sprintf(buffer, "'to' cannot be used with turtle blocks on line %d", _myrtle_line_get(ctx));
+		return _myrtle_fail(ctx, TERM_ERR_SYNTAX, buffer);
+	}
+	if (ctx->proc >= 0) {
+		sprintf(buffer, "Procedures cannot be nested on line %d", _myrtle_line_get(ctx));
+		return _myrtle_fail(ctx, TERM_ERR_SYNTAX, buffer);
+	}
+	if (ctx->repeat >= 0) {
+		sprintf(buffer, "Procedures cannot be declared inside 'repeat' on line %d", _myrtle_line_get(ctx));
+		return _myrtle_fail(ctx, TERM_ERR_SYNTAX, buffer);
+	}
+	if (_myrtle_operand_next(ctx, command, &token) != TERM_NORM) return ctx->status;
+	len = token.len < 64 ? token.len : 64;
+	if (_myrtle_cmd_lookup(token.text, token.len) || _myrtle_proc_find(ctx, token.text, token.len) >= 0) {
+		sprintf(buffer, "'%.*s' is already defined on line %d", len, token.text, _myrtle_line_get(ctx));
+		return _myrtle_fail(ctx, TERM_ERR_SYNTAX, buffer);
+	}
+
+	if (ctx->proc_count == ctx->proc_cap) {
+		int     cap   = ctx->proc_cap ? ctx->proc_cap * 2 : 4;
+		proc_t *procs = (proc_t *)realloc(ctx->procs, cap * sizeof(proc_t));
+		if (!procs) return _myrtle_fail(ctx, TERM_ERR_MEMORY, "Out of memory compiling program");
+		ctx->procs = procs;
+		for (; ctx->proc_cap < cap; ctx->proc_cap++) {
+			for (i = 0; i < 4; i++) stamp_init(&ctx->procs[ctx->proc_cap].stamps[i]);
+		}
+	}
+	p       = &ctx->procs[ctx->proc_count];
+	p->name = (char *)malloc(token.len + 1);
+	if (!p->name) return _myrtle_fail(ctx, TERM_ERR_MEMORY, "Out of memory compiling program");
+	memcpy(p->name, token.text, token.len);
+	p->name[token.len] = '\0';
+	p->at        = (int)ctx->code.count;
+	p->defined   = false;
+	p->stampable = false;
+	for (i = 0; i < 4; i++) stamp_reset(&p->stamps[i]);
+	ctx->proc = ctx->proc_count++;
+
+	if (code_emit(&ctx->code, CMD_TO) != TERM_NORM || code_emit(&ctx->code, 0) != TERM_NORM) {
+		return _myrtle_fail(ctx, TERM_ERR_MEMORY, "Out of memory compiling program");
+	}
+	return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_proc_call()
+ * DESCR:    Compiles a call of a procedure: 'call name' if 'command' is the 'call' command, or just 'name' in
+ *           *token if 'command' is NULL. A procedure whose body is at most INLINE_WORDS words is inlined: its
+ *           body is copied in place of the call, so performing it costs no more than if it had been written out.
+ *           A profiled run inlines nothing, so that each command is reported where it was written and under the
+ *           procedure it is in. Any other call is compiled into CMD_CALL and how far back the procedure's
+ *           CMD_TO is. A procedure must be declared before it is called, so it cannot call itself.
+ * RETURNS:  TERM_NORM, TERM_ERR_UNK_CMD if there is no such procedure, TERM_ERR_SYNTAX if the name is missing or
+ *           names the procedure being compiled, TERM_ERR_MEMORY if the program does not fit in memory, or the
+ *           status of the input file if it cannot be read.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_proc_call(myrtle_ctx_t *ctx, const cmd_t *command, token_t *token) {
+	code_t *code = &ctx->code;
+	char    buffer[160];
+	proc_t *p;
+	int     i, src, end, len, offset;
+
+	if (command && _myrtle_operand_next(ctx, command, token) != TERM_NORM) return ctx->status;
+	len = token->len < 64 ? token->len : 64;
+	i   = _myrtle_proc_find(ctx, token->text, token->len);
+	if (i < 0) {
+		sprintf(buffer, "Unknown %s '%.*s' on line %d", command ? "procedure" : "command", len, token->text,
+			_myrtle_line_get(ctx));
+		return _myrtle_fail(ctx, TERM_ERR_UNK_CMD, buffer);
+	}
+	p = &ctx->procs[i];
+	if (!p->defined) {
+		sprintf(buffer, "Procedure '%.*s' cannot call itself on line %d", len, token->text, _myrtle_line_get(ctx));
+		return _myrtle_fail(ctx, TERM_ERR_SYNTAX, buffer);
+	}
+
+	if (code->words[p->at + 1] > INLINE_WORDS || ctx->prof) {
+		ctx->calls++;
+		offset = p->at - (int)code->count;   /* How far back the CMD_TO is from the CMD_CALL. */
+		if (code_emit(code, CMD_CALL) != TERM_NORM || code_emit(code, offset) != TERM_NORM) {
+			return _myrtle_fail(ctx, TERM_ERR_MEMORY, "Out of memory compiling program");
+		}
+		return TERM_NORM;
+	}
+	/* Inline the body, an op at a time. Each copied CALL is further from its CMD_TO than the original was. */
+	src = p->at + 2;
+	end = src + code->words[p->at + 1];
+	while (src < end) {
+		int op = code->words[src];
+		int at = (int)code->count;
+		for (i = 0; i <= cmd_nargs[op]; i++) {
+			int word = code->words[src + i];
+			if (op == CMD_CALL && i == 1) {
+				word += src - at;
+				ctx->calls++;
+			}
+			if (code_emit(code, word) != TERM_NORM) {
+				return _myrtle_fail(ctx, TERM_ERR_MEMORY, "Out of memory compiling program");
+			}
+		}
+		src += 1 + cmd_nargs[op];
+	}
+	return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_proc_end()
+ * DESCR:    Compiles 'end', which ends the procedure being compiled: the length of its body is filled in, and
+ *           whether it can be stamped is worked out. It can unless it has a 'hyper', which moves Myrtle to a
+ *           square which is not relative to where she was, or a 'stop', which writes the world, or calls a
+ *           procedure which cannot be stamped.
+ * RETURNS:  TERM_NORM, or TERM_ERR_SYNTAX if a 'repeat' block inside the procedure has not been ended.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_proc_end(myrtle_ctx_t *ctx) {
+	proc_t *p = &ctx->procs[ctx->proc];
+	char    buffer[128];
+	int    *words, *pc, *end;
+
+	if (ctx->repeat >= 0) {
+		sprintf(buffer, "Missing ']' before 'end' on line %d", _myrtle_line_get(ctx));
+		return _myrtle_fail(ctx, TERM_ERR_SYNTAX, buffer);
+	}
+	words            = ctx->code.words;
+	words[p->at + 1] = (int)ctx->code.count - (p->at + 2);
+	p->stampable     = true;
+	end              = words + ctx->code.count;
+	for (pc = words + p->at + 2; pc < end && p->stampable; pc += 1 + cmd_nargs[*pc]) {
+		if (*pc == CMD_HYPER || *pc == CMD_STOP) p->stampable = false;
+		if (*pc == CMD_CALL) p->stampable = ctx->procs[_myrtle_proc_at(ctx, (int)(pc - words) + pc[1])].stampable;
+	}
+	p->defined = true;
+	ctx->proc  = -1;
+	return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_proc_exec()
+ * DESCR:    Performs the body of a procedure, from 'body' to 'end', for the CMD_CALL at 'site'. When the run is
+ *           profiled, the commands of the body are attributed to the call path through 'site' (see prof.c).
+ * RETURNS:  See _myrtle_exec().
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_proc_exec(myrtle_ctx_t *ctx, int *site, int *body, int *end) {
+	int status;
+	if (!ctx->prof) return _myrtle_exec(ctx, body, end);
+	prof_enter(ctx->prof, (int)(site - ctx->code.words), (int)(body - ctx->code.words), (int)(end - body));
+	status = _myrtle_exec(ctx, body, end);
+	prof_leave(ctx->prof);
+	return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_proc_find()
+ * DESCR:    Looks up the procedure named by the 'len' chars at 'name'.
+ * RETURNS:  Its index in ctx->procs, or -1 if there is no such procedure.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_proc_find(myrtle_ctx_t *ctx, const char *name, int len) {
+	int i;
+	for (i = 0; i < ctx->proc_count; i++) {
+		if ((int)strlen(ctx->procs[i].name) == len && !memcmp(ctx->procs[i].name, name, len)) return i;
+	}
+	return -1;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: _myrtle_pen_up()
- * DESCR:    Sets the globals.pendown variable to indicate that Myrtle's pen is up.
+ * FUNCTION: _myrtle_procs_clear()
+ * DESCR:    Forgets the procedures declared by the last program compiled. Their stamps' memory is kept for the
+ *           next one.
  * RETURNS:  Nothing.
  *------------------------------------------------------------------------------------------------------------*/
-static void _myrtle_pen_up() {
-	globals.pendown = false;
+static void _myrtle_procs_clear(myrtle_ctx_t *ctx) {
+	int i;
+	for (i = 0; i < ctx->proc_count; i++) free(ctx->procs[i].name);
+	ctx->proc_count = 0;
+	ctx->proc       = -1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_repeat_begin()
+ * DESCR:    Compiles 'repeat n [', which starts a 'repeat' block. It is compiled into CMD_REPEAT, n, and the
+ *           length of the body, which is not known until the matching ']'. Until then, that word holds the index
+ *           of the enclosing open 'repeat', or -1, so that blocks can be nested without a stack. A program with
+ *           'repeat' blocks cannot have turtle blocks, whose turtles keep time by counting commands (see par.c).
+ * RETURNS:  TERM_NORM, TERM_ERR_SYNTAX if the count or the '[' is missing or the program has turtle blocks,
+ *           TERM_ERR_MEMORY if the program does not fit in memory, or the status of the input file if it cannot
+ *           be read.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_repeat_begin(myrtle_ctx_t *ctx, const cmd_t *command) {
+	token_t token;
+	char    buffer[128];
+	int     count = 0, at = (int)ctx->code.count;
+
+	if (ctx->turtle_count > 0) {
+		sprintf(buffer, "'repeat' cannot be used with turtle blocks on line %d", _myrtle_line_get(ctx));
+		return _myrtle_fail(ctx, TERM_ERR_SYNTAX, buffer);
+	}
+	if (_myrtle_arg_next(ctx, command, &count) != TERM_NORM) return ctx->status;
+	if (_myrtle_operand_next(ctx, command, &token) != TERM_NORM) return ctx->status;
+	if (token.len != 1 || token.text[0] != '[') {
+		sprintf(buffer, "Missing '[' after 'repeat' on line %d", _myrtle_line_get(ctx));
+		return _myrtle_fail(ctx, TERM_ERR_SYNTAX, buffer);
+	}
+	if (code_emit(&ctx->code, CMD_REPEAT) != TERM_NORM || code_emit(&ctx->code, count) != TERM_NORM ||
+	    code_emit(&ctx->code, ctx->repeat) != TERM_NORM) {
+		return _myrtle_fail(ctx, TERM_ERR_MEMORY, "Out of memory compiling program");
+	}
+	ctx->repeat = at;
+	ctx->repeats++;
+	return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_repeat_end()
+ * DESCR:    Compiles ']', which ends the innermost open 'repeat' block: the length of its body is filled in.
+ * RETURNS:  TERM_NORM, or TERM_ERR_SYNTAX if there is no block to end.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_repeat_end(myrtle_ctx_t *ctx) {
+	char buffer[128];
+	int *words = ctx->code.words;
+	int  at    = ctx->repeat;
+
+	if (at < 0) {
+		sprintf(buffer, "Unexpected ']' on line %d", _myrtle_line_get(ctx));
+		return _myrtle_fail(ctx, TERM_ERR_SYNTAX, buffer);
+	}
+	ctx->repeat   = words[at + 2];
+	words[at + 2] = (int)ctx->code.count - (at + 3);
+	return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_restore()
+ * DESCR:    Restores the checkpoint ctx->restored, which the run is resuming from: Myrtle and her world are put
+ *           back as they were, and its frames are copied to ctx->frames for _myrtle_frame_enter() to enter again.
+ *           The checkpoint must have been taken of this program, and each of its frames must be a command of the
+ *           program in the body of the 'repeat' or call of the frame before it, or, for the first, at the top.
+ * RETURNS:  TERM_NORM, TERM_ERR_INPUT if the checkpoint is not of this program, or TERM_ERR_MEMORY if the world
+ *           or the frames cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_restore(myrtle_ctx_t *ctx) {
+	const checkpoint_t *restored = &ctx->restored;
+	int                *words    = ctx->code.words;
+	long                first    = 0, last = (long)ctx->code.count, pc = 0, i;
+	char                buffer[160];
+
+	for (i = 0; i < restored->depth && restored->program == ctx->program; i++) {
+		const checkpoint_frame_t *frame = &restored->frames[i];
+		for (pc = first; pc < last && pc < frame->pc; ) {
+			long next = pc + 1 + cmd_nargs[words[pc]];
+			if (words[pc] == CMD_REPEAT) next += words[pc + 2];
+			if (words[pc] == CMD_TO) next += words[pc + 1];
+			pc = next;
+		}
+		if (pc != frame->pc || pc >= last || i == restored->depth - 1) break;
+		if (words[pc] == CMD_REPEAT && frame->rep >= 0 && frame->rep < frame->plan.first + frame->plan.last) {
+			first = pc + 3;
+			last  = first + words[pc + 2];
+		} else if (words[pc] == CMD_CALL && pc + words[pc + 1] >= 0 && pc + words[pc + 1] < last) {
+			first = pc + words[pc + 1] + 2;
+			last  = first + words[first - 1];
+		} else {
+			break;
+		}
+	}
+	if (restored->program != ctx->program || i != restored->depth - 1 || pc != restored->frames[i].pc ||
+	    pc >= last) {
+		sprintf(buffer, "The checkpoint '%.100s' was not taken of this program", ctx->restore);
+		return _myrtle_fail(ctx, TERM_ERR_INPUT, buffer);
+	}
+
+	if (world_load(&ctx->world, restored->cells) != TERM_NORM) return _myrtle_world_status(ctx, TERM_ERR_MEMORY);
+	_myrtle_turtle_set(ctx, &restored->turtle);
+	if (restored->depth > ctx->frame_cap) {
+		checkpoint_frame_t *frames = (checkpoint_frame_t *)realloc(ctx->frames,
+		                                                           restored->depth * sizeof(checkpoint_frame_t));
+		if (!frames) return _myrtle_fail(ctx, TERM_ERR_MEMORY, "Out of memory performing program");
+		ctx->frames    = frames;
+		ctx->frame_cap = restored->depth;
+	}
+	memcpy(ctx->frames, restored->frames, restored->depth * sizeof(checkpoint_frame_t));
+	ctx->resume          = restored->depth;
+	ctx->performed       = restored->commands;
+	ctx->last_checkpoint = restored->commands;
+	return TERM_NORM;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
  * FUNCTION: _myrtle_row_get()
- * DESCR:    Accessor function for globals.row.
- * RETURNS:  The value of the int globals.row variable.
+ * DESCR:    Accessor function for ctx->row.
+ * RETURNS:  The value of the coord_t ctx->row variable.
  *------------------------------------------------------------------------------------------------------------*/
-static int _myrtle_row_get() {
-	return globals.row;
+static coord_t _myrtle_row_get(myrtle_ctx_t *ctx) {
+	return ctx->row;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
  * FUNCTION: _myrtle_row_set()
- * DESCR:    Mutator function for globals.row. Note that as Myrtle is moving, if she reaches either the north
- *           or south border of her world, she stops moving and essentially just keeps banging her head against
- *           the wall.
+ * DESCR:    Mutator function for ctx->row. Note that as Myrtle is moving, if she reaches either the north or
+ *           south border of her world, she stops moving and essentially just keeps banging her head against the
+ *           wall.
  * RETURNS:  Nothing.
  *------------------------------------------------------------------------------------------------------------*/
-static void _myrtle_row_set(int row) {
+static void _myrtle_row_set(myrtle_ctx_t *ctx, coord_t row) {
 	/* Hint: see _myrtle_col_set(). This function is very similar. */
-	if (row < 0) globals.row = 0;
-	else if (row >= MAX_WORLD_ROWS) globals.row = MAX_WORLD_ROWS - 1;
-	else globals.row = row;
+	if (row < 0) ctx->row = 0;
+	else if (row >= ctx->world.rows) ctx->row = ctx->world.rows - 1;
+	else ctx->row = row;
 }
 
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: _myrtle_world_clear()
- * DESCR:    Clears all of the squares in Myrtle's world to the space char.
- * RETURNS:  Nothing.
+ * FUNCTION: _myrtle_run()
+ * DESCR:    Implements the interpreter for the Myrtle programming language. The input and output of ctx->file
+ *           have already been opened by the caller.
+ * RETURNS:  TERM_NORM on success, a negative TERM_ERR_* code on failure.
  * PSEUDOCODE:
- * 1. Write nested for row/for col loops which iterate over each row and col of the globals.world[][] array.
- *    a. Put a space in each array element.
- *------------------------------------------------------------------------------------------------------------*/
-static void _myrtle_world_clear() {
-	int r, c;
-	for(r = 0; r< MAX_WORLD_ROWS; ++r){
-		for(c = 0; c<MAX_WORLD_COLS; ++c){
-			globals.world[r][c] = ' ';
-		}
-	}
+ * 1. Reset Myrtle: pen up, pen char ' ', facing east at 0, 0, and no error.
+ * 2. Call world_reset() to initialize Myrtle's world at the size in ctx, reusing the memory of the world of the
+ *    previous run if it is the same size.
+ * 3. Call _myrtle_compile() to translate the entire input file into ctx->code. Syntax errors are reported here,
+ *    before any command is performed. Then call _myrtle_optimize(), which optimizes ctx->code if -O was given.
+ * 4. Call _myrtle_exec() to perform the compiled commands, or _myrtle_exec_par() if ctx->jobs is more than one.
+ *    If the program declared turtles, call _myrtle_exec_turtles() to perform everyone's commands instead. With
+ *    ctx->jit on, call _myrtle_exec_jit() to run the program as native code instead, if it can be.
+ * 5. Call _myrtle_world_write() to write Myrtle's world to the output file. The world is kept for
+ *    myrtle_ctx_world().
+ * Steps 1 to 3 are _myrtle_load() and step 4 is _myrtle_perform().
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_run(myrtle_ctx_t *ctx) {
+	int status;
+
+	/* 1 - 3. Reset Myrtle and her world, and compile the program. */
+	status = _myrtle_load(ctx);
+
+	/* 4. Perform the compiled commands. */
+	if (status == TERM_NORM) status = _myrtle_perform(ctx);
+
+	/* 5. Write Myrtle's world to the output file. */
+	if (status == TERM_NORM) status = _myrtle_world_write(ctx);
+	if (ctx->prof) prof_stop(ctx->prof);
+	if (ctx->journal) _myrtle_journal_command(ctx, -1);
+	STATS_DO(ctx->stats, _myrtle_stats_end(ctx));
+	return status;
 }
 
+#ifndef MYRTLE_NO_STATS
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: _myrtle_world_draw_char()
- * DESCR:    Draws the current globals.penchar character in the square Myrtle is in.
+ * FUNCTION: _myrtle_stats_end()
+ * DESCR:    Ends the statistics of a run, however it ended: records the bytes of input read and ends the phase.
  * RETURNS:  Nothing.
  *------------------------------------------------------------------------------------------------------------*/
-static void _myrtle_world_draw_char() {
-	if (!_myrtle_pen_is_down()) return;
-	globals.world[_myrtle_row_get()][_myrtle_col_get()] = _myrtle_pen_char_get();
+static void _myrtle_stats_end(myrtle_ctx_t *ctx) {
+	ctx->stats->bytes = ctx->file.in_read;
+	stats_end(ctx->stats);
 }
 
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: _myrtle_world_init()
- * DESCR:    Initializes Myrtle's world by dynamically allocating a 2D-array of chars. Each square in the world
- *           is set to the space char.
+ * FUNCTION: _myrtle_stats_program()
+ * DESCR:    Counts the commands the compiled program, Myrtle's and every turtle's, is about to perform (see
+ *           stats_program()) and starts timing the exec phase.
  * RETURNS:  Nothing.
- * PSEUDOCODE:
- * 1. Dynamically allocate a 2D-array of chars with MAX_WORLD_ROWS rows and MAX_WORLD_COLS cols.
- * 2. Call _myrtle_world_clear() to initialize each square in Myrtle's world to the space char.
  *------------------------------------------------------------------------------------------------------------*/
-static void _myrtle_world_init() {
-	/*1. Dynamically allocate a 2D-array of chars with MAX_WORLD_ROWS rows and MAX_WORLD_COLS cols.*/
-	int r;
-	globals.world = (char**)malloc(MAX_WORLD_ROWS * sizeof(char*));
-	for(r=0;r < MAX_WORLD_ROWS; r++){
-		globals.world[r] = (char*)malloc(MAX_WORLD_COLS * sizeof(char));
+static void _myrtle_stats_program(myrtle_ctx_t *ctx) {
+	int i;
+	stats_program(ctx->stats, ctx->code.words, ctx->code.count);
+	for (i = 0; i < ctx->turtle_count; i++) {
+		stats_program(ctx->stats, ctx->turtles[i].code.words, ctx->turtles[i].code.count);
 	}
+	stats_phase(ctx->stats, STATS_EXEC);
+}
+#endif
 
-	/*2. Call _myrtle_world_clear() to initialize each square in Myrtle's world to the space char. */
-	_myrtle_world_clear();
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_trace()
+ * DESCR:    In verbose mode, writes the commands from 'pc' to 'end' to ctx->trace as _myrtle_exec() would as it
+ *           performed them. Used for the commands which par_exec() performed.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _myrtle_trace(myrtle_ctx_t *ctx, int *pc, int *end) {
+	if (!ctx->trace) return;
+	for (; pc < end; pc += 1 + cmd_nargs[*pc]) {
+		fprintf(ctx->trace, "Performing command: %s\n", _myrtle_cmd_name(*pc));
+	}
 }
 
 /*--------------------------------------------------------------------------------------------------------------
- * FUNCTION: _myrtle_world_write()
- * DESCR:    Writes the 2D-array of char representing Myrtle's world to the output file.
+ * FUNCTION: _myrtle_turtle_get()
+ * DESCR:    Copies Myrtle's state into *turtle, for par.c.
  * RETURNS:  Nothing.
  *------------------------------------------------------------------------------------------------------------*/
-static void _myrtle_world_write() {
-	int row, col;
-	for (row = 0; row < MAX_WORLD_ROWS; row++) {
-		for (col = 0; col < MAX_WORLD_COLS; col++) {
-			file_write_char(globals.world[row][col]);
-		}
-		file_write_char('\n');
+static void _myrtle_turtle_get(myrtle_ctx_t *ctx, par_turtle_t *turtle) {
+	turtle->row     = _myrtle_row_get(ctx);
+	turtle->col     = _myrtle_col_get(ctx);
+	turtle->dir     = _myrtle_dir_get(ctx);
+	turtle->pendown = _myrtle_pen_is_down(ctx);
+	turtle->penchar = _myrtle_pen_char_get(ctx);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_turtle_set()
+ * DESCR:    Sets Myrtle's state from *turtle, after par.c has performed her commands.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _myrtle_turtle_set(myrtle_ctx_t *ctx, const par_turtle_t *turtle) {
+	_myrtle_row_set(ctx, turtle->row);
+	_myrtle_col_set(ctx, turtle->col);
+	_myrtle_dir_set(ctx, turtle->dir);
+	ctx->pendown = turtle->pendown;
+	_myrtle_pen_char_set(ctx, turtle->penchar);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_turtles_clear()
+ * DESCR:    Forgets the turtles declared by the last program compiled. Their code is kept for the next one.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _myrtle_turtles_clear(myrtle_ctx_t *ctx) {
+	int i;
+	for (i = 0; i < ctx->turtle_count; i++) free(ctx->turtles[i].name);
+	ctx->turtle_count = 0;
+	ctx->block        = -1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_watch_compile()
+ * DESCR:    Step 3 of _myrtle_run() for a watched run. The input file is compiled on from the last mark whose
+ *           input has not changed (see watch_start()), keeping the program, procedures and counts compiled before
+ *           it, or from the beginning. The words compiled over are kept, and once the rest has been compiled the
+ *           run resumes from the last mark before the first word which changed (see watch_resume()). If the file
+ *           does not compile, the marks after the one it was compiled from are dropped, since the program they
+ *           were taken of is gone. Only a run of a mapped input file may resume. The program is not optimized or
+ *           cached.
+ * RETURNS:  TERM_NORM, TERM_ERR_CMD_LINE if the run is profiled, recorded or checkpointed, TERM_ERR_MEMORY if
+ *           the words compiled over cannot be kept, or the status of _myrtle_compile().
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_watch_compile(myrtle_ctx_t *ctx) {
+	watch_t           *watch = ctx->watch;
+	const watch_loc_t *loc   = NULL;
+	long               match = -1;
+	int                i;
+
+	if (ctx->prof || ctx->journal || ctx->resumable) {
+		return _myrtle_fail(ctx, TERM_ERR_CMD_LINE, "A watched run cannot be profiled, recorded or checkpointed");
+	}
+	if (ctx->file.in_mapped) {
+		match = watch_start(watch, ctx->file.in_buf, ctx->file.in_len);
+	} else {
+		watch_drop(watch, -1);
+		watch->loc_count = 0;
 	}
+	if (match >= 0) loc = &watch->marks[match].loc;
+	if (!watch_keep(watch, ctx->code.words, loc ? loc->pc : 0, watch->mark_count ? (long)ctx->code.count : 0)) {
+		return _myrtle_fail(ctx, TERM_ERR_MEMORY, "Out of memory compiling program");
+	}
+
+	if (loc) {
+		for (i = loc->procs; i < ctx->proc_count; i++) free(ctx->procs[i].name);
+		ctx->proc_count = loc->procs;
+		ctx->proc       = -1;
+		ctx->code.count = loc->pc;
+		ctx->repeats    = loc->repeats;
+		ctx->calls      = loc->calls;
+		file_skip_in(&ctx->file, loc->offset, loc->line);
+	} else {
+		ctx->code.count = 0;
+		ctx->repeats    = 0;
+		ctx->calls      = 0;
+		_myrtle_procs_clear(ctx);
+	}
+	if (_myrtle_compile(ctx) != TERM_NORM) {
+		watch_drop(watch, match);
+		return ctx->status;
+	}
+
+	if (ctx->file.in_mapped && ctx->turtle_count == 0) {
+		watch_resume(watch, ctx->code.words, (long)ctx->code.count, ctx->file.in_buf, match);
+	} else {
+		watch_drop(watch, -1);
+		watch->resumed = -1;
+		watch->line    = 0;
+	}
+	return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_watch_loc()
+ * DESCR:    Called by _myrtle_compile() in a watched run at 'token', the first token of a top-level command:
+ *           notes where the command came from and what had been compiled before it (see watch_loc()). Only the
+ *           commands of a mapped input file are noted, since no other input can be compiled on from them.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the location cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_watch_loc(myrtle_ctx_t *ctx, const token_t *token) {
+	watch_loc_t loc;
+
+	if (!ctx->file.in_mapped) return TERM_NORM;
+	loc.pc      = (long)ctx->code.count;
+	loc.offset  = (size_t)(token->text - ctx->file.in_buf);
+	loc.line    = token->line;
+	loc.procs   = ctx->proc_count;
+	loc.repeats = ctx->repeats;
+	loc.calls   = ctx->calls;
+	if (!watch_loc(ctx->watch, &loc)) return _myrtle_fail(ctx, TERM_ERR_MEMORY, "Out of memory compiling program");
+	return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_watch_start()
+ * DESCR:    Gets a watched run ready to be performed: restores Myrtle and her world from the mark it resumes from,
+ *           if there is one, and cuts the output back to what had been written before it, or to nothing. If the
+ *           output is not a file, or is shorter than the mark says, the run starts from the beginning.
+ * RETURNS:  TERM_NORM, the status of the output file if it cannot be cut back, or TERM_ERR_MEMORY if the world
+ *           cannot be restored.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_watch_start(myrtle_ctx_t *ctx) {
+	watch_t            *watch = ctx->watch;
+	const watch_mark_t *mark  = watch->resumed >= 0 ? &watch->marks[watch->resumed] : NULL;
+
+	if (mark && (ctx->file.fout < 2 || mark->output > ctx->file.out_total)) {
+		watch_drop(watch, -1);
+		watch->resumed = -1;
+		watch->line    = 0;
+		mark           = NULL;
+	}
+	if (file_cut_out(&ctx->file, mark ? mark->output : 0) != TERM_NORM) {
+		return _myrtle_fail(ctx, ctx->file.status, ctx->file.error);
+	}
+	if (!mark) return TERM_NORM;
+	if (world_load(&ctx->world, mark->cells) != TERM_NORM) return _myrtle_world_status(ctx, TERM_ERR_MEMORY);
+	_myrtle_turtle_set(ctx, &mark->turtle);
+	return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_world_draw_char()
+ * DESCR:    Draws the current ctx->penchar character in the square Myrtle is in, if the pen is down.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the world cannot grow to hold the char.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_world_draw_char(myrtle_ctx_t *ctx) {
+	if (!_myrtle_pen_is_down(ctx)) return TERM_NORM;
+	if (ctx->journal) journal_fill(ctx->journal, false, ctx->row, ctx->col, 1, _myrtle_pen_char_get(ctx));
+	return _myrtle_world_status(ctx,
+		world_draw(&ctx->world, _myrtle_row_get(ctx), _myrtle_col_get(ctx), _myrtle_pen_char_get(ctx)));
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_world_status()
+ * DESCR:    Turns the status returned by world_init() or a world_draw()/world_fill_*() into an error on 'ctx'.
+ * RETURNS:  'status'.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_world_status(myrtle_ctx_t *ctx, int status) {
+	if (status == TERM_NORM) return TERM_NORM;
+	return _myrtle_fail(ctx, status, "Out of memory allocating Myrtle's world");
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _myrtle_world_write()
+ * DESCR:    Writes Myrtle's world to the output file.
+ * RETURNS:  TERM_NORM, TERM_ERR_MEMORY if the world cannot be written for lack of memory, or the status of the
+ *           output file if it cannot be written.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _myrtle_world_write(myrtle_ctx_t *ctx) {
+	int status;
+	STATS_DO(ctx->stats, stats_phase(ctx->stats, STATS_WRITE));
+	status = world_write(&ctx->world, &ctx->file);
+	STATS_DO(ctx->stats, stats_phase(ctx->stats, STATS_NONE));
+	if (status == TERM_NORM) return TERM_NORM;
+	if (ctx->file.status != TERM_NORM) return _myrtle_fail(ctx, ctx->file.status, ctx->file.error);
+	return _myrtle_fail(ctx, status, "Out of memory writing Myrtle's world");
 }
@@ -8,6 +8,25 @@
  *
  * MODIFICATION HISTORY:
  * 20111010T1747 [JMW] added ifndef, define directives; added CMD_ macros
+ * 20261016T0900 [JMW] added CMD_BACKWARD and CMD_STOP
+ * 20261016T1000 [JMW] CMD_* constants are generated from cmds.def; added MYRTLE_CMD_HASH()
+ * 20261016T1500 [JMW] added myrtle_world_layout_set() and myrtle_world_size_set()
+ * 20261016T1800 [JMW] replaced myrtle_interp() and the setters with the reentrant myrtle_ctx_* API
+ * 20261016T1900 [JMW] added myrtle_ctx_clone()
+ * 20261016T2000 [JMW] added myrtle_ctx_jobs_set(); the DIR_* macros moved here from myrtle.c
+ * 20261016T2200 [JMW] added myrtle_ctx_run_lanes(), myrtle_ctx_run_lanes_file() and myrtle_ctx_status()
+ * 20261016T2300 [JMW] added myrtle_ctx_optimize_set() and myrtle_ctx_removed()
+ * 20261017T0200 [JMW] added myrtle_ctx_jit_set()
+ * 20261017T0300 [JMW] added myrtle_ctx_cache_set()
+ * 20261017T0500 [JMW] added myrtle_ctx_stats_set()
+ * 20261017T0600 [JMW] added myrtle_ctx_prof_set()
+ * 20261017T0700 [JMW] added myrtle_ctx_journal_set(), myrtle_ctx_replay_file() and myrtle_ctx_replayed()
+ * 20261017T0800 [JMW] added myrtle_ctx_checkpoint_set(), myrtle_ctx_restore_set() and MYRTLE_CHECKPOINT_*
+ * 20261017T0900 [JMW] added myrtle_ctx_watch_set()
+ * 20261017T1100 [JMW] added cmd_names[] and cmd_nargs[]
+ * 20261017T1200 [JMW] added myrtle_ctx_lanes_impl_set()
+ * 20261017T1300 [JMW] the myrtle_ctx_*lanes* functions are only declared with MYRTLE_LANES
+ * 20261017T1400 [JMW] removed myrtle_ctx_lanes_impl_set(), myrtle_ctx_run_lanes() and myrtle_ctx_run_lanes_file()
  * ------------------------------------------------------------------------------------------------------------
  * 01 Oct 2011 [KRB] Initial revision.
  **************************************************************************************************************/
@@ -17,23 +36,100 @@
 #define __MYRTLE_H__
 
 /* You need to #include one header file here. I wonder which one it is. */
+#include <signal.h>   /* For sig_atomic_t. */
+#include <stdio.h>    /* For FILE. */
+#include "bool.h"     /* For bool. */
 #include "globals.h"
+#include "world.h"    /* For world_t. */
 
 /*--------------------------------------------------------------------------------------------------------------
  * PREPROCESSOR MACRO DEFINITIONS
  *
- * Use #define to define CMD_FORWARD as 1, CMD_HYPER as 2, CMD_LEFT as 3, CMD_PENCHAR as 4, CMD_PENDOWN as 5,
- * CMD_PENUP as 6, and CMD_RIGHT as 7.
+ * MYRTLE_CMD_HASH() is the hash function for command strings. 's' is the command and 'len' its length in chars;
+ * 'len_mult', 'first_mult' and 'mask' are the parameters chosen by mkcmds, which searches for values that make
+ * the hash perfect (no two commands in cmds.def share a slot). The generated values are in cmds_hash.h.
+ *------------------------------------------------------------------------------------------------------------*/
+#define MYRTLE_CMD_HASH(s, len, len_mult, first_mult, mask) \
+    (((len) * (len_mult) + (unsigned char)(s)[0] * (first_mult) + (unsigned char)(s)[(len) - 1]) & (mask))
+
+/*--------------------------------------------------------------------------------------------------------------
+ * The directions Myrtle can face, in clockwise order. They are here rather than in myrtle.c because par.c
+ * follows Myrtle around too.
+ *
+ * I have a good reason for defining these constants as preprocessor macros rather than using the const reserv-
+ * ed word. The reason is that in the initialization of the 'globals' variable on line x, I want to initialize
+ * 'dir' to DIR_EAST. If DIR_EAST were defined using "static const int DIR_EAST = 1", then I would not be able
+ * to use the static constant in that initialization because... well, for some reason I don't quite understand.
+ * All I know is that the gcc C compiler barfed on that line, so I switched these to be preprocessor macros.  
+ *------------------------------------------------------------------------------------------------------------*/
+#define DIR_NORTH 0
+#define DIR_EAST  1
+#define DIR_SOUTH 2
+#define DIR_WEST  3
+
+/*--------------------------------------------------------------------------------------------------------------
+ * What a signal handler stores in the flag given to myrtle_ctx_checkpoint_set(): take a checkpoint and go on,
+ * or take one and stop the run.
+ *------------------------------------------------------------------------------------------------------------*/
+#define MYRTLE_CHECKPOINT_GO   1
+#define MYRTLE_CHECKPOINT_STOP 2
+
+/*--------------------------------------------------------------------------------------------------------------
+ * ENUMERATED CONSTANTS
+ *
+ * The CMD_* constants are generated from cmds.def, so there is one for every command and they are numbered 0,
+ * 1, 2, ... in the order of that list. They are also the opcodes of the compiled program (see code.h) and the
+ * index of each command in the command table in myrtle.c. CMD_COUNT is the number of commands.
+ *------------------------------------------------------------------------------------------------------------*/
+enum {
+#define MYRTLE_CMD(name, str, nargs, usage, help) CMD_##name,
+#include "cmds.def"
+#undef MYRTLE_CMD
+    CMD_COUNT
+};
+
+/*--------------------------------------------------------------------------------------------------------------
+ * GLOBAL CONSTANT DECLARATIONS
  *
- * Note: These constants could have been defined using "const int ... ".
+ * cmd_names -- How each CMD_* opcode is written in a Myrtle source code file.
+ * cmd_nargs -- The number of operands which follow each CMD_* opcode in the compiled program, so the command
+ *              after the one at pc is at pc + 1 + cmd_nargs[*pc].
+ *
+ * Both are defined in myrtle.c, from cmds.def.
+ *------------------------------------------------------------------------------------------------------------*/
+extern const char *const cmd_names[CMD_COUNT];
+extern const int         cmd_nargs[CMD_COUNT];
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * An interpreter context: the options, Myrtle's state, her world and the input and output of a run. Everything
+ * the interpreter uses lives in one, so a program embedding Myrtle can create as many as it likes and run them
+ * at the same time, one per thread. The members are private to myrtle.c; use the myrtle_ctx_* functions.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct myrtle_ctx myrtle_ctx_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * The statistics kept by a run. See stats.h, which includes this file.
+ *------------------------------------------------------------------------------------------------------------*/
+struct stats;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * The profile kept by a run. See prof.h. Only one run in the process can be timed at a time; the profile of a
+ * run started while another context's run is being profiled has squares but no samples, and is marked
+ * incomplete (see myrtle_ctx_prof_set()).
+ *------------------------------------------------------------------------------------------------------------*/
+struct prof;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * The trace a run is recorded in. See journal.h.
+ *------------------------------------------------------------------------------------------------------------*/
+struct journal;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * What watch mode keeps from one run of a script to the next. See watch.h, which includes this file.
  *------------------------------------------------------------------------------------------------------------*/
-#define CMD_FORWARD 1
-#define CMD_HYPER 2
-#define CMD_LEFT 3
-#define CMD_PENCHAR 4
-#define CMD_PENDOWN 5
-#define CMD_PENUP 6
-#define CMD_RIGHT 7
+struct watch;
 
 /*--------------------------------------------------------------------------------------------------------------
  * NONSTATIC FUNCTION DECLARATIONS (PROTOTYPES)
@@ -52,9 +148,33 @@
  *
  * Hint: Think of the word "extern" as meaning "public".
  *------------------------------------------------------------------------------------------------------------*/
-extern int  myrtle_interp();
-extern bool myrtle_verbose_get();
-extern void myrtle_verbose_set(bool);
+extern void          myrtle_ctx_cache_set(myrtle_ctx_t *ctx, bool cache, const char *dir);
+extern void          myrtle_ctx_checkpoint_set(myrtle_ctx_t *ctx, const char *fname, long every, bool at_stop,
+                                               volatile sig_atomic_t *signalled);
+extern myrtle_ctx_t *myrtle_ctx_clone(myrtle_ctx_t *ctx);
+extern myrtle_ctx_t *myrtle_ctx_create();
+extern void          myrtle_ctx_destroy(myrtle_ctx_t *ctx);
+extern const char   *myrtle_ctx_error(myrtle_ctx_t *ctx);
+extern void          myrtle_ctx_jit_set(myrtle_ctx_t *ctx, bool jit);
+extern void          myrtle_ctx_jobs_set(myrtle_ctx_t *ctx, int jobs);
+extern void          myrtle_ctx_journal_set(myrtle_ctx_t *ctx, struct journal *journal);
+extern void          myrtle_ctx_optimize_set(myrtle_ctx_t *ctx, bool optimize);
+extern char         *myrtle_ctx_output(myrtle_ctx_t *ctx, size_t *len);
+extern void          myrtle_ctx_prof_set(myrtle_ctx_t *ctx, struct prof *prof);
+extern long          myrtle_ctx_removed(myrtle_ctx_t *ctx, long *commands);
+extern int           myrtle_ctx_replay_file(myrtle_ctx_t *ctx, const char *trace_fname, long at,
+                                            const char *out_fname);
+extern long          myrtle_ctx_replayed(myrtle_ctx_t *ctx, long *total, const char **last);
+extern void          myrtle_ctx_restore_set(myrtle_ctx_t *ctx, const char *fname);
+extern int           myrtle_ctx_run(myrtle_ctx_t *ctx, const char *src, size_t len);
+extern int           myrtle_ctx_run_file(myrtle_ctx_t *ctx, const char *in_fname, const char *out_fname);
+extern bool          myrtle_ctx_stats_set(myrtle_ctx_t *ctx, struct stats *stats);
+extern int           myrtle_ctx_status(myrtle_ctx_t *ctx);
+extern void          myrtle_ctx_verbose_set(myrtle_ctx_t *ctx, FILE *trace);
+extern void          myrtle_ctx_watch_set(myrtle_ctx_t *ctx, struct watch *watch);
+extern world_t      *myrtle_ctx_world(myrtle_ctx_t *ctx);
+extern void          myrtle_ctx_world_layout_set(myrtle_ctx_t *ctx, int layout);
+extern void          myrtle_ctx_world_size_set(myrtle_ctx_t *ctx, coord_t rows, coord_t cols);
 
 /* What goes here at the end of a header file? */
 #endif
@@ -0,0 +1,355 @@
+/***************************************************************************************************************
+ * FILE: opt.c
+ *
+ * DESCRIPTION:
+ * The optimizer which -O runs over a compiled program (see code.h) between compiling and performing it. Script
+ * generators write a lot of commands which do nothing that can be seen: 'forward 3 forward 4' where one move
+ * would do, 'left right', four 'right's in a row, the pen going up and down again, and long chains of moves with
+ * the pen up on the way to the next thing to draw. The optimizer rewrites the program into one with fewer
+ * commands which draws exactly the same worlds.
+ *
+ * A Myrtle program has no branches and reads no input, so the optimizer knows, at every command, exactly where
+ * Myrtle is, which way she faces and what her pen is doing. It follows two turtles through the program: the
+ * one the original program moves ('want'), and the one the optimized program moves ('have'). Only three kinds of
+ * command can be seen in the output: a move with the pen down, a 'hyper' with the pen down, and a 'stop'. Every
+ * other command only changes 'want', and costs nothing in the optimized program. When the original program comes
+ * to one of the three, the optimizer emits just enough commands to bring 'have' to the state the command needs,
+ * and then the command:
+ *
+ *     - a move with the pen down needs Myrtle where 'want' is, facing along the line of the move (either way,
+ *       since 'forward' and 'backward' are the same move turned around, so it needs at most one turn), and the
+ *       pen down with the right char. She gets where she needs to be with the pen up, by one 'forward' if she
+ *       is already on the right row or col, or by one 'hyper'. Moves one after another along the same line in
+ *       the same direction are merged into one, which draws the same squares.
+ *     - a 'hyper' with the pen down needs the pen down with the right char. It is emitted with the position it
+ *       clamps to, which the optimizer works out with the same clamping as _myrtle_row_set() and
+ *       _myrtle_col_set(), so what it emits is never clamped again.
+ *     - a 'stop' needs nothing.
+ *
+ * A 'repeat' block is copied as it is, once 'have' has been brought exactly to 'want', since its body sees the
+ * whole state. Its effect on 'want' is worked out with repeat_advance() without performing it. A block whose
+ * count is not positive does nothing and is dropped. So are procedures: a program which still has a 'call' once
+ * small procedures have been inlined is not optimized, so every procedure left in it is never called.
+ *
+ * Whatever the original program does after its last command which can be seen is dropped. If the rewritten
+ * program would not be shorter, the original is kept.
+ *
+ * Programs with turtle blocks are not optimized: the turtles keep time by counting commands (see par.c), so
+ * removing any would change which turtle draws last in a square. Nor are worlds with more than INT_MAX rows or
+ * cols, whose positions do not fit an operand.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * 20261017T0000 [JMW] 'repeat' blocks are copied as they are
+ * 20261017T0100 [JMW] procedures are dropped
+ * 20261017T1100 [JMW] operand counts come from cmd_nargs[] in myrtle.c
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261016T2300 [JMW] Initial revision.
+ **************************************************************************************************************/
+#include <limits.h>
+#include "bool.h"
+#include "code.h"
+#include "globals.h"
+#include "myrtle.h"
+#include "opt.h"
+#include "par.h"
+#include "repeat.h"
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * The state of the optimizer as it works through a program.
+ *
+ * out        -- The optimized program.
+ * want       -- Myrtle as the original program has left her.
+ * have       -- Myrtle as the optimized program has left her.
+ * rows, cols -- The size of her world.
+ * last       -- The index in out->words of the operand of the last command emitted, if it was a move with the
+ *               pen down, so that the next move can be merged into it. -1 otherwise.
+ * last_dir   -- The DIR_* direction that move went in.
+ * emitted    -- The number of commands emitted.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    code_t       *out;
+    par_turtle_t  want;
+    par_turtle_t  have;
+    coord_t       rows;
+    coord_t       cols;
+    long          last;
+    int           last_dir;
+    long          emitted;
+} opt_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+static coord_t _opt_clamp(coord_t pos, coord_t size);
+static int     _opt_draw(opt_t *o, int dir, int squares);
+static int     _opt_emit(opt_t *o, int op, int arg1, int arg2);
+static void    _opt_move(opt_t *o, par_turtle_t *turtle, int dir, int squares);
+static int     _opt_pen(opt_t *o);
+static int     _opt_place(opt_t *o);
+static int     _opt_repeat(opt_t *o, const int *pc);
+static int     _opt_sync(opt_t *o);
+
+/*======================================= NONSTATIC FUNCTION DEFINITIONS =====================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: opt_code()
+ * DESCR:    Optimizes the program in 'code', which Myrtle starts in state *start in a world of 'rows' x 'cols'.
+ *           The optimized program is built in 'scratch', whose memory is reused from run to run, and swapped
+ *           with 'code' if it is shorter. *commands is the number of commands in the original program, and
+ *           *removed how many fewer the optimized one has.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the optimized program does not fit in memory, in which case 'code'
+ *           is left as it was.
+ *------------------------------------------------------------------------------------------------------------*/
+int opt_code(code_t *code, code_t *scratch, const par_turtle_t *start, coord_t rows, coord_t cols,
+             long *commands, long *removed) {
+    const int *pc  = code->words;
+    const int *end = code->words + code->count;
+    const int *next;
+    opt_t      o;
+    int        status = TERM_NORM;
+
+    *commands = *removed = 0;
+    if (rows > INT_MAX || cols > INT_MAX) return TERM_NORM;
+
+    scratch->count = 0;
+    o.out      = scratch;
+    o.want     = *start;
+    o.have     = *start;
+    o.rows     = rows;
+    o.cols     = cols;
+    o.last     = -1;
+    o.last_dir = DIR_EAST;
+    o.emitted  = 0;
+
+    for (; pc < end && status == TERM_NORM; pc = next) {
+        next = pc + 1 + cmd_nargs[*pc];
+        ++*commands;
+        switch (*pc) {
+        case CMD_BACKWARD:
+        case CMD_FORWARD:
+            if (pc[1] > 0) {
+                int dir = (*pc == CMD_FORWARD) ? o.want.dir : (o.want.dir + 2) & 3;
+                if (o.want.pendown) status = _opt_draw(&o, dir, pc[1]);
+                _opt_move(&o, &o.want, dir, pc[1]);
+            }
+            break;
+        case CMD_HYPER:
+            o.want.row = _opt_clamp(pc[1], rows);
+            o.want.col = _opt_clamp(pc[2], cols);
+            if (o.want.pendown && (status = _opt_pen(&o)) == TERM_NORM) {
+                status     = _opt_emit(&o, CMD_HYPER, (int)o.want.row, (int)o.want.col);
+                o.have.row = o.want.row;
+                o.have.col = o.want.col;
+            }
+            break;
+        case CMD_LEFT:    o.want.dir     = (o.want.dir + 3) & 3; break;
+        case CMD_PENCHAR: o.want.penchar = (char)pc[1];          break;
+        case CMD_PENDOWN: o.want.pendown = true;                 break;
+        case CMD_PENUP:   o.want.pendown = false;                break;
+        case CMD_REPEAT:
+            status = _opt_repeat(&o, pc);
+            next  += pc[2];
+            break;
+        case CMD_RIGHT:   o.want.dir     = (o.want.dir + 1) & 3; break;
+        case CMD_STOP:    status = _opt_emit(&o, CMD_STOP, 0, 0); break;
+        case CMD_TO:      next += pc[1];                          break;
+        }
+    }
+    if (status != TERM_NORM) {
+        *commands = 0;
+        return status;
+    }
+
+    if (o.emitted < *commands) {
+        code_t swap = *code;
+        *code    = *scratch;
+        *scratch = swap;
+        *removed = *commands - o.emitted;
+    }
+    return TERM_NORM;
+}
+
+/*========================================= STATIC FUNCTION DEFINITIONS ======================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _opt_clamp()
+ * DESCR:    Clamps 'pos' to 0 .. size - 1, as _myrtle_row_set() and _myrtle_col_set() do.
+ * RETURNS:  The clamped position.
+ *------------------------------------------------------------------------------------------------------------*/
+static coord_t _opt_clamp(coord_t pos, coord_t size) {
+    if (pos < 0) return 0;
+    if (pos >= size) return size - 1;
+    return pos;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _opt_draw()
+ * DESCR:    Emits a move of 'squares' squares in the direction 'dir' with the pen down, from where o->want is.
+ *           If the last command emitted was such a move in the same direction, and nothing the original program
+ *           has done since can be seen, the squares are added to it instead. Otherwise Myrtle is first turned to
+ *           face along the line of the move, brought to where she starts it and given the right pen.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _opt_draw(opt_t *o, int dir, int squares) {
+    par_turtle_t *have   = &o->have;
+    int           status = TERM_NORM;
+
+    if (o->last >= 0 && o->last_dir == dir && have->row == o->want.row && have->col == o->want.col &&
+        have->penchar == o->want.penchar && o->out->words[o->last] <= INT_MAX - squares) {
+        o->out->words[o->last] += squares;
+        _opt_move(o, have, dir, squares);
+        return TERM_NORM;
+    }
+
+    /* One turn puts her on the line of the move. Turn the way the original program did, if it did. */
+    if ((have->dir & 1) != (dir & 1)) {
+        bool left = ((have->dir + 3) & 3) == o->want.dir;
+        status    = _opt_emit(o, left ? CMD_LEFT : CMD_RIGHT, 0, 0);
+        have->dir = (have->dir + (left ? 3 : 1)) & 3;
+    }
+    if (status == TERM_NORM) status = _opt_place(o);
+    if (status == TERM_NORM) status = _opt_pen(o);
+    if (status == TERM_NORM) status = _opt_emit(o, have->dir == dir ? CMD_FORWARD : CMD_BACKWARD, squares, 0);
+    if (status != TERM_NORM) return status;
+
+    o->last     = (long)o->out->count - 1;
+    o->last_dir = dir;
+    _opt_move(o, have, dir, squares);
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _opt_emit()
+ * DESCR:    Appends the command 'op' to the optimized program, followed by as many of 'arg1' and 'arg2' as it
+ *           has operands.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _opt_emit(opt_t *o, int op, int arg1, int arg2) {
+    int status = code_emit(o->out, op);
+    if (status == TERM_NORM && cmd_nargs[op] > 0) status = code_emit(o->out, arg1);
+    if (status == TERM_NORM && cmd_nargs[op] > 1) status = code_emit(o->out, arg2);
+    o->last = -1;
+    o->emitted++;
+    return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _opt_move()
+ * DESCR:    Moves *turtle 'squares' squares in the direction 'dir', wrapping around the edges of the world as
+ *           _myrtle_move() does.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _opt_move(opt_t *o, par_turtle_t *turtle, int dir, int squares) {
+    bool    vert = (dir == DIR_NORTH || dir == DIR_SOUTH);
+    coord_t size = vert ? o->rows : o->cols;
+    coord_t step = (dir == DIR_NORTH || dir == DIR_WEST) ? -(coord_t)squares : (coord_t)squares;
+    if (vert) turtle->row = ((turtle->row + step % size) % size + size) % size;
+    else turtle->col = ((turtle->col + step % size) % size + size) % size;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _opt_pen()
+ * DESCR:    Emits what it takes to put the pen down with the char o->want draws with.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _opt_pen(opt_t *o) {
+    int status = TERM_NORM;
+    if (o->have.penchar != o->want.penchar) {
+        status          = _opt_emit(o, CMD_PENCHAR, o->want.penchar, 0);
+        o->have.penchar = o->want.penchar;
+    }
+    if (status == TERM_NORM && !o->have.pendown) {
+        status          = _opt_emit(o, CMD_PENDOWN, 0, 0);
+        o->have.pendown = true;
+    }
+    return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _opt_place()
+ * DESCR:    Emits what it takes to bring Myrtle to where o->want is without drawing: the pen goes up, and she
+ *           goes forward along the row or col she faces if o->want is on it, or hyperspaces there if not.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _opt_place(opt_t *o) {
+    par_turtle_t *have   = &o->have;
+    par_turtle_t *want   = &o->want;
+    bool          vert   = (have->dir == DIR_NORTH || have->dir == DIR_SOUTH);
+    bool          back   = (have->dir == DIR_NORTH || have->dir == DIR_WEST);
+    int           status = TERM_NORM;
+
+    if (have->row == want->row && have->col == want->col) return TERM_NORM;
+    if (have->pendown) {
+        status        = _opt_emit(o, CMD_PENUP, 0, 0);
+        have->pendown = false;
+    }
+    if (status != TERM_NORM) return status;
+
+    if (vert && have->col == want->col) {
+        coord_t ahead = back ? have->row - want->row : want->row - have->row;
+        status = _opt_emit(o, CMD_FORWARD, (int)((ahead + o->rows) % o->rows), 0);
+    } else if (!vert && have->row == want->row) {
+        coord_t ahead = back ? have->col - want->col : want->col - have->col;
+        status = _opt_emit(o, CMD_FORWARD, (int)((ahead + o->cols) % o->cols), 0);
+    } else {
+        status = _opt_emit(o, CMD_HYPER, (int)want->row, (int)want->col);
+    }
+    have->row = want->row;
+    have->col = want->col;
+    return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _opt_repeat()
+ * DESCR:    Copies the 'repeat' block at 'pc' to the optimized program as it is, once Myrtle is in exactly the
+ *           state the original program has left her in, and then moves o->want to where the block leaves her.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _opt_repeat(opt_t *o, const int *pc) {
+    const int *body   = pc + 3;
+    const int *end    = body + pc[2];
+    const int *word   = pc;
+    int        status = TERM_NORM;
+
+    if (pc[1] <= 0) return TERM_NORM;
+    status = _opt_sync(o);
+    for (; word < end && status == TERM_NORM; word++) status = code_emit(o->out, *word);
+    if (status != TERM_NORM) return status;
+    o->last = -1;
+    o->emitted++;
+
+    repeat_advance(&o->want, pc[1], body, end, o->rows, o->cols);
+    o->have = o->want;
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _opt_sync()
+ * DESCR:    Emits what it takes to bring o->have exactly to o->want: position, direction, pen and pen char.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _opt_sync(opt_t *o) {
+    par_turtle_t *have   = &o->have;
+    int           turn   = (o->want.dir - have->dir) & 3;
+    int           status = _opt_place(o);
+
+    if (turn == 3 && status == TERM_NORM) status = _opt_emit(o, CMD_LEFT, 0, 0);
+    for (; turn > 0 && turn < 3 && status == TERM_NORM; turn--) status = _opt_emit(o, CMD_RIGHT, 0, 0);
+    have->dir = o->want.dir;
+    if (status == TERM_NORM && o->want.pendown) return _opt_pen(o);
+
+    /* The pen stays up, but the body may put it down, so the char must be right too. */
+    if (status == TERM_NORM && have->penchar != o->want.penchar) {
+        status        = _opt_emit(o, CMD_PENCHAR, o->want.penchar, 0);
+        have->penchar = o->want.penchar;
+    }
+    if (status == TERM_NORM && have->pendown) {
+        status        = _opt_emit(o, CMD_PENUP, 0, 0);
+        have->pendown = false;
+    }
+    return status;
+}
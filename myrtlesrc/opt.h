@@ -0,0 +1,26 @@
+/***************************************************************************************************************
+ * FILE: opt.h
+ *
+ * DESCRIPTION:
+ * Declarations for the optimizer which -O runs over a compiled program. See comments in opt.c.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261016T2300 [JMW] Initial revision.
+ **************************************************************************************************************/
+#ifndef __OPT_H__
+#define __OPT_H__
+
+#include "code.h"     /* For code_t.       */
+#include "globals.h"  /* For coord_t.      */
+#include "par.h"      /* For par_turtle_t. */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * NONSTATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+extern int opt_code(code_t *code, code_t *scratch, const par_turtle_t *start, coord_t rows, coord_t cols,
+                    long *commands, long *removed);
+
+#endif
@@ -0,0 +1,761 @@
+/***************************************************************************************************************
+ * FILE: par.c
+ *
+ * DESCRIPTION:
+ * Runs Myrtle programs on several threads, with a result which does not depend on how many threads there are or
+ * how they are scheduled. There are two ways in:
+ *
+ * par_exec() runs one long stretch of commands, for the -j option (see myrtle_ctx_jobs_set()), with exactly the
+ * result of running it serially. Every command changes Myrtle's state -- row, col, direction, pen and pen char --
+ * in a way which can be worked out without knowing the state it starts from, so the effect of a whole run of
+ * commands can be summed up as a function from the state before it to the state after it. The commands are split
+ * into one chunk per thread and run in three phases:
+ *
+ *     1. Summarize. Each thread works out the summary of its chunk. Where Myrtle ends up depends on which way
+ *        she was facing at the start, so the summary is worked out for all four directions at once.
+ *     2. Rasterize. The summaries are composed in order (a prefix scan) to give the state each chunk starts in.
+ *        Each thread then performs its chunk from that state, but instead of drawing in the world it logs the
+ *        runs of squares it would draw.
+ *     3. Draw. The runs are drawn in the order of the commands that drew them, so where two commands draw the
+ *        same square the later one wins, as it does when the program is run serially.
+ *
+ * par_exec_streams() runs several turtles at once, each performing its own stream of commands (see 'turtle' in
+ * cmds.def). The turtles keep time together: every turtle performs its first command at tick 0, its second at
+ * tick 1, and so on, and within a tick they take turns in the order of the streams. Each thread performs whole
+ * streams, logging the runs of squares they draw stamped with the tick of the command that drew them. The logs
+ * are then merged in (tick, stream) order and drawn, so the last writer of a square is always the same turtle.
+ * A 'stop' in any stream writes the world as it is at that tick.
+ *
+ * Either way, dense and blocked worlds are split into bands of rows for drawing, one per thread, and each thread
+ * draws the part of every run which falls in its band, in order, so no two threads ever write the same square.
+ * Sparse and packed worlds allocate as they are drawn in, so they are drawn by one thread. Drawing is most of the
+ * work of a program with long moves, and it is shared evenly however the turtles move. The commands are handled
+ * a window at a time, so the run logs never get much bigger than the program itself.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * 20261016T2100 [JMW] added par_exec_streams()
+ * 20261017T1100 [JMW] operand counts come from cmd_nargs[] in myrtle.c
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261016T2000 [JMW] Initial revision.
+ **************************************************************************************************************/
+/* Threads and the number of CPUs are POSIX, not Standard C, so ask for them before including anything. */
+#define _POSIX_C_SOURCE 200112L
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "bool.h"
+#include "globals.h"
+#include "myrtle.h"
+#include "par.h"
+#include "world.h"
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC GLOBAL CONSTANT DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+static const size_t PAR_MIN_RUNS     = 4096;      /* Fewest runs worth drawing on more than one thread.     */
+static const size_t PAR_RUNS_INIT    = 1024;      /* Runs allocated for at first. Doubles as the log fills. */
+static const long   PAR_WINDOW_WORDS = 1L << 20;  /* Code words handled at a time.                          */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * What a chunk of commands does to Myrtle's state. Entry d of each array is for Myrtle starting the chunk facing
+ * direction d.
+ *
+ * dir      -- The direction she ends up facing.
+ * absolute -- True if the chunk hyperspaces, in which case row and col are where she ends up. Otherwise, they
+ *             are how far she ends up from where she started, wrapped to the size of the world.
+ * row, col -- See absolute.
+ * pendown  -- 1 or 0 if the chunk puts the pen down or lifts it last. -1 if it does neither.
+ * penchar  -- The last pen char the chunk sets, as an unsigned char. -1 if it sets none.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    int     dir[4];
+    bool    absolute[4];
+    coord_t row[4];
+    coord_t col[4];
+    int     pendown;
+    int     penchar;
+} par_summary_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * A run of squares drawn by one command: 'count' squares of 'ch' from row (or col) 'first' of col (or row)
+ * 'line', going down a col if 'vert' is true and along a row if not. 'tick' is when the command was performed.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    coord_t line;
+    coord_t first;
+    coord_t count;
+    coord_t tick;
+    bool    vert;
+    char    ch;
+} par_run_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * A log of the runs drawn by some commands, in order.
+ *
+ * runs  -- The runs.
+ * count -- The number of runs.
+ * cap   -- The number of runs allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    par_run_t *runs;
+    size_t     count;
+    size_t     cap;
+} par_log_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * One chunk of the commands split up by par_exec().
+ *
+ * pc, end -- The commands of the chunk.
+ * summary -- What the commands do to Myrtle's state. Phase 1.
+ * start   -- The state Myrtle is in when the chunk starts. Phase 2.
+ * log     -- The runs of squares drawn by the commands. Phase 2.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    const int     *pc;
+    const int     *end;
+    par_summary_t  summary;
+    par_turtle_t   start;
+    par_log_t      log;
+} par_chunk_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * One stream run by par_exec_streams().
+ *
+ * stream -- The stream. stream->pc is where the next window starts.
+ * window -- Where the current window started. Advanced past each command as the window is merged.
+ * log    -- The runs of squares drawn in the current window.
+ * next   -- The next run of 'log' to merge.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    par_stream_t *stream;
+    const int    *window;
+    par_log_t     log;
+    size_t        next;
+} par_strand_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * A thread working on a phase of a job.
+ *
+ * thread -- The thread.
+ * job    -- The job.
+ * id     -- The index of the worker: the chunk it works on, or the band of the world it draws.
+ * status -- TERM_NORM, or TERM_ERR_MEMORY if the phase ran out of memory.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    pthread_t       thread;
+    struct par_job *job;
+    int             id;
+    int             status;
+} par_worker_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * Everything the threads of a par_exec() or par_exec_streams() share.
+ *
+ * world        -- The world being drawn in.
+ * workers      -- The number of workers in the current phase.
+ * worker       -- The workers.
+ * chunks       -- par_exec(): the chunks of the window being run, one per worker.
+ * strands      -- par_exec_streams(): the streams.
+ * strand_count -- The number of streams.
+ * strand_next  -- The next stream to be performed in the current window. Protected by 'lock'.
+ * lock         -- See strand_next.
+ * tick         -- The tick the current window starts at.
+ * ticks        -- The number of ticks in a window.
+ * merged       -- The runs of all the streams, in (tick, stream) order, since the last 'stop'.
+ * draw         -- The logs to draw in phase 3, in order.
+ * draw_count   -- The number of logs in 'draw'.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct par_job {
+    world_t         *world;
+    int              workers;
+    par_worker_t     worker[PAR_MAX_THREADS];
+    par_chunk_t      chunks[PAR_MAX_THREADS];
+    par_strand_t    *strands;
+    int              strand_count;
+    int              strand_next;
+    pthread_mutex_t  lock;
+    coord_t          tick;
+    coord_t          ticks;
+    par_log_t        merged;
+    par_log_t       *draw[PAR_MAX_THREADS];
+    int              draw_count;
+} par_job_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+static void    _par_advance(coord_t *row, coord_t *col, int dir, coord_t squares, coord_t rows, coord_t cols);
+static int     _par_apply(par_job_t *job, coord_t first_row, coord_t end_row);
+static void   *_par_apply_band(void *arg);
+static coord_t _par_clamp(coord_t pos, coord_t size);
+static void    _par_compose(par_turtle_t *turtle, const par_summary_t *summary, coord_t rows, coord_t cols);
+static int     _par_draw(par_job_t *job, int threads);
+static int     _par_grow(par_log_t *log, size_t count);
+static int     _par_left(int dir);
+static int     _par_log(par_log_t *log, bool vert, coord_t line, coord_t first, coord_t count, char ch,
+                        coord_t tick);
+static int     _par_merge(par_job_t *job, const par_hooks_t *hooks, int threads);
+static int     _par_move(world_t *world, par_turtle_t *turtle, coord_t squares, par_log_t *log, coord_t tick);
+static int     _par_perform(world_t *world, const int **pc, const int *end, coord_t limit, par_turtle_t *turtle,
+                            par_log_t *log, coord_t tick);
+static void    _par_phase(par_job_t *job, void *(*phase)(void *), int workers);
+static void   *_par_rasterize(void *arg);
+static int     _par_right(int dir);
+static const int *_par_split(par_job_t *job, const int *pc, const int *end);
+static void   *_par_strands(void *arg);
+static void   *_par_summarize(void *arg);
+static int     _par_window(par_job_t *job, par_turtle_t *turtle);
+
+/*======================================= NONSTATIC FUNCTION DEFINITIONS =====================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: par_exec()
+ * DESCR:    Performs the commands from 'pc' to 'end' in 'world' on up to 'threads' threads, starting from and
+ *           updating *turtle. The commands must not include 'stop', which writes the world; the caller runs the
+ *           commands between one 'stop' and the next with this. Nothing is traced.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the runs drawn or the world cannot be allocated. PAR_SERIAL, having
+ *           done nothing, if 'threads' is less than two or there are too few commands to be worth splitting.
+ *------------------------------------------------------------------------------------------------------------*/
+int par_exec(world_t *world, const int *pc, const int *end, par_turtle_t *turtle, int threads) {
+    par_job_t *job;
+    int        t, status = TERM_NORM;
+
+    if (threads > PAR_MAX_THREADS) threads = PAR_MAX_THREADS;
+    if (threads < 2 || end - pc < PAR_MIN_WORDS) return PAR_SERIAL;
+
+    job = (par_job_t *)calloc(1, sizeof(par_job_t));
+    if (!job) return TERM_ERR_MEMORY;
+    job->world = world;
+    for (t = 0; t < threads; t++) job->draw[t] = &job->chunks[t].log;
+    job->draw_count = threads;
+
+    while (pc < end && status == TERM_NORM) {
+        job->workers = threads;
+        pc = _par_split(job, pc, end);
+        status = _par_window(job, turtle);
+    }
+
+    for (t = 0; t < threads; t++) free(job->chunks[t].log.runs);
+    free(job);
+    return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: par_exec_streams()
+ * DESCR:    Performs the 'count' streams of commands in 'streams' at the same time, in 'world', on up to
+ *           'threads' threads. A 'threads' of zero or less means one per online CPU. Each stream starts from and
+ *           updates its own turtle. For each command, in (tick, stream) order, hooks->trace is called if it is not
+ *           NULL, and for each 'stop' hooks->stop is called once everything drawn up to that tick is in the world.
+ * RETURNS:  TERM_NORM, TERM_ERR_MEMORY if the runs drawn or the world cannot be allocated, or the first status
+ *           other than TERM_NORM returned by hooks->stop.
+ *------------------------------------------------------------------------------------------------------------*/
+int par_exec_streams(world_t *world, par_stream_t *streams, int count, int threads, const par_hooks_t *hooks) {
+    par_job_t *job;
+    int        i, status = TERM_NORM;
+    bool       more = true;
+
+    if (threads <= 0) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (threads > PAR_MAX_THREADS) threads = PAR_MAX_THREADS;
+    if (threads < 1) threads = 1;
+
+    job = (par_job_t *)calloc(1, sizeof(par_job_t));
+    if (!job) return TERM_ERR_MEMORY;
+    job->strands = (par_strand_t *)calloc(count, sizeof(par_strand_t));
+    if (!job->strands) {
+        free(job);
+        return TERM_ERR_MEMORY;
+    }
+    pthread_mutex_init(&job->lock, NULL);
+    job->world        = world;
+    job->strand_count = count;
+    job->ticks        = count < PAR_WINDOW_WORDS ? PAR_WINDOW_WORDS / count : 1;
+    job->draw[0]      = &job->merged;
+    job->draw_count   = 1;
+    for (i = 0; i < count; i++) job->strands[i].stream = &streams[i];
+
+    while (more && status == TERM_NORM) {
+        /* Perform the window, a stream at a time on each worker. */
+        job->strand_next = 0;
+        _par_phase(job, _par_strands, threads < count ? threads : count);
+        for (i = 0; i < job->workers && status == TERM_NORM; i++) status = job->worker[i].status;
+
+        /* Draw it in (tick, stream) order. */
+        if (status == TERM_NORM) status = _par_merge(job, hooks, threads);
+        job->tick += job->ticks;
+        for (more = false, i = 0; i < count; i++) more = more || streams[i].pc < streams[i].end;
+    }
+
+    for (i = 0; i < count; i++) free(job->strands[i].log.runs);
+    free(job->merged.runs);
+    free(job->strands);
+    pthread_mutex_destroy(&job->lock);
+    free(job);
+    return status;
+}
+
+/*========================================= STATIC FUNCTION DEFINITIONS ======================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _par_advance()
+ * DESCR:    Moves the position *row, *col 'squares' squares in direction 'dir', or backward if 'squares' is
+ *           negative, wrapping around the edges of a 'rows' x 'cols' world. The same arithmetic as _myrtle_move()
+ *           in myrtle.c. It works as well on how far Myrtle is from where she started as on where she is.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _par_advance(coord_t *row, coord_t *col, int dir, coord_t squares, coord_t rows, coord_t cols) {
+    bool     vert = (dir == DIR_NORTH || dir == DIR_SOUTH);
+    coord_t  size = vert ? rows : cols;
+    coord_t *pos  = vert ? row : col;
+    coord_t  step = (dir == DIR_NORTH || dir == DIR_WEST) ? -squares : squares;
+    *pos = ((*pos + step % size) % size + size) % size;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _par_apply()
+ * DESCR:    Draws the part of every run in the logs job->draw which falls in rows 'first_row' to 'end_row' - 1
+ *           of the world, in order.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the world cannot grow to hold what was drawn.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _par_apply(par_job_t *job, coord_t first_row, coord_t end_row) {
+    int    d, status = TERM_NORM;
+    size_t i;
+
+    for (d = 0; d < job->draw_count && status == TERM_NORM; d++) {
+        par_log_t *log = job->draw[d];
+        for (i = 0; i < log->count && status == TERM_NORM; i++) {
+            par_run_t *run = &log->runs[i];
+            if (run->vert) {
+                coord_t first = run->first > first_row ? run->first : first_row;
+                coord_t end   = run->first + run->count < end_row ? run->first + run->count : end_row;
+                if (first < end) status = world_fill_col(job->world, run->line, first, end - first, run->ch);
+            } else if (run->line >= first_row && run->line < end_row) {
+                status = world_fill_row(job->world, run->line, run->first, run->count, run->ch);
+            }
+        }
+    }
+    return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _par_apply_band()
+ * DESCR:    Phase 3 for a dense or blocked world: draws the runs which fall in band worker->id of the world. The
+ *           bands are whole rows of tiles, so that two threads do not even share a tile of a blocked world.
+ * RETURNS:  NULL.
+ *------------------------------------------------------------------------------------------------------------*/
+static void *_par_apply_band(void *arg) {
+    par_worker_t *worker = (par_worker_t *)arg;
+    par_job_t    *job    = worker->job;
+    coord_t       rows   = job->world->rows;
+    coord_t       bands  = (rows + WORLD_TILE_SIZE - 1) / WORLD_TILE_SIZE;
+    coord_t       first  = bands * worker->id / job->workers * WORLD_TILE_SIZE;
+    coord_t       end    = bands * (worker->id + 1) / job->workers * WORLD_TILE_SIZE;
+
+    if (end > rows) end = rows;
+    worker->status = (first < end) ? _par_apply(job, first, end) : TERM_NORM;
+    return NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _par_clamp()
+ * DESCR:    Clamps 'pos' to 0 .. 'size' - 1, as _myrtle_row_set() and _myrtle_col_set() do.
+ * RETURNS:  The clamped position.
+ *------------------------------------------------------------------------------------------------------------*/
+static coord_t _par_clamp(coord_t pos, coord_t size) {
+    if (pos < 0) return 0;
+    if (pos >= size) return size - 1;
+    return pos;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _par_compose()
+ * DESCR:    Updates *turtle to the state Myrtle is in after the chunk 'summary' sums up, in a 'rows' x 'cols'
+ *           world.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _par_compose(par_turtle_t *turtle, const par_summary_t *summary, coord_t rows, coord_t cols) {
+    int d = turtle->dir;
+    if (summary->absolute[d]) {
+        turtle->row = summary->row[d];
+        turtle->col = summary->col[d];
+    } else {
+        turtle->row = (turtle->row + summary->row[d]) % rows;
+        turtle->col = (turtle->col + summary->col[d]) % cols;
+    }
+    turtle->dir = summary->dir[d];
+    if (summary->pendown >= 0) turtle->pendown = summary->pendown ? true : false;
+    if (summary->penchar >= 0) turtle->penchar = (char)summary->penchar;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _par_draw()
+ * DESCR:    Phase 3: draws the logs job->draw in the world, in order. A dense or blocked world is drawn a band
+ *           per thread on up to 'threads' threads, unless there are too few runs to be worth it.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the world cannot grow to hold what was drawn.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _par_draw(par_job_t *job, int threads) {
+    size_t runs = 0;
+    int    d;
+
+    for (d = 0; d < job->draw_count; d++) runs += job->draw[d]->count;
+    if (threads < 2 || runs < PAR_MIN_RUNS) return _par_apply(job, 0, job->world->rows);
+    if (job->world->layout != WORLD_DENSE && job->world->layout != WORLD_BLOCKED) {
+        return _par_apply(job, 0, job->world->rows);
+    }
+    /* Drawing in a dense or blocked world never allocates, so it cannot fail. */
+    _par_phase(job, _par_apply_band, threads);
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _par_grow()
+ * DESCR:    Makes room in 'log' for at least 'count' runs.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the log cannot grow.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _par_grow(par_log_t *log, size_t count) {
+    size_t     cap = log->cap ? log->cap : PAR_RUNS_INIT;
+    par_run_t *runs;
+
+    if (count <= log->cap) return TERM_NORM;
+    while (cap < count) cap *= 2;
+    runs = (par_run_t *)realloc(log->runs, cap * sizeof(par_run_t));
+    if (!runs) return TERM_ERR_MEMORY;
+    log->runs = runs;
+    log->cap  = cap;
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _par_left()
+ * DESCR:    Turns 'dir' 90 degrees counterclockwise.
+ * RETURNS:  The new direction.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _par_left(int dir) {
+    return dir == DIR_NORTH ? DIR_WEST : dir - 1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _par_log()
+ * DESCR:    Adds a run of squares to 'log'. See par_run_t.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the log cannot grow.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _par_log(par_log_t *log, bool vert, coord_t line, coord_t first, coord_t count, char ch, coord_t tick) {
+    par_run_t *run;
+    if (_par_grow(log, log->count + 1) != TERM_NORM) return TERM_ERR_MEMORY;
+    run = &log->runs[log->count++];
+    run->vert  = vert;
+    run->line  = line;
+    run->first = first;
+    run->count = count;
+    run->tick  = tick;
+    run->ch    = ch;
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _par_merge()
+ * DESCR:    Merges the logs of the window the streams of 'job' just performed into job->merged, walking the
+ *           commands of the window in (tick, stream) order. Each command is traced by hooks->trace if there is
+ *           one. At each 'stop', what has been merged is drawn, on up to 'threads' threads, and hooks->stop is
+ *           called. What is left at the end of the window is drawn too.
+ * RETURNS:  TERM_NORM, TERM_ERR_MEMORY if job->merged or the world cannot grow, or the status of hooks->stop.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _par_merge(par_job_t *job, const par_hooks_t *hooks, int threads) {
+    size_t  runs = 0;
+    coord_t tick;
+    int     i, status;
+    bool    live = true;
+
+    for (i = 0; i < job->strand_count; i++) runs += job->strands[i].log.count;
+    if (_par_grow(&job->merged, runs) != TERM_NORM) return TERM_ERR_MEMORY;
+    job->merged.count = 0;
+
+    for (tick = job->tick; live && tick < job->tick + job->ticks; tick++) {
+        live = false;
+        for (i = 0; i < job->strand_count; i++) {
+            par_strand_t *strand = &job->strands[i];
+            int           op;
+            if (strand->window >= strand->stream->pc) continue;
+            live = true;
+            op = *strand->window;
+            strand->window += 1 + cmd_nargs[op];
+            if (hooks->trace) hooks->trace(hooks->arg, i, op);
+            while (strand->next < strand->log.count && strand->log.runs[strand->next].tick == tick) {
+                job->merged.runs[job->merged.count++] = strand->log.runs[strand->next++];
+            }
+            if (op == CMD_STOP) {
+                status = _par_draw(job, threads);
+                job->merged.count = 0;
+                if (status == TERM_NORM) status = hooks->stop(hooks->arg, i);
+                if (status != TERM_NORM) return status;
+            }
+        }
+    }
+    return _par_draw(job, threads);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _par_move()
+ * DESCR:    Moves *turtle 'squares' squares, or backward if 'squares' is negative, in 'world', and logs the
+ *           squares she enters in 'log' if the pen is down. Logs the same runs that _myrtle_move() in myrtle.c
+ *           draws. 'tick' is when the move is made.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the log cannot grow.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _par_move(world_t *world, par_turtle_t *turtle, coord_t squares, par_log_t *log, coord_t tick) {
+    int      dir    = turtle->dir;
+    bool     vert   = (dir == DIR_NORTH || dir == DIR_SOUTH);
+    coord_t  size   = vert ? world->rows : world->cols;
+    coord_t  pos    = vert ? turtle->row : turtle->col;
+    coord_t  line   = vert ? turtle->col : turtle->row;
+    coord_t  step   = (dir == DIR_NORTH || dir == DIR_WEST) ? -squares : squares;
+    coord_t  count  = step < 0 ? -step : step;
+    int      status = TERM_NORM;
+
+    if (turtle->pendown) {
+        coord_t end   = ((pos + step % size) % size + size) % size;
+        coord_t first = (count >= size) ? 0 : (step > 0) ? (pos + 1) % size : end;
+        coord_t run   = (count >= size) ? size : count;
+        coord_t tail  = first + run - size;
+        if (tail > 0) run -= tail;
+        status = _par_log(log, vert, line, first, run, turtle->penchar, tick);
+        if (tail > 0 && !status) status = _par_log(log, vert, line, 0, tail, turtle->penchar, tick);
+    }
+    _par_advance(&turtle->row, &turtle->col, dir, squares, world->rows, world->cols);
+    return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _par_perform()
+ * DESCR:    Performs up to 'limit' commands from *pc to 'end' in 'world', starting from and updating *turtle, and
+ *           logs the runs of squares they draw in 'log'. The first command is performed at 'tick', the next at
+ *           'tick' + 1, and so on. A 'stop' does nothing here; it is up to the caller. *pc is left at the first
+ *           command not performed.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the log cannot grow.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _par_perform(world_t *world, const int **pc, const int *end, coord_t limit, par_turtle_t *turtle,
+                        par_log_t *log, coord_t tick) {
+    const int *p      = *pc;
+    coord_t    last   = tick + limit;
+    int        status = TERM_NORM;
+
+    for (; p < end && tick < last && status == TERM_NORM; tick++) {
+        int op = *p++;
+        switch (op) {
+        case CMD_BACKWARD:
+            if (p[0] > 0) status = _par_move(world, turtle, -(coord_t)p[0], log, tick);
+            p += 1;
+            break;
+        case CMD_FORWARD:
+            if (p[0] > 0) status = _par_move(world, turtle, (coord_t)p[0], log, tick);
+            p += 1;
+            break;
+        case CMD_HYPER:
+            turtle->row = _par_clamp(p[0], world->rows);
+            turtle->col = _par_clamp(p[1], world->cols);
+            if (turtle->pendown) status = _par_log(log, false, turtle->row, turtle->col, 1, turtle->penchar, tick);
+            p += 2;
+            break;
+        case CMD_LEFT:    turtle->dir = _par_left(turtle->dir);  break;
+        case CMD_PENCHAR: turtle->penchar = (char)p[0];          p += 1; break;
+        case CMD_PENDOWN: turtle->pendown = true;                break;
+        case CMD_PENUP:   turtle->pendown = false;               break;
+        case CMD_RIGHT:   turtle->dir = _par_right(turtle->dir); break;
+        default:          p += cmd_nargs[op];                    break;
+        }
+    }
+    *pc = p;
+    return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _par_phase()
+ * DESCR:    Runs 'phase' on 'workers' workers of 'job', each on its own thread, and waits for them all. The
+ *           calling thread does worker 0 itself, and any worker whose thread cannot be started.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _par_phase(par_job_t *job, void *(*phase)(void *), int workers) {
+    bool started[PAR_MAX_THREADS];
+    int  t;
+
+    job->workers = workers;
+    for (t = 0; t < workers; t++) {
+        job->worker[t].job    = job;
+        job->worker[t].id     = t;
+        job->worker[t].status = TERM_NORM;
+    }
+    for (t = 1; t < workers; t++) {
+        started[t] = !pthread_create(&job->worker[t].thread, NULL, phase, &job->worker[t]);
+    }
+    phase(&job->worker[0]);
+    for (t = 1; t < workers; t++) {
+        if (started[t]) pthread_join(job->worker[t].thread, NULL);
+        else phase(&job->worker[t]);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _par_rasterize()
+ * DESCR:    Phase 2 of par_exec(): performs the commands of chunk worker->id from chunk->start, logging the runs
+ *           of squares they draw.
+ * RETURNS:  NULL. worker->status is TERM_NORM, or TERM_ERR_MEMORY if the log cannot grow.
+ *------------------------------------------------------------------------------------------------------------*/
+static void *_par_rasterize(void *arg) {
+    par_worker_t *worker = (par_worker_t *)arg;
+    par_chunk_t  *chunk  = &worker->job->chunks[worker->id];
+    par_turtle_t  turtle = chunk->start;
+    const int    *pc     = chunk->pc;
+
+    chunk->log.count = 0;
+    worker->status = _par_perform(worker->job->world, &pc, chunk->end, chunk->end - chunk->pc, &turtle,
+                                  &chunk->log, 0);
+    return NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _par_right()
+ * DESCR:    Turns 'dir' 90 degrees clockwise.
+ * RETURNS:  The new direction.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _par_right(int dir) {
+    return dir == DIR_WEST ? DIR_NORTH : dir + 1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _par_split()
+ * DESCR:    Takes the next window of commands, starting at 'pc', and splits it into job->workers chunks of about
+ *           the same number of code words. A chunk may be empty.
+ * RETURNS:  The end of the window, where the next one starts.
+ *------------------------------------------------------------------------------------------------------------*/
+static const int *_par_split(par_job_t *job, const int *pc, const int *end) {
+    const int *stop = (end - pc > PAR_WINDOW_WORDS) ? pc + PAR_WINDOW_WORDS : end;
+    const int *p    = pc;
+    long       len  = (long)(stop - pc);
+    int        t;
+
+    job->chunks[0].pc = pc;
+    for (t = 1; t < job->workers; t++) {
+        const int *target = pc + len * t / job->workers;
+        while (p < target) p += 1 + cmd_nargs[*p];
+        job->chunks[t - 1].end = p;
+        job->chunks[t].pc = p;
+    }
+    while (p < stop) p += 1 + cmd_nargs[*p];
+    job->chunks[job->workers - 1].end = p;
+    return p;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _par_strands()
+ * DESCR:    The body of a worker of par_exec_streams(): takes the next stream which has not been performed in the
+ *           current window and performs its commands for the window, until there are none left.
+ * RETURNS:  NULL. worker->status is TERM_NORM, or TERM_ERR_MEMORY if a log cannot grow.
+ *------------------------------------------------------------------------------------------------------------*/
+static void *_par_strands(void *arg) {
+    par_worker_t *worker = (par_worker_t *)arg;
+    par_job_t    *job    = worker->job;
+
+    while (worker->status == TERM_NORM) {
+        par_strand_t *strand;
+        pthread_mutex_lock(&job->lock);
+        strand = (job->strand_next < job->strand_count) ? &job->strands[job->strand_next++] : NULL;
+        pthread_mutex_unlock(&job->lock);
+        if (!strand) break;
+
+        strand->window    = strand->stream->pc;
+        strand->log.count = 0;
+        strand->next      = 0;
+        worker->status = _par_perform(job->world, &strand->stream->pc, strand->stream->end, job->ticks,
+                                      &strand->stream->turtle, &strand->log, job->tick);
+    }
+    return NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _par_summarize()
+ * DESCR:    Phase 1 of par_exec(): works out the par_summary_t of chunk worker->id for each direction at once.
+ *           Nothing is drawn.
+ * RETURNS:  NULL.
+ *------------------------------------------------------------------------------------------------------------*/
+static void *_par_summarize(void *arg) {
+    par_worker_t  *worker  = (par_worker_t *)arg;
+    par_chunk_t   *chunk   = &worker->job->chunks[worker->id];
+    par_summary_t *summary = &chunk->summary;
+    coord_t        rows    = worker->job->world->rows;
+    coord_t        cols    = worker->job->world->cols;
+    const int     *pc      = chunk->pc;
+    int            d;
+
+    for (d = 0; d < 4; d++) {
+        summary->dir[d]      = d;
+        summary->absolute[d] = false;
+        summary->row[d]      = 0;
+        summary->col[d]      = 0;
+    }
+    summary->pendown = -1;
+    summary->penchar = -1;
+
+    while (pc < chunk->end) {
+        int op = *pc++;
+        switch (op) {
+        case CMD_BACKWARD:
+        case CMD_FORWARD:
+            if (pc[0] > 0) {
+                coord_t squares = (op == CMD_FORWARD) ? (coord_t)pc[0] : -(coord_t)pc[0];
+                for (d = 0; d < 4; d++) {
+                    _par_advance(&summary->row[d], &summary->col[d], summary->dir[d], squares, rows, cols);
+                }
+            }
+            break;
+        case CMD_HYPER:
+            for (d = 0; d < 4; d++) {
+                summary->absolute[d] = true;
+                summary->row[d]      = _par_clamp(pc[0], rows);
+                summary->col[d]      = _par_clamp(pc[1], cols);
+            }
+            break;
+        case CMD_LEFT:
+            for (d = 0; d < 4; d++) summary->dir[d] = _par_left(summary->dir[d]);
+            break;
+        case CMD_PENCHAR: summary->penchar = (unsigned char)pc[0]; break;
+        case CMD_PENDOWN: summary->pendown = 1;                    break;
+        case CMD_PENUP:   summary->pendown = 0;                    break;
+        case CMD_RIGHT:
+            for (d = 0; d < 4; d++) summary->dir[d] = _par_right(summary->dir[d]);
+            break;
+        }
+        pc += cmd_nargs[op];
+    }
+    return NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _par_window()
+ * DESCR:    Runs the three phases of par_exec() on the window of commands which _par_split() shared out among the
+ *           chunks of 'job', starting from and updating *turtle.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the runs drawn or the world cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _par_window(par_job_t *job, par_turtle_t *turtle) {
+    world_t *world   = job->world;
+    int      workers = job->workers;
+    int      t;
+
+    /* 1. Summarize each chunk. */
+    _par_phase(job, _par_summarize, workers);
+
+    /* 2. Compose the summaries to find where each chunk starts, then rasterize the chunks from there. */
+    for (t = 0; t < workers; t++) {
+        job->chunks[t].start = *turtle;
+        _par_compose(turtle, &job->chunks[t].summary, world->rows, world->cols);
+    }
+    _par_phase(job, _par_rasterize, workers);
+    for (t = 0; t < workers; t++) {
+        if (job->worker[t].status != TERM_NORM) return job->worker[t].status;
+    }
+
+    /* 3. Draw the runs in the world. */
+    return _par_draw(job, workers);
+}
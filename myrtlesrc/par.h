@@ -0,0 +1,71 @@
+/***************************************************************************************************************
+ * FILE: par.h
+ *
+ * DESCRIPTION:
+ * Declarations for running one program on several threads. See comments in par.c.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * 20261016T2100 [JMW] added par_exec_streams()
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261016T2000 [JMW] Initial revision.
+ **************************************************************************************************************/
+#ifndef __PAR_H__
+#define __PAR_H__
+
+#include "bool.h"     /* For bool.    */
+#include "globals.h"  /* For coord_t. */
+#include "world.h"    /* For world_t. */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * PREPROCESSOR MACRO DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+#define PAR_MAX_THREADS 64           /* Most threads par_exec() or par_exec_streams() run on.               */
+#define PAR_MIN_WORDS   (1 << 15)    /* Shortest run of commands, in code words, worth splitting.           */
+#define PAR_SERIAL      1            /* Returned by par_exec() when the caller should run the commands itself. */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * Myrtle's state, as far as the commands par_exec() runs are concerned. 'dir' is one of the DIR_* directions in
+ * myrtle.h.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    coord_t row;
+    coord_t col;
+    int     dir;
+    bool    pendown;
+    char    penchar;
+} par_turtle_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * One turtle's stream of commands for par_exec_streams(): the commands from 'pc' to 'end', and the turtle which
+ * performs them. 'pc' and 'turtle' are updated as the commands are performed.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    const int    *pc;
+    const int    *end;
+    par_turtle_t  turtle;
+} par_stream_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * What par_exec_streams() calls back, with 'arg' and the index of the stream performing the command.
+ *
+ * stop  -- Called for each 'stop', to write the world. Returns TERM_NORM, or a status which ends the run.
+ * trace -- Called for each command 'op', in the order the commands are performed. NULL for no trace.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    void  *arg;
+    int  (*stop)(void *arg, int stream);
+    void (*trace)(void *arg, int stream, int op);
+} par_hooks_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * NONSTATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+extern int par_exec(world_t *world, const int *pc, const int *end, par_turtle_t *turtle, int threads);
+extern int par_exec_streams(world_t *world, par_stream_t *streams, int count, int threads,
+                            const par_hooks_t *hooks);
+
+#endif
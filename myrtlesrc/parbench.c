@@ -0,0 +1,187 @@
+/***************************************************************************************************************
+ * FILE: parbench.c
+ *
+ * DESCRIPTION:
+ * Benchmark for running a program on several threads (par.c) against running it on one. Generates two scripts
+ * in memory, runs each 'runs' times in a context with one job and in one with 'threads' jobs, as myrtle does
+ * without and with -j, checks that both write exactly the same output, and reports the commands per second of
+ * each and the speedup. The times are wall-clock times.
+ *
+ *     long    -- random moves, turns, pen changes and 'hyper's, with a 'stop' every 50000 commands, so every
+ *                stretch between stops is long enough for par_exec() to split.
+ *     turtles -- the same, shared out between Myrtle and 7 turtles (see par_exec_streams()).
+ *
+ * Both are run in a world of 'size' x 'size' squares, with moves of up to a fifth of it.
+ *
+ * Usage: parbench [threads [commands [runs [size]]]]     (default one per CPU, at least 2, 1000000 5 1000)
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261017T1400 [JMW] Initial revision.
+ **************************************************************************************************************/
+/* clock_gettime() and the number of CPUs are POSIX, not Standard C, so ask for them before including anything. */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "bool.h"
+#include "globals.h"
+#include "myrtle.h"
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC GLOBAL CONSTANT DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+static const int BENCH_STOP    = 50000;  /* Commands between stops.                          */
+static const int BENCH_TURTLES = 7;      /* Turtles besides Myrtle in the turtles workload. */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+static int     _bench_compare(const char *name, const char *src, size_t len, int cmds, int runs, int threads,
+                              int size);
+static char   *_bench_generate(int cmds, int turtles, int size, size_t *len);
+static double  _bench_now();
+static double  _bench_runs(myrtle_ctx_t *ctx, const char *src, size_t len, int runs);
+
+/*======================================= NONSTATIC FUNCTION DEFINITIONS =====================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: main()
+ * DESCR:    Generates the two scripts and compares their runs on one thread and on 'threads'.
+ * RETURNS:  Zero if every run on 'threads' threads matched, TERM_ERR_OUTPUT otherwise, or TERM_ERR_MEMORY.
+ *------------------------------------------------------------------------------------------------------------*/
+int main(int argc, char *argv[]) {
+    int     cpus    = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int     threads = argc > 1 ? atoi(argv[1]) : (cpus > 2 ? cpus : 2);
+    int     cmds    = argc > 2 ? atoi(argv[2]) : 1000000;
+    int     runs    = argc > 3 ? atoi(argv[3]) : 5;
+    int     size    = argc > 4 ? atoi(argv[4]) : 1000;
+    size_t  long_len, turtles_len;
+    char   *long_src, *turtles_src;
+    int     status;
+
+    if (runs < 1) runs = 1;
+    if (size < 5) size = 5;
+    long_src    = _bench_generate(cmds, 0, size, &long_len);
+    turtles_src = _bench_generate(cmds, BENCH_TURTLES, size, &turtles_len);
+    if (!long_src || !turtles_src) return TERM_ERR_MEMORY;
+    printf("parbench: %d commands, %d runs, world %d x %d, -j %d on %d CPUs\n", cmds, runs, size, size, threads,
+           cpus);
+
+    status = _bench_compare("long", long_src, long_len, cmds, runs, threads, size);
+    if (status == TERM_NORM) status = _bench_compare("turtles", turtles_src, turtles_len, cmds, runs, threads, size);
+
+    free(long_src);
+    free(turtles_src);
+    return status;
+}
+
+/*========================================= STATIC FUNCTION DEFINITIONS ======================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _bench_compare()
+ * DESCR:    Runs the script 'runs' times with one job and 'runs' times with 'threads' jobs, each in a context of
+ *           its own with a world of 'size' x 'size', checks that the last runs wrote the same output, and writes
+ *           the commands per second of each and the speedup.
+ * RETURNS:  TERM_NORM if the outputs matched, TERM_ERR_OUTPUT if not, or TERM_ERR_MEMORY.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _bench_compare(const char *name, const char *src, size_t len, int cmds, int runs, int threads,
+                          int size) {
+    myrtle_ctx_t *plain_ctx = myrtle_ctx_create(), *par_ctx = myrtle_ctx_create();
+    size_t        plain_len, par_len;
+    char         *plain_out, *par_out;
+    double        plain, par;
+    int           status = TERM_NORM;
+
+    if (!plain_ctx || !par_ctx) return TERM_ERR_MEMORY;
+    myrtle_ctx_world_size_set(plain_ctx, size, size);
+    myrtle_ctx_world_size_set(par_ctx, size, size);
+    myrtle_ctx_jobs_set(par_ctx, threads);
+
+    plain     = _bench_runs(plain_ctx, src, len, runs);
+    par       = _bench_runs(par_ctx, src, len, runs);
+    plain_out = myrtle_ctx_output(plain_ctx, &plain_len);
+    par_out   = myrtle_ctx_output(par_ctx, &par_len);
+    if (myrtle_ctx_status(plain_ctx) != TERM_NORM || myrtle_ctx_status(par_ctx) != TERM_NORM) {
+        printf("%-8s failed: %s\n", name, myrtle_ctx_error(myrtle_ctx_status(plain_ctx) != TERM_NORM ? plain_ctx :
+                                                                                                         par_ctx));
+        status = TERM_ERR_OUTPUT;
+    } else if (plain_len != par_len || memcmp(plain_out, par_out, plain_len) != 0) {
+        printf("%-8s -j %d MISMATCH with one thread\n", name, threads);
+        status = TERM_ERR_OUTPUT;
+    } else {
+        printf("%-8s plain %8.2f Mcmds/sec   -j %-2d %8.2f Mcmds/sec   %.2fx\n", name,
+               (double)cmds * runs / plain / 1e6, threads, (double)cmds * runs / par / 1e6, plain / par);
+    }
+
+    myrtle_ctx_destroy(plain_ctx);
+    myrtle_ctx_destroy(par_ctx);
+    return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _bench_generate()
+ * DESCR:    Generates a deterministic script of 'cmds' random commands in a world of 'size' x 'size', with a
+ *           'stop' every BENCH_STOP commands. With 'turtles', the commands after Myrtle's first share go to that
+ *           many turtle blocks, an equal share each.
+ * RETURNS:  The script, allocated with malloc(), and its length in *len.
+ *------------------------------------------------------------------------------------------------------------*/
+static char *_bench_generate(int cmds, int turtles, int size, size_t *len) {
+    unsigned long seed  = 12345;
+    int           share = cmds / (turtles + 1), t = 0, i;
+    char         *buf   = (char *)malloc((size_t)cmds * 32 + (size_t)turtles * 32 + 64), *p = buf;
+
+    if (!buf) return NULL;
+    for (i = 0; i < cmds; i++) {
+        int c;
+        if (turtles && i == share * (t + 1) && t < turtles) {
+            if (t++) p += sprintf(p, "end\n");
+            p += sprintf(p, "turtle t%d\n", t);
+        }
+        seed = seed * 1103515245 + 12345;
+        c = (int)((seed >> 16) % 16);
+        if (c < 6) p += sprintf(p, "forward %lu\n", (seed >> 4) % (size / 5) + 1);
+        else if (c < 8) p += sprintf(p, "backward %lu\n", (seed >> 4) % (size / 5) + 1);
+        else if (c < 10) p += sprintf(p, "right\n");
+        else if (c < 12) p += sprintf(p, "left\n");
+        else if (c < 13) p += sprintf(p, "penchar %c\n", "#*@xo+"[(seed >> 20) % 6]);
+        else if (c < 14) p += sprintf(p, "penup\n");
+        else if (c < 15) p += sprintf(p, "pendown\n");
+        else p += sprintf(p, "hyper %lu %lu\n", (seed >> 4) % size, (seed >> 20) % size);
+        if ((i + 1) % BENCH_STOP == 0) p += sprintf(p, "stop\n");
+    }
+    if (t) p += sprintf(p, "end\n");
+    p += sprintf(p, "stop\n");
+    *len = (size_t)(p - buf);
+    return buf;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _bench_now()
+ * DESCR:    Reads the monotonic clock.
+ * RETURNS:  The time in seconds.
+ *------------------------------------------------------------------------------------------------------------*/
+static double _bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _bench_runs()
+ * DESCR:    Runs the script 'runs' times in 'ctx'.
+ * RETURNS:  The wall-clock time taken in seconds.
+ *------------------------------------------------------------------------------------------------------------*/
+static double _bench_runs(myrtle_ctx_t *ctx, const char *src, size_t len, int runs) {
+    double start = _bench_now(), secs;
+    int    i;
+
+    for (i = 0; i < runs; i++) myrtle_ctx_run(ctx, src, len);
+    secs = _bench_now() - start;
+    return secs > 0 ? secs : 1e-9;
+}
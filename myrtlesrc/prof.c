@@ -0,0 +1,1052 @@
+/***************************************************************************************************************
+ * FILE: prof.c
+ *
+ * DESCRIPTION:
+ * The sampling profiler run by -P. It says which lines of a script the time of a run goes to, and which lines
+ * paint the squares, as folded stacks which flamegraph tools (flamegraph.pl, speedscope, inferno) read directly:
+ *
+ *     square.myr;repeat@4:1;sq@5:3;forward@2:9 312
+ *
+ * is 312 samples (or squares) in the 'forward' at line 2, column 9, inside the procedure 'sq' called at line 5,
+ * column 3, inside the 'repeat' at line 4, column 1 of square.myr.
+ *
+ * The compiler records where each command came from with prof_loc() as it emits it, and inlines no procedure
+ * bodies, so each command is reported where it was written, under the calls which led to it. A long script has
+ * a location for nearly every line, and most of a run's time can be compiling it, so the locations are encoded
+ * in a byte or so each rather than kept as structs (see prof_loc()). Time is sampled: a SIGPROF timer adds a
+ * tick to prof_ticks every PROF_INTERVAL_US of CPU time, and the interpreter, after each command, attributes
+ * the ticks which arrived while it was being performed to it (see PROF_COMMAND()). Squares are added to
+ * prof->cells as they are drawn and attributed the same way. So a command which takes a long time, e.g. a
+ * 'stop' writing a large world, gets all of the samples taken while it ran, and the interpreter does no more
+ * than test two counters per command.
+ *
+ * The counts of a command are kept along each call path which reaches it, so that a procedure called from two
+ * places shows up under both. A call path is a frame: the whole program, or the body of a procedure with the
+ * frame and the 'call' it was called from. Each frame has a count of squares for every word of its body, so
+ * attributing the squares of a command is an index, not a lookup. The counts are two bytes each, since a flat
+ * script writes to all of them; squares which would take one over PROF_COUNT_MAX are kept with the samples,
+ * which are far fewer, in a hash table. 'repeat' blocks are not frames, since the block around a command never
+ * changes; they are found when the profile is written. A procedure can only call procedures declared before it,
+ * so the paths cannot go round in circles, but there can be very many; calls below the first PROF_MAX_FRAMES
+ * paths are dropped. Both profiles are written in one walk of the program and its frames, into buffers of
+ * PROF_OUT_SIZE bytes.
+ *
+ * Only the interpreter is profiled: with -P, the program is not optimized, not loaded from the cache, and not
+ * run as native code or on threads. The timer and prof_ticks belong to the process, so only one run
+ * at a time can be timed: prof_start() refuses the timer to a run while another has it, and that run counts
+ * squares but takes no samples, and its profile is marked incomplete.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * 20261017T1100 [JMW] operand counts and command names come from cmd_nargs[] and cmd_names[] in myrtle.c
+ * 20261017T1200 [JMW] prof_start() does not take the timer from a run which already has it
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261017T0600 [JMW] Initial revision.
+ **************************************************************************************************************/
+/* sigaction() and setitimer() are POSIX, not Standard C, so ask for them before including anything. */
+#define _POSIX_C_SOURCE 200809L
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bool.h"
+#include "file.h"
+#include "globals.h"
+#include "myrtle.h"
+#include "prof.h"
+#include "stamp.h"
+
+/* POSIX header for setitimer() */
+#include <sys/time.h>
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * Where reading the locations has got to: the last location read, the offset in prof->locs of the next, and the
+ * number read. 'loc' is only valid if 'count' is not 0.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    prof_loc_t loc;
+    size_t     pos;
+    size_t     count;
+} prof_cursor_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * The call path being written by prof_write(): the frames from the whole program down, separated by ';', in a
+ * buffer which grows as needed.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    char   *buf;
+    size_t  len;
+    size_t  cap;
+    bool    ok;
+} prof_path_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * One of the files prof_write() writes: the file, or NULL if it is not written, and the bytes not written to it
+ * yet. 'ok' is false once it could not be written.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    FILE   *out;
+    char   *buf;
+    size_t  len;
+    bool    ok;
+} prof_out_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * Everything prof_write() writes with: the call path, the two files, and the entries of prof->samples which are
+ * not empty, sorted by path and then by command, so that a walk of a path finds them in the order it reaches
+ * them instead of looking up every command.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    prof_path_t    path;
+    prof_out_t     time;
+    prof_out_t     cells;
+    prof_sample_t *sorted;
+    size_t         sorted_count;
+} prof_writer_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+static int               _prof_compare(const void *a, const void *b);
+static int               _prof_find(const prof_t *prof, int parent, int site);
+static void              _prof_flush(prof_out_t *out);
+static int               _prof_frame_add(prof_t *prof, int site, int base, int len);
+static void              _prof_frame_set(prof_t *prof);
+static size_t            _prof_hash(int parent, int site, size_t size);
+static bool              _prof_insert(prof_t *prof, int frame);
+static void              _prof_loc_find(const prof_t *prof, int at, prof_cursor_t *cur);
+static void              _prof_loc_put(prof_t *prof, const prof_loc_t *loc);
+static size_t            _prof_loc_read(const prof_t *prof, const prof_cursor_t *cur, prof_loc_t *loc);
+static void              _prof_loc_seek(const prof_t *prof, prof_cursor_t *cur, int at);
+static const char       *_prof_name(const prof_t *prof, const int *pc);
+static const int        *_prof_next(const int *pc);
+static size_t            _prof_num(char *buf, unsigned long n);
+static void              _prof_out(prof_out_t *out, const prof_path_t *path, unsigned long n);
+static void              _prof_push(prof_path_t *path, const char *name, const prof_loc_t *loc);
+static bool              _prof_sample(prof_t *prof, int frame, int at, unsigned long ticks, unsigned long cells);
+static size_t            _prof_sorted_find(const prof_writer_t *w, int frame, int at);
+static void              _prof_tick(int sig);
+static size_t            _prof_uint_get(const unsigned char *p, unsigned long *n);
+static size_t            _prof_uint_put(unsigned char *p, unsigned long n);
+static void              _prof_walk(const prof_t *prof, prof_writer_t *w, int frame, const int *pc, const int *end,
+                                    prof_cursor_t *loc, size_t *s);
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC GLOBAL CONSTANT DEFINITIONS
+ *
+ * prof_pairs -- The numbers 00 to 99 in decimal, two chars each, for _prof_num().
+ *------------------------------------------------------------------------------------------------------------*/
+static const char prof_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+/*--------------------------------------------------------------------------------------------------------------
+ * NONSTATIC GLOBAL VARIABLE DEFINITIONS
+ *
+ * prof_ticks -- Samples taken by the timer which have not been attributed to a command yet.
+ *------------------------------------------------------------------------------------------------------------*/
+volatile sig_atomic_t prof_ticks = 0;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC GLOBAL VARIABLE DEFINITIONS
+ *
+ * armed      -- True while the timer is running for some run.
+ * arm_lock   -- Held while 'armed' is tested and set, so that two runs starting at once cannot both take the
+ *               timer.
+ * old_action -- The SIGPROF action before prof_start(), restored by prof_stop().
+ * old_timer  -- The profiling timer before prof_start(), restored by prof_stop().
+ *------------------------------------------------------------------------------------------------------------*/
+static bool             armed    = false;
+static pthread_mutex_t  arm_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct sigaction old_action;
+static struct itimerval old_timer;
+
+/*======================================= NONSTATIC FUNCTION DEFINITIONS =====================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: prof_command()
+ * DESCR:    Attributes the ticks and squares since the last command to the command at index 'at' of the program,
+ *           along the call path being performed. Called through PROF_COMMAND(). Squares which would take its
+ *           count over PROF_COUNT_MAX are moved, with the count, to its entry in the samples. A run which does
+ *           not have the timer leaves prof_ticks to the run which does.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void prof_command(prof_t *prof, int at) {
+    unsigned long ticks = 0, over = 0;
+
+    if (prof->timed) {
+        ticks      = (unsigned long)prof_ticks;
+        prof_ticks = 0;
+    }
+    if (!prof->counts) {
+        prof->dropped.samples += ticks;
+        prof->dropped.cells   += prof->cells;
+    } else {
+        unsigned short *count = &prof->counts[at - prof->base];
+        if (prof->cells > (unsigned long)(PROF_COUNT_MAX - *count)) {
+            over   = *count + prof->cells;
+            *count = 0;
+        } else {
+            *count += (unsigned short)prof->cells;
+        }
+        if ((ticks || over) && !_prof_sample(prof, prof->frame, at, ticks, over)) {
+            prof->dropped.samples += ticks;
+            prof->dropped.cells   += over;
+            prof->ok = false;
+        }
+    }
+    prof->cells = 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: prof_enter()
+ * DESCR:    Called before the body of a procedure is performed for the 'call' at index 'site' of the program. The
+ *           body is the 'len' words from index 'base'. Its frame along the call path being performed becomes the
+ *           one being performed, and is made if this is the first call along that path.
+ * RETURNS:  Nothing. If the frame cannot be made, the samples and squares of the call are dropped.
+ *------------------------------------------------------------------------------------------------------------*/
+void prof_enter(prof_t *prof, int site, int base, int len) {
+    int i = -1;
+
+    if (!prof->lost && prof->frame_count > 0) {
+        i = _prof_find(prof, prof->frame, site);
+        if (i < 0) i = _prof_frame_add(prof, site, base, len);
+    }
+    if (i < 0) {
+        prof->lost++;
+    } else {
+        prof->frame = i;
+    }
+    _prof_frame_set(prof);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: prof_free()
+ * DESCR:    Frees everything in 'prof'.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void prof_free(prof_t *prof) {
+    prof_reset(prof, NULL);
+    free(prof->locs);
+    free(prof->keys);
+    free(prof->procs);
+    free(prof->frames);
+    free(prof->table);
+    free(prof->samples);
+    prof_init(prof);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: prof_init()
+ * DESCR:    Initializes 'prof' to an empty profile.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void prof_init(prof_t *prof) {
+    memset(prof, 0, sizeof(*prof));
+    prof_reset(prof, NULL);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: prof_leave()
+ * DESCR:    Called after the body of a procedure is performed. The frame it was called from is performed again.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void prof_leave(prof_t *prof) {
+    if (prof->lost) prof->lost--;
+    else prof->frame = prof->frames[prof->frame].parent;
+    _prof_frame_set(prof);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: prof_loc()
+ * DESCR:    Records that the command whose first word is about to be emitted at index 'index' of the program is
+ *           'token' of 'file'. Commands must be located in order of index. A command which emits no words (']' or
+ *           'end') is replaced by the next one, so each location is only encoded once the next command is at
+ *           another index (see _prof_loc_put()). The column is worked out from where the line starts, which is
+ *           only looked for once per line, so locating every command of the file takes time in proportion to its
+ *           size. In a streamed input, a line longer than the window of the input starts at the start of the
+ *           window.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void prof_loc(prof_t *prof, int index, const file_t *file, const token_t *token) {
+    size_t offset = file->in_read - file->in_len + (size_t)(token->text - file->in_buf);
+
+    if (token->line != prof->last.line) {
+        const char *p = token->text;
+        while (p > file->in_buf && p[-1] != '\n') p--;
+        prof->line_start = offset - (size_t)(token->text - p);
+    }
+    if (prof->last.index != index && prof->last.index >= 0) {
+        /* The one-byte case of _prof_loc_put(), which is nearly every command, without the call. */
+        unsigned long d_index = (unsigned long)(prof->last.index - prof->prev.index - 1);
+        unsigned long d_line  = (unsigned long)(prof->last.line - prof->prev.line);
+        unsigned long col     = (unsigned long)(prof->last.col - 1);
+        if (d_index < 4 && d_line <= 1 && col < 16 && prof->loc_len < prof->loc_cap &&
+            prof->loc_count % PROF_LOC_KEY != 0) {
+            prof->locs[prof->loc_len++] = (unsigned char)(d_index | d_line << 2 | col << 3);
+            prof->loc_count++;
+            prof->prev = prof->last;
+        } else {
+            _prof_loc_put(prof, &prof->last);
+        }
+    }
+    prof->last.index = index;
+    prof->last.line  = token->line;
+    prof->last.col   = (int)(offset - prof->line_start) + 1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: prof_proc()
+ * DESCR:    Records the name of the procedure whose CMD_TO is at index 'at' of the program. Procedures must be
+ *           recorded in order of 'at'. The name is not copied; it must last until the profile is written.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void prof_proc(prof_t *prof, int at, const char *name) {
+    if (prof->proc_count == prof->proc_cap) {
+        int          cap   = prof->proc_cap ? prof->proc_cap * 2 : 16;
+        prof_proc_t *procs = (prof_proc_t *)realloc(prof->procs, cap * sizeof(prof_proc_t));
+        if (!procs) {
+            prof->ok = false;
+            return;
+        }
+        prof->procs    = procs;
+        prof->proc_cap = cap;
+    }
+    prof->procs[prof->proc_count].at   = at;
+    prof->procs[prof->proc_count].name = name;
+    prof->proc_count++;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: prof_reset()
+ * DESCR:    Empties 'prof' for a new run of the input file named 'source' (NULL if it has no name). The memory of
+ *           the arrays is kept.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void prof_reset(prof_t *prof, const char *source) {
+    int i;
+    for (i = 0; i < prof->frame_count; i++) free(prof->frames[i].cells);
+    if (prof->table) memset(prof->table, 0, prof->table_size * sizeof(int));
+    if (prof->samples) memset(prof->samples, 0, prof->sample_size * sizeof(prof_sample_t));
+    prof->sample_count = 0;
+    prof->source      = source;
+    prof->words       = NULL;
+    prof->loc_len     = 0;
+    prof->loc_count   = 0;
+    prof->key_count   = 0;
+    prof->last.index  = prof->prev.index = -1;
+    prof->last.line   = prof->prev.line  = 0;
+    prof->last.col    = prof->prev.col   = 0;
+    prof->line_start  = 0;
+    prof->proc_count  = 0;
+    prof->frame_count = 0;
+    prof->frame       = 0;
+    prof->counts      = NULL;
+    prof->base        = 0;
+    prof->lost        = 0;
+    prof->cells       = 0;
+    prof->other       = 0;
+    prof->timed       = false;
+    prof->ok          = true;
+    prof->dropped.samples = prof->dropped.cells = 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: prof_stamp()
+ * DESCR:    Counts the squares drawn by one stamp_blit() of 'stamp' as painted by the command being performed.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void prof_stamp(prof_t *prof, const stamp_t *stamp) {
+    size_t i;
+    for (i = 0; i < stamp->count; i++) prof->cells += (unsigned long)stamp->runs[i].count;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: prof_start()
+ * DESCR:    Starts profiling the 'count' words of compiled program at 'words', which must not move until the
+ *           profile is written: encodes the last location, makes the frame of the whole program and starts the
+ *           timer. The timer belongs to the process, so if another run already has it, it is left alone: this
+ *           run counts its squares but takes no samples, and prof->ok is set to false.
+ * RETURNS:  Nothing. If the frame cannot be allocated, every sample is dropped.
+ *------------------------------------------------------------------------------------------------------------*/
+void prof_start(prof_t *prof, const int *words, size_t count) {
+    struct sigaction action;
+    struct itimerval timer;
+
+    if (prof->last.index >= 0) {
+        _prof_loc_put(prof, &prof->last);
+        prof->last.index = -1;
+    }
+    prof->words = words;
+    if (!prof->frames) {
+        prof->frames    = (prof_frame_t *)malloc(16 * sizeof(prof_frame_t));
+        prof->frame_cap = prof->frames ? 16 : 0;
+    }
+    if (prof->frames) {
+        prof->frames[0].parent = -1;
+        prof->frames[0].site   = -1;
+        prof->frames[0].base   = 0;
+        prof->frames[0].len    = (int)count;
+        prof->frames[0].cells  = (unsigned short *)calloc(count ? count : 1, sizeof(unsigned short));
+        if (prof->frames[0].cells) prof->frame_count = 1;
+    }
+    if (prof->frame_count == 0) prof->ok = false;
+    _prof_frame_set(prof);
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = _prof_tick;
+    action.sa_flags   = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    timer.it_interval.tv_sec  = timer.it_value.tv_sec  = 0;
+    timer.it_interval.tv_usec = timer.it_value.tv_usec = PROF_INTERVAL_US;
+    pthread_mutex_lock(&arm_lock);
+    if (armed) {
+        prof->ok = false;
+    } else if (sigaction(SIGPROF, &action, &old_action) == 0) {
+        prof_ticks = 0;
+        if (setitimer(ITIMER_PROF, &timer, &old_timer) == 0) armed = prof->timed = true;
+        else sigaction(SIGPROF, &old_action, NULL);
+    }
+    pthread_mutex_unlock(&arm_lock);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: prof_stop()
+ * DESCR:    Stops the timer, if prof_start() started it for this run. Ticks which no command claimed are counted
+ *           as 'other'.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void prof_stop(prof_t *prof) {
+    if (!prof->timed) return;
+    pthread_mutex_lock(&arm_lock);
+    setitimer(ITIMER_PROF, &old_timer, NULL);
+    sigaction(SIGPROF, &old_action, NULL);
+    prof->other += (unsigned long)prof_ticks;
+    prof_ticks   = 0;
+    armed        = prof->timed = false;
+    pthread_mutex_unlock(&arm_lock);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: prof_write()
+ * DESCR:    Writes the profile as folded stacks, one line for each command along each call path with anything
+ *           attributed to it: the samples taken while it was performed to 'time_out', and the squares it painted
+ *           to 'cells_out'. Either may be NULL, and is then not written. The first frame is the name of the input
+ *           file. See the top of this file.
+ * RETURNS:  True, or false if a file could not be written or memory ran out.
+ *------------------------------------------------------------------------------------------------------------*/
+bool prof_write(const prof_t *prof, FILE *time_out, FILE *cells_out) {
+    prof_writer_t w;
+    size_t        i;
+    bool          ok;
+
+    w.path.buf = NULL;
+    w.path.len = w.path.cap = 0;
+    w.path.ok  = true;
+    w.time.out  = time_out;
+    w.cells.out = cells_out;
+    w.time.len  = w.cells.len = 0;
+    w.time.ok   = w.cells.ok  = true;
+    w.time.buf  = time_out ? (char *)malloc(PROF_OUT_SIZE) : NULL;
+    w.cells.buf = cells_out ? (char *)malloc(PROF_OUT_SIZE) : NULL;
+    w.sorted    = (prof_sample_t *)malloc((prof->sample_count ? prof->sample_count : 1) * sizeof(prof_sample_t));
+    w.sorted_count = 0;
+    if ((time_out && !w.time.buf) || (cells_out && !w.cells.buf) || !w.sorted) w.path.ok = false;
+
+    if (w.path.ok) {
+        for (i = 0; i < prof->sample_size; i++) {
+            if (prof->samples[i].samples || prof->samples[i].cells) w.sorted[w.sorted_count++] = prof->samples[i];
+        }
+        qsort(w.sorted, w.sorted_count, sizeof(prof_sample_t), _prof_compare);
+    }
+    _prof_push(&w.path, prof->source && *prof->source ? prof->source : "stdin", NULL);
+    if (prof->frame_count > 0 && w.path.ok) {
+        prof_cursor_t loc;
+        size_t        s = 0;
+        loc.pos = loc.count = 0;
+        _prof_walk(prof, &w, 0, prof->words, prof->words + prof->frames[0].len, &loc, &s);
+    }
+    if (w.path.ok) {
+        size_t len = w.path.len;
+        if (prof->dropped.samples || prof->dropped.cells) _prof_push(&w.path, "(dropped)", NULL);
+        if (prof->dropped.samples) _prof_out(&w.time, &w.path, prof->dropped.samples);
+        if (prof->dropped.cells) _prof_out(&w.cells, &w.path, prof->dropped.cells);
+        w.path.len = len;
+        w.path.buf[len] = '\0';
+        if (prof->other) {
+            _prof_push(&w.path, "(outside commands)", NULL);
+            _prof_out(&w.time, &w.path, prof->other);
+        }
+    }
+    _prof_flush(&w.time);
+    _prof_flush(&w.cells);
+    ok = w.path.ok && w.time.ok && w.cells.ok && !(time_out && ferror(time_out)) &&
+         !(cells_out && ferror(cells_out));
+    free(w.path.buf);
+    free(w.time.buf);
+    free(w.cells.buf);
+    free(w.sorted);
+    return ok;
+}
+
+/*======================================== STATIC FUNCTION DEFINITIONS =======================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _prof_compare()
+ * DESCR:    Orders two samples, for qsort(), by call path and then by command.
+ * RETURNS:  Less than, equal to or greater than 0 as 'a' comes before, with or after 'b'.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _prof_compare(const void *a, const void *b) {
+    const prof_sample_t *x = (const prof_sample_t *)a, *y = (const prof_sample_t *)b;
+    if (x->frame != y->frame) return x->frame < y->frame ? -1 : 1;
+    return x->at < y->at ? -1 : x->at > y->at;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _prof_find()
+ * DESCR:    Looks up the frame of the procedure called by the 'call' at index 'site' along the call path
+ *           'parent'.
+ * RETURNS:  The index of the frame, or -1 if there is none.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _prof_find(const prof_t *prof, int parent, int site) {
+    size_t i;
+    if (!prof->table) return -1;
+    for (i = _prof_hash(parent, site, prof->table_size); prof->table[i]; i = (i + 1) & (prof->table_size - 1)) {
+        const prof_frame_t *f = &prof->frames[prof->table[i] - 1];
+        if (f->parent == parent && f->site == site) return prof->table[i] - 1;
+    }
+    return -1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _prof_flush()
+ * DESCR:    Writes the bytes buffered for 'out' to its file.
+ * RETURNS:  Nothing. out->ok becomes false if they cannot be written.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _prof_flush(prof_out_t *out) {
+    if (out->out && out->len && fwrite(out->buf, 1, out->len, out->out) != out->len) out->ok = false;
+    out->len = 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _prof_frame_add()
+ * DESCR:    Makes the frame of the procedure whose body is the 'len' words from index 'base', called by the 'call'
+ *           at index 'site' along the call path being performed. See prof_enter().
+ * RETURNS:  The index of the frame, or -1 if there are PROF_MAX_FRAMES already or memory ran out, in which case
+ *           the profile is not ok.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _prof_frame_add(prof_t *prof, int site, int base, int len) {
+    prof_frame_t *f;
+
+    if (prof->frame_count == prof->frame_cap && prof->frame_count < PROF_MAX_FRAMES) {
+        int           cap    = prof->frame_cap * 2;
+        prof_frame_t *frames = (prof_frame_t *)realloc(prof->frames, cap * sizeof(prof_frame_t));
+        if (frames) {
+            prof->frames    = frames;
+            prof->frame_cap = cap;
+        }
+    }
+    if (prof->frame_count == prof->frame_cap) {
+        prof->ok = false;
+        return -1;
+    }
+    f = &prof->frames[prof->frame_count];
+    f->parent = prof->frame;
+    f->site   = site;
+    f->base   = base;
+    f->len    = len;
+    f->cells  = (unsigned short *)calloc(len > 0 ? len : 1, sizeof(unsigned short));
+    if (!f->cells || !_prof_insert(prof, prof->frame_count)) {
+        free(f->cells);
+        prof->ok = false;
+        return -1;
+    }
+    return prof->frame_count++;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _prof_frame_set()
+ * DESCR:    Points prof->counts and prof->base at the squares of the frame being performed, for PROF_COMMAND(),
+ *           or prof->counts at NULL if there is none, so that what is attributed is dropped.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _prof_frame_set(prof_t *prof) {
+    if (prof->lost || prof->frame_count == 0) {
+        prof->counts = NULL;
+    } else {
+        prof->counts = prof->frames[prof->frame].cells;
+        prof->base   = prof->frames[prof->frame].base;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _prof_hash()
+ * DESCR:    Hashes a parent frame and a call site, or a frame and a command, to a slot of a table of 'size' slots,
+ *           a power of 2.
+ * RETURNS:  The slot.
+ *------------------------------------------------------------------------------------------------------------*/
+static size_t _prof_hash(int parent, int site, size_t size) {
+    unsigned long h = (unsigned long)parent * 2654435761UL ^ (unsigned long)site * 40503UL;
+    return (size_t)(h ^ (h >> 15)) & (size - 1);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _prof_insert()
+ * DESCR:    Adds frame 'frame' to the hash table, doubling the table first if it would be more than half full.
+ * RETURNS:  True, or false if the table could not be grown.
+ *------------------------------------------------------------------------------------------------------------*/
+static bool _prof_insert(prof_t *prof, int frame) {
+    const prof_frame_t *f = &prof->frames[frame];
+    size_t              i;
+
+    if ((size_t)(prof->frame_count + 1) * 2 > prof->table_size) {
+        size_t  size  = prof->table_size ? prof->table_size * 2 : 64;
+        int    *table = (int *)calloc(size, sizeof(int));
+        size_t  j;
+        if (!table) return false;
+        for (j = 0; j < prof->table_size; j++) {
+            if (prof->table[j]) {
+                const prof_frame_t *g = &prof->frames[prof->table[j] - 1];
+                i = _prof_hash(g->parent, g->site, size);
+                while (table[i]) i = (i + 1) & (size - 1);
+                table[i] = prof->table[j];
+            }
+        }
+        free(prof->table);
+        prof->table      = table;
+        prof->table_size = size;
+    }
+    i = _prof_hash(f->parent, f->site, prof->table_size);
+    while (prof->table[i]) i = (i + 1) & (prof->table_size - 1);
+    prof->table[i] = frame + 1;
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _prof_loc_find()
+ * DESCR:    Sets *cur to read the locations from the last key at or before index 'at' of the program, and reads
+ *           on to where the command at 'at' came from (see _prof_loc_seek()).
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _prof_loc_find(const prof_t *prof, int at, prof_cursor_t *cur) {
+    size_t lo = 0, hi = prof->key_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (prof->keys[mid].loc.index <= at) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == 0) {
+        cur->pos = cur->count = 0;
+    } else {
+        cur->loc   = prof->keys[lo - 1].loc;
+        cur->pos   = prof->keys[lo - 1].pos;
+        cur->count = (lo - 1) * PROF_LOC_KEY + 1;
+    }
+    _prof_loc_seek(prof, cur, at);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _prof_loc_put()
+ * DESCR:    Encodes 'loc' at the end of prof->locs, relative to the location before it, prof->prev. Nearly every
+ *           command of a script is on the line after the one before or on the same line, a word or two on in the
+ *           program and near the start of its line, so in most it fits in one byte below 0x80:
+ *
+ *               bits 0-1 -- index - prev.index - 1
+ *               bit  2   -- line - prev.line
+ *               bits 3-6 -- col - 1
+ *
+ *           Any other is the byte 0x80, then index - prev.index, line - prev.line and col, each a varint (see
+ *           _prof_uint_put()). Every PROF_LOC_KEY locations, a key is kept.
+ * RETURNS:  Nothing. If memory runs out, the location is dropped and the profile is not ok.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _prof_loc_put(prof_t *prof, const prof_loc_t *loc) {
+    unsigned long  index = (unsigned long)(loc->index - prof->prev.index);
+    unsigned long  line  = (unsigned long)(loc->line - prof->prev.line);
+    unsigned long  col   = (unsigned long)(loc->col - 1);
+    unsigned char *p;
+
+    if (prof->loc_len + 16 > prof->loc_cap) {
+        size_t         cap  = prof->loc_cap ? prof->loc_cap * 2 : 4096;
+        unsigned char *locs = (unsigned char *)realloc(prof->locs, cap);
+        if (!locs) {
+            prof->ok = false;
+            return;
+        }
+        prof->locs    = locs;
+        prof->loc_cap = cap;
+    }
+    if (prof->loc_count % PROF_LOC_KEY == 0 && prof->key_count == prof->key_cap) {
+        size_t      cap  = prof->key_cap ? prof->key_cap * 2 : 64;
+        prof_key_t *keys = (prof_key_t *)realloc(prof->keys, cap * sizeof(prof_key_t));
+        if (!keys) {
+            prof->ok = false;
+            return;
+        }
+        prof->keys    = keys;
+        prof->key_cap = cap;
+    }
+    p = prof->locs + prof->loc_len;
+    if (index - 1 < 4 && line <= 1 && col < 16) {
+        *p++ = (unsigned char)((index - 1) | line << 2 | col << 3);
+    } else {
+        *p++ = 0x80;
+        p += _prof_uint_put(p, index);
+        p += _prof_uint_put(p, line);
+        p += _prof_uint_put(p, (unsigned long)loc->col);
+    }
+    prof->loc_len = (size_t)(p - prof->locs);
+    if (prof->loc_count % PROF_LOC_KEY == 0) {
+        prof->keys[prof->key_count].loc = *loc;
+        prof->keys[prof->key_count].pos = prof->loc_len;
+        prof->key_count++;
+    }
+    prof->loc_count++;
+    prof->prev = *loc;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _prof_loc_read()
+ * DESCR:    Decodes the location after the one *cur has read into *loc (see _prof_loc_put()). *cur must not have
+ *           read them all.
+ * RETURNS:  The offset in prof->locs of the location after it.
+ *------------------------------------------------------------------------------------------------------------*/
+static size_t _prof_loc_read(const prof_t *prof, const prof_cursor_t *cur, prof_loc_t *loc) {
+    const unsigned char *p     = prof->locs + cur->pos;
+    int                  index = cur->count ? cur->loc.index : -1;
+    int                  line  = cur->count ? cur->loc.line : 0;
+    unsigned long        n;
+
+    if (*p < 0x80) {
+        loc->index = index + 1 + (*p & 3);
+        loc->line  = line + (*p >> 2 & 1);
+        loc->col   = (*p >> 3) + 1;
+        return cur->pos + 1;
+    }
+    p++;
+    p += _prof_uint_get(p, &n);
+    loc->index = index + (int)n;
+    p += _prof_uint_get(p, &n);
+    loc->line = line + (int)n;
+    p += _prof_uint_get(p, &n);
+    loc->col = (int)n;
+    return (size_t)(p - prof->locs);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _prof_loc_seek()
+ * DESCR:    Reads on from *cur over the locations at or before index 'at' of the program. The last of them is
+ *           where the command at 'at' came from. Skips to the last key at or before 'at' if there is one ahead,
+ *           and decodes the one-byte locations here rather than in _prof_loc_read().
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _prof_loc_seek(const prof_t *prof, prof_cursor_t *cur, int at) {
+    size_t        k = (cur->count + PROF_LOC_KEY - 1) / PROF_LOC_KEY;
+    prof_cursor_t c;
+
+    if (k < prof->key_count && prof->keys[k].loc.index <= at) {
+        while (k + 1 < prof->key_count && prof->keys[k + 1].loc.index <= at) k++;
+        cur->loc   = prof->keys[k].loc;
+        cur->pos   = prof->keys[k].pos;
+        cur->count = k * PROF_LOC_KEY + 1;
+    }
+    /* Read into a copy, which the compiler can keep in registers, since prof->locs is chars and could alias it. */
+    c = *cur;
+    while (c.count < prof->loc_count) {
+        unsigned char byte = prof->locs[c.pos];
+        if (c.count && byte < 0x80) {
+            if (c.loc.index + 1 + (byte & 3) > at) break;
+            c.loc.index += 1 + (byte & 3);
+            c.loc.line  += byte >> 2 & 1;
+            c.loc.col    = (byte >> 3) + 1;
+            c.pos++;
+        } else {
+            prof_loc_t loc;
+            size_t     pos = _prof_loc_read(prof, &c, &loc);
+            if (loc.index > at) break;
+            c.loc = loc;
+            c.pos = pos;
+        }
+        c.count++;
+    }
+    *cur = c;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _prof_name()
+ * DESCR:    Names the command at 'pc' for a frame: a 'call' by the name of the procedure it calls, anything else
+ *           as it is written in the source.
+ * RETURNS:  The name.
+ *------------------------------------------------------------------------------------------------------------*/
+static const char *_prof_name(const prof_t *prof, const int *pc) {
+    int lo = 0, hi = prof->proc_count - 1;
+    int at = (int)(pc + pc[1] - prof->words);
+    if (*pc != CMD_CALL) return cmd_names[*pc];
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (prof->procs[mid].at == at) return prof->procs[mid].name;
+        if (prof->procs[mid].at < at) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return cmd_names[CMD_CALL];
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _prof_next()
+ * DESCR:    Steps over the command at 'pc', and over its body if it is a 'repeat' or a 'to'.
+ * RETURNS:  The command after it.
+ *------------------------------------------------------------------------------------------------------------*/
+static const int *_prof_next(const int *pc) {
+    if (*pc == CMD_REPEAT) return pc + 3 + pc[2];
+    if (*pc == CMD_TO) return pc + 2 + pc[1];
+    return pc + 1 + cmd_nargs[*pc];
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _prof_num()
+ * DESCR:    Writes 'n' in decimal to 'buf', without a '\0'. A profile has a line, and three numbers, for nearly
+ *           every command of a large script, so this is done here rather than with sprintf(), two digits at a
+ *           time from the end.
+ * RETURNS:  The number of chars written.
+ *------------------------------------------------------------------------------------------------------------*/
+static size_t _prof_num(char *buf, unsigned long n) {
+    char   digits[24];
+    char  *p = digits + sizeof(digits);
+    size_t len;
+
+    while (n >= 100) {
+        p -= 2;
+        memcpy(p, prof_pairs + n % 100 * 2, 2);
+        n /= 100;
+    }
+    if (n >= 10) {
+        p -= 2;
+        memcpy(p, prof_pairs + n * 2, 2);
+    } else {
+        *--p = (char)('0' + n);
+    }
+    len = (size_t)(digits + sizeof(digits) - p);
+    memcpy(buf, p, len);
+    return len;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _prof_out()
+ * DESCR:    Writes a line of 'out': the call path 'path', then 'n'. Does nothing if 'out' is not written.
+ * RETURNS:  Nothing. out->ok becomes false if the line cannot be written.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _prof_out(prof_out_t *out, const prof_path_t *path, unsigned long n) {
+    if (!out->out) return;
+    if (out->len + path->len + 32 > PROF_OUT_SIZE) {
+        _prof_flush(out);
+        if (path->len + 32 > PROF_OUT_SIZE) {
+            if (fwrite(path->buf, 1, path->len, out->out) != path->len) out->ok = false;
+            if (fprintf(out->out, " %lu\n", n) < 0) out->ok = false;
+            return;
+        }
+    }
+    memcpy(out->buf + out->len, path->buf, path->len);
+    out->len += path->len;
+    out->buf[out->len++] = ' ';
+    out->len += _prof_num(out->buf + out->len, n);
+    out->buf[out->len++] = '\n';
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _prof_push()
+ * DESCR:    Appends the frame 'name', at 'loc' if it is not NULL, to 'path'. A ';' in the name, which would split
+ *           it into two frames, is written as '_'. On running out of memory, path->ok becomes false.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _prof_push(prof_path_t *path, const char *name, const prof_loc_t *loc) {
+    size_t need = path->len + strlen(name) + 64, i;
+    if (!path->ok) return;
+    if (need > path->cap) {
+        size_t cap = need * 2;
+        char  *buf = (char *)realloc(path->buf, cap);
+        if (!buf) {
+            path->ok = false;
+            return;
+        }
+        path->buf = buf;
+        path->cap = cap;
+    }
+    if (path->len) path->buf[path->len++] = ';';
+    for (i = path->len; *name; name++) path->buf[i++] = *name == ';' ? '_' : *name;
+    path->len = i;
+    if (loc) {
+        path->buf[path->len++] = '@';
+        path->len += _prof_num(path->buf + path->len, (unsigned long)loc->line);
+        path->buf[path->len++] = ':';
+        path->len += _prof_num(path->buf + path->len, (unsigned long)loc->col);
+    }
+    path->buf[path->len] = '\0';
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _prof_sample()
+ * DESCR:    Adds 'ticks' samples and 'cells' squares to the command at index 'at' of the program along call path
+ *           'frame'. Samples are kept in a hash table rather than an array like the squares: there are few of
+ *           them, and a table of the size of the program which was hardly ever written would still have to be
+ *           read to be written out. So are the squares of a command beyond what its two-byte count holds.
+ * RETURNS:  True, or false if the table could not be grown.
+ *------------------------------------------------------------------------------------------------------------*/
+static bool _prof_sample(prof_t *prof, int frame, int at, unsigned long ticks, unsigned long cells) {
+    size_t i;
+
+    if ((prof->sample_count + 1) * 2 > prof->sample_size) {
+        size_t         size    = prof->sample_size ? prof->sample_size * 2 : 256;
+        prof_sample_t *samples = (prof_sample_t *)calloc(size, sizeof(prof_sample_t));
+        size_t         j;
+        if (!samples) return false;
+        for (j = 0; j < prof->sample_size; j++) {
+            const prof_sample_t *old = &prof->samples[j];
+            if (old->samples || old->cells) {
+                i = _prof_hash(old->frame, old->at, size);
+                while (samples[i].samples || samples[i].cells) i = (i + 1) & (size - 1);
+                samples[i] = *old;
+            }
+        }
+        free(prof->samples);
+        prof->samples     = samples;
+        prof->sample_size = size;
+    }
+    i = _prof_hash(frame, at, prof->sample_size);
+    while ((prof->samples[i].samples || prof->samples[i].cells) &&
+           (prof->samples[i].frame != frame || prof->samples[i].at != at)) {
+        i = (i + 1) & (prof->sample_size - 1);
+    }
+    if (!prof->samples[i].samples && !prof->samples[i].cells) {
+        prof->samples[i].frame = frame;
+        prof->samples[i].at    = at;
+        prof->sample_count++;
+    }
+    prof->samples[i].samples += ticks;
+    prof->samples[i].cells   += cells;
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _prof_sorted_find()
+ * DESCR:    Looks for the first of the sorted samples of prof_write() which is along call path 'frame' at or after
+ *           index 'at' of the program, or along a later path.
+ * RETURNS:  Its index in w->sorted, or w->sorted_count if there is none.
+ *------------------------------------------------------------------------------------------------------------*/
+static size_t _prof_sorted_find(const prof_writer_t *w, int frame, int at) {
+    size_t lo = 0, hi = w->sorted_count;
+    while (lo < hi) {
+        size_t               mid = lo + (hi - lo) / 2;
+        const prof_sample_t *e   = &w->sorted[mid];
+        if (e->frame < frame || (e->frame == frame && e->at < at)) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _prof_tick()
+ * DESCR:    The SIGPROF handler. Counts a sample for the interpreter to attribute.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _prof_tick(int sig) {
+    prof_ticks++;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _prof_uint_get()
+ * DESCR:    Decodes the varint at 'p' into *n (see _prof_uint_put()).
+ * RETURNS:  The number of bytes it took.
+ *------------------------------------------------------------------------------------------------------------*/
+static size_t _prof_uint_get(const unsigned char *p, unsigned long *n) {
+    size_t len = 0;
+    int    shift = 0;
+    *n = 0;
+    do {
+        *n |= (unsigned long)(p[len] & 0x7F) << shift;
+        shift += 7;
+    } while (p[len++] & 0x80);
+    return len;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _prof_uint_put()
+ * DESCR:    Encodes 'n' at 'p' as a varint: 7 bits to a byte, lowest first, with the top bit set in all but the
+ *           last. An int takes at most 5 bytes.
+ * RETURNS:  The number of bytes written.
+ *------------------------------------------------------------------------------------------------------------*/
+static size_t _prof_uint_put(unsigned char *p, unsigned long n) {
+    size_t len = 0;
+    while (n >= 0x80) {
+        p[len++] = (unsigned char)(n | 0x80);
+        n >>= 7;
+    }
+    p[len++] = (unsigned char)n;
+    return len;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _prof_walk()
+ * DESCR:    Writes the lines of prof_write() for the commands from 'pc' to 'end' of frame 'frame', whose call path
+ *           so far is w->path, and for the frames of the procedures they call. A 'repeat' is a frame around its
+ *           body, and a 'call' around the frame of the procedure along this path; each also has a line of its
+ *           own, for what was attributed to the command itself. The commands are written in order, so *loc reads
+ *           on through the locations, and *s through the sorted samples of the frame, as they are reached.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _prof_walk(const prof_t *prof, prof_writer_t *w, int frame, const int *pc, const int *end,
+                       prof_cursor_t *loc, size_t *s) {
+    const prof_frame_t   *f      = &prof->frames[frame];
+    const int            *words  = prof->words;
+    const unsigned short *counts = f->cells - f->base;
+    const prof_sample_t  *sorted = w->sorted;
+    size_t                count  = w->sorted_count;
+
+    for (; pc < end && w->path.ok; pc = _prof_next(pc)) {
+        const int    *next    = end;
+        int           at;
+        unsigned long samples = 0, cells;
+        size_t        mark, i = *s;
+
+        /* Most commands have nothing to write, so step over them here, up to the next with samples. */
+        if (i < count && sorted[i].frame == frame) next = words + sorted[i].at;
+        while (pc < next && !counts[pc - words] && *pc != CMD_REPEAT && *pc != CMD_CALL && *pc != CMD_TO) {
+            pc += 1 + cmd_nargs[*pc];
+        }
+        if (pc >= end) break;
+        at    = (int)(pc - words);
+        cells = counts[at];
+        while (i < count && sorted[i].frame == frame && sorted[i].at < at) i++;
+        if (i < count && sorted[i].frame == frame && sorted[i].at == at) {
+            samples = sorted[i].samples;
+            cells  += sorted[i].cells;
+            i++;
+        }
+        *s = i;
+        if (!samples && !cells && *pc != CMD_REPEAT && *pc != CMD_CALL) continue;
+        _prof_loc_seek(prof, loc, at);
+        mark = w->path.len;
+        _prof_push(&w->path, _prof_name(prof, pc), loc->count ? &loc->loc : NULL);
+        if (!w->path.ok) return;
+        if (samples) _prof_out(&w->time, &w->path, samples);
+        if (cells) _prof_out(&w->cells, &w->path, cells);
+        if (*pc == CMD_REPEAT) {
+            _prof_walk(prof, w, frame, pc + 3, pc + 3 + pc[2], loc, s);
+        } else if (*pc == CMD_CALL) {
+            int child = _prof_find(prof, frame, at);
+            if (child >= 0) {
+                const prof_frame_t *c = &prof->frames[child];
+                prof_cursor_t       first;
+                size_t              t = _prof_sorted_find(w, child, c->base);
+                _prof_loc_find(prof, c->base, &first);
+                _prof_walk(prof, w, child, prof->words + c->base, prof->words + c->base + c->len, &first, &t);
+            }
+        }
+        w->path.len = mark;
+        w->path.buf[mark] = '\0';
+    }
+}
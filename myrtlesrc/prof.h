@@ -0,0 +1,219 @@
+/***************************************************************************************************************
+ * FILE: prof.h
+ *
+ * DESCRIPTION:
+ * Declarations for the sampling profiler run by -P. See comments in prof.c.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * 20261017T1200 [JMW] added prof_t.timed
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261017T0600 [JMW] Initial revision.
+ **************************************************************************************************************/
+#ifndef __PROF_H__
+#define __PROF_H__
+
+#include <limits.h>   /* For USHRT_MAX.        */
+#include <signal.h>   /* For sig_atomic_t.     */
+#include <stddef.h>   /* For size_t.           */
+#include <stdio.h>    /* For FILE.             */
+#include "bool.h"     /* For bool.             */
+#include "file.h"     /* For file_t, token_t.  */
+#include "stamp.h"    /* For stamp_t.          */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * PREPROCESSOR MACRO DEFINITIONS
+ *
+ * PROF_COMMAND(prof, at) -- Called by the interpreter after it performs the command at index 'at' of the
+ *                           compiled program. Adds the squares it painted to its count along the call path being
+ *                           performed, and calls prof_command() only if a sample was taken, the path is not
+ *                           kept, or the count would go over PROF_COUNT_MAX.
+ *------------------------------------------------------------------------------------------------------------*/
+#define PROF_COUNT_MAX   USHRT_MAX  /* Most squares counted in the cells of a frame. The rest are in samples.  */
+#define PROF_INTERVAL_US 1000       /* Microseconds of CPU time between samples.                               */
+#define PROF_LOC_KEY     256        /* Locations between one key and the next (see prof_key_t).                */
+#define PROF_MAX_FRAMES  65536      /* Most call paths kept. Samples in calls along further paths are dropped. */
+#define PROF_OUT_SIZE    (1 << 16)  /* Bytes of a profile buffered before they are written.                    */
+
+#define PROF_COMMAND(prof, at)                                                  \
+    do {                                                                        \
+        if (prof_ticks || !(prof)->counts) {                                    \
+            if ((prof)->cells || prof_ticks) prof_command(prof, at);            \
+        } else if ((prof)->cells) {                                             \
+            unsigned short *count_ = &(prof)->counts[(at) - (prof)->base];      \
+            if ((prof)->cells > (unsigned long)(PROF_COUNT_MAX - *count_)) {    \
+                prof_command(prof, at);                                         \
+            } else {                                                            \
+                *count_ += (unsigned short)(prof)->cells;                       \
+                (prof)->cells = 0;                                              \
+            }                                                                   \
+        }                                                                       \
+    } while (0)
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * Where a command of the compiled program came from: the index in the program of its first word, and the line
+ * and column in the source code file of the command, both starting at 1.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    int index;
+    int line;
+    int col;
+} prof_loc_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * A key into the locations, which are encoded one after another (see prof_loc()) and so can only be read in
+ * order: location number k * PROF_LOC_KEY, and the offset in prof->locs of the one after it. Reading starts at
+ * the last key before the location looked for.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    prof_loc_t loc;
+    size_t     pos;
+} prof_key_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * What could not be attributed to a command along a call path which was kept: samples taken while it was being
+ * performed, and squares it painted.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    unsigned long samples;
+    unsigned long cells;
+} prof_count_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * A call path: the whole program, or the body of a procedure called from a command of another path.
+ *
+ * parent  -- The index of the path it was called along, or -1 for the whole program.
+ * site    -- The index in the program of the CMD_CALL in the parent. -1 for the whole program.
+ * base    -- The index in the program of the first word of the body.
+ * len     -- The number of words in the body.
+ * cells   -- The squares painted by each word of the body, indexed from 'base', up to PROF_COUNT_MAX; what would
+ *            go over that is moved to the command's entry in prof->samples. Only the first word of a command is
+ *            used. Two bytes a word, since these are written all over for a long script.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    int             parent;
+    int             site;
+    int             base;
+    int             len;
+    unsigned short *cells;
+} prof_frame_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * The samples taken in one command along one call path: the index of the path, the index in the program of the
+ * command, the number of samples, and the squares it painted beyond those in the cells of the path. An entry
+ * with neither samples nor squares is empty.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    int           frame;
+    int           at;
+    unsigned long samples;
+    unsigned long cells;
+} prof_sample_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * A procedure of the program being profiled: the index in the program of its CMD_TO, and its name.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    int         at;
+    const char *name;
+} prof_proc_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * The profile of one run. The struct is named so that myrtle.h can declare myrtle_ctx_prof_set() without
+ * including this file. The arrays are kept from run to run.
+ *
+ * source       -- The name of the input file of the run, or NULL.
+ * words        -- The compiled program, set by prof_start().
+ * locs         -- Where each command of the program came from, in order of index, encoded (see prof_loc()).
+ * loc_len      -- The number of bytes in locs.
+ * loc_cap      -- The number of bytes allocated for locs.
+ * loc_count    -- The number of locations encoded in locs.
+ * keys         -- A key for every PROF_LOC_KEY locations, the first for location 0.
+ * key_count    -- The number of keys.
+ * key_cap      -- The number of keys allocated.
+ * last         -- The location of the last command located, which is not encoded until the next is, since a
+ *                 command which emits no words is replaced by the next one. Its index is -1 if there is none.
+ * prev         -- The last location encoded in locs, which the next is encoded relative to.
+ * line_start   -- The offset in the input of the first char of the line of 'last'.
+ * procs        -- The procedures of the program, in order of 'at'.
+ * proc_count   -- The number of procs.
+ * proc_cap     -- The number of procs allocated.
+ * frames       -- The call paths. frames[0] is the whole program.
+ * frame_count  -- The number of frames.
+ * frame_cap    -- The number of frames allocated.
+ * table        -- A hash table of the frames by parent and site, for prof_enter(). Each entry is 1 + the index of
+ *                 a frame, or 0 if it is empty.
+ * table_size   -- The number of entries in table, a power of 2.
+ * samples      -- A hash table of the samples by path and command.
+ * sample_count -- The number of entries in samples which are not empty.
+ * sample_size  -- The number of entries in samples, a power of 2.
+ * frame        -- The call path being performed.
+ * counts       -- The squares of each word of that path (its cells), or NULL if it is not kept.
+ * base         -- The index in the program of the first word of that path.
+ * lost         -- How many calls deep the interpreter is below a call path which could not be kept.
+ * cells        -- Squares painted by the command being performed, not attributed yet.
+ * dropped      -- Samples and squares which could not be attributed to a kept call path.
+ * other        -- Samples taken outside any command, e.g. while the world was written at the end of the run.
+ * timed        -- True if prof_start() started the timer for this run, false if another run had it.
+ * ok           -- False if memory ran out, or the run could not be timed, and the profile is incomplete.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct prof {
+    const char     *source;
+    const int      *words;
+    unsigned char  *locs;
+    size_t          loc_len;
+    size_t          loc_cap;
+    size_t          loc_count;
+    prof_key_t     *keys;
+    size_t          key_count;
+    size_t          key_cap;
+    prof_loc_t      last;
+    prof_loc_t      prev;
+    size_t          line_start;
+    prof_proc_t    *procs;
+    int             proc_count;
+    int             proc_cap;
+    prof_frame_t   *frames;
+    int             frame_count;
+    int             frame_cap;
+    int            *table;
+    size_t          table_size;
+    prof_sample_t  *samples;
+    size_t          sample_count;
+    size_t          sample_size;
+    int             frame;
+    unsigned short *counts;
+    int             base;
+    int             lost;
+    unsigned long   cells;
+    prof_count_t    dropped;
+    unsigned long   other;
+    bool            timed;
+    bool            ok;
+} prof_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * NONSTATIC GLOBAL VARIABLE DECLARATIONS
+ *------------------------------------------------------------------------------------------------------------*/
+extern volatile sig_atomic_t prof_ticks;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * NONSTATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+extern void prof_command(prof_t *prof, int at);
+extern void prof_enter(prof_t *prof, int site, int base, int len);
+extern void prof_free(prof_t *prof);
+extern void prof_init(prof_t *prof);
+extern void prof_leave(prof_t *prof);
+extern void prof_loc(prof_t *prof, int index, const file_t *file, const token_t *token);
+extern void prof_proc(prof_t *prof, int at, const char *name);
+extern void prof_reset(prof_t *prof, const char *source);
+extern void prof_stamp(prof_t *prof, const stamp_t *stamp);
+extern void prof_start(prof_t *prof, const int *words, size_t count);
+extern void prof_stop(prof_t *prof);
+extern bool prof_write(const prof_t *prof, FILE *time_out, FILE *cells_out);
+
+#endif
@@ -0,0 +1,345 @@
+/***************************************************************************************************************
+ * FILE: repeat.c
+ *
+ * DESCRIPTION:
+ * Works out which repetitions of a 'repeat n [ ... ]' block can be skipped without changing what is drawn, so
+ * that 'repeat 1000000000 [ ... ]' of a square takes no longer than drawing the square twice.
+ *
+ * As in par.c, the effect of the body on Myrtle's state -- row, col, direction, pen and pen char -- is summed up
+ * once as a function from the state before a repetition to the state after it, for each direction she may start
+ * facing. Nested blocks are summed up the same way, and raised to their count by repeated squaring. Then:
+ *
+ *     - The squares a repetition draws, and the chars it draws in them, depend only on the state it starts in.
+ *     - From the second repetition on, the pen and pen char are the same at the start of every repetition, and
+ *       the direction comes round again every 'turns' repetitions (1, 2 or 4). Over 'turns' repetitions Myrtle
+ *       either ends up somewhere fixed (the body hyperspaces) or is displaced by the same amount every time, and
+ *       on a world which wraps around, a displacement comes back to zero after a whole number of laps. So from
+ *       repetition turns + 2 on, the states repetitions start in come round again every 'period' repetitions.
+ *       When the body brings her back to the state she started in, 'period' is just 'turns'.
+ *     - Once a whole period has been drawn, every square a later repetition draws has been drawn before, by a
+ *       repetition starting in the same state: the world stops changing, except for the order of the writes.
+ *       The last 'period' repetitions make the last write to every square they draw, and no square is drawn by
+ *       any repetition in between which is not drawn by them.
+ *
+ * So the block is performed as: the repetitions up to the end of the first period, then Myrtle jumps to the
+ * state the last 'period' repetitions start in, then those repetitions. The closed form only ever performs at
+ * most turns + 1 + 2 * period repetitions, however large 'n' is. A body which contains a 'stop' is performed
+ * every time, since each 'stop' writes the world. A 'call' in the body is summed up as the body of the procedure.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * 20261017T0100 [JMW] 'call' and 'to'
+ * 20261017T1100 [JMW] operand counts come from cmd_nargs[] in myrtle.c
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261017T0000 [JMW] Initial revision.
+ **************************************************************************************************************/
+#include "bool.h"
+#include "globals.h"
+#include "myrtle.h"
+#include "par.h"
+#include "repeat.h"
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * What a body of commands does to Myrtle's state. Entry d of each array is for Myrtle starting the body facing
+ * direction d. The same as par_summary_t in par.c, plus 'stops'.
+ *
+ * dir      -- The direction she ends up facing.
+ * absolute -- True if the body hyperspaces, in which case row and col are where she ends up. Otherwise, they
+ *             are how far she ends up from where she started, wrapped to the size of the world.
+ * row, col -- See absolute.
+ * pendown  -- 1 or 0 if the body puts the pen down or lifts it last. -1 if it does neither.
+ * penchar  -- The last pen char the body sets, as an unsigned char. -1 if it sets none.
+ * stops    -- True if the body contains a 'stop'.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    int     dir[4];
+    bool    absolute[4];
+    coord_t row[4];
+    coord_t col[4];
+    int     pendown;
+    int     penchar;
+    bool    stops;
+} repeat_summary_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+static void    _repeat_apply(par_turtle_t *turtle, const repeat_summary_t *summary, coord_t rows, coord_t cols);
+static coord_t _repeat_clamp(coord_t pos, coord_t size);
+static void    _repeat_compose(repeat_summary_t *out, const repeat_summary_t *first, const repeat_summary_t *then,
+                               coord_t rows, coord_t cols);
+static coord_t _repeat_gcd(coord_t a, coord_t b);
+static void    _repeat_identity(repeat_summary_t *summary);
+static coord_t _repeat_lcm(coord_t a, coord_t b, coord_t limit);
+static void    _repeat_move(coord_t *row, coord_t *col, int dir, coord_t squares, coord_t rows, coord_t cols);
+static void    _repeat_power(repeat_summary_t *out, const repeat_summary_t *summary, long times, coord_t rows,
+                             coord_t cols);
+static void    _repeat_summarize(repeat_summary_t *summary, const int *pc, const int *end, coord_t rows,
+                                 coord_t cols);
+
+/*======================================= NONSTATIC FUNCTION DEFINITIONS =====================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: repeat_advance()
+ * DESCR:    Updates *turtle to the state Myrtle is in after performing the commands from 'body' to 'end' 'times'
+ *           times in a 'rows' x 'cols' world, without performing them. Nothing is drawn.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void repeat_advance(par_turtle_t *turtle, long times, const int *body, const int *end, coord_t rows,
+                    coord_t cols) {
+    repeat_summary_t summary;
+    if (times <= 0) return;
+    _repeat_summarize(&summary, body, end, rows, cols);
+    _repeat_power(&summary, &summary, times, rows, cols);
+    _repeat_apply(turtle, &summary, rows, cols);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: repeat_plan()
+ * DESCR:    Works out *plan for performing the commands from 'body' to 'end' 'times' times, starting in state
+ *           *start in a 'rows' x 'cols' world. See the top of this file.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void repeat_plan(repeat_plan_t *plan, long times, const int *body, const int *end, const par_turtle_t *start,
+                 coord_t rows, coord_t cols) {
+    repeat_summary_t once, cycle, step;
+    par_turtle_t     settled;
+    coord_t          period, from;
+    long             turns, lead;
+    int              d;
+
+    plan->first   = times > 0 ? times : 0;
+    plan->skipped = 0;
+    plan->last    = 0;
+    plan->resume  = *start;
+    if (times <= 0) return;
+
+    _repeat_summarize(&once, body, end, rows, cols);
+    if (once.stops) return;
+
+    /* Repetitions 1 .. lead come before the states start coming round. 'settled' is the state after them. */
+    d     = once.dir[DIR_NORTH];
+    turns = (d == DIR_NORTH) ? 1 : (d == DIR_SOUTH) ? 2 : 4;
+    lead  = turns + 1;
+    settled = *start;
+    _repeat_power(&step, &once, lead, rows, cols);
+    _repeat_apply(&settled, &step, rows, cols);
+
+    _repeat_power(&cycle, &once, turns, rows, cols);
+    d = settled.dir;
+    if (cycle.absolute[d]) {
+        period = turns;
+    } else {
+        coord_t laps = _repeat_lcm(rows / _repeat_gcd(cycle.row[d], rows), cols / _repeat_gcd(cycle.col[d], cols),
+                                   times);
+        period = (laps > times / turns) ? (coord_t)times + 1 : laps * turns;
+    }
+    if (period > times || times - lead <= 2 * period) return;
+
+    /* 'from' is the first of the last 'period' repetitions, counting from 1. */
+    from = times - period + 1;
+    _repeat_power(&step, &once, (long)((from - lead - 1) % period), rows, cols);
+    plan->resume = settled;
+    _repeat_apply(&plan->resume, &step, rows, cols);
+    plan->first   = lead + (long)period;
+    plan->skipped = (long)from - 1 - plan->first;
+    plan->last    = (long)period;
+}
+
+/*========================================= STATIC FUNCTION DEFINITIONS ======================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _repeat_apply()
+ * DESCR:    Updates *turtle to the state Myrtle is in after the body 'summary' sums up, in a 'rows' x 'cols'
+ *           world.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _repeat_apply(par_turtle_t *turtle, const repeat_summary_t *summary, coord_t rows, coord_t cols) {
+    int d = turtle->dir;
+    if (summary->absolute[d]) {
+        turtle->row = summary->row[d];
+        turtle->col = summary->col[d];
+    } else {
+        turtle->row = (turtle->row + summary->row[d]) % rows;
+        turtle->col = (turtle->col + summary->col[d]) % cols;
+    }
+    turtle->dir = summary->dir[d];
+    if (summary->pendown >= 0) turtle->pendown = summary->pendown ? true : false;
+    if (summary->penchar >= 0) turtle->penchar = (char)summary->penchar;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _repeat_clamp()
+ * DESCR:    Clamps 'pos' to 0 .. 'size' - 1, as _myrtle_row_set() and _myrtle_col_set() do.
+ * RETURNS:  The clamped position.
+ *------------------------------------------------------------------------------------------------------------*/
+static coord_t _repeat_clamp(coord_t pos, coord_t size) {
+    if (pos < 0) return 0;
+    if (pos >= size) return size - 1;
+    return pos;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _repeat_compose()
+ * DESCR:    Sums up in *out the body 'first' followed by the body 'then'. 'out' may be either of them.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _repeat_compose(repeat_summary_t *out, const repeat_summary_t *first, const repeat_summary_t *then,
+                            coord_t rows, coord_t cols) {
+    repeat_summary_t summary;
+    int              d;
+
+    for (d = 0; d < 4; d++) {
+        int mid = first->dir[d];
+        summary.dir[d]      = then->dir[mid];
+        summary.absolute[d] = first->absolute[d] || then->absolute[mid];
+        if (then->absolute[mid]) {
+            summary.row[d] = then->row[mid];
+            summary.col[d] = then->col[mid];
+        } else {
+            summary.row[d] = (first->row[d] + then->row[mid]) % rows;
+            summary.col[d] = (first->col[d] + then->col[mid]) % cols;
+        }
+    }
+    summary.pendown = then->pendown >= 0 ? then->pendown : first->pendown;
+    summary.penchar = then->penchar >= 0 ? then->penchar : first->penchar;
+    summary.stops   = first->stops || then->stops;
+    *out = summary;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _repeat_gcd()
+ * DESCR:    Euclid's algorithm. 'a' and 'b' are not negative.
+ * RETURNS:  The greatest common divisor of 'a' and 'b'. 'b' if 'a' is zero.
+ *------------------------------------------------------------------------------------------------------------*/
+static coord_t _repeat_gcd(coord_t a, coord_t b) {
+    while (a != 0) {
+        coord_t r = b % a;
+        b = a;
+        a = r;
+    }
+    return b;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _repeat_identity()
+ * DESCR:    Sums up in *summary a body with no commands.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _repeat_identity(repeat_summary_t *summary) {
+    int d;
+    for (d = 0; d < 4; d++) {
+        summary->dir[d]      = d;
+        summary->absolute[d] = false;
+        summary->row[d]      = 0;
+        summary->col[d]      = 0;
+    }
+    summary->pendown = -1;
+    summary->penchar = -1;
+    summary->stops   = false;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _repeat_lcm()
+ * DESCR:    Works out the least common multiple of 'a' and 'b', which are positive.
+ * RETURNS:  The least common multiple, or 'limit' + 1 if it is more than 'limit'.
+ *------------------------------------------------------------------------------------------------------------*/
+static coord_t _repeat_lcm(coord_t a, coord_t b, coord_t limit) {
+    coord_t g = _repeat_gcd(a, b);
+    if (a / g > limit / b) return limit + 1;
+    return a / g * b;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _repeat_move()
+ * DESCR:    Moves the position *row, *col 'squares' squares in direction 'dir', or backward if 'squares' is
+ *           negative, wrapping around the edges of a 'rows' x 'cols' world, as _par_advance() in par.c does.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _repeat_move(coord_t *row, coord_t *col, int dir, coord_t squares, coord_t rows, coord_t cols) {
+    bool     vert = (dir == DIR_NORTH || dir == DIR_SOUTH);
+    coord_t  size = vert ? rows : cols;
+    coord_t *pos  = vert ? row : col;
+    coord_t  step = (dir == DIR_NORTH || dir == DIR_WEST) ? -squares : squares;
+    *pos = ((*pos + step % size) % size + size) % size;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _repeat_power()
+ * DESCR:    Sums up in *out the body 'summary' performed 'times' times, by repeated squaring. 'out' may be
+ *           'summary'.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _repeat_power(repeat_summary_t *out, const repeat_summary_t *summary, long times, coord_t rows,
+                          coord_t cols) {
+    repeat_summary_t base = *summary;
+    _repeat_identity(out);
+    for (; times > 0; times >>= 1) {
+        if (times & 1) _repeat_compose(out, out, &base, rows, cols);
+        _repeat_compose(&base, &base, &base, rows, cols);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _repeat_summarize()
+ * DESCR:    Works out in *summary what the commands from 'pc' to 'end' do to Myrtle's state in a 'rows' x 'cols'
+ *           world, for each direction at once. Nothing is drawn.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _repeat_summarize(repeat_summary_t *summary, const int *pc, const int *end, coord_t rows,
+                              coord_t cols) {
+    repeat_summary_t inner;
+    int              d;
+
+    _repeat_identity(summary);
+    while (pc < end) {
+        int op = *pc++;
+        switch (op) {
+        case CMD_BACKWARD:
+        case CMD_FORWARD:
+            if (pc[0] > 0) {
+                coord_t squares = (op == CMD_FORWARD) ? (coord_t)pc[0] : -(coord_t)pc[0];
+                for (d = 0; d < 4; d++) {
+                    _repeat_move(&summary->row[d], &summary->col[d], summary->dir[d], squares, rows, cols);
+                }
+            }
+            break;
+        case CMD_CALL: {
+            const int *to = pc - 1 + pc[0];   /* The CMD_TO of the procedure; its body follows its length. */
+            _repeat_summarize(&inner, to + 2, to + 2 + to[1], rows, cols);
+            _repeat_compose(summary, summary, &inner, rows, cols);
+            break;
+        }
+        case CMD_HYPER:
+            for (d = 0; d < 4; d++) {
+                summary->absolute[d] = true;
+                summary->row[d]      = _repeat_clamp(pc[0], rows);
+                summary->col[d]      = _repeat_clamp(pc[1], cols);
+            }
+            break;
+        case CMD_LEFT:
+            for (d = 0; d < 4; d++) summary->dir[d] = (summary->dir[d] + 3) & 3;
+            break;
+        case CMD_PENCHAR: summary->penchar = (unsigned char)pc[0]; break;
+        case CMD_PENDOWN: summary->pendown = 1;                    break;
+        case CMD_PENUP:   summary->pendown = 0;                    break;
+        case CMD_REPEAT:
+            if (pc[0] > 0) {
+                _repeat_summarize(&inner, pc + 2, pc + 2 + pc[1], rows, cols);
+                _repeat_power(&inner, &inner, pc[0], rows, cols);
+                _repeat_compose(summary, summary, &inner, rows, cols);
+            }
+            pc += pc[1];
+            break;
+        case CMD_RIGHT:
+            for (d = 0; d < 4; d++) summary->dir[d] = (summary->dir[d] + 1) & 3;
+            break;
+        case CMD_STOP: summary->stops = true; break;
+        case CMD_TO:   pc += pc[0];           break;
+        }
+        pc += cmd_nargs[op];
+    }
+}
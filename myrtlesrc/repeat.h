@@ -0,0 +1,41 @@
+/***************************************************************************************************************
+ * FILE: repeat.h
+ *
+ * DESCRIPTION:
+ * Declarations for working out which repetitions of a 'repeat' block can be skipped. See comments in repeat.c.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261017T0000 [JMW] Initial revision.
+ **************************************************************************************************************/
+#ifndef __REPEAT_H__
+#define __REPEAT_H__
+
+#include "globals.h"  /* For coord_t.      */
+#include "par.h"      /* For par_turtle_t. */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * How to perform a 'repeat' block: perform its body 'first' times, then set Myrtle's state to 'resume' in place
+ * of performing it 'skipped' more times, then perform it 'last' more times. 'skipped' and 'last' are 0 when no
+ * repetition can be skipped.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    long         first;
+    long         skipped;
+    long         last;
+    par_turtle_t resume;
+} repeat_plan_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * NONSTATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+extern void repeat_advance(par_turtle_t *turtle, long times, const int *body, const int *end, coord_t rows,
+                           coord_t cols);
+extern void repeat_plan(repeat_plan_t *plan, long times, const int *body, const int *end,
+                        const par_turtle_t *start, coord_t rows, coord_t cols);
+
+#endif
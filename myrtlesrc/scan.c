@@ -0,0 +1,330 @@
+/***************************************************************************************************************
+ * FILE: scan.c
+ *
+ * DESCRIPTION:
+ * Bulk token scanner for the input layer in file.c. Rather than looking at the input one char at a time, the
+ * scanner classifies 64 bytes at a time into two bit masks, one bit per byte: which bytes are whitespace and
+ * which are newlines. Token boundaries are the places where the whitespace mask changes from 1 to 0 (start)
+ * and 0 to 1 (end), and the line of a token is the number of newline bits before its start. The masks are
+ * built with SSE2 (16 bytes per compare) or AVX2 (32 bytes per compare) when the CPU has them, and with plain
+ * C otherwise. The implementation is chosen at run time from the CPUID feature bits, once per process under
+ * pthread_once(), so every thread scanning at the same time sees the same choice and nothing is written while
+ * they scan. A caller which wants a particular implementation, like scanbench, passes it to scan_tokens().
+ *
+ * While a token is being emitted, a token which begins with a digit or a sign is also converted to an int
+ * with the same result as atoi(), so the compiler never has to look at the digits again.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * 20261017T1200 [JMW] the implementation is chosen once, and passed to scan_tokens() rather than set
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261016T1200 [JMW] Initial revision.
+ **************************************************************************************************************/
+/* pthread_once() is POSIX, not Standard C, so ask for it before including anything. */
+#define _POSIX_C_SOURCE 200112L
+
+#include <limits.h>
+#include <pthread.h>
+#include <string.h>
+#include "bool.h"
+#include "file.h"
+#include "scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * mask_t -- A bit mask with one bit per byte of a 64-byte block. Bit i describes byte i of the block.
+ * mask_fn_t -- A function which builds the whitespace and newline masks of the 64 bytes at 'p'.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef unsigned long long mask_t;
+typedef void (*mask_fn_t)(const char *p, mask_t *ws, mask_t *nl);
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+static void      _scan_choose();
+static void      _scan_emit(token_t *tok, char *text, int len, int line);
+static int       _scan_int(const char *p, const char *end);
+static void      _scan_mask_scalar(const char *p, mask_t *ws, mask_t *nl);
+static void      _scan_mask_tail(const char *p, size_t n, mask_t *ws, mask_t *nl);
+#ifdef SCAN_X86
+static void      _scan_mask_avx2(const char *p, mask_t *ws, mask_t *nl);
+static void      _scan_mask_sse2(const char *p, mask_t *ws, mask_t *nl);
+#endif
+static mask_fn_t _scan_mask_fn(int which);
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC GLOBAL VARIABLE DEFINITIONS
+ *
+ * chosen      -- The fastest SCAN_* implementation the CPU supports, which SCAN_AUTO stands for. Written only
+ *                by _scan_choose().
+ * chosen_once -- Makes _scan_choose() run once, before the first use of 'chosen'.
+ *------------------------------------------------------------------------------------------------------------*/
+static int            chosen      = SCAN_SCALAR;
+static pthread_once_t chosen_once = PTHREAD_ONCE_INIT;
+
+/*======================================= NONSTATIC FUNCTION DEFINITIONS =====================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: scan_impl_get()
+ * DESCR:    Accessor for the implementation SCAN_AUTO stands for: the fastest one the CPU supports.
+ * RETURNS:  One of SCAN_SCALAR, SCAN_SSE2, or SCAN_AVX2.
+ *------------------------------------------------------------------------------------------------------------*/
+int scan_impl_get() {
+    pthread_once(&chosen_once, _scan_choose);
+    return chosen;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: scan_impl_name()
+ * DESCR:    Names a SCAN_* implementation, for the benchmark and statistics output.
+ * RETURNS:  A string constant.
+ *------------------------------------------------------------------------------------------------------------*/
+char *scan_impl_name(int which) {
+    switch (which) {
+    case SCAN_SCALAR: return "scalar";
+    case SCAN_SSE2:   return "sse2";
+    case SCAN_AVX2:   return "avx2";
+    }
+    return "auto";
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: scan_impl_ok()
+ * DESCR:    Checks whether the CPU supports the implementation 'which'. SCAN_AUTO and SCAN_SCALAR always are.
+ * RETURNS:  True if 'which' can be passed to scan_tokens().
+ *------------------------------------------------------------------------------------------------------------*/
+bool scan_impl_ok(int which) {
+    switch (which) {
+    case SCAN_AUTO:
+    case SCAN_SCALAR:
+        return true;
+#ifdef SCAN_X86
+    case SCAN_SSE2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse2") != 0;
+    case SCAN_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+#endif
+    }
+    return false;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: scan_tokens()
+ * DESCR:    Finds up to 'max' tokens in buf[*pos..len) with the implementation 'impl', which is SCAN_AUTO or one
+ *           which scan_impl_ok() accepts, and stores them in 'toks'. *line is the source line at
+ *           *pos. On return, *pos and *line have been advanced past everything consumed: the whitespace and the
+ *           tokens which were stored. If 'final' is false, more input may follow 'len', so a token which runs
+ *           into 'len' is incomplete; it is not stored, and *pos is left at its first char so the caller can
+ *           refill the buffer and scan again.
+ * RETURNS:  The number of tokens stored in 'toks'.
+ *------------------------------------------------------------------------------------------------------------*/
+size_t scan_tokens(char *buf, size_t len, bool final, size_t *pos, int *line, token_t *toks, size_t max,
+                   int impl) {
+    mask_fn_t mask_fn = _scan_mask_fn(impl == SCAN_AUTO ? scan_impl_get() : impl);
+    size_t    base = *pos, start = 0, count = 0;
+    int       cur_line = *line, start_line = 0;
+    mask_t    prev_ws = 1;   /* The byte before *pos is whitespace, or *pos is the first token char. */
+    bool      in_tok = false;
+
+    while (base < len && count < max) {
+        mask_t ws, nl, shifted, events;
+        size_t n = len - base;
+
+        if (n >= 64) mask_fn(buf + base, &ws, &nl);
+        else _scan_mask_tail(buf + base, n, &ws, &nl);
+
+        /* A token starts where a non-whitespace byte follows whitespace, and ends where whitespace follows a
+         * non-whitespace byte. Both are bits where 'ws' differs from itself shifted by one byte. */
+        shifted = (ws << 1) | prev_ws;
+        events  = ws ^ shifted;
+        while (events) {
+            int    bit = __builtin_ctzll(events);
+            mask_t below = (((mask_t)1) << bit) - 1;
+            events &= events - 1;
+            if (!in_tok) {
+                start      = base + bit;
+                start_line = cur_line + __builtin_popcountll(nl & below);
+                in_tok     = true;
+            } else {
+                size_t end = base + bit;
+                if (end > len) end = len;
+                if (end == len && !final) break;
+                _scan_emit(&toks[count++], buf + start, (int)(end - start), start_line);
+                in_tok = false;
+                if (count == max) {
+                    *pos  = end;
+                    *line = start_line;
+                    return count;
+                }
+            }
+        }
+        if (n <= 64 && in_tok) {
+            /* The token runs into the end of the buffer. */
+            if (final) {
+                _scan_emit(&toks[count++], buf + start, (int)(len - start), start_line);
+                in_tok = false;
+            }
+            break;
+        }
+        cur_line += __builtin_popcountll(nl);
+        prev_ws   = ws >> 63;
+        base     += 64;
+    }
+    if (in_tok) {
+        *pos  = start;
+        *line = start_line;
+    } else {
+        *pos  = len;
+        *line = cur_line;
+    }
+    return count;
+}
+
+/*========================================= STATIC FUNCTION DEFINITIONS ======================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _scan_choose()
+ * DESCR:    Chooses the fastest implementation the CPU supports and records it in 'chosen'. Run once, by
+ *           scan_impl_get().
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _scan_choose() {
+    if (scan_impl_ok(SCAN_AVX2)) chosen = SCAN_AVX2;
+    else if (scan_impl_ok(SCAN_SSE2)) chosen = SCAN_SSE2;
+    else chosen = SCAN_SCALAR;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _scan_emit()
+ * DESCR:    Fills in 'tok'. If the token looks like a number, its value is converted now.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _scan_emit(token_t *tok, char *text, int len, int line) {
+    char ch = text[0];
+    tok->text  = text;
+    tok->len   = len;
+    tok->line  = line;
+    tok->value = ((ch >= '0' && ch <= '9') || ch == '-' || ch == '+') ? _scan_int(text, text + len) : 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _scan_int()
+ * DESCR:    Converts the chars from 'p' up to 'end' into an int exactly as atoi() would if they were a C-string:
+ *           an optional sign followed by decimal digits, stopping at the first char that is not a digit. Like
+ *           glibc's atoi(), the value saturates at the range of a long and is then converted to an int.
+ * RETURNS:  The value, or zero if the chars do not begin with a number.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _scan_int(const char *p, const char *end) {
+    unsigned long value = 0, limit;
+    bool          neg = false, over = false;
+
+    if (p < end && (*p == '-' || *p == '+')) neg = (*p++ == '-');
+    limit = neg ? (unsigned long)LONG_MAX + 1 : (unsigned long)LONG_MAX;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        unsigned digit = *p - '0';
+        if (value > (limit - digit) / 10) over = true;
+        else value = value * 10 + digit;
+    }
+    if (over) return neg ? (int)LONG_MIN : (int)LONG_MAX;
+    return neg ? (int)(0 - value) : (int)value;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _scan_mask_scalar()
+ * DESCR:    Builds the masks for the 64 bytes at 'p' one byte at a time. Whitespace is the same set of chars as
+ *           isspace() in the C locale: ' ' and '\t' through '\r'.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _scan_mask_scalar(const char *p, mask_t *ws, mask_t *nl) {
+    _scan_mask_tail(p, 64, ws, nl);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _scan_mask_tail()
+ * DESCR:    Builds the masks for the 'n' bytes at 'p', where n <= 64. The bits for bytes past 'n' are set in
+ *           'ws', so the last token in the buffer has an end.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _scan_mask_tail(const char *p, size_t n, mask_t *ws, mask_t *nl) {
+    mask_t w = 0, l = 0;
+    size_t i;
+    for (i = 0; i < n; i++) {
+        unsigned char ch = p[i];
+        if (ch == ' ' || (unsigned char)(ch - '\t') <= '\r' - '\t') w |= ((mask_t)1) << i;
+        if (ch == '\n') l |= ((mask_t)1) << i;
+    }
+    if (n < 64) w |= ~((((mask_t)1) << n) - 1);
+    *ws = w;
+    *nl = l;
+}
+
+#ifdef SCAN_X86
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _scan_mask_avx2()
+ * DESCR:    Builds the masks for the 64 bytes at 'p' 32 bytes at a time. '\t' through '\r' are found with one
+ *           signed compare: adding 128 - 9 moves them to -128..-124, below every other byte.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+__attribute__((target("avx2")))
+static void _scan_mask_avx2(const char *p, mask_t *ws, mask_t *nl) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i bias  = _mm256_set1_epi8(128 - '\t');
+    const __m256i limit = _mm256_set1_epi8(-128 + ('\r' - '\t') + 1);
+    const __m256i nlch  = _mm256_set1_epi8('\n');
+    __m256i lo = _mm256_loadu_si256((const __m256i *)p);
+    __m256i hi = _mm256_loadu_si256((const __m256i *)(p + 32));
+    __m256i ws_lo = _mm256_or_si256(_mm256_cmpeq_epi8(lo, space),
+                                    _mm256_cmpgt_epi8(limit, _mm256_add_epi8(lo, bias)));
+    __m256i ws_hi = _mm256_or_si256(_mm256_cmpeq_epi8(hi, space),
+                                    _mm256_cmpgt_epi8(limit, _mm256_add_epi8(hi, bias)));
+    *ws = (mask_t)(unsigned)_mm256_movemask_epi8(ws_lo)
+        | ((mask_t)(unsigned)_mm256_movemask_epi8(ws_hi) << 32);
+    *nl = (mask_t)(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, nlch))
+        | ((mask_t)(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, nlch)) << 32);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _scan_mask_sse2()
+ * DESCR:    Builds the masks for the 64 bytes at 'p' 16 bytes at a time. See _scan_mask_avx2().
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+__attribute__((target("sse2")))
+static void _scan_mask_sse2(const char *p, mask_t *ws, mask_t *nl) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i bias  = _mm_set1_epi8(128 - '\t');
+    const __m128i limit = _mm_set1_epi8(-128 + ('\r' - '\t') + 1);
+    const __m128i nlch  = _mm_set1_epi8('\n');
+    mask_t w = 0, l = 0;
+    int    i;
+    for (i = 0; i < 64; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i s = _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmplt_epi8(_mm_add_epi8(v, bias), limit));
+        w |= (mask_t)(unsigned)_mm_movemask_epi8(s) << i;
+        l |= (mask_t)(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, nlch)) << i;
+    }
+    *ws = w;
+    *nl = l;
+}
+#endif
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _scan_mask_fn()
+ * DESCR:    Looks up the mask builder of the implementation 'which', which is not SCAN_AUTO.
+ * RETURNS:  The mask builder. The scalar one for an implementation which was not built in.
+ *------------------------------------------------------------------------------------------------------------*/
+static mask_fn_t _scan_mask_fn(int which) {
+#ifdef SCAN_X86
+    if (which == SCAN_AVX2) return _scan_mask_avx2;
+    if (which == SCAN_SSE2) return _scan_mask_sse2;
+#endif
+    return _scan_mask_scalar;
+}
@@ -0,0 +1,40 @@
+/***************************************************************************************************************
+ * FILE: scan.h
+ *
+ * DESCRIPTION:
+ * Declarations for the bulk token scanner. See comments in scan.c.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * 20261017T1200 [JMW] scan_impl_set() is replaced by scan_impl_ok() and the impl argument of scan_tokens()
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261016T1200 [JMW] Initial revision.
+ **************************************************************************************************************/
+#ifndef __SCAN_H__
+#define __SCAN_H__
+
+#include <stddef.h>   /* For size_t. */
+#include "bool.h"
+#include "file.h"     /* For token_t. */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * PREPROCESSOR MACRO DEFINITIONS
+ *
+ * The scanner implementations. SCAN_AUTO picks the fastest one the CPU supports.
+ *------------------------------------------------------------------------------------------------------------*/
+#define SCAN_AUTO   0
+#define SCAN_SCALAR 1
+#define SCAN_SSE2   2
+#define SCAN_AVX2   3
+
+/*--------------------------------------------------------------------------------------------------------------
+ * NONSTATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+extern int    scan_impl_get();
+extern char  *scan_impl_name(int impl);
+extern bool   scan_impl_ok(int impl);
+extern size_t scan_tokens(char *buf, size_t len, bool final, size_t *pos, int *line, token_t *toks,
+                          size_t max, int impl);
+
+#endif
@@ -0,0 +1,172 @@
+/***************************************************************************************************************
+ * FILE: scanbench.c
+ *
+ * DESCRIPTION:
+ * Microbenchmark for the token scanner in scan.c. Generates a large Myrtle script in memory, checks that every
+ * scanner implementation the CPU supports finds exactly the tokens, lines and values that a char-at-a-time
+ * tokenizer using atoi() finds, and then reports the throughput of each implementation in MB/sec.
+ *
+ * Usage: scanbench [megabytes]     (default 64)
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261016T1200 [JMW] Initial revision.
+ **************************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bool.h"
+#include "file.h"
+#include "globals.h"
+#include "scan.h"
+
+/*--------------------------------------------------------------------------------------------------------------
+ * PREPROCESSOR MACRO DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+#define BATCH 256  /* Tokens requested per call to scan_tokens(), the same as file.c. */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+static char   *_bench_generate(size_t size);
+static bool    _bench_is_space(char ch);
+static size_t  _bench_reference(char *buf, size_t len, token_t **out);
+static double  _bench_run(char *buf, size_t len, int reps, token_t *ref, size_t nref, int impl);
+
+/*======================================= NONSTATIC FUNCTION DEFINITIONS =====================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: main()
+ * DESCR:    Generates the script, builds the reference token list, then checks and times each implementation.
+ * RETURNS:  Zero if every implementation matched the reference, TERM_ERR_INPUT otherwise.
+ *------------------------------------------------------------------------------------------------------------*/
+int main(int argc, char *argv[]) {
+    size_t   mb = argc > 1 ? (size_t)atoi(argv[1]) : 64, len = mb << 20, nref;
+    char    *buf = _bench_generate(len);
+    token_t *ref;
+    int      impls[] = { SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2 }, i, status = TERM_NORM;
+
+    nref = _bench_reference(buf, len, &ref);
+    printf("scanbench: %lu MB, %lu tokens\n", (unsigned long)mb, (unsigned long)nref);
+    for (i = 0; i < 3; i++) {
+        double secs;
+        if (!scan_impl_ok(impls[i])) {
+            printf("%-8s not supported by this CPU\n", scan_impl_name(impls[i]));
+            continue;
+        }
+        secs = _bench_run(buf, len, 3, ref, nref, impls[i]);
+        if (secs < 0) {
+            printf("%-8s MISMATCH with reference tokenizer\n", scan_impl_name(impls[i]));
+            status = TERM_ERR_INPUT;
+        } else {
+            printf("%-8s %8.1f MB/sec %8.1f Mtokens/sec\n", scan_impl_name(impls[i]), mb / secs,
+                   nref / secs / 1e6);
+        }
+    }
+    free(ref);
+    free(buf);
+    return status;
+}
+
+/*========================================= STATIC FUNCTION DEFINITIONS ======================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _bench_generate()
+ * DESCR:    Generates 'size' bytes of a deterministic, generator-style Myrtle script: one command per line with
+ *           a mix of blank lines, tabs, carriage returns, signed and oversized numbers.
+ * RETURNS:  The script, allocated with malloc().
+ *------------------------------------------------------------------------------------------------------------*/
+static char *_bench_generate(size_t size) {
+    static char  *cmds[] = { "forward", "backward", "hyper", "left", "right", "penup", "pendown", "penchar" };
+    char         *buf = (char *)malloc(size + 64), *p = buf;
+    unsigned long seed = 12345;
+
+    while ((size_t)(p - buf) < size) {
+        int c;
+        seed = seed * 1103515245 + 12345;
+        c = (seed >> 16) % 8;
+        p += sprintf(p, "%s", cmds[c]);
+        if (c <= 1) p += sprintf(p, " %ld", (long)((seed >> 8) % 100000) - ((seed & 7) == 0 ? 50 : 0));
+        if (c == 2) p += sprintf(p, "\t%lu %lu", (seed >> 4) % 64, (seed >> 12) % 64);
+        if (c == 7) p += sprintf(p, " %c", "#*@xo+"[(seed >> 20) % 6]);
+        if ((seed & 63) == 1) p += sprintf(p, " 99999999999999999999");
+        p += sprintf(p, "%s", (seed & 15) == 3 ? "\r\n\n" : (seed & 15) == 5 ? "  " : "\n");
+    }
+    buf[size] = '\0';
+    return buf;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _bench_is_space()
+ * DESCR:    The whitespace test used by fscanf("%s") in the C locale.
+ * RETURNS:  True if 'ch' is whitespace.
+ *------------------------------------------------------------------------------------------------------------*/
+static bool _bench_is_space(char ch) {
+    return ch == ' ' || (ch >= '\t' && ch <= '\r');
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _bench_reference()
+ * DESCR:    Tokenizes 'buf' one char at a time, converting numbers with atoi(), to produce the expected output.
+ * RETURNS:  The number of tokens. *out is set to the tokens, allocated with malloc().
+ *------------------------------------------------------------------------------------------------------------*/
+static size_t _bench_reference(char *buf, size_t len, token_t **out) {
+    size_t   cap = 1 << 20, n = 0, i = 0;
+    token_t *toks = (token_t *)malloc(cap * sizeof(token_t));
+    int      line = 1;
+    char     tmp[64];
+
+    for (;;) {
+        size_t start;
+        while (i < len && _bench_is_space(buf[i])) if (buf[i++] == '\n') line++;
+        if (i == len) break;
+        for (start = i; i < len && !_bench_is_space(buf[i]); i++) ;
+        if (n == cap) toks = (token_t *)realloc(toks, (cap *= 2) * sizeof(token_t));
+        toks[n].text = buf + start;
+        toks[n].len  = (int)(i - start);
+        toks[n].line = line;
+        memcpy(tmp, buf + start, i - start < 63 ? i - start : 63);
+        tmp[i - start < 63 ? i - start : 63] = '\0';
+        toks[n].value = (strchr("0123456789+-", tmp[0]) && tmp[0]) ? atoi(tmp) : 0;
+        n++;
+    }
+    *out = toks;
+    return n;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _bench_run()
+ * DESCR:    Scans 'buf' 'reps' times with the implementation 'impl', checking the tokens of the first pass
+ *           against 'ref'.
+ * RETURNS:  The best time for one pass in seconds, or -1 if the tokens did not match.
+ *------------------------------------------------------------------------------------------------------------*/
+static double _bench_run(char *buf, size_t len, int reps, token_t *ref, size_t nref, int impl) {
+    static token_t toks[BATCH];
+    double         best = 1e30;
+    int            rep;
+
+    for (rep = 0; rep < reps; rep++) {
+        size_t  pos = 0, total = 0, n, i;
+        int     line = 1;
+        clock_t start = clock();
+        double  secs;
+
+        while ((n = scan_tokens(buf, len, true, &pos, &line, toks, BATCH, impl)) > 0) {
+            if (rep == 0) {
+                for (i = 0; i < n; i++) {
+                    token_t *a = &toks[i], *b = &ref[total + i];
+                    if (total + i >= nref || a->text != b->text || a->len != b->len || a->line != b->line ||
+                        a->value != b->value) return -1;
+                }
+            }
+            total += n;
+        }
+        if (total != nref) return -1;
+        secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+        if (secs < best) best = secs;
+    }
+    return best > 0 ? best : 1e-9;
+}
@@ -0,0 +1,178 @@
+/***************************************************************************************************************
+ * FILE: stamp.c
+ *
+ * DESCRIPTION:
+ * Stamps cache what a procedure draws (see 'to' in cmds.def), so that calling it again can just draw the same
+ * squares instead of performing its commands again.
+ *
+ * A procedure with no 'hyper' and no 'stop' in it draws the same squares, relative to where Myrtle is, every
+ * time it is called with her facing the same way with the same pen, since every move wraps around the edges of
+ * the world. The first time it is called with the pen down, the runs of squares it draws are recorded relative
+ * to where she started, along with the state it leaves her in. A later call with her facing the same way and
+ * the same pen char just draws the runs again, in order, from where she is, and moves her on. A square drawn
+ * twice by the procedure ends up with the later char, as it does when the commands are performed.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261017T0100 [JMW] Initial revision.
+ **************************************************************************************************************/
+#include <stdlib.h>
+#include "bool.h"
+#include "globals.h"
+#include "par.h"
+#include "stamp.h"
+#include "world.h"
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC GLOBAL CONSTANT DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+static const size_t STAMP_RUNS_INIT = 64;  /* Runs allocated for at first. Doubles as the stamp fills. */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+static int _stamp_fill(world_t *world, bool vert, coord_t line, coord_t first, coord_t count, char ch);
+
+/*======================================= NONSTATIC FUNCTION DEFINITIONS =====================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: stamp_begin()
+ * DESCR:    Starts recording 'stamp' for a call which starts in state *start. The runs logged with stamp_log()
+ *           until stamp_end() make up the stamp.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void stamp_begin(stamp_t *stamp, const par_turtle_t *start) {
+    stamp->count = 0;
+    stamp->start = *start;
+    stamp->valid = false;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: stamp_blit()
+ * DESCR:    Draws the runs of 'stamp' in 'world' from where *turtle is, and updates *turtle to the state the
+ *           procedure leaves Myrtle in.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the world cannot grow to hold what was drawn.
+ *------------------------------------------------------------------------------------------------------------*/
+int stamp_blit(const stamp_t *stamp, world_t *world, par_turtle_t *turtle) {
+    coord_t rows   = world->rows;
+    coord_t cols   = world->cols;
+    int     status = TERM_NORM;
+    size_t  i;
+
+    for (i = 0; i < stamp->count && status == TERM_NORM; i++) {
+        const stamp_run_t *run   = &stamp->runs[i];
+        coord_t            size  = run->vert ? rows : cols;
+        coord_t            line  = run->vert ? (turtle->col + run->line) % cols : (turtle->row + run->line) % rows;
+        coord_t            first = ((run->vert ? turtle->row : turtle->col) + run->first) % size;
+        coord_t            tail  = first + run->count - size;   /* Squares that wrap around to the start. */
+
+        if (tail > 0) {
+            status = _stamp_fill(world, run->vert, line, first, run->count - tail, run->ch);
+            if (status == TERM_NORM) status = _stamp_fill(world, run->vert, line, 0, tail, run->ch);
+        } else {
+            status = _stamp_fill(world, run->vert, line, first, run->count, run->ch);
+        }
+    }
+    turtle->row     = (turtle->row + stamp->end.row) % rows;
+    turtle->col     = (turtle->col + stamp->end.col) % cols;
+    turtle->dir     = stamp->end.dir;
+    turtle->pendown = stamp->end.pendown;
+    turtle->penchar = stamp->end.penchar;
+    return status;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: stamp_end()
+ * DESCR:    Finishes recording 'stamp': *end is the state the procedure left Myrtle in, in a 'rows' x 'cols'
+ *           world. The stamp is valid unless too many runs were logged.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void stamp_end(stamp_t *stamp, const par_turtle_t *end, coord_t rows, coord_t cols) {
+    stamp->end     = *end;
+    stamp->end.row = (end->row - stamp->start.row + rows) % rows;
+    stamp->end.col = (end->col - stamp->start.col + cols) % cols;
+    stamp->valid   = !stamp->failed;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: stamp_free()
+ * DESCR:    Releases the runs of 'stamp' and leaves it empty.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void stamp_free(stamp_t *stamp) {
+    free(stamp->runs);
+    stamp_init(stamp);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: stamp_init()
+ * DESCR:    Initializes 'stamp' to an empty stamp which has not been recorded.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void stamp_init(stamp_t *stamp) {
+    stamp->runs  = NULL;
+    stamp->count = 0;
+    stamp->cap   = 0;
+    stamp_reset(stamp);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: stamp_log()
+ * DESCR:    Logs a run drawn while 'stamp' is being recorded: 'count' squares of 'ch' from row (or col) 'first'
+ *           of col (or row) 'line', going down a col if 'vert' is true, in a 'rows' x 'cols' world. A stamp
+ *           which would hold more than STAMP_MAX_RUNS runs, or whose runs cannot be allocated, fails.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void stamp_log(stamp_t *stamp, bool vert, coord_t line, coord_t first, coord_t count, char ch, coord_t rows,
+               coord_t cols) {
+    stamp_run_t *run;
+
+    if (stamp->failed) return;
+    if (stamp->count == stamp->cap) {
+        size_t       cap  = stamp->cap ? stamp->cap * 2 : STAMP_RUNS_INIT;
+        stamp_run_t *runs = NULL;
+        if (cap <= STAMP_MAX_RUNS) runs = (stamp_run_t *)realloc(stamp->runs, cap * sizeof(stamp_run_t));
+        if (!runs) {
+            stamp->failed = true;
+            return;
+        }
+        stamp->runs = runs;
+        stamp->cap  = cap;
+    }
+    run        = &stamp->runs[stamp->count++];
+    run->vert  = vert;
+    run->ch    = ch;
+    run->count = count;
+    if (vert) {
+        run->line  = (line - stamp->start.col + cols) % cols;
+        run->first = (first - stamp->start.row + rows) % rows;
+    } else {
+        run->line  = (line - stamp->start.row + rows) % rows;
+        run->first = (first - stamp->start.col + cols) % cols;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: stamp_reset()
+ * DESCR:    Forgets what 'stamp' recorded, for a new run. Its runs are kept for the next recording.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void stamp_reset(stamp_t *stamp) {
+    stamp->count  = 0;
+    stamp->valid  = false;
+    stamp->failed = false;
+}
+
+/*========================================= STATIC FUNCTION DEFINITIONS ======================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _stamp_fill()
+ * DESCR:    Fills 'count' squares of col (or row) 'line' of 'world' with 'ch' from row (or col) 'first', going
+ *           down the col if 'vert' is true.
+ * RETURNS:  See world_fill_col() and world_fill_row().
+ *------------------------------------------------------------------------------------------------------------*/
+static int _stamp_fill(world_t *world, bool vert, coord_t line, coord_t first, coord_t count, char ch) {
+    return vert ? world_fill_col(world, line, first, count, ch) : world_fill_row(world, line, first, count, ch);
+}
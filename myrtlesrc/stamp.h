@@ -0,0 +1,77 @@
+/***************************************************************************************************************
+ * FILE: stamp.h
+ *
+ * DESCRIPTION:
+ * Declarations for the stamps which cache what a procedure draws. See comments in stamp.c.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261017T0100 [JMW] Initial revision.
+ **************************************************************************************************************/
+#ifndef __STAMP_H__
+#define __STAMP_H__
+
+#include <stddef.h>   /* For size_t.       */
+#include "bool.h"     /* For bool.         */
+#include "globals.h"  /* For coord_t.      */
+#include "par.h"      /* For par_turtle_t. */
+#include "world.h"    /* For world_t.      */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * PREPROCESSOR MACRO DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+#define STAMP_MAX_RUNS 4096   /* Most runs a stamp holds. A procedure which draws more is not stamped. */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * A run of squares drawn while a stamp was recorded: 'count' squares of 'ch', along the row (or down the col)
+ * 'line' squares from where Myrtle started, beginning 'first' squares from where she started. Both are wrapped
+ * to the size of the world.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    coord_t line;
+    coord_t first;
+    coord_t count;
+    bool    vert;
+    char    ch;
+} stamp_run_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * What a procedure draws when it is called with the pen down, facing one direction, with one pen char.
+ *
+ * runs    -- The runs drawn, in order.
+ * count   -- The number of runs.
+ * cap     -- The number of runs allocated. Kept from run to run.
+ * start   -- Where Myrtle started while the stamp is being recorded. Its pen char is the one the stamp is for.
+ * end     -- The state the procedure leaves Myrtle in, with row and col as how far she ends up from where she
+ *            started, wrapped to the size of the world.
+ * valid   -- True once the stamp has been recorded.
+ * failed  -- True if the procedure drew too much to stamp, or the runs could not be allocated. It is not tried
+ *            again until the next run.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    stamp_run_t  *runs;
+    size_t        count;
+    size_t        cap;
+    par_turtle_t  start;
+    par_turtle_t  end;
+    bool          valid;
+    bool          failed;
+} stamp_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * NONSTATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+extern void stamp_begin(stamp_t *stamp, const par_turtle_t *start);
+extern int  stamp_blit(const stamp_t *stamp, world_t *world, par_turtle_t *turtle);
+extern void stamp_end(stamp_t *stamp, const par_turtle_t *end, coord_t rows, coord_t cols);
+extern void stamp_free(stamp_t *stamp);
+extern void stamp_init(stamp_t *stamp);
+extern void stamp_log(stamp_t *stamp, bool vert, coord_t line, coord_t first, coord_t count, char ch,
+                      coord_t rows, coord_t cols);
+extern void stamp_reset(stamp_t *stamp);
+
+#endif
@@ -0,0 +1,380 @@
+/***************************************************************************************************************
+ * FILE: stats.c
+ *
+ * DESCRIPTION:
+ * The statistics kept by -S: how many times each command is performed, how many squares are painted and how many
+ * of them were painted before, how much input was read, the time spent compiling, performing and writing the
+ * world, with a histogram of each, and the peak memory of the process. They are printed when the run ends, as a
+ * summary or as JSON.
+ *
+ * The interpreter only calls in here through STATS_DO(), which tests the context's stats pointer, so a run
+ * without -S pays one predictable branch per square-filling command and per token. "make STATS=0" defines
+ * MYRTLE_NO_STATS, STATS_DO() becomes an empty statement, and not even that is left.
+ *
+ * Counting every command as it is performed would cost a store per command in the innermost loop of the
+ * interpreter, and native code, threads and skipped 'repeat' repetitions (see repeat.c) would not be counted at
+ * all. Instead, stats_program() counts them from the compiled program before it runs: each command is counted
+ * once, times the counts of the 'repeat' blocks around it; a 'call' adds what the body of its procedure
+ * performs, which is worked out once per procedure. The counts are what the program performs as written, however
+ * the run gets there, and saturate at ULONG_MAX.
+ *
+ * Time is read from the monotonic clock only where the run moves from one phase to the next, and every
+ * STATS_CHUNK tokens while compiling, so that a long compile shows up in the histogram as many events instead of
+ * one.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * 20261017T1100 [JMW] operand counts and command names come from cmd_nargs[] and cmd_names[] in myrtle.c
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261017T0500 [JMW] Initial revision.
+ **************************************************************************************************************/
+/* clock_gettime() and getrusage() are POSIX, not Standard C, so ask for them before including anything. */
+#define _POSIX_C_SOURCE 200809L
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bool.h"
+#include "globals.h"
+#include "myrtle.h"
+#include "stamp.h"
+#include "stats.h"
+#include "world.h"
+
+/* POSIX header for getrusage() */
+#include <sys/resource.h>
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * The procedures of the program being counted by stats_program().
+ *
+ * at    -- The CMD_TO of each procedure, in the order they appear in the program.
+ * ops   -- For each procedure, CMD_COUNT counts of what one call of it performs.
+ * done  -- True for each procedure whose ops have been worked out.
+ * count -- The number of procedures.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    const int    **at;
+    unsigned long *ops;
+    bool          *done;
+    size_t         count;
+} stats_procs_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+static unsigned long  _stats_add(unsigned long a, unsigned long b);
+static void           _stats_count(stats_procs_t *procs, unsigned long *ops, const int *pc, const int *end,
+                                   unsigned long times);
+static unsigned long  _stats_mul(unsigned long a, unsigned long b);
+static const int     *_stats_next(const int *pc);
+static double         _stats_now(void);
+static void           _stats_print_json(const stats_t *stats, FILE *out);
+static void           _stats_print_text(const stats_t *stats, FILE *out);
+static const unsigned long *_stats_proc(stats_procs_t *procs, const int *to);
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC GLOBAL CONSTANT DEFINITIONS
+ *
+ * stats_phases -- The name of each phase.
+ *------------------------------------------------------------------------------------------------------------*/
+static const char *const stats_phases[STATS_PHASES] = { "parse", "exec", "write" };
+
+/*======================================= NONSTATIC FUNCTION DEFINITIONS =====================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: stats_end()
+ * DESCR:    Ends the run: closes the phase being timed and records the peak memory of the process.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void stats_end(stats_t *stats) {
+    struct rusage usage;
+    stats_phase(stats, STATS_NONE);
+    if (getrusage(RUSAGE_SELF, &usage) == 0) stats->peak_kb = usage.ru_maxrss;  /* In KB on Linux. */
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: stats_executor()
+ * DESCR:    Records that the program is being performed by 'executor' instead of the interpreter. Squares are
+ *           then no longer counted, since the executor draws them without calling stats_fill().
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void stats_executor(stats_t *stats, const char *executor) {
+    stats->executor = executor;
+    stats->counted  = false;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: stats_fill()
+ * DESCR:    Counts the 'count' squares of col (or row) 'line' of 'world' from row (or col) 'first' which are
+ *           about to be filled, as _myrtle_fill() describes them, and how many of them are not blank.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void stats_fill(stats_t *stats, world_t *world, bool vert, coord_t line, coord_t first, coord_t count) {
+    coord_t i;
+    stats->painted = _stats_add(stats->painted, (unsigned long)count);
+    for (i = first; i < first + count; i++) {
+        char ch = vert ? world_get(world, i, line) : world_get(world, line, i);
+        if (ch != WORLD_BACKGROUND) stats->overwritten++;
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: stats_phase()
+ * DESCR:    Moves the run to 'phase', or to STATS_NONE if it is between phases. The time since the last move is
+ *           one event of the phase being left, if there was one. Moving to the phase already being timed also
+ *           ends an event and starts another.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void stats_phase(stats_t *stats, int phase) {
+    double now = _stats_now();
+    if (stats->phase != STATS_NONE) {
+        stats_phase_t *p    = &stats->phases[stats->phase];
+        double         secs = now - stats->start;
+        double         us   = secs * 1e6;
+        int            b    = 0;
+        while (b < STATS_BUCKETS - 1 && us >= 2.0) {
+            us /= 2.0;
+            b++;
+        }
+        p->events++;
+        p->secs += secs;
+        if (secs > p->max) p->max = secs;
+        p->buckets[b]++;
+    }
+    stats->phase = phase;
+    stats->start = now;
+    stats->chunk = 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: stats_print()
+ * DESCR:    Writes 'stats' to 'out' as a summary for people to read, or as one JSON object if 'json' is true.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void stats_print(const stats_t *stats, FILE *out, bool json) {
+    if (json) _stats_print_json(stats, out);
+    else _stats_print_text(stats, out);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: stats_program()
+ * DESCR:    Adds the commands which the 'count' words of compiled program at 'words' perform to stats->ops. See
+ *           the top of this file. If the procedures cannot be allocated, a 'call' counts only itself.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void stats_program(stats_t *stats, const int *words, size_t count) {
+    const int     *pc, *end = words + count;
+    stats_procs_t  procs;
+    size_t         n = 0;
+
+    /* Procedures are only declared at the top level, so they are found without going into 'repeat' blocks. */
+    for (pc = words; pc < end; pc = _stats_next(pc)) {
+        if (*pc == CMD_TO) n++;
+    }
+    procs.count = 0;
+    procs.at    = n ? (const int **)malloc(n * sizeof(const int *)) : NULL;
+    procs.ops   = n ? (unsigned long *)calloc(n * CMD_COUNT, sizeof(unsigned long)) : NULL;
+    procs.done  = n ? (bool *)calloc(n, sizeof(bool)) : NULL;
+    if (procs.at && procs.ops && procs.done) {
+        for (pc = words; pc < end; pc = _stats_next(pc)) {
+            if (*pc == CMD_TO) procs.at[procs.count++] = pc;
+        }
+    }
+    _stats_count(&procs, stats->ops, words, end, 1);
+    free((void *)procs.at);
+    free(procs.ops);
+    free(procs.done);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: stats_reset()
+ * DESCR:    Zeroes 'stats' for a new run, which starts between phases, performed by the interpreter.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void stats_reset(stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->counted  = true;
+    stats->executor = "interpreter";
+    stats->phase    = STATS_NONE;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: stats_stamp()
+ * DESCR:    Counts the squares drawn by one stamp_blit() of 'stamp'.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void stats_stamp(stats_t *stats, const stamp_t *stamp) {
+    size_t i;
+    for (i = 0; i < stamp->count; i++) {
+        stats->stamped = _stats_add(stats->stamped, (unsigned long)stamp->runs[i].count);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: stats_token()
+ * DESCR:    Counts a token compiled. Every STATS_CHUNK tokens, the parse phase ends an event and starts another.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void stats_token(stats_t *stats) {
+    stats->tokens++;
+    if (++stats->chunk == STATS_CHUNK) stats_phase(stats, STATS_PARSE);
+}
+
+/*======================================== STATIC FUNCTION DEFINITIONS =======================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _stats_add()
+ * DESCR:    Adds 'a' and 'b', saturating at ULONG_MAX.
+ * RETURNS:  The sum.
+ *------------------------------------------------------------------------------------------------------------*/
+static unsigned long _stats_add(unsigned long a, unsigned long b) {
+    return (a > ULONG_MAX - b) ? ULONG_MAX : a + b;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _stats_count()
+ * DESCR:    Adds 'times' times the commands performed from 'pc' to 'end' to 'ops'.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _stats_count(stats_procs_t *procs, unsigned long *ops, const int *pc, const int *end,
+                         unsigned long times) {
+    const unsigned long *body;
+    int                  op, i;
+
+    for (; pc < end; pc = _stats_next(pc)) {
+        op = *pc;
+        ops[op] = _stats_add(ops[op], times);
+        if (op == CMD_CALL) {
+            body = _stats_proc(procs, pc + pc[1]);
+            for (i = 0; body && i < CMD_COUNT; i++) ops[i] = _stats_add(ops[i], _stats_mul(body[i], times));
+        } else if (op == CMD_REPEAT && pc[1] > 0) {
+            _stats_count(procs, ops, pc + 3, pc + 3 + pc[2], _stats_mul(times, (unsigned long)pc[1]));
+        }
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _stats_mul()
+ * DESCR:    Multiplies 'a' by 'b', saturating at ULONG_MAX.
+ * RETURNS:  The product.
+ *------------------------------------------------------------------------------------------------------------*/
+static unsigned long _stats_mul(unsigned long a, unsigned long b) {
+    return (a && b > ULONG_MAX / a) ? ULONG_MAX : a * b;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _stats_next()
+ * DESCR:    Steps over the command at 'pc', and over its body if it is a 'repeat' or a 'to'.
+ * RETURNS:  The command after it.
+ *------------------------------------------------------------------------------------------------------------*/
+static const int *_stats_next(const int *pc) {
+    if (*pc == CMD_REPEAT) return pc + 3 + pc[2];
+    if (*pc == CMD_TO) return pc + 2 + pc[1];
+    return pc + 1 + cmd_nargs[*pc];
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _stats_now()
+ * DESCR:    Reads the monotonic clock.
+ * RETURNS:  The time in seconds from an arbitrary point.
+ *------------------------------------------------------------------------------------------------------------*/
+static double _stats_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _stats_print_json()
+ * DESCR:    Writes 'stats' to 'out' as one JSON object on one line. Squares which were not counted are null.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _stats_print_json(const stats_t *stats, FILE *out) {
+    int i, b;
+
+    fprintf(out, "{\"executor\":\"%s\",\"cached\":%s,\"bytes\":%lu,\"tokens\":%lu,\"ops\":{", stats->executor,
+            stats->cached ? "true" : "false", stats->bytes, stats->tokens);
+    for (i = 0; i < CMD_COUNT; i++) fprintf(out, "%s\"%s\":%lu", i ? "," : "", cmd_names[i], stats->ops[i]);
+    if (stats->counted) {
+        fprintf(out, "},\"painted\":%lu,\"overwritten\":%lu,\"stamped\":%lu", stats->painted, stats->overwritten,
+                stats->stamped);
+    } else {
+        fprintf(out, "},\"painted\":null,\"overwritten\":null,\"stamped\":null");
+    }
+    fprintf(out, ",\"peak_kb\":%ld,\"phases\":{", stats->peak_kb);
+    for (i = 0; i < STATS_PHASES; i++) {
+        const stats_phase_t *p = &stats->phases[i];
+        fprintf(out, "%s\"%s\":{\"events\":%lu,\"secs\":%.9f,\"max_secs\":%.9f,\"buckets_us\":[", i ? "," : "",
+                stats_phases[i], p->events, p->secs, p->max);
+        for (b = 0; b < STATS_BUCKETS; b++) fprintf(out, "%s%lu", b ? "," : "", p->buckets[b]);
+        fprintf(out, "]}");
+    }
+    fprintf(out, "}}\n");
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _stats_print_text()
+ * DESCR:    Writes 'stats' to 'out' for people to read. Commands which are never performed, and empty buckets,
+ *           are left out.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _stats_print_text(const stats_t *stats, FILE *out) {
+    int i, b;
+
+    fprintf(out, "Statistics:\n");
+    fprintf(out, "  executor     %s%s\n", stats->executor, stats->cached ? ", program loaded from the cache" : "");
+    fprintf(out, "  input        %lu bytes, %lu tokens\n", stats->bytes, stats->tokens);
+    fprintf(out, "  commands    ");
+    for (i = 0; i < CMD_COUNT; i++) {
+        if (stats->ops[i]) fprintf(out, " %s %lu", cmd_names[i], stats->ops[i]);
+    }
+    fprintf(out, "\n");
+    if (stats->counted) {
+        fprintf(out, "  squares      %lu painted, %lu of them overwritten (%.1f%%), %lu stamped\n", stats->painted,
+                stats->overwritten, stats->painted ? 100.0 * stats->overwritten / stats->painted : 0.0,
+                stats->stamped);
+    } else {
+        fprintf(out, "  squares      not counted by the %s executor\n", stats->executor);
+    }
+    fprintf(out, "  peak memory  %ld KB\n", stats->peak_kb);
+    fprintf(out, "  phase     events      total ms    mean us     max us\n");
+    for (i = 0; i < STATS_PHASES; i++) {
+        const stats_phase_t *p = &stats->phases[i];
+        fprintf(out, "  %-6s %9lu %13.3f %10.1f %10.1f\n", stats_phases[i], p->events, p->secs * 1e3,
+                p->events ? p->secs * 1e6 / p->events : 0.0, p->max * 1e6);
+    }
+    for (i = 0; i < STATS_PHASES; i++) {
+        const stats_phase_t *p = &stats->phases[i];
+        if (!p->events) continue;
+        fprintf(out, "  %-6s us ", stats_phases[i]);
+        for (b = 0; b < STATS_BUCKETS; b++) {
+            if (p->buckets[b]) fprintf(out, " <%lu:%lu", 2UL << b, p->buckets[b]);
+        }
+        fprintf(out, "\n");
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _stats_proc()
+ * DESCR:    Finds the procedure whose CMD_TO is at 'to' and works out what one call of it performs, if that has
+ *           not been done yet. A procedure only calls procedures declared before it, so this always ends.
+ * RETURNS:  Its CMD_COUNT counts, or NULL if the procedures could not be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+static const unsigned long *_stats_proc(stats_procs_t *procs, const int *to) {
+    size_t lo = 0, hi = procs->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (procs->at[mid] < to) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == procs->count || procs->at[lo] != to) return NULL;
+    if (!procs->done[lo]) {
+        _stats_count(procs, procs->ops + lo * CMD_COUNT, to + 2, to + 2 + to[1], 1);
+        procs->done[lo] = true;
+    }
+    return procs->ops + lo * CMD_COUNT;
+}
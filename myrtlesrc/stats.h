@@ -0,0 +1,120 @@
+/***************************************************************************************************************
+ * FILE: stats.h
+ *
+ * DESCRIPTION:
+ * Declarations for the statistics kept by -S. See comments in stats.c.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261017T0500 [JMW] Initial revision.
+ **************************************************************************************************************/
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdio.h>    /* For FILE.      */
+#include "bool.h"     /* For bool.      */
+#include "globals.h"  /* For coord_t.   */
+#include "myrtle.h"   /* For CMD_COUNT. */
+#include "stamp.h"    /* For stamp_t.   */
+#include "world.h"    /* For world_t.   */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * PREPROCESSOR MACRO DEFINITIONS
+ *
+ * Building with -DMYRTLE_NO_STATS ("make STATS=0") leaves the statistics out: STATS_DO() compiles to nothing,
+ * so not even the test of the stats pointer is left in the interpreter, and -S is refused.
+ *
+ * STATS_DO(stats, call) -- Makes 'call', a call of a stats_*() function, if 'stats' is not NULL.
+ *------------------------------------------------------------------------------------------------------------*/
+#ifdef MYRTLE_NO_STATS
+#define STATS_ENABLED          false
+#define STATS_DO(stats, call)  do { } while (0)
+#else
+#define STATS_ENABLED          true
+#define STATS_DO(stats, call)  do { if (stats) call; } while (0)
+#endif
+
+#define STATS_BUCKETS   32      /* Latency buckets: bucket i > 0 counts events of 2^i to 2^(i+1) microseconds. */
+#define STATS_CHUNK     4096    /* Tokens compiled per parse event.                                            */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * ENUMERATED CONSTANTS
+ *
+ * The phases of a run which are timed. STATS_NONE is between phases.
+ *------------------------------------------------------------------------------------------------------------*/
+enum {
+    STATS_PARSE,     /* Compiling and optimizing the input, or loading it from the cache. */
+    STATS_EXEC,      /* Performing the program, from one 'stop' to the next.              */
+    STATS_WRITE,     /* Writing the world, at each 'stop' and at the end.                 */
+    STATS_PHASES,
+    STATS_NONE = STATS_PHASES
+};
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * The time spent in one phase: the number of events (stretches of time spent in the phase), their total, the
+ * longest, and a histogram of their lengths with a bucket for each power of 2 microseconds. Bucket 0 also
+ * counts the events shorter than a microsecond.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    unsigned long events;
+    double        secs;
+    double        max;
+    unsigned long buckets[STATS_BUCKETS];
+} stats_phase_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * The statistics of one run. The struct is named so that myrtle.h can declare myrtle_ctx_stats_set() without
+ * including this file.
+ *
+ * ops         -- How many times each command is performed by the program, by opcode, as if nothing were
+ *                skipped (see stats_program()).
+ * painted     -- Squares drawn by commands.
+ * overwritten -- Those of them which already held a char other than WORLD_BACKGROUND.
+ * stamped     -- Squares drawn by stamps (see stamp.c), which are not checked for overwriting.
+ * counted     -- True if painted, overwritten and stamped are complete. Only the interpreter counts squares;
+ *                native code and threads draw without telling anyone (see stats_executor()).
+ * tokens      -- Tokens compiled.
+ * bytes       -- Bytes of input read.
+ * cached      -- True if the program was loaded from the cache (see cache.c) instead of compiled.
+ * executor    -- How the program was performed: "interpreter", "native", "parallel" or "turtles".
+ * peak_kb     -- The peak resident memory of the process, in KB, when the run ended.
+ * phases      -- The time spent in each phase.
+ * phase       -- The phase being timed, or STATS_NONE.
+ * chunk       -- Tokens compiled since the last parse event.
+ * start       -- When the phase being timed started, in seconds from an arbitrary point.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct stats {
+    unsigned long   ops[CMD_COUNT];
+    unsigned long   painted;
+    unsigned long   overwritten;
+    unsigned long   stamped;
+    bool            counted;
+    unsigned long   tokens;
+    unsigned long   bytes;
+    bool            cached;
+    const char     *executor;
+    long            peak_kb;
+    stats_phase_t   phases[STATS_PHASES];
+    int             phase;
+    int             chunk;
+    double          start;
+} stats_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * NONSTATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+extern void stats_end(stats_t *stats);
+extern void stats_executor(stats_t *stats, const char *executor);
+extern void stats_fill(stats_t *stats, world_t *world, bool vert, coord_t line, coord_t first, coord_t count);
+extern void stats_phase(stats_t *stats, int phase);
+extern void stats_print(const stats_t *stats, FILE *out, bool json);
+extern void stats_program(stats_t *stats, const int *words, size_t count);
+extern void stats_reset(stats_t *stats);
+extern void stats_stamp(stats_t *stats, const stamp_t *stamp);
+extern void stats_token(stats_t *stats);
+
+#endif
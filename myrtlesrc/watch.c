@@ -0,0 +1,366 @@
+/***************************************************************************************************************
+ * FILE: watch.c
+ *
+ * DESCRIPTION:
+ * Watch mode, started by --watch: runs a script, then runs it again each time it changes, so that an artist
+ * editing it sees the new picture as soon as it is saved. Most saves change a few commands near where the artist
+ * is working, so each run starts again from just before the first command which changed, instead of from the
+ * beginning, and takes about as long as the commands after it.
+ *
+ * While a program is performed, a mark is taken before some of its top-level commands: Myrtle, her world and how
+ * much output had been written, which is all the rest of the run depends on. Marks are taken at most one per
+ * key_work words performed and squares painted, where key_work is at least the size of the world, so that taking
+ * them never costs more than performing the program does. A mark is only taken at a location, the first token of
+ * a top-level command at least WATCH_LOC_WORDS words of program after the last one, which the compiler notes as
+ * it goes, together with what it had compiled before it. When there are WATCH_MAX_MARKS marks, every other one
+ * is dropped and they are taken half as often.
+ *
+ * Each mark is keyed by its command's index in the program and a hash of the input before it. When the script
+ * changes, the input is hashed again up to each mark in turn, and the last mark whose input has not changed is
+ * where compiling starts again: the program, procedures and locations before it are kept, and the scanner skips
+ * straight to its token. The new program is then compared word by word with the old one from there, and the run
+ * resumes from the last mark before the first word which differs. So an edit which does not change the program
+ * from some point on, such as to a comment or the spacing, still resumes as late as it can.
+ *
+ * The input is hashed a whole word at a time, with FNV-1a's multiply, and the bytes before a mark which do not
+ * make a whole word are hashed one at a time on top of that. Inputs which differ in one place never hash the
+ * same, since each step is one to one.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261017T0900 [JMW] Initial revision.
+ **************************************************************************************************************/
+/* stat(), nanosleep() and clock_gettime() are POSIX, not Standard C, so ask for them before including anything. */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "bool.h"
+#include "file.h"
+#include "globals.h"
+#include "myrtle.h"
+#include "par.h"
+#include "watch.h"
+#include "world.h"
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+static unsigned long _watch_bytes(unsigned long hash, const char *buf, size_t len);
+static bool          _watch_changed(const struct stat *st, const struct stat *last);
+static void          _watch_key(watch_mark_t *mark, const watch_mark_t *prev, const char *input);
+static double        _watch_now_ms();
+static unsigned long _watch_words(unsigned long hash, const char *input, size_t from, size_t to);
+
+/*===================================== NONSTATIC FUNCTION DEFINITIONS =======================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: watch_drop()
+ * DESCR:    Drops the marks after mark 'keep', or all of them if it is -1. Work is counted again from 'keep'.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void watch_drop(watch_t *watch, long keep) {
+    size_t i;
+    for (i = (size_t)(keep + 1); i < watch->mark_count; i++) free(watch->marks[i].cells);
+    if ((size_t)(keep + 1) < watch->mark_count) watch->mark_count = (size_t)(keep + 1);
+    if (!watch->mark_count) watch->key_work = 0;
+    watch->work = 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: watch_find()
+ * DESCR:    Finds the location of the command at index 'pc' in the program. The locations are in order, so they
+ *           are searched by halves.
+ * RETURNS:  The index of the location in watch->locs, or -1 if there is none at 'pc'.
+ *------------------------------------------------------------------------------------------------------------*/
+long watch_find(const watch_t *watch, long pc) {
+    long lo = 0, hi = (long)watch->loc_count - 1;
+    while (lo <= hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (watch->locs[mid].pc == pc) return mid;
+        if (watch->locs[mid].pc < pc) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return -1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: watch_free()
+ * DESCR:    Frees everything 'watch' holds and initializes it again.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void watch_free(watch_t *watch) {
+    watch_drop(watch, -1);
+    free(watch->locs);
+    free(watch->marks);
+    free(watch->old);
+    if (watch->snap) file_free(watch->snap);
+    free(watch->snap);
+    watch_init(watch);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: watch_init()
+ * DESCR:    Initializes 'watch' with no locations, no marks and no program, so the first run starts from the
+ *           beginning.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void watch_init(watch_t *watch) {
+    memset(watch, 0, sizeof(watch_t));
+    watch->resumed = -1;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: watch_keep()
+ * DESCR:    Keeps a copy of the words from index 'from' to index 'count' of the program about to be compiled over,
+ *           for watch_resume() to compare the new program with. The words before 'from' do not change.
+ * RETURNS:  True, or false if the copy cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+bool watch_keep(watch_t *watch, const int *words, long from, long count) {
+    size_t n = count > from ? (size_t)(count - from) : 0;
+    if (n > watch->old_cap) {
+        int *old = (int *)realloc(watch->old, n * sizeof(int));
+        if (!old) return false;
+        watch->old     = old;
+        watch->old_cap = n;
+    }
+    if (n) memcpy(watch->old, words + from, n * sizeof(int));
+    watch->old_at    = from;
+    watch->old_count = n;
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: watch_loc()
+ * DESCR:    Called by the compiler at the first token of each top-level command: notes where it came from, if it
+ *           is at least WATCH_LOC_WORDS words after the last location.
+ * RETURNS:  True, or false if the location cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+bool watch_loc(watch_t *watch, const watch_loc_t *loc) {
+    if (watch->loc_count && loc->pc < watch->locs[watch->loc_count - 1].pc + WATCH_LOC_WORDS) return true;
+    if (watch->loc_count == watch->loc_cap) {
+        size_t       cap  = watch->loc_cap ? watch->loc_cap * 2 : 256;
+        watch_loc_t *locs = (watch_loc_t *)realloc(watch->locs, cap * sizeof(watch_loc_t));
+        if (!locs) return false;
+        watch->locs    = locs;
+        watch->loc_cap = cap;
+    }
+    watch->locs[watch->loc_count++] = *loc;
+    return true;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: watch_mark()
+ * DESCR:    Called before the top-level command at location 'loc' is performed: takes a mark of the run if
+ *           key_work words and squares have been performed and painted since the last one. 'input' is the mapped
+ *           input, 'world' and 'turtle' are Myrtle's, and 'output' is the number of bytes of output written. A
+ *           mark which cannot be allocated is just not taken.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void watch_mark(watch_t *watch, long loc, const char *input, world_t *world, const par_turtle_t *turtle,
+                size_t output) {
+    watch_mark_t *mark;
+    const char   *text;
+    size_t        i, len;
+
+    if (!watch->key_work) {
+        watch->key_work = world->rows * world->cols;
+        if (watch->key_work < WATCH_KEY_MIN) watch->key_work = WATCH_KEY_MIN;
+    }
+    if (watch->work < watch->key_work) return;
+    watch->work = 0;
+
+    if (watch->mark_count == WATCH_MAX_MARKS) {
+        for (i = 1; i < watch->mark_count; i += 2) free(watch->marks[i].cells);
+        for (i = 2; i < watch->mark_count; i += 2) watch->marks[i / 2] = watch->marks[i];
+        watch->mark_count = (watch->mark_count + 1) / 2;
+        watch->key_work  *= 2;
+    }
+    if (watch->mark_count == watch->mark_cap) {
+        size_t        cap   = watch->mark_cap ? watch->mark_cap * 2 : 16;
+        watch_mark_t *marks = (watch_mark_t *)realloc(watch->marks, cap * sizeof(watch_mark_t));
+        if (!marks) return;
+        watch->marks    = marks;
+        watch->mark_cap = cap;
+    }
+    if (!watch->snap) {
+        watch->snap = (file_t *)malloc(sizeof(file_t));
+        if (!watch->snap) return;
+        file_init(watch->snap);
+    }
+    file_open_out_mem(watch->snap);
+    if (world_write(world, watch->snap) != TERM_NORM) return;
+    text = file_mem(watch->snap, &len);
+
+    mark        = &watch->marks[watch->mark_count];
+    mark->cells = (char *)malloc(len);
+    if (!mark->cells) return;
+    memcpy(mark->cells, text, len);
+    mark->loc    = watch->locs[loc];
+    mark->output = output;
+    mark->turtle = *turtle;
+    _watch_key(mark, watch->mark_count ? mark - 1 : NULL, input);
+    watch->mark_count++;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: watch_resume()
+ * DESCR:    Called once the program has been compiled again from mark 'match', the one watch_start() returned:
+ *           compares its 'count' words with those watch_keep() kept, and picks the last mark before the first
+ *           word which differs, which the run resumes from. The marks after 'match' up to that one are keyed
+ *           again with where their commands now are in 'input', and the marks after it are dropped.
+ * RETURNS:  The mark the run resumes from, or -1 if it starts from the beginning. Also in watch->resumed.
+ *------------------------------------------------------------------------------------------------------------*/
+long watch_resume(watch_t *watch, const int *words, long count, const char *input, long match) {
+    long first = watch->old_at, end = watch->old_at + (long)watch->old_count, i, loc;
+
+    while (first < count && first < end && words[first] == watch->old[first - watch->old_at]) first++;
+    for (i = match + 1; i < (long)watch->mark_count && watch->marks[i].loc.pc <= first; i++) {
+        loc = watch_find(watch, watch->marks[i].loc.pc);
+        if (loc < 0) break;
+        watch->marks[i].loc = watch->locs[loc];
+        _watch_key(&watch->marks[i], i ? &watch->marks[i - 1] : NULL, input);
+    }
+    watch_drop(watch, i - 1);
+    watch->old_count = 0;
+    watch->resumed   = i - 1;
+    watch->line      = i > 0 ? watch->marks[i - 1].loc.line : 0;
+    return watch->resumed;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: watch_run()
+ * DESCR:    Runs the script 'in_fname' in 'ctx', writing the world to 'out_fname' as myrtle_ctx_run_file() does,
+ *           and then runs it again whenever its size or modification time changes, looking every WATCH_POLL_MS
+ *           milliseconds. Each run resumes from the last mark before the first command which changed (see
+ *           myrtle_ctx_watch_set()). How long each run took, and which line it resumed from, or why it failed,
+ *           is written to 'report'. A script which is missing while it is being saved is just looked at again.
+ * RETURNS:  Only if the script cannot be found to start with: TERM_ERR_INPUT, with a message in 'error', which
+ *           must hold WATCH_ERROR_SIZE chars. Otherwise it runs until the program is killed.
+ *------------------------------------------------------------------------------------------------------------*/
+int watch_run(myrtle_ctx_t *ctx, watch_t *watch, const char *in_fname, const char *out_fname, FILE *report,
+              char *error) {
+    struct stat     st, last;
+    struct timespec pause;
+    double          start;
+    bool            ran = false;
+
+    if (!in_fname || stat(in_fname, &last) != 0) {
+        sprintf(error, "Cannot open input file '%.100s'", in_fname ? in_fname : "");
+        return TERM_ERR_INPUT;
+    }
+    myrtle_ctx_watch_set(ctx, watch);
+    pause.tv_sec  = WATCH_POLL_MS / 1000;
+    pause.tv_nsec = WATCH_POLL_MS % 1000 * 1000000L;
+    for (;;) {
+        if (stat(in_fname, &st) == 0 && (!ran || _watch_changed(&st, &last))) {
+            ran   = true;
+            last  = st;
+            start = _watch_now_ms();
+            if (myrtle_ctx_run_file(ctx, in_fname, out_fname) != TERM_NORM) {
+                fprintf(report, "%s.\n", myrtle_ctx_error(ctx));
+            } else if (watch->line) {
+                fprintf(report, "Re-rendered from line %d in %.1f ms.\n", watch->line, _watch_now_ms() - start);
+            } else {
+                fprintf(report, "Rendered in %.1f ms.\n", _watch_now_ms() - start);
+            }
+            fflush(report);
+        }
+        nanosleep(&pause, NULL);
+    }
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: watch_start()
+ * DESCR:    Called before the script is compiled again: hashes the 'len' bytes of mapped 'input' up to each mark
+ *           in turn, and finds the last mark whose input has not changed, from whose command compiling can start
+ *           again. The locations after it are forgotten, since the compiler notes them again.
+ * RETURNS:  The mark, or -1 if the script must be compiled from the beginning.
+ *------------------------------------------------------------------------------------------------------------*/
+long watch_start(watch_t *watch, const char *input, size_t len) {
+    const watch_mark_t *mark;
+    watch_mark_t        key;
+    long                match = -1, loc = -1, found;
+    size_t              i;
+
+    for (i = 0; i < watch->mark_count && watch->marks[i].loc.offset <= len; i++) {
+        mark    = &watch->marks[i];
+        key.loc = mark->loc;
+        _watch_key(&key, i ? mark - 1 : NULL, input);
+        if (key.words != mark->words || key.hash != mark->hash || (found = watch_find(watch, mark->loc.pc)) < 0) {
+            break;
+        }
+        match = (long)i;
+        loc   = found;
+    }
+    watch->loc_count = (size_t)(loc + 1);
+    return match;
+}
+
+/*========================================= STATIC FUNCTION DEFINITIONS ======================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _watch_bytes()
+ * DESCR:    Adds the 'len' bytes at 'buf' to 'hash' with 64-bit FNV-1a.
+ * RETURNS:  The new hash.
+ *------------------------------------------------------------------------------------------------------------*/
+static unsigned long _watch_bytes(unsigned long hash, const char *buf, size_t len) {
+    const unsigned char *p   = (const unsigned char *)buf;
+    const unsigned char *end = p + len;
+    for (; p < end; p++) hash = (hash ^ *p) * 1099511628211UL;
+    return hash;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _watch_changed()
+ * DESCR:    Compares what stat() said about the script now, 'st', with what it said when it was last run, 'last'.
+ *           An editor which saves by renaming a new file over the old one changes its inode.
+ * RETURNS:  True if the script may have changed.
+ *------------------------------------------------------------------------------------------------------------*/
+static bool _watch_changed(const struct stat *st, const struct stat *last) {
+    return st->st_size != last->st_size || st->st_ino != last->st_ino || st->st_dev != last->st_dev ||
+           st->st_mtim.tv_sec != last->st_mtim.tv_sec || st->st_mtim.tv_nsec != last->st_mtim.tv_nsec;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _watch_key()
+ * DESCR:    Hashes the input before the command of 'mark' into mark->words and mark->hash, going on from the
+ *           hash of the mark before it, 'prev', or from the beginning if it is NULL. Whole words are hashed by
+ *           _watch_words(), so the result does not depend on which mark it went on from.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _watch_key(watch_mark_t *mark, const watch_mark_t *prev, const char *input) {
+    size_t from = prev ? prev->loc.offset / sizeof(unsigned long) * sizeof(unsigned long) : 0;
+    size_t to   = mark->loc.offset / sizeof(unsigned long) * sizeof(unsigned long);
+    mark->words = _watch_words(prev ? prev->words : 14695981039346656037UL, input, from, to);
+    mark->hash  = _watch_bytes(mark->words, input + to, mark->loc.offset - to);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _watch_now_ms()
+ * DESCR:    Reads the monotonic clock.
+ * RETURNS:  The time in milliseconds since some fixed point.
+ *------------------------------------------------------------------------------------------------------------*/
+static double _watch_now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _watch_words()
+ * DESCR:    Adds the whole words of 'input' from offset 'from' to offset 'to', both multiples of the size of a
+ *           word, to 'hash', one word at a time. 'input' is a mapping, so the words are aligned.
+ * RETURNS:  The new hash.
+ *------------------------------------------------------------------------------------------------------------*/
+static unsigned long _watch_words(unsigned long hash, const char *input, size_t from, size_t to) {
+    const unsigned long *p   = (const unsigned long *)(input + from);
+    const unsigned long *end = (const unsigned long *)(input + to);
+    for (; p < end; p++) hash = (hash ^ *p) * 1099511628211UL;
+    return hash;
+}
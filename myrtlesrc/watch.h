@@ -0,0 +1,125 @@
+/***************************************************************************************************************
+ * FILE: watch.h
+ *
+ * DESCRIPTION:
+ * Declarations for watch mode, which runs a script again each time it changes. See comments in watch.c.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261017T0900 [JMW] Initial revision.
+ **************************************************************************************************************/
+#ifndef __WATCH_H__
+#define __WATCH_H__
+
+#include <stddef.h>   /* For size_t.        */
+#include <stdio.h>    /* For FILE.          */
+#include "bool.h"     /* For bool.          */
+#include "file.h"     /* For file_t.        */
+#include "globals.h"  /* For coord_t.       */
+#include "myrtle.h"   /* For myrtle_ctx_t.  */
+#include "par.h"      /* For par_turtle_t.  */
+#include "world.h"    /* For world_t.       */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * PREPROCESSOR MACRO DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+#define WATCH_ERROR_SIZE 160         /* Size of the buffer watch_run() writes its error message into. */
+#define WATCH_KEY_MIN    (1L << 12)  /* Fewest words performed and squares painted between two marks.  */
+#define WATCH_LOC_WORDS  64          /* Fewest words of the program between two locations.            */
+#define WATCH_MAX_MARKS  1024        /* Most marks kept. Beyond that, every other one is dropped.     */
+#define WATCH_POLL_MS    50          /* Milliseconds between one look at the script and the next.     */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * Where a top-level command of the program came from: its index in the compiled program, the offset in the input
+ * of its first token and the line that is on, and the number of procedures, 'repeat' blocks and calls which were
+ * not inlined compiled before it. Compiling can start again from there with just those.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    long   pc;
+    size_t offset;
+    int    line;
+    int    procs;
+    int    repeats;
+    int    calls;
+} watch_loc_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * The state of a run as the top-level command at 'loc' was about to be performed.
+ *
+ * loc    -- Where the command came from.
+ * words  -- The hash of the whole words of input before loc.offset (see _watch_words()).
+ * hash   -- The hash of all of the input before loc.offset. Only input which hashes the same has the mark.
+ * output -- The number of bytes of output written before it.
+ * turtle -- Myrtle.
+ * cells  -- The world, as world_write() writes it.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    watch_loc_t   loc;
+    unsigned long words;
+    unsigned long hash;
+    size_t        output;
+    par_turtle_t  turtle;
+    char         *cells;
+} watch_mark_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * What watch mode keeps from one run of a script to the next.
+ *
+ * locs       -- The locations of the top-level commands of the program, at least WATCH_LOC_WORDS words apart,
+ *               in order. Marks are only taken at these.
+ * loc_count  -- The number of locations.
+ * loc_cap    -- The number of locations allocated.
+ * marks      -- The marks taken by the runs so far, in order.
+ * mark_count -- The number of marks.
+ * mark_cap   -- The number of marks allocated.
+ * old        -- The words of the last program from old_at on, which the new program is compared with.
+ * old_at     -- The index in the program of the first word in old.
+ * old_count  -- The number of words in old.
+ * old_cap    -- The number of words allocated for old.
+ * work       -- The words performed and squares painted since the last mark.
+ * key_work   -- How much work there is between marks: the number of squares in the world, so that the time
+ *               spent taking marks is never more than the time spent performing, but at least WATCH_KEY_MIN, and
+ *               twice that each time the marks are thinned out.
+ * resumed    -- The mark the run resumes from, or -1 if it starts from the beginning.
+ * line       -- The line of the command the last run resumed from, or 0 if it started from the beginning.
+ * snap       -- Where the world is written to take a mark. Allocated by the first mark.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct watch {
+    watch_loc_t  *locs;
+    size_t        loc_count;
+    size_t        loc_cap;
+    watch_mark_t *marks;
+    size_t        mark_count;
+    size_t        mark_cap;
+    int          *old;
+    long          old_at;
+    size_t        old_count;
+    size_t        old_cap;
+    coord_t       work;
+    coord_t       key_work;
+    long          resumed;
+    int           line;
+    file_t       *snap;
+} watch_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * NONSTATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+extern void watch_drop(watch_t *watch, long keep);
+extern long watch_find(const watch_t *watch, long pc);
+extern void watch_free(watch_t *watch);
+extern void watch_init(watch_t *watch);
+extern bool watch_keep(watch_t *watch, const int *words, long from, long count);
+extern bool watch_loc(watch_t *watch, const watch_loc_t *loc);
+extern void watch_mark(watch_t *watch, long loc, const char *input, world_t *world, const par_turtle_t *turtle,
+                       size_t output);
+extern long watch_resume(watch_t *watch, const int *words, long count, const char *input, long match);
+extern int  watch_run(myrtle_ctx_t *ctx, watch_t *watch, const char *in_fname, const char *out_fname,
+                      FILE *report, char *error);
+extern long watch_start(watch_t *watch, const char *input, size_t len);
+
+#endif
@@ -0,0 +1,675 @@
+/***************************************************************************************************************
+ * FILE: world.c
+ *
+ * DESCRIPTION:
+ * Myrtle's world: the grid of squares she draws in, and the code which writes it to the output file.
+ *
+ * A small world is stored dense, as one block which is exactly the text of the output file. A large world is
+ * stored sparse, as WORLD_TILE_SIZE x WORLD_TILE_SIZE tiles which are only allocated when something is drawn in
+ * them. A square in a tile which was never allocated holds WORLD_BACKGROUND, and world_write() writes such a
+ * tile's squares straight from a buffer of spaces without ever allocating it. Either way the output is the
+ * same.
+ *
+ * A packed world is dense, but stores each square as an index into a palette of the chars which have been drawn,
+ * in as few bits as the palette needs. Most scripts draw with one or two pen chars, so most worlds need one or
+ * two bits per square instead of eight. Squares are filled, and decoded for output, a whole word at a time.
+ *
+ * A blocked world is made of the same tiles as a sparse world, but all of them are allocated up front, in order,
+ * in one block. Moving north or south in a dense world touches a new cache line, and often a new page, at every
+ * step; in a blocked world the next square is in the same tile, one cache line away. The price is that the
+ * tiles must be copied back into rows (detiled) when the world is written.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * 20261016T1600 [JMW] added WORLD_PACKED
+ * 20261016T1700 [JMW] added WORLD_BLOCKED
+ * 20261016T1800 [JMW] errors are returned instead of terminating the program; output goes to a file_t
+ * 20261016T1900 [JMW] added world_reset()
+ * 20261017T0800 [JMW] added world_load()
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261016T1500 [JMW] Initial revision. The dense world used to live in myrtle.c.
+ **************************************************************************************************************/
+/* posix_memalign() is POSIX, not Standard C, so ask for it before including anything. */
+#define _POSIX_C_SOURCE 200112L
+
+#include <limits.h>   /* For CHAR_BIT.                          */
+#include <stdlib.h>   /* For posix_memalign(), qsort(), free(). */
+#include <string.h>   /* For memset().                          */
+#include "bool.h"
+#include "file.h"
+#include "globals.h"
+#include "world.h"
+
+/*--------------------------------------------------------------------------------------------------------------
+ * PREPROCESSOR MACRO DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+#define WORLD_BLANK_SIZE 4096  /* Spaces in the buffer that background is written from. A macro because it sizes
+                                  an array. */
+#define WORLD_WORD_BITS ((int)(sizeof(world_word_t) * CHAR_BIT))
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC GLOBAL CONSTANT DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+static const size_t WORLD_TILE_BYTES    = (size_t)WORLD_TILE_SIZE * WORLD_TILE_SIZE;
+static const size_t WORLD_TILE_INIT_CAP = 1024;  /* Slots in the tile table at first. Doubles at half full. */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+static void  *_world_alloc(size_t size);
+static void   _world_blank(file_t *file, coord_t count);
+static int    _world_layout(coord_t rows, coord_t cols, int layout);
+static int    _world_pack_alloc(world_t *world, int bits);
+static void   _world_pack_fill_col(world_t *world, coord_t col, coord_t row, coord_t count, int index);
+static void   _world_pack_fill_row(world_t *world, coord_t row, coord_t col, coord_t count, int index);
+static int    _world_pack_index(world_t *world, char ch);
+static world_word_t _world_pack_pattern(world_t *world, int index);
+static int    _world_pack_widen(world_t *world);
+static int    _world_tile_cmp(const void *a, const void *b);
+static char  *_world_tile_find(world_t *world, coord_t trow, coord_t tcol, bool create);
+static int    _world_tile_grow(world_t *world);
+static size_t _world_tile_hash(world_t *world, coord_t trow, coord_t tcol);
+static int    _world_write_blocked(world_t *world, file_t *file);
+static int    _world_write_packed(world_t *world, file_t *file);
+static int    _world_write_sparse(world_t *world, file_t *file);
+
+/*======================================= NONSTATIC FUNCTION DEFINITIONS =====================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: world_draw()
+ * DESCR:    Draws 'ch' in the square at 'row', 'col'.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if a tile or a wider packed world cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+int world_draw(world_t *world, coord_t row, coord_t col, char ch) {
+    return world_fill_row(world, row, col, 1, ch);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: world_fill_col()
+ * DESCR:    Draws 'ch' in 'count' squares of column 'col', starting at 'row' and going south. The squares must
+ *           all be in the world. A sparse or blocked world is filled one tile at a time.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if a tile or a wider packed world cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+int world_fill_col(world_t *world, coord_t col, coord_t row, coord_t count, char ch) {
+    if (world->layout == WORLD_DENSE) {
+        char *p = world->cells + (size_t)row * world->stride + (size_t)col;
+        for (; count > 0; count--, p += world->stride) *p = ch;
+        return TERM_NORM;
+    }
+    if (world->layout == WORLD_PACKED) {
+        int index = _world_pack_index(world, ch);
+        if (index < 0) return TERM_ERR_MEMORY;
+        _world_pack_fill_col(world, col, row, count, index);
+        return TERM_NORM;
+    }
+    while (count > 0) {
+        coord_t off = row & (WORLD_TILE_SIZE - 1);
+        coord_t n   = WORLD_TILE_SIZE - off < count ? WORLD_TILE_SIZE - off : count;
+        char   *p   = _world_tile_find(world, row >> WORLD_TILE_SHIFT, col >> WORLD_TILE_SHIFT, true);
+        if (!p) return TERM_ERR_MEMORY;
+        p += off * WORLD_TILE_SIZE + (col & (WORLD_TILE_SIZE - 1));
+        for (row += n, count -= n; n > 0; n--, p += WORLD_TILE_SIZE) *p = ch;
+    }
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: world_fill_row()
+ * DESCR:    Draws 'ch' in 'count' squares of row 'row', starting at 'col' and going east. The squares must all
+ *           be in the world. A sparse or blocked world is filled one tile at a time.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if a tile or a wider packed world cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+int world_fill_row(world_t *world, coord_t row, coord_t col, coord_t count, char ch) {
+    if (world->layout == WORLD_DENSE) {
+        memset(world->cells + (size_t)row * world->stride + (size_t)col, ch, (size_t)count);
+        return TERM_NORM;
+    }
+    if (world->layout == WORLD_PACKED) {
+        int index = _world_pack_index(world, ch);
+        if (index < 0) return TERM_ERR_MEMORY;
+        _world_pack_fill_row(world, row, col, count, index);
+        return TERM_NORM;
+    }
+    while (count > 0) {
+        coord_t off = col & (WORLD_TILE_SIZE - 1);
+        coord_t n   = WORLD_TILE_SIZE - off < count ? WORLD_TILE_SIZE - off : count;
+        char   *p   = _world_tile_find(world, row >> WORLD_TILE_SHIFT, col >> WORLD_TILE_SHIFT, true);
+        if (!p) return TERM_ERR_MEMORY;
+        memset(p + (row & (WORLD_TILE_SIZE - 1)) * WORLD_TILE_SIZE + off, ch, (size_t)n);
+        col   += n;
+        count -= n;
+    }
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: world_free()
+ * DESCR:    Frees the squares of 'world'.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+void world_free(world_t *world) {
+    size_t i;
+    free(world->cells);
+    for (i = 0; i < world->tile_cap; i++) free(world->tiles[i].cells);
+    free(world->tiles);
+    free(world->words);
+    world->words      = NULL;
+    world->cells      = NULL;
+    world->tiles      = NULL;
+    world->tile_cap   = 0;
+    world->tile_count = 0;
+    world->last.cells = NULL;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: world_get()
+ * DESCR:    Looks at the square at 'row', 'col'. Never allocates a tile.
+ * RETURNS:  The char in the square.
+ *------------------------------------------------------------------------------------------------------------*/
+char world_get(world_t *world, coord_t row, coord_t col) {
+    char *p;
+    if (world->layout == WORLD_DENSE) return world->cells[(size_t)row * world->stride + (size_t)col];
+    if (world->layout == WORLD_PACKED) {
+        int          per  = WORLD_WORD_BITS / world->bits;
+        world_word_t word = world->words[(size_t)row * world->row_words + (size_t)(col / per)];
+        return world->palette[(word >> (col % per * world->bits)) & (((world_word_t)1 << world->bits) - 1)];
+    }
+    p = _world_tile_find(world, row >> WORLD_TILE_SHIFT, col >> WORLD_TILE_SHIFT, false);
+    if (!p) return WORLD_BACKGROUND;
+    return p[(row & (WORLD_TILE_SIZE - 1)) * WORLD_TILE_SIZE + (col & (WORLD_TILE_SIZE - 1))];
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: world_init()
+ * DESCR:    Initializes 'world' to 'rows' x 'cols' squares of WORLD_BACKGROUND. 'layout' is one of the WORLD_*
+ *           layouts. A dense world is allocated here, as one block aligned to a cache line with the '\n' at the
+ *           end of each row already in place. A sparse world starts with an empty tile table. A packed world
+ *           starts at one bit per square with only WORLD_BACKGROUND in its palette. A blocked world is allocated
+ *           here, rounded up to whole tiles. Even if it fails, 'world' can be passed to world_free().
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the world cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+int world_init(world_t *world, coord_t rows, coord_t cols, int layout) {
+    coord_t r;
+
+    layout = _world_layout(rows, cols, layout);
+    world->layout     = layout;
+    world->rows       = rows;
+    world->cols       = cols;
+    world->cells      = NULL;
+    world->stride     = (size_t)cols + 1;
+    world->tiles      = NULL;
+    world->tile_cap   = 0;
+    world->tile_count = 0;
+    world->last.cells = NULL;
+    world->tile_cols  = (cols + WORLD_TILE_SIZE - 1) >> WORLD_TILE_SHIFT;
+    world->words      = NULL;
+    world->row_words  = 0;
+    world->bits       = 0;
+
+    if (layout == WORLD_DENSE) {
+        world->cells = (char *)_world_alloc((size_t)rows * world->stride);
+        if (!world->cells) return TERM_ERR_MEMORY;
+        memset(world->cells, WORLD_BACKGROUND, (size_t)rows * world->stride);
+        for (r = 0; r < rows; ++r) world->cells[(size_t)r * world->stride + (size_t)cols] = '\n';
+    } else if (layout == WORLD_PACKED) {
+        for (r = 0; r < 256; r++) world->index[r] = -1;
+        world->palette[0] = WORLD_BACKGROUND;
+        world->index[(unsigned char)WORLD_BACKGROUND] = 0;
+        world->colors = 1;
+        return _world_pack_alloc(world, 1);
+    } else if (layout == WORLD_BLOCKED) {
+        coord_t tile_rows = (rows + WORLD_TILE_SIZE - 1) >> WORLD_TILE_SHIFT;
+        size_t  size      = (size_t)tile_rows * (size_t)world->tile_cols * WORLD_TILE_BYTES;
+        world->cells = (char *)_world_alloc(size);
+        if (!world->cells) return TERM_ERR_MEMORY;
+        memset(world->cells, WORLD_BACKGROUND, size);
+    } else {
+        world->tiles = (world_tile_t *)calloc(WORLD_TILE_INIT_CAP, sizeof(world_tile_t));
+        if (!world->tiles) return TERM_ERR_MEMORY;
+        world->tile_cap = WORLD_TILE_INIT_CAP;
+    }
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: world_load()
+ * DESCR:    Draws the world whose text is at 'text', laid out as world_write() writes it, into 'world', which has
+ *           just been reset to the same size. A dense world is copied as one block. Otherwise each row is drawn
+ *           as runs of the same char, and runs of WORLD_BACKGROUND are skipped, so a sparse world allocates no
+ *           tile that nothing was drawn in.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if a tile or a wider packed world cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+int world_load(world_t *world, const char *text) {
+    coord_t row, col, first;
+
+    if (world->layout == WORLD_DENSE) {
+        memcpy(world->cells, text, (size_t)world->rows * world->stride);
+        return TERM_NORM;
+    }
+    for (row = 0; row < world->rows; row++, text += world->stride) {
+        for (col = 0; col < world->cols; ) {
+            char ch = text[col];
+            first = col;
+            while (col < world->cols && text[col] == ch) col++;
+            if (ch != WORLD_BACKGROUND && world_fill_row(world, row, first, col - first, ch) != TERM_NORM) {
+                return TERM_ERR_MEMORY;
+            }
+        }
+    }
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: world_reset()
+ * DESCR:    Like world_init(), but for a 'world' which may already hold a world. If it has the same size and
+ *           layout, its memory is kept and only cleared to WORLD_BACKGROUND, so a program which runs many
+ *           scripts does not allocate a world for each one. Otherwise it is freed and initialized again. A sparse
+ *           world keeps its tile table but frees its tiles; a packed world which was widened starts over.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the world cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+int world_reset(world_t *world, coord_t rows, coord_t cols, int layout) {
+    coord_t r;
+    size_t  i;
+
+    layout = _world_layout(rows, cols, layout);
+    if (layout != world->layout || rows != world->rows || cols != world->cols ||
+        !(world->cells || world->tiles || world->words) || (layout == WORLD_PACKED && world->bits != 1)) {
+        world_free(world);
+        return world_init(world, rows, cols, layout);
+    }
+
+    if (layout == WORLD_DENSE) {
+        char *row = world->cells;
+        for (r = 0; r < rows; r++, row += world->stride) memset(row, WORLD_BACKGROUND, (size_t)cols);
+    } else if (layout == WORLD_PACKED) {
+        for (i = 1; i < (size_t)world->colors; i++) world->index[(unsigned char)world->palette[i]] = -1;
+        world->colors = 1;
+        memset(world->words, 0, (size_t)rows * world->row_words * sizeof(world_word_t));
+    } else if (layout == WORLD_BLOCKED) {
+        coord_t tile_rows = (rows + WORLD_TILE_SIZE - 1) >> WORLD_TILE_SHIFT;
+        memset(world->cells, WORLD_BACKGROUND, (size_t)tile_rows * (size_t)world->tile_cols * WORLD_TILE_BYTES);
+    } else {
+        for (i = 0; i < world->tile_cap; i++) free(world->tiles[i].cells);
+        memset(world->tiles, 0, world->tile_cap * sizeof(world_tile_t));
+        world->tile_count = 0;
+        world->last.cells = NULL;
+    }
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: world_write()
+ * DESCR:    Writes 'world' to 'file', one line per row. A dense world already has the newlines in it, so it is
+ *           a single write. The output is flushed right away so that it is not overtaken by verbose output on
+ *           stdout.
+ * RETURNS:  TERM_NORM, TERM_ERR_MEMORY if a buffer for the output cannot be allocated, or the status of 'file'
+ *           (see file_flush()).
+ *------------------------------------------------------------------------------------------------------------*/
+int world_write(world_t *world, file_t *file) {
+    int status = TERM_NORM;
+    if (world->layout == WORLD_DENSE) file_write(file, world->cells, (size_t)world->rows * world->stride);
+    else if (world->layout == WORLD_PACKED) status = _world_write_packed(world, file);
+    else if (world->layout == WORLD_BLOCKED) status = _world_write_blocked(world, file);
+    else status = _world_write_sparse(world, file);
+    if (file_flush(file) != TERM_NORM) return file->status;
+    return status;
+}
+
+/*========================================= STATIC FUNCTION DEFINITIONS ======================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _world_alloc()
+ * DESCR:    Allocates 'size' bytes aligned to a cache line.
+ * RETURNS:  The block, or NULL if it cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+static void *_world_alloc(size_t size) {
+    void *block;
+    if (posix_memalign(&block, 64, size)) return NULL;
+    return block;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _world_blank()
+ * DESCR:    Writes 'count' squares of WORLD_BACKGROUND to 'file'. The blanks are on the stack, not in a static
+ *           buffer, so that worlds can be written from more than one thread.
+ * RETURNS:  Nothing. Errors are left in file->status.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _world_blank(file_t *file, coord_t count) {
+    char blank[WORLD_BLANK_SIZE];
+    memset(blank, WORLD_BACKGROUND, count < WORLD_BLANK_SIZE ? (size_t)count : WORLD_BLANK_SIZE);
+    for (; count > WORLD_BLANK_SIZE; count -= WORLD_BLANK_SIZE) file_write(file, blank, WORLD_BLANK_SIZE);
+    file_write(file, blank, (size_t)count);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _world_layout()
+ * DESCR:    Picks the layout for a 'rows' x 'cols' world when 'layout' is WORLD_AUTO: WORLD_DENSE if the world is
+ *           at most WORLD_DENSE_MAX bytes, WORLD_SPARSE otherwise.
+ * RETURNS:  The layout.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _world_layout(coord_t rows, coord_t cols, int layout) {
+    if (layout != WORLD_AUTO) return layout;
+    return rows <= WORLD_DENSE_MAX / (cols + 1) ? WORLD_DENSE : WORLD_SPARSE;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _world_pack_alloc()
+ * DESCR:    Allocates the words of a packed world for 'bits' bits per square, all zero, i.e., WORLD_BACKGROUND.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the words cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _world_pack_alloc(world_t *world, int bits) {
+    int    per  = WORLD_WORD_BITS / bits;
+    size_t size;
+
+    world->bits      = bits;
+    world->row_words = (size_t)((world->cols + per - 1) / per);
+    size = (size_t)world->rows * world->row_words * sizeof(world_word_t);
+    world->words = (world_word_t *)_world_alloc(size);
+    if (!world->words) return TERM_ERR_MEMORY;
+    memset(world->words, 0, size);
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _world_pack_fill_col()
+ * DESCR:    Stores palette index 'index' in 'count' squares of column 'col' of a packed world, starting at 'row'
+ *           and going south. The squares are all at the same place in the same word of each row.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _world_pack_fill_col(world_t *world, coord_t col, coord_t row, coord_t count, int index) {
+    int           per   = WORLD_WORD_BITS / world->bits;
+    int           shift = (int)(col % per) * world->bits;
+    world_word_t  mask  = (((world_word_t)1 << world->bits) - 1) << shift;
+    world_word_t  value = (world_word_t)index << shift;
+    world_word_t *p     = world->words + (size_t)row * world->row_words + (size_t)(col / per);
+
+    for (; count > 0; count--, p += world->row_words) *p = (*p & ~mask) | value;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _world_pack_fill_row()
+ * DESCR:    Stores palette index 'index' in 'count' squares of row 'row' of a packed world, starting at 'col' and
+ *           going east. The words at the two ends of the run are merged under a mask; every word in between is
+ *           simply overwritten with 'index' repeated across the word.
+ * RETURNS:  Nothing.
+ *------------------------------------------------------------------------------------------------------------*/
+static void _world_pack_fill_row(world_t *world, coord_t row, coord_t col, coord_t count, int index) {
+    int           per     = WORLD_WORD_BITS / world->bits;
+    world_word_t  pattern = _world_pack_pattern(world, index);
+    world_word_t *p       = world->words + (size_t)row * world->row_words;
+    coord_t       first   = col / per, last = (col + count - 1) / per, w;
+    world_word_t  head    = ~(world_word_t)0 << (col % per * world->bits);
+    int           end     = (int)((col + count - 1) % per + 1) * world->bits;
+    world_word_t  tail    = end == WORLD_WORD_BITS ? ~(world_word_t)0 : ((world_word_t)1 << end) - 1;
+
+    if (first == last) {
+        head &= tail;
+        p[first] = (p[first] & ~head) | (pattern & head);
+        return;
+    }
+    p[first] = (p[first] & ~head) | (pattern & head);
+    for (w = first + 1; w < last; w++) p[w] = pattern;
+    p[last] = (p[last] & ~tail) | (pattern & tail);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _world_pack_index()
+ * DESCR:    Looks up the palette index of 'ch' in a packed world. A char which has not been drawn before is
+ *           added to the palette, and if the palette no longer fits in world->bits, the world is widened.
+ * RETURNS:  The palette index, or -1 if the world needed widening and the wider world cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _world_pack_index(world_t *world, char ch) {
+    int index = world->index[(unsigned char)ch];
+    if (index >= 0) return index;
+    if (world->colors + 1 > 1 << world->bits && _world_pack_widen(world) != TERM_NORM) return -1;
+    index = world->colors++;
+    world->palette[index] = ch;
+    world->index[(unsigned char)ch] = (short)index;
+    return index;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _world_pack_pattern()
+ * DESCR:    Repeats palette index 'index' in every square of a word.
+ * RETURNS:  The word.
+ *------------------------------------------------------------------------------------------------------------*/
+static world_word_t _world_pack_pattern(world_t *world, int index) {
+    world_word_t pattern = (world_word_t)index;
+    int          width;
+    for (width = world->bits; width < WORLD_WORD_BITS; width *= 2) pattern |= pattern << width;
+    return pattern;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _world_pack_widen()
+ * DESCR:    Doubles the bits per square of a packed world, copying every square into a new block of words. This
+ *           happens at most three times (1 -> 2 -> 4 -> 8 bits), the first time a script draws with its 2nd, 4th
+ *           and 16th distinct char.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the new words cannot be allocated. The world is then unchanged.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _world_pack_widen(world_t *world) {
+    world_word_t *old      = world->words;
+    size_t        old_row  = world->row_words;
+    int           old_bits = world->bits, old_per = WORLD_WORD_BITS / old_bits, per;
+    world_word_t  old_mask = ((world_word_t)1 << old_bits) - 1;
+    coord_t       r, c;
+
+    if (_world_pack_alloc(world, old_bits * 2) != TERM_NORM) {
+        world->words     = old;
+        world->row_words = old_row;
+        world->bits      = old_bits;
+        return TERM_ERR_MEMORY;
+    }
+    per = WORLD_WORD_BITS / world->bits;
+    for (r = 0; r < world->rows; r++) {
+        world_word_t *src = old + (size_t)r * old_row, *dst = world->words + (size_t)r * world->row_words;
+        for (c = 0; c < world->cols; c++) {
+            world_word_t v = (src[c / old_per] >> (c % old_per * old_bits)) & old_mask;
+            dst[c / per] |= v << (c % per * world->bits);
+        }
+    }
+    free(old);
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _world_tile_cmp()
+ * DESCR:    qsort() comparison function which orders tiles by tile row and then by tile col.
+ * RETURNS:  Negative, zero or positive as 'a' comes before, with or after 'b'.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _world_tile_cmp(const void *a, const void *b) {
+    const world_tile_t *ta = (const world_tile_t *)a, *tb = (const world_tile_t *)b;
+    if (ta->trow != tb->trow) return ta->trow < tb->trow ? -1 : 1;
+    if (ta->tcol != tb->tcol) return ta->tcol < tb->tcol ? -1 : 1;
+    return 0;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _world_tile_find()
+ * DESCR:    Looks up the tile at tile row 'trow', tile col 'tcol' of a sparse or blocked world. In a blocked world
+ *           the tile is simply computed. In a sparse world, if there is none and 'create' is true, a tile of
+ *           WORLD_BACKGROUND is allocated and added to the table. The table is grown before it can be more than
+ *           half full, so a probe always ends at an empty slot.
+ * RETURNS:  The squares of the tile, or NULL if there is no tile and 'create' is false or the tile cannot be
+ *           allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+static char *_world_tile_find(world_t *world, coord_t trow, coord_t tcol, bool create) {
+    world_tile_t *slot;
+    size_t        mask = world->tile_cap - 1, i;
+
+    if (world->layout == WORLD_BLOCKED) {
+        return world->cells + ((size_t)trow * world->tile_cols + (size_t)tcol) * WORLD_TILE_BYTES;
+    }
+
+    if (world->last.cells && world->last.trow == trow && world->last.tcol == tcol) return world->last.cells;
+    for (i = _world_tile_hash(world, trow, tcol); ; i = (i + 1) & mask) {
+        slot = &world->tiles[i];
+        if (!slot->cells) break;
+        if (slot->trow == trow && slot->tcol == tcol) {
+            world->last = *slot;
+            return slot->cells;
+        }
+    }
+    if (!create) return NULL;
+
+    if ((world->tile_count + 1) * 2 > world->tile_cap) {
+        if (_world_tile_grow(world) != TERM_NORM) return NULL;
+        mask = world->tile_cap - 1;
+        for (i = _world_tile_hash(world, trow, tcol); world->tiles[i].cells; i = (i + 1) & mask) ;
+        slot = &world->tiles[i];
+    }
+    slot->cells = (char *)_world_alloc(WORLD_TILE_BYTES);
+    if (!slot->cells) return NULL;
+    slot->trow  = trow;
+    slot->tcol  = tcol;
+    memset(slot->cells, WORLD_BACKGROUND, WORLD_TILE_BYTES);
+    world->last = *slot;
+    world->tile_count++;
+    return slot->cells;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _world_tile_grow()
+ * DESCR:    Doubles the size of the tile table of a sparse world and rehashes the tiles into it.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the table cannot be grown. The table is then unchanged.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _world_tile_grow(world_t *world) {
+    world_tile_t *old = world->tiles;
+    size_t        old_cap = world->tile_cap, i, j;
+
+    world->tiles = (world_tile_t *)calloc(old_cap * 2, sizeof(world_tile_t));
+    if (!world->tiles) {
+        world->tiles = old;
+        return TERM_ERR_MEMORY;
+    }
+    world->tile_cap = old_cap * 2;
+    for (i = 0; i < old_cap; i++) {
+        if (!old[i].cells) continue;
+        for (j = _world_tile_hash(world, old[i].trow, old[i].tcol); world->tiles[j].cells;
+             j = (j + 1) & (world->tile_cap - 1)) ;
+        world->tiles[j] = old[i];
+    }
+    free(old);
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _world_tile_hash()
+ * DESCR:    Hashes a tile row and tile col. Multiplying by large odd constants spreads neighboring tiles, which
+ *           are the common case, across the whole table.
+ * RETURNS:  The slot in the tile table where the search for the tile starts.
+ *------------------------------------------------------------------------------------------------------------*/
+static size_t _world_tile_hash(world_t *world, coord_t trow, coord_t tcol) {
+    unsigned long long h = (unsigned long long)trow * 0x9E3779B97F4A7C15ULL ^
+                           (unsigned long long)tcol * 0xC2B2AE3D27D4EB4FULL;
+    return (size_t)(h ^ (h >> 29)) & (world->tile_cap - 1);
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _world_write_blocked()
+ * DESCR:    Writes a blocked world to the output file. Each band of tiles is detiled into a buffer which holds
+ *           the band's rows exactly as they are written, newlines included: one memcpy() per tile row, which
+ *           reads each tile front to back. The buffer is then written with one file_write().
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the band buffer cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _world_write_blocked(world_t *world, file_t *file) {
+    char    *band = (char *)malloc(WORLD_TILE_SIZE * world->stride);
+    coord_t  row, tcol, r;
+
+    if (!band) return TERM_ERR_MEMORY;
+    for (row = 0; row < world->rows; row += WORLD_TILE_SIZE) {
+        coord_t band_rows = world->rows - row < WORLD_TILE_SIZE ? world->rows - row : WORLD_TILE_SIZE;
+        for (tcol = 0; tcol < world->tile_cols; tcol++) {
+            char   *tile  = _world_tile_find(world, row >> WORLD_TILE_SHIFT, tcol, false);
+            coord_t start = tcol << WORLD_TILE_SHIFT;
+            coord_t width = world->cols - start < WORLD_TILE_SIZE ? world->cols - start : WORLD_TILE_SIZE;
+            for (r = 0; r < band_rows; r++) {
+                memcpy(band + r * world->stride + start, tile + r * WORLD_TILE_SIZE, (size_t)width);
+            }
+        }
+        for (r = 0; r < band_rows; r++) band[r * world->stride + world->cols] = '\n';
+        file_write(file, band, (size_t)band_rows * world->stride);
+    }
+    free(band);
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _world_write_packed()
+ * DESCR:    Writes a packed world to 'file'. Each row is decoded into a line buffer a word at a time: a
+ *           word which is all background is a memset(), and any other word is decoded a byte at a time from a
+ *           table of the chars each possible byte stands for.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the line buffer cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _world_write_packed(world_t *world, file_t *file) {
+    char          decode[256][8];
+    int           per   = WORLD_WORD_BITS / world->bits, per_byte = CHAR_BIT / world->bits, b, i;
+    world_word_t  mask  = ((world_word_t)1 << world->bits) - 1;
+    char         *line  = (char *)malloc(world->row_words * per + 1);
+    coord_t       r;
+    size_t        w;
+
+    if (!line) return TERM_ERR_MEMORY;
+    for (b = 0; b < 256; b++) {
+        for (i = 0; i < per_byte; i++) decode[b][i] = world->palette[(b >> (i * world->bits)) & mask];
+    }
+    for (r = 0; r < world->rows; r++) {
+        world_word_t *src = world->words + (size_t)r * world->row_words;
+        char         *out = line;
+        for (w = 0; w < world->row_words; w++, out += per) {
+            world_word_t word = src[w];
+            if (!word) {
+                memset(out, WORLD_BACKGROUND, per);
+                continue;
+            }
+            for (i = 0; i < per; i += per_byte, word >>= CHAR_BIT) memcpy(out + i, decode[word & 0xFF], per_byte);
+        }
+        line[world->cols] = '\n';
+        file_write(file, line, (size_t)world->cols + 1);
+    }
+    free(line);
+    return TERM_NORM;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _world_write_sparse()
+ * DESCR:    Writes a sparse world to 'file'. The tiles are sorted into the order they appear in the
+ *           output, then the world is written one band of WORLD_TILE_SIZE rows at a time. Each row of a band is
+ *           the row of each tile in the band, in order, with background written for the gaps between them. The
+ *           work is proportional to the size of the output plus the number of tiles, and nothing is allocated
+ *           for a tile which was never drawn in.
+ * RETURNS:  TERM_NORM, or TERM_ERR_MEMORY if the sort array cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+static int _world_write_sparse(world_t *world, file_t *file) {
+    world_tile_t *sorted;
+    size_t        n = 0, i, band_first, band_end;
+    coord_t       row = 0;
+
+    sorted = (world_tile_t *)malloc((world->tile_count + 1) * sizeof(world_tile_t));
+    if (!sorted) return TERM_ERR_MEMORY;
+    for (i = 0; i < world->tile_cap; i++) if (world->tiles[i].cells) sorted[n++] = world->tiles[i];
+    qsort(sorted, n, sizeof(world_tile_t), _world_tile_cmp);
+
+    for (band_first = 0; row < world->rows; band_first = band_end) {
+        coord_t trow = row >> WORLD_TILE_SHIFT;
+        coord_t band_rows = world->rows - row < WORLD_TILE_SIZE ? world->rows - row : WORLD_TILE_SIZE;
+        coord_t r;
+        for (band_end = band_first; band_end < n && sorted[band_end].trow == trow; band_end++) ;
+        for (r = 0; r < band_rows; r++) {
+            coord_t col = 0;
+            for (i = band_first; i < band_end; i++) {
+                coord_t start = sorted[i].tcol << WORLD_TILE_SHIFT;
+                coord_t width = world->cols - start < WORLD_TILE_SIZE ? world->cols - start : WORLD_TILE_SIZE;
+                _world_blank(file, start - col);
+                file_write(file, sorted[i].cells + r * WORLD_TILE_SIZE, (size_t)width);
+                col = start + width;
+            }
+            _world_blank(file, world->cols - col);
+            file_write_char(file, '\n');
+        }
+        row += band_rows;
+    }
+    free(sorted);
+    return TERM_NORM;
+}
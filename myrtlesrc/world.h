@@ -0,0 +1,127 @@
+/***************************************************************************************************************
+ * FILE: world.h
+ *
+ * DESCRIPTION:
+ * Declarations for Myrtle's world. See comments in world.c.
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * 20261016T1600 [JMW] added WORLD_PACKED
+ * 20261016T1700 [JMW] added WORLD_BLOCKED
+ * 20261016T1800 [JMW] functions which can fail return a status; world_write() takes the file_t to write to
+ * 20261016T1900 [JMW] added world_reset()
+ * 20261017T0800 [JMW] added world_load()
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261016T1500 [JMW] Initial revision.
+ **************************************************************************************************************/
+#ifndef __WORLD_H__
+#define __WORLD_H__
+
+#include <stddef.h>   /* For size_t. */
+#include "file.h"     /* For file_t. */
+#include "globals.h"  /* For coord_t. */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * PREPROCESSOR MACRO DEFINITIONS
+ *
+ * The ways the squares of the world can be stored. WORLD_AUTO picks WORLD_DENSE for worlds of up to
+ * WORLD_DENSE_MAX bytes and WORLD_SPARSE for anything larger. WORLD_PACKED and WORLD_BLOCKED are only used when
+ * asked for.
+ *------------------------------------------------------------------------------------------------------------*/
+#define WORLD_AUTO    0
+#define WORLD_DENSE   1
+#define WORLD_SPARSE  2
+#define WORLD_PACKED  3
+#define WORLD_BLOCKED 4
+
+#define WORLD_BACKGROUND ' '                       /* The char in every square nothing was drawn in.         */
+#define WORLD_DENSE_MAX  (64LL << 20)              /* Largest world, in bytes, that WORLD_AUTO stores dense. */
+#define WORLD_MAX_DIM    (1LL << 40)               /* Largest number of rows or cols.                        */
+#define WORLD_TILE_SHIFT 6                         /* log2 of WORLD_TILE_SIZE.                               */
+#define WORLD_TILE_SIZE  (1 << WORLD_TILE_SHIFT)   /* Squares on a side of a tile of a sparse/blocked world. */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * TYPEDEFS
+ *
+ * The unit a packed world is stored and drawn in. Each word holds several squares.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef unsigned long world_word_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * One tile of a sparse world: the tile row and tile col it covers and its WORLD_TILE_SIZE * WORLD_TILE_SIZE
+ * squares, stored row by row. A slot in the tile table whose cells is NULL is empty.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    coord_t  trow;
+    coord_t  tcol;
+    char    *cells;
+} world_tile_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * Myrtle's world.
+ *
+ * layout     -- WORLD_DENSE, WORLD_SPARSE, WORLD_PACKED or WORLD_BLOCKED.
+ * rows, cols -- The size of the world in squares.
+ *
+ * WORLD_DENSE:
+ * cells      -- One block of 'rows' rows of 'stride' chars. Each row is 'cols' squares and the '\n' that ends it,
+ *               so the block is exactly what is written to the output file.
+ * stride     -- cols + 1.
+ *
+ * WORLD_SPARSE:
+ * tiles      -- An open-addressing hash table of the tiles which have been drawn in, keyed by tile row and col.
+ *               A tile is allocated the first time a square in it is drawn, so memory grows with the area that
+ *               is drawn and not with the size of the world.
+ * tile_cap   -- The number of slots in tiles, a power of two.
+ * tile_count -- The number of tiles allocated.
+ * last       -- The tile most recently looked up. Moves draw many squares in the same tile in a row.
+ *
+ * WORLD_PACKED:
+ * words      -- 'rows' rows of 'row_words' words. Each square is a 'bits'-bit index into 'palette'; square c of a
+ *               row is in word c / (bits per word / 'bits') of the row, lowest bits first.
+ * row_words  -- Words per row. Every row starts on a word so that a row can be filled a word at a time.
+ * bits       -- Bits per square: 1, 2, 4 or 8. Starts at 1 and doubles when 'palette' outgrows it.
+ * colors     -- The number of chars in 'palette'.
+ * palette    -- The chars which have been drawn, by index. palette[0] is WORLD_BACKGROUND.
+ * index      -- The index of each char in 'palette', or -1 for a char which has not been drawn yet.
+ *
+ * WORLD_BLOCKED:
+ * cells      -- Every tile of the world, allocated up front as one block. The tiles are stored band by band (a
+ *               band is a row of tiles) and each tile's squares are stored row by row, so a step north or south
+ *               is WORLD_TILE_SIZE bytes away instead of a whole row of the world away.
+ * tile_cols  -- Tiles per band.
+ *------------------------------------------------------------------------------------------------------------*/
+typedef struct {
+    int           layout;
+    coord_t       rows;
+    coord_t       cols;
+    char         *cells;
+    size_t        stride;
+    world_tile_t *tiles;
+    size_t        tile_cap;
+    size_t        tile_count;
+    world_tile_t  last;
+    coord_t       tile_cols;
+    world_word_t *words;
+    size_t        row_words;
+    int           bits;
+    int           colors;
+    char          palette[256];
+    short         index[256];
+} world_t;
+
+/*--------------------------------------------------------------------------------------------------------------
+ * NONSTATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+extern int   world_draw(world_t *world, coord_t row, coord_t col, char ch);
+extern int   world_fill_col(world_t *world, coord_t col, coord_t row, coord_t count, char ch);
+extern int   world_fill_row(world_t *world, coord_t row, coord_t col, coord_t count, char ch);
+extern void  world_free(world_t *world);
+extern char  world_get(world_t *world, coord_t row, coord_t col);
+extern int   world_init(world_t *world, coord_t rows, coord_t cols, int layout);
+extern int   world_load(world_t *world, const char *text);
+extern int   world_reset(world_t *world, coord_t rows, coord_t cols, int layout);
+extern int   world_write(world_t *world, file_t *file);
+
+#endif
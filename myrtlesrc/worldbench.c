@@ -0,0 +1,130 @@
+/***************************************************************************************************************
+ * FILE: worldbench.c
+ *
+ * DESCRIPTION:
+ * Microbenchmark for the world layouts in world.c. Draws a vertical-heavy workload (long runs down columns, the
+ * way a script full of 'right' 'forward n' draws) and a horizontal-heavy workload (the same runs along rows) in
+ * a square world stored in each layout, checks that every layout ends up with the same squares, and reports the
+ * time to draw each workload and the time to write the world to /dev/null.
+ *
+ * Usage: worldbench [squares on a side]     (default 8192)
+ *
+ * AUTHORS: Matt Welch [JMW]
+ *
+ * MODIFICATION HISTORY:
+ * ------------------------------------------------------------------------------------------------------------
+ * 20261016T1700 [JMW] Initial revision.
+ * 20261016T1800 [JMW] writes through a file_t; no longer needs a main_terminate_err() stub
+ **************************************************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "bool.h"
+#include "file.h"
+#include "globals.h"
+#include "world.h"
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC GLOBAL CONSTANT DEFINITIONS
+ *------------------------------------------------------------------------------------------------------------*/
+static const int RUNS_PER_SIDE = 16;  /* Each workload draws this many times as many squares as the world has. */
+
+/*--------------------------------------------------------------------------------------------------------------
+ * STATIC FUNCTION DECLARATIONS (PROTOTYPES)
+ *------------------------------------------------------------------------------------------------------------*/
+static double        _bench_draw(world_t *world, bool vert, coord_t size);
+static unsigned long _bench_sum(world_t *world, coord_t size);
+static double        _bench_write(world_t *world, file_t *file);
+
+/*======================================= NONSTATIC FUNCTION DEFINITIONS =====================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: main()
+ * DESCR:    Runs both workloads on each layout and prints a table of times in milliseconds.
+ * RETURNS:  Zero if every layout drew the same squares, TERM_ERR_OUTPUT otherwise, or TERM_ERR_MEMORY if a world
+ *           cannot be allocated.
+ *------------------------------------------------------------------------------------------------------------*/
+int main(int argc, char *argv[]) {
+    static int   layouts[] = { WORLD_DENSE, WORLD_BLOCKED, WORLD_SPARSE, WORLD_PACKED };
+    static char *names[]   = { "dense", "blocked", "sparse", "packed" };
+    coord_t      size = argc > 1 ? atol(argv[1]) : 8192;
+    unsigned long sums[2];
+    int          i, vert, status = TERM_NORM;
+    static file_t file;
+
+    file_init(&file);
+    if (file_open_out(&file, "/dev/null") != TERM_NORM) return file.status;
+    printf("worldbench: %ld x %ld squares\n", (long)size, (long)size);
+    printf("%-8s %12s %12s %12s\n", "layout", "vertical ms", "horiz ms", "write ms");
+    for (i = 0; i < 4; i++) {
+        double draw[2], write = 0;
+        for (vert = 1; vert >= 0; vert--) {
+            world_t world;
+            if (world_init(&world, size, size, layouts[i]) != TERM_NORM) {
+                printf("%s: out of memory\n", names[i]);
+                return TERM_ERR_MEMORY;
+            }
+            draw[vert] = _bench_draw(&world, (bool)vert, size);
+            if (!vert) write = _bench_write(&world, &file);
+            if (!i) sums[vert] = _bench_sum(&world, size);
+            else if (sums[vert] != _bench_sum(&world, size)) status = TERM_ERR_OUTPUT;
+            world_free(&world);
+        }
+        printf("%-8s %12.1f %12.1f %12.1f%s\n", names[i], draw[1] * 1e3, draw[0] * 1e3, write * 1e3,
+               status == TERM_NORM ? "" : "  MISMATCH");
+    }
+    file_free(&file);
+    return status;
+}
+
+/*========================================= STATIC FUNCTION DEFINITIONS ======================================*/
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _bench_draw()
+ * DESCR:    Draws RUNS_PER_SIDE * 'size' runs with a pseudo-random start and a length of up to 'size' squares,
+ *           down columns if 'vert' is true and along rows otherwise, with a handful of pen chars. The sequence
+ *           is the same for every layout.
+ * RETURNS:  The time taken in seconds.
+ *------------------------------------------------------------------------------------------------------------*/
+static double _bench_draw(world_t *world, bool vert, coord_t size) {
+    static char   pens[] = "#*@+";
+    unsigned long seed = 12345;
+    coord_t       n;
+    clock_t       start = clock();
+
+    for (n = 0; n < RUNS_PER_SIDE * size; n++) {
+        coord_t line, first, count;
+        seed  = seed * 1103515245 + 12345;
+        line  = (coord_t)((seed >> 8) % (unsigned long)size);
+        first = (coord_t)((seed >> 20) % (unsigned long)size);
+        count = size - first;
+        if (vert) world_fill_col(world, line, first, count, pens[(seed >> 4) & 3]);
+        else world_fill_row(world, line, first, count, pens[(seed >> 4) & 3]);
+    }
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _bench_sum()
+ * DESCR:    Checksums every square of the world, in row order.
+ * RETURNS:  The checksum.
+ *------------------------------------------------------------------------------------------------------------*/
+static unsigned long _bench_sum(world_t *world, coord_t size) {
+    unsigned long sum = 0;
+    coord_t       r, c;
+    for (r = 0; r < size; r++) {
+        for (c = 0; c < size; c++) sum = sum * 31 + (unsigned char)world_get(world, r, c);
+    }
+    return sum;
+}
+
+/*--------------------------------------------------------------------------------------------------------------
+ * FUNCTION: _bench_write()
+ * DESCR:    Writes the world to 'file', which is /dev/null, so only the detiling/decoding is timed.
+ * RETURNS:  The time taken in seconds.
+ *------------------------------------------------------------------------------------------------------------*/
+static double _bench_write(world_t *world, file_t *file) {
+    clock_t start = clock();
+    world_write(world, file);
+    return (double)(clock() - start) / CLOCKS_PER_SEC;
+}